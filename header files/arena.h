@@ -0,0 +1,213 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include "profiler.h"
+
+// what a FrameArena starts with. it grows to fit the busiest frame it has seen, so this only needs to be a guess
+constexpr size_t FRAME_ARENA_SIZE = 64 * 1024;
+// blocks a PoolResource takes from upstream at a time once its free list runs dry
+constexpr size_t POOL_BLOCKS_PER_CHUNK = 256;
+
+#ifdef TRACK_HEAP_ALLOCATIONS
+// bumped by the replacement operator new in main.cpp, so the profiler can show allocations per frame. a frame that
+// isn't doing anything new (no loading, no window resize) should come out at zero
+inline std::atomic<unsigned long long> heapAllocations{0};
+#endif
+
+// a linear allocator for anything that only has to live for one frame. allocating bumps a pointer, freeing does
+// nothing, and reset() throws the lot away at once. it's a memory_resource, so pmr containers can sit on top of it.
+// if a frame needs more than the arena has, the extra comes from upstream and on the next reset the arena grows to
+// the new high water mark, so after the first few frames it never allocates again.
+// not thread safe; one arena per thread (or per frame in flight) instead
+class FrameArena : public std::pmr::memory_resource {
+    public:
+
+        explicit FrameArena(const size_t capacity = FRAME_ARENA_SIZE,
+                            std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : upstream(upstream), capacity(std::max<size_t>(capacity, 64)) {
+            block = static_cast<std::byte *>(upstream->allocate(this->capacity, alignof(std::max_align_t)));
+        }
+
+        FrameArena(const FrameArena &) = delete;
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        ~FrameArena() override {
+            releaseOverflow();
+            upstream->deallocate(block, capacity, alignof(std::max_align_t));
+        }
+
+        // frees everything allocated since the last reset. nothing allocated from the arena may be used after this
+        void reset() {
+            if (overflow) {
+                releaseOverflow();
+                // one block big enough for the whole of that frame, with room to spare
+                const size_t grown = std::max(capacity * 2, peak + peak / 2);
+                upstream->deallocate(block, capacity, alignof(std::max_align_t));
+                capacity = grown;
+                block = static_cast<std::byte *>(upstream->allocate(capacity, alignof(std::max_align_t)));
+            }
+            used = 0;
+            peak = 0;
+        }
+
+        // bytes handed out since the last reset, including any that spilled upstream
+        [[nodiscard]] size_t bytesUsed() const {
+            return peak;
+        }
+
+        [[nodiscard]] size_t bytesReserved() const {
+            return capacity;
+        }
+
+    private:
+
+        // an allocation that didn't fit, chained through a header at the front so keeping track of them doesn't
+        // itself need a container
+        struct Overflow {
+            Overflow *next;
+            size_t size;
+            size_t alignment;
+        };
+
+        std::pmr::memory_resource *upstream;
+        std::byte *block = nullptr;
+        size_t capacity;
+        size_t used = 0;
+        size_t peak = 0;
+        Overflow *overflow = nullptr;
+
+        void *do_allocate(const size_t bytes, const size_t alignment) override {
+            const auto base = reinterpret_cast<uintptr_t>(block);
+            const uintptr_t aligned = (base + used + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            const size_t end = static_cast<size_t>(aligned - base) + bytes;
+            peak += bytes;
+            if (end <= capacity) {
+                used = end;
+                return reinterpret_cast<void *>(aligned);
+            }
+
+            const size_t header = (sizeof(Overflow) + alignment - 1) / alignment * alignment;
+            const size_t size = header + bytes;
+            const size_t spillAlignment = std::max(alignment, alignof(Overflow));
+            auto *spill = static_cast<std::byte *>(upstream->allocate(size, spillAlignment));
+            overflow = new (spill) Overflow{overflow, size, spillAlignment};
+            profiler.addCounter("Frame arena overflows", 1.0);
+            return spill + header;
+        }
+
+        void do_deallocate(void *, size_t, size_t) override {
+            // freed all at once by reset
+        }
+
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+
+        void releaseOverflow() {
+            while (overflow) {
+                Overflow *next = overflow->next;
+                upstream->deallocate(overflow, overflow->size, overflow->alignment);
+                overflow = next;
+            }
+        }
+};
+
+// hands out blocks of one fixed size from a free list, for small objects that come and go all the time (jobs,
+// render items). freed blocks are kept for reuse rather than given back, so once it has seen its busiest moment it
+// never allocates again. anything bigger than a block goes straight to upstream. safe to use from any thread
+class PoolResource : public std::pmr::memory_resource {
+    public:
+
+        explicit PoolResource(const size_t blockSize, const size_t blocksPerChunk = POOL_BLOCKS_PER_CHUNK,
+                              std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : upstream(upstream),
+              blockSize((std::max(blockSize, sizeof(FreeBlock)) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t)),
+              blocksPerChunk(std::max<size_t>(blocksPerChunk, 1)) {}
+
+        PoolResource(const PoolResource &) = delete;
+        PoolResource &operator=(const PoolResource &) = delete;
+
+        ~PoolResource() override {
+            while (chunks) {
+                Chunk *next = chunks->next;
+                upstream->deallocate(chunks, chunkBytes(), alignof(std::max_align_t));
+                chunks = next;
+            }
+        }
+
+        [[nodiscard]] size_t blocksInUse() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return inUse;
+        }
+
+    private:
+
+        struct FreeBlock {
+            FreeBlock *next;
+        };
+
+        // sits in front of a chunk's blocks, padded so the first block is still max aligned
+        struct alignas(std::max_align_t) Chunk {
+            Chunk *next;
+        };
+
+        std::pmr::memory_resource *upstream;
+        size_t blockSize;
+        size_t blocksPerChunk;
+        mutable std::mutex mutex;
+        FreeBlock *freeList = nullptr;
+        Chunk *chunks = nullptr;
+        size_t inUse = 0;
+
+        [[nodiscard]] size_t chunkBytes() const {
+            return sizeof(Chunk) + blockSize * blocksPerChunk;
+        }
+
+        [[nodiscard]] bool fits(const size_t bytes, const size_t alignment) const {
+            return bytes <= blockSize && alignment <= alignof(std::max_align_t);
+        }
+
+        void *do_allocate(const size_t bytes, const size_t alignment) override {
+            if (!fits(bytes, alignment)) {
+                return upstream->allocate(bytes, alignment);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeList) {
+                auto *chunk = static_cast<Chunk *>(upstream->allocate(chunkBytes(), alignof(std::max_align_t)));
+                chunk->next = chunks;
+                chunks = chunk;
+                auto *blocks = reinterpret_cast<std::byte *>(chunk + 1);
+                // threaded back to front, so blocks are handed out in address order
+                for (size_t i = blocksPerChunk; i-- > 0;) {
+                    freeList = new (blocks + i * blockSize) FreeBlock{freeList};
+                }
+            }
+            FreeBlock *block = freeList;
+            freeList = block->next;
+            inUse++;
+            return block;
+        }
+
+        void do_deallocate(void *pointer, const size_t bytes, const size_t alignment) override {
+            if (!fits(bytes, alignment)) {
+                upstream->deallocate(pointer, bytes, alignment);
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            freeList = new (pointer) FreeBlock{freeList};
+            inUse--;
+        }
+
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+};
+
+#endif //ARENA_H
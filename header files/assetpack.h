@@ -0,0 +1,297 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bakedasset.h"
+#include "lz4.h"
+#include "mappedfile.h"
+
+// every baked model and texture in one file, so startup is one open and one map however many assets there are.
+// the asset baker writes it after each run from its per asset outputs
+constexpr char ASSET_PACK_MAGIC[4] = {'P', 'A', 'C', 'K'};
+constexpr uint32_t ASSET_PACK_VERSION = 1;
+constexpr char ASSET_PACK_PATH[] = BAKED_ASSET_ROOT "/assets.pack";
+// every blob starts on this boundary, so whatever's inside it is at its natural alignment wherever the pack is mapped
+constexpr uint64_t ASSET_PACK_ALIGNMENT = 64;
+// a blob is only stored compressed if that makes it a quarter of the size or less, which in practice is the flat and
+// mostly flat textures. anything that compresses worse (photos, vertices) costs less read straight out of the mapping
+// and handed to gl as it is than decompressed into a copy first, unless the disk is slower than the decoder
+constexpr double ASSET_PACK_MAX_COMPRESSED_RATIO = 0.25;
+
+constexpr uint16_t ASSET_PACK_MODEL = 0;
+constexpr uint16_t ASSET_PACK_TEXTURE = 1;
+constexpr uint16_t ASSET_PACK_SRGB_TEXTURE = 2;
+
+constexpr uint16_t ASSET_PACK_STORED = 0;
+constexpr uint16_t ASSET_PACK_LZ4 = 1;
+
+// a pack is an AssetPackHeader, entryCount AssetPackEntries, stringBytes of nul terminated source paths, then the
+// blobs, each on an ASSET_PACK_ALIGNMENT boundary. offsets are from the start of the file
+struct AssetPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t stringBytes;
+    uint64_t stringOffset;
+    // hash of the baker outputs that went in, so the baker can tell the pack is already up to date
+    uint64_t contentKey;
+};
+
+// the table of contents is sorted by source path then kind, so finding an asset is a binary search
+struct AssetPackEntry {
+    uint64_t offset;
+    // the bytes in the pack, and the bytes of the baked file they decode to. the same when it's stored
+    uint64_t storedSize;
+    uint64_t size;
+    uint32_t source;
+    uint16_t kind;
+    uint16_t codec;
+};
+
+inline uint16_t assetPackKind(const bool texture, const bool srgb) {
+    return texture ? (srgb ? ASSET_PACK_SRGB_TEXTURE : ASSET_PACK_TEXTURE) : ASSET_PACK_MODEL;
+}
+
+class AssetPack {
+    public:
+
+        // one baked file's bytes. a stored blob points straight into the mapping, so it can go from there to gl with
+        // nothing copied; a compressed one is decoded into its own buffer
+        struct Blob {
+            const unsigned char *mapped = nullptr;
+            size_t size = 0;
+            std::vector<unsigned char> decompressed;
+
+            [[nodiscard]] const unsigned char *data() const {
+                return decompressed.empty() ? mapped : decompressed.data();
+            }
+
+            explicit operator bool() const {
+                return data() != nullptr;
+            }
+        };
+
+        // false if there's no pack at path, or it's from another version of the baker or damaged
+        bool open(const std::string &path) {
+            close();
+            if (!file.open(path)) {
+                return false;
+            }
+            const unsigned char *bytes = file.data();
+            const size_t length = file.size();
+            header = reinterpret_cast<const AssetPackHeader *>(bytes);
+            // sizes are compared against what's left rather than summed, so a damaged offset can't wrap round past the end
+            if (length < sizeof(AssetPackHeader) || std::memcmp(header->magic, ASSET_PACK_MAGIC, sizeof(header->magic)) != 0 ||
+                header->version != ASSET_PACK_VERSION || header->entryCount > (length - sizeof(AssetPackHeader)) / sizeof(AssetPackEntry) ||
+                header->stringOffset > length || header->stringBytes > length - header->stringOffset ||
+                (header->stringBytes > 0 && bytes[header->stringOffset + header->stringBytes - 1] != 0)) {
+                close();
+                return false;
+            }
+            entries = reinterpret_cast<const AssetPackEntry *>(bytes + sizeof(AssetPackHeader));
+            strings = reinterpret_cast<const char *>(bytes + header->stringOffset);
+            for (uint32_t i = 0; i < header->entryCount; i++) {
+                // an lz4 block can't decode to more than 255 times its size, so a bigger size is damage and would
+                // otherwise be allocated for
+                const AssetPackEntry &entry = entries[i];
+                if (entry.source >= header->stringBytes || entry.offset > length || entry.storedSize > length - entry.offset ||
+                    (entry.codec == ASSET_PACK_LZ4 && entry.size / 255 > entry.storedSize)) {
+                    close();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // blobs already read stay valid, their bytes are copied or uploaded by then
+        void close() {
+            file.close();
+            header = nullptr;
+            entries = nullptr;
+            strings = nullptr;
+        }
+
+        [[nodiscard]] bool loaded() const {
+            return header != nullptr;
+        }
+
+        // 0 if nothing's loaded
+        [[nodiscard]] uint64_t contentKey() const {
+            return header ? header->contentKey : 0;
+        }
+
+        // the baked bytes for source, empty if it isn't in the pack or won't decode. safe from several threads at once
+        [[nodiscard]] Blob read(const std::string &source, const bool texture = false, const bool srgb = false) {
+            Blob blob;
+            const AssetPackEntry *entry = find(AssetManifest::normalise(source), assetPackKind(texture, srgb));
+            if (!entry) {
+                return blob;
+            }
+            const unsigned char *stored = file.data() + entry->offset;
+            blob.size = static_cast<size_t>(entry->size);
+            if (entry->codec == ASSET_PACK_STORED && entry->storedSize == entry->size) {
+                blob.mapped = stored;
+            } else if (entry->codec == ASSET_PACK_LZ4) {
+                blob.decompressed.resize(blob.size);
+                if (!lz4Decompress(stored, static_cast<size_t>(entry->storedSize), blob.decompressed.data(), blob.size)) {
+                    std::cout << "ASSETS: " << source << " is damaged in the pack, run AssetBaker" << std::endl;
+                    return {};
+                }
+                bytesDecompressed += entry->size;
+            } else {
+                return {};
+            }
+            blobsRead++;
+            bytesRead += entry->storedSize;
+            return blob;
+        }
+
+        // what's been read since startup, for the load report
+        [[nodiscard]] uint32_t blobCount() const {
+            return blobsRead;
+        }
+
+        [[nodiscard]] uint64_t readBytes() const {
+            return bytesRead;
+        }
+
+        [[nodiscard]] uint64_t decompressedBytes() const {
+            return bytesDecompressed;
+        }
+
+    private:
+
+        MappedFile file;
+        const AssetPackHeader *header = nullptr;
+        const AssetPackEntry *entries = nullptr;
+        const char *strings = nullptr;
+        std::atomic<uint32_t> blobsRead = 0;
+        std::atomic<uint64_t> bytesRead = 0;
+        std::atomic<uint64_t> bytesDecompressed = 0;
+
+        [[nodiscard]] const AssetPackEntry *find(const std::string &source, const uint16_t kind) const {
+            if (!header) {
+                return nullptr;
+            }
+            const AssetPackEntry *end = entries + header->entryCount;
+            const AssetPackEntry *found = std::lower_bound(entries, end, kind, [this, &source](const AssetPackEntry &entry, const uint16_t key) {
+                const int order = std::strcmp(strings + entry.source, source.c_str());
+                return order < 0 || (order == 0 && entry.kind < key);
+            });
+            if (found == end || found->kind != kind || source != strings + found->source) {
+                return nullptr;
+            }
+            return found;
+        }
+};
+
+// what the game loads its models and textures from. main opens it before the first model and closes it once the
+// textures are uploaded
+inline AssetPack assetPack;
+
+// ---- writing, for the asset baker ----
+
+// one baked file on its way into a pack
+struct AssetPackBlob {
+    std::string source;
+    uint16_t kind = ASSET_PACK_MODEL;
+    std::string bytes;
+    // the lz4 block it's stored as, empty if it's stored as it is
+    std::vector<unsigned char> compressed;
+};
+
+// compresses the blob if that gets it under ASSET_PACK_MAX_COMPRESSED_RATIO. blobs are independent, so the baker does
+// these in parallel
+inline void compressAssetPackBlob(AssetPackBlob &blob) {
+    lz4Compress(reinterpret_cast<const unsigned char *>(blob.bytes.data()), blob.bytes.size(), blob.compressed);
+    if (static_cast<double>(blob.compressed.size()) > static_cast<double>(blob.bytes.size()) * ASSET_PACK_MAX_COMPRESSED_RATIO) {
+        blob.compressed = {};
+    }
+}
+
+// writes the blobs as a pack at path, sorting them into the order AssetPack::find searches them in. written next to
+// where it's going and renamed over it, so the game never maps half a pack. false if it couldn't be written; status
+// says what happened either way
+inline bool writeAssetPack(const std::string &path, std::vector<AssetPackBlob> &blobs, const uint64_t contentKey, std::string &status) {
+    std::sort(blobs.begin(), blobs.end(), [](const AssetPackBlob &a, const AssetPackBlob &b) {
+        return a.source != b.source ? a.source < b.source : a.kind < b.kind;
+    });
+
+    const auto align = [](const uint64_t offset) {
+        return (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+    };
+    std::vector<char> strings;
+    std::vector<AssetPackEntry> entries(blobs.size());
+    for (size_t i = 0; i < blobs.size(); i++) {
+        entries[i].source = static_cast<uint32_t>(strings.size());
+        strings.insert(strings.end(), blobs[i].source.c_str(), blobs[i].source.c_str() + blobs[i].source.size() + 1);
+    }
+    AssetPackHeader header{};
+    std::memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+    header.stringOffset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry);
+    header.contentKey = contentKey;
+    uint64_t offset = header.stringOffset + strings.size();
+    uint64_t stored = 0, raw = 0;
+    int compressed = 0;
+    for (size_t i = 0; i < blobs.size(); i++) {
+        const bool useCompressed = !blobs[i].compressed.empty();
+        offset = align(offset);
+        entries[i].offset = offset;
+        entries[i].size = blobs[i].bytes.size();
+        entries[i].storedSize = useCompressed ? blobs[i].compressed.size() : blobs[i].bytes.size();
+        entries[i].kind = blobs[i].kind;
+        entries[i].codec = useCompressed ? ASSET_PACK_LZ4 : ASSET_PACK_STORED;
+        offset += entries[i].storedSize;
+        stored += entries[i].storedSize;
+        raw += entries[i].size;
+        compressed += useCompressed ? 1 : 0;
+    }
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(AssetPackEntry)));
+        file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        const std::vector<char> padding(ASSET_PACK_ALIGNMENT, 0);
+        uint64_t written = header.stringOffset + strings.size();
+        for (size_t i = 0; i < blobs.size(); i++) {
+            file.write(padding.data(), static_cast<std::streamsize>(entries[i].offset - written));
+            const AssetPackBlob &blob = blobs[i];
+            if (entries[i].codec == ASSET_PACK_LZ4) {
+                file.write(reinterpret_cast<const char *>(blob.compressed.data()), static_cast<std::streamsize>(blob.compressed.size()));
+            } else {
+                file.write(blob.bytes.data(), static_cast<std::streamsize>(blob.bytes.size()));
+            }
+            written = entries[i].offset + entries[i].storedSize;
+        }
+        if (!file) {
+            status = "couldn't write " + temporary;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        status = "couldn't replace " + path;
+        return false;
+    }
+    std::stringstream summary;
+    summary << "packed " << blobs.size() << " assets, " << compressed << " lz4 compressed, " << raw / 1024 << " KB in " << stored / 1024 << " KB";
+    status = summary.str();
+    return true;
+}
+
+#endif //ASSETPACK_H
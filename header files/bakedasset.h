@@ -0,0 +1,321 @@
+#ifndef BAKEDASSET_H
+#define BAKEDASSET_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <rapidjson/document.h>
+#include <rapidjson/error/en.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+// bump whenever a baked layout or what the baker does to an asset changes, so every output is baked again
+constexpr uint32_t BAKED_ASSET_VERSION = 1;
+constexpr char BAKED_MODEL_MAGIC[4] = {'B', 'M', 'D', 'L'};
+constexpr char BAKED_TEXTURE_MAGIC[4] = {'B', 'T', 'E', 'X'};
+// where the asset baker keeps its outputs, each named after the hash of what went into it, and the manifest that
+// says which output belongs to which source file. the cmake build points the baker and the game at a directory in
+// the build tree instead, so building never writes into the sources
+#ifndef BAKED_ASSET_ROOT
+#define BAKED_ASSET_ROOT "resources/cache/baked"
+#endif
+constexpr char BAKED_ASSET_DIRECTORY[] = BAKED_ASSET_ROOT;
+constexpr char BAKED_ASSET_MANIFEST[] = BAKED_ASSET_ROOT "/manifest.json";
+
+// a baked model is a BakedModelHeader, meshCount BakedMeshRecords, then the data they point into: each mesh's
+// vertices, its element list (every level of detail back to back) and its BakedLodRecords, and stringBytes of nul
+// terminated texture paths at the end. offsets are from the start of the file, and everything sits at its natural
+// alignment so the file can be used where it's mapped
+
+struct BakedModelHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t stringBytes;
+    uint64_t stringOffset;
+    // bounding sphere in model space
+    float boundsCentre[3];
+    float boundsRadius;
+};
+
+// same layout as mesh.h's Vertex
+struct BakedVertex {
+    float position[3];
+    float normal[3];
+    float texCoords[2];
+};
+
+struct BakedLodRecord {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+constexpr uint32_t BAKED_NO_TEXTURE = 0xFFFFFFFFu;
+
+struct BakedMeshRecord {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t lodOffset;
+    uint32_t vertexCount;
+    // every level's indices, level 0 first
+    uint32_t indexCount;
+    uint32_t lodCount;
+    float diffuse[3];
+    float specular[3];
+    float ambient[3];
+    float shininess;
+    // offsets into the strings of the textures' source paths, BAKED_NO_TEXTURE for none
+    uint32_t diffuseTexture;
+    uint32_t specularTexture;
+};
+
+// a baked texture is a BakedTextureHeader and then every mip level from the top down, rgba8, tightly packed
+struct BakedTextureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t srgb;
+};
+
+// biggest baked texture a reader believes, well past any gl limit, so a corrupt header can't make the size sum overflow
+constexpr uint32_t BAKED_MAX_TEXTURE_SIZE = 1u << 16;
+
+// the size of a mip level's side, the same as gl works it out
+inline uint32_t bakedMipSize(const uint32_t size, const uint32_t level) {
+    return std::max(size >> level, 1u);
+}
+
+// a baked texture's header checked against the bytes it came in, and where its pixels start
+struct BakedTextureView {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t levels = 0;
+    bool srgb = false;
+    // level 0, each smaller level straight after the one before
+    const unsigned char *pixels = nullptr;
+
+    [[nodiscard]] const unsigned char *level(const uint32_t mip) const {
+        const unsigned char *at = pixels;
+        for (uint32_t l = 0; l < mip; l++) {
+            at += static_cast<size_t>(bakedMipSize(width, l)) * bakedMipSize(height, l) * 4;
+        }
+        return at;
+    }
+};
+
+// false if the bytes aren't a baked texture from this version of the baker, or are cut short. everything the size
+// sum relies on is checked first, so a stale or corrupt header can't send it round billions of levels or overflow it
+inline bool readBakedTexture(const unsigned char *bytes, const size_t size, BakedTextureView &view) {
+    view = {};
+    if (!bytes || size < sizeof(BakedTextureHeader)) {
+        return false;
+    }
+    BakedTextureHeader header{};
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != BAKED_ASSET_VERSION ||
+        header.width == 0 || header.height == 0 || header.width > BAKED_MAX_TEXTURE_SIZE || header.height > BAKED_MAX_TEXTURE_SIZE) {
+        return false;
+    }
+    uint32_t fullChain = 1;
+    while ((std::max(header.width, header.height) >> fullChain) > 0) {
+        fullChain++;
+    }
+    size_t total = sizeof(BakedTextureHeader);
+    for (uint32_t level = 0; level < fullChain; level++) {
+        total += static_cast<size_t>(bakedMipSize(header.width, level)) * bakedMipSize(header.height, level) * 4;
+    }
+    if (header.levels != fullChain || total > size) {
+        return false;
+    }
+    view = {header.width, header.height, header.levels, header.srgb != 0, bytes + sizeof(BakedTextureHeader)};
+    return true;
+}
+
+// a source file something was baked from, and what it looked like at the time
+struct AssetDependency {
+    std::string path;
+    int64_t size = -1;
+    int64_t time = 0;
+};
+
+// one node of the asset graph: a model (its obj and the mtls it pulls in) or a texture one of those mtls names.
+// a model's textures are nodes of their own, so changing an image only bakes the image again
+struct AssetRecord {
+    std::string source;
+    bool texture = false;
+    bool srgb = false;
+    // hash of everything that went into the output, which is also the output's file name
+    std::string output;
+    std::vector<AssetDependency> dependencies;
+    // for models, the textures its materials use
+    std::vector<std::string> textures;
+};
+
+// which baked output goes with which source file. it's the whole dependency graph, so the baker can tell what changed
+// since last time without opening anything that didn't. only the baker reads it, the game loads the pack it writes
+// from these outputs (assetpack.h)
+class AssetManifest {
+    public:
+
+        std::vector<AssetRecord> records;
+
+        // paths are compared in this form, so "a/./b.png" and "a/b.png" are the same asset
+        static std::string normalise(const std::string &path) {
+            return std::filesystem::path(path).lexically_normal().generic_string();
+        }
+
+        static std::string outputPath(const std::string &output) {
+            return std::string(BAKED_ASSET_DIRECTORY) + "/" + output + ".bin";
+        }
+
+        [[nodiscard]] const AssetRecord *find(const std::string &source, const bool texture = false, const bool srgb = false) const {
+            const std::string key = normalise(source);
+            for (const AssetRecord &record : records) {
+                if (record.source == key && record.texture == texture && (!texture || record.srgb == srgb)) {
+                    return &record;
+                }
+            }
+            return nullptr;
+        }
+
+        bool load(const std::string &path) {
+            records.clear();
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                return false;
+            }
+            const std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            rapidjson::Document document;
+            document.Parse(json.c_str());
+            if (document.HasParseError() || !document.IsObject()) {
+                std::cout << "ASSETS: " << path << " isn't valid json: " << rapidjson::GetParseError_En(document.GetParseError()) << std::endl;
+                return false;
+            }
+            if (!document.HasMember("version") || !document["version"].IsUint() || document["version"].GetUint() != BAKED_ASSET_VERSION) {
+                return false;
+            }
+            if (!document.HasMember("assets") || !document["assets"].IsArray()) {
+                return true;
+            }
+            // a record that isn't what save() writes is left out, so whatever it was for is baked again
+            for (const auto &value : document["assets"].GetArray()) {
+                AssetRecord record;
+                if (readRecord(value, record)) {
+                    records.push_back(std::move(record));
+                }
+            }
+            return true;
+        }
+
+        bool save(const std::string &path) const {
+            rapidjson::StringBuffer buffer;
+            rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+            writer.StartObject();
+            writer.Key("version");
+            writer.Uint(BAKED_ASSET_VERSION);
+            writer.Key("assets");
+            writer.StartArray();
+            for (const AssetRecord &record : records) {
+                writer.StartObject();
+                writer.Key("source");
+                writer.String(record.source.c_str());
+                writer.Key("type");
+                writer.String(record.texture ? "texture" : "model");
+                if (record.texture) {
+                    writer.Key("srgb");
+                    writer.Bool(record.srgb);
+                }
+                writer.Key("output");
+                writer.String(record.output.c_str());
+                writer.Key("dependencies");
+                writer.StartArray();
+                for (const AssetDependency &dependency : record.dependencies) {
+                    writer.StartObject();
+                    writer.Key("path");
+                    writer.String(dependency.path.c_str());
+                    writer.Key("size");
+                    writer.Int64(dependency.size);
+                    writer.Key("time");
+                    writer.Int64(dependency.time);
+                    writer.EndObject();
+                }
+                writer.EndArray();
+                if (!record.texture) {
+                    writer.Key("textures");
+                    writer.StartArray();
+                    for (const std::string &texture : record.textures) {
+                        writer.String(texture.c_str());
+                    }
+                    writer.EndArray();
+                }
+                writer.EndObject();
+            }
+            writer.EndArray();
+            writer.EndObject();
+
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(buffer.GetString(), static_cast<std::streamsize>(buffer.GetSize()));
+            return static_cast<bool>(file);
+        }
+
+    private:
+
+        static bool isString(const rapidjson::Value &object, const char *name) {
+            return object.HasMember(name) && object[name].IsString();
+        }
+
+        static bool readRecord(const rapidjson::Value &value, AssetRecord &record) {
+            if (!value.IsObject() || !isString(value, "source") || !isString(value, "output") || !isString(value, "type")) {
+                return false;
+            }
+            record.source = value["source"].GetString();
+            record.output = value["output"].GetString();
+            const std::string type = value["type"].GetString();
+            if ((type != "texture" && type != "model") || record.output.empty()) {
+                return false;
+            }
+            record.texture = type == "texture";
+            if (record.texture) {
+                if (!value.HasMember("srgb") || !value["srgb"].IsBool()) {
+                    return false;
+                }
+                record.srgb = value["srgb"].GetBool();
+            }
+            if (!value.HasMember("dependencies") || !value["dependencies"].IsArray()) {
+                return false;
+            }
+            for (const auto &dependency : value["dependencies"].GetArray()) {
+                if (!dependency.IsObject() || !isString(dependency, "path") || !dependency.HasMember("size") || !dependency["size"].IsInt64() ||
+                    !dependency.HasMember("time") || !dependency["time"].IsInt64()) {
+                    return false;
+                }
+                record.dependencies.push_back({dependency["path"].GetString(), dependency["size"].GetInt64(), dependency["time"].GetInt64()});
+            }
+            // every record depends on at least its own source
+            if (record.dependencies.empty()) {
+                return false;
+            }
+            if (!record.texture) {
+                if (!value.HasMember("textures") || !value["textures"].IsArray()) {
+                    return false;
+                }
+                for (const auto &texture : value["textures"].GetArray()) {
+                    if (!texture.IsString()) {
+                        return false;
+                    }
+                    record.textures.emplace_back(texture.GetString());
+                }
+            }
+            return true;
+        }
+};
+
+#endif //BAKEDASSET_H
@@ -0,0 +1,83 @@
+#ifndef BAKEDCUBEMAP_H
+#define BAKEDCUBEMAP_H
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "assetpack.h"
+#include "bakedasset.h"
+#include "hash.h"
+
+constexpr int CUBEMAP_FACES = 6;
+
+// the six faces of a cubemap as the asset baker left them in the pack: srgb rgba8, square, all the same size, with
+// every mip level. read while the pack is open, and used up (uploaded, or copied out) before it's closed, since
+// faces stored as they are point straight into the mapping. one missing or the wrong size makes the whole thing
+// invalid, and what uses it falls back to black
+class BakedCubemap {
+    public:
+
+        // faces in GL order: right, left, top, bottom, front, back
+        explicit BakedCubemap(const std::vector<std::string> &faces) : packKey(assetPack.contentKey()) {
+            for (int face = 0; face < CUBEMAP_FACES; face++) {
+                const std::string path = face < static_cast<int>(faces.size()) ? faces[face] : "(none)";
+                pathKey = fnv1a(path.data(), path.size(), pathKey);
+                blobs[face] = assetPack.read(path, true, true);
+                if (!readBakedTexture(blobs[face].data(), blobs[face].size, views[face]) || views[face].width != views[face].height ||
+                    views[face].width != views[0].width) {
+                    std::cout << "CUBEMAP: face " << face << " failed to load at path: " << path
+                              << " (missing from the asset pack, not square or not the size of the others, run AssetBaker)" << std::endl;
+                    valid = false;
+                }
+            }
+        }
+
+        [[nodiscard]] bool loaded() const {
+            return valid;
+        }
+
+        [[nodiscard]] uint32_t size() const {
+            return valid ? views[0].width : 0;
+        }
+
+        [[nodiscard]] uint32_t levels() const {
+            return valid ? views[0].levels : 0;
+        }
+
+        // which faces these are, for naming what's cached from them
+        [[nodiscard]] uint64_t sourceKey() const {
+            return pathKey;
+        }
+
+        // the pack they were read from, which changes whenever anything in it is rebaked
+        [[nodiscard]] uint64_t contentKey() const {
+            return packKey;
+        }
+
+        // rgba8, bakedMipSize(size(), level) square
+        [[nodiscard]] const unsigned char *face(const int index, const uint32_t level) const {
+            return views[index].level(level);
+        }
+
+        // a hash of every face's pixels from level down, for caching what's made from them. a level well down the
+        // chain keeps it quick, though then only changes that show at that size are noticed
+        [[nodiscard]] uint64_t hash(const uint32_t fromLevel, uint64_t key = FNV1A_OFFSET_BASIS) const {
+            for (int index = 0; index < CUBEMAP_FACES && valid; index++) {
+                for (uint32_t level = fromLevel; level < levels(); level++) {
+                    key = fnv1a(face(index, level), static_cast<size_t>(bakedMipSize(size(), level)) * bakedMipSize(size(), level) * 4, key);
+                }
+            }
+            return key;
+        }
+
+    private:
+
+        AssetPack::Blob blobs[CUBEMAP_FACES];
+        BakedTextureView views[CUBEMAP_FACES];
+        uint64_t pathKey = FNV1A_OFFSET_BASIS;
+        uint64_t packKey = 0;
+        bool valid = true;
+};
+
+#endif //BAKEDCUBEMAP_H
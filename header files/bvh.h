@@ -0,0 +1,505 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "glm/glm.hpp"
+#include "model.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVH_USE_SSE 1
+#endif
+
+// leaves stop splitting at this many primitives, unless splitting still looks cheaper by the sah
+constexpr uint32_t BVH_LEAF_SIZE = 4;
+// leaves this big are always split, whatever the sah says, so a bad split can't leave a huge leaf behind
+constexpr uint32_t BVH_MAX_LEAF_SIZE = 16;
+// candidate split planes tried per axis
+constexpr int BVH_BINS = 12;
+// nodes this deep are always leaves, whatever is left in them. the traversals keep at most one entry per level plus
+// one on their stacks, so this is what lets those stay fixed size arrays
+constexpr uint32_t BVH_MAX_DEPTH = 48;
+constexpr uint32_t BVH_STACK_SIZE = BVH_MAX_DEPTH + 2;
+// a refitted top level is rebuilt once instances have moved far enough to grow its root this much, since the tree
+// shape that was good for where they were stops being good for where they are
+constexpr float BVH_REBUILD_GROWTH = 2.0f;
+
+struct Ray {
+    glm::vec3 origin;
+    // doesn't need to be normalised, distances come back in multiples of it
+    glm::vec3 direction;
+    float maxDistance = FLT_MAX;
+};
+
+struct RayHit {
+    // index of the SceneBvh instance that was hit, -1 for a miss
+    int instance = -1;
+    float distance = FLT_MAX;
+    glm::vec3 point = glm::vec3(0.0f);
+    // world space, facing back towards the ray
+    glm::vec3 normal = glm::vec3(0.0f);
+};
+
+// 32 bytes, two to a cache line. an internal node has count 0 and its children at first and first + 1
+struct BvhNode {
+    glm::vec3 min;
+    uint32_t first;
+    glm::vec3 max;
+    uint32_t count;
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode is meant to be 32 bytes");
+
+// the ray in the form the slab test wants: 1 / direction is worked out once instead of per box
+struct BvhRay {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+#ifdef BVH_USE_SSE
+    __m128 originSse;
+    __m128 inverseSse;
+#endif
+
+    BvhRay(const glm::vec3 &origin, const glm::vec3 &direction) : origin(origin), direction(direction) {
+        // dividing by 0 gives inf, which is what the slab test wants for an axis the ray never moves along
+        inverseDirection = 1.0f / direction;
+#ifdef BVH_USE_SSE
+        originSse = _mm_setr_ps(origin.x, origin.y, origin.z, 0.0f);
+        // w is 0 so the count/first bits sharing the box's last lane come out as 0
+        inverseSse = _mm_setr_ps(inverseDirection.x, inverseDirection.y, inverseDirection.z, 0.0f);
+#endif
+    }
+
+    // distance to where the ray enters the box, or FLT_MAX if it misses it or enters beyond tMax
+    [[nodiscard]] float intersect(const BvhNode &node, const float tMax) const {
+#ifdef BVH_USE_SSE
+        const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.min.x), originSse), inverseSse);
+        const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.max.x), originSse), inverseSse);
+        // lane 3 is 0 in both, so it clamps the entry to the ray start for free. the exit needs it set to tMax instead
+        const __m128 lo = _mm_min_ps(t0, t1);
+        const __m128 hi = _mm_or_ps(_mm_and_ps(_mm_max_ps(t0, t1), _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0))),
+                                    _mm_setr_ps(0.0f, 0.0f, 0.0f, tMax));
+        const __m128 enter = _mm_max_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 0, 3, 2)));
+        const __m128 exit = _mm_min_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 0, 3, 2)));
+        const float tEnter = _mm_cvtss_f32(_mm_max_ss(enter, _mm_shuffle_ps(enter, enter, _MM_SHUFFLE(2, 3, 0, 1))));
+        const float tExit = _mm_cvtss_f32(_mm_min_ss(exit, _mm_shuffle_ps(exit, exit, _MM_SHUFFLE(2, 3, 0, 1))));
+#else
+        const glm::vec3 t0 = (node.min - origin) * inverseDirection;
+        const glm::vec3 t1 = (node.max - origin) * inverseDirection;
+        const glm::vec3 lo = glm::min(t0, t1);
+        const glm::vec3 hi = glm::max(t0, t1);
+        const float tEnter = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+        const float tExit = std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+#endif
+        return tEnter <= tExit ? tEnter : FLT_MAX;
+    }
+};
+
+// half the surface area of a box, which is all the sah needs
+inline float bvhSurfaceArea(const glm::vec3 &min, const glm::vec3 &max) {
+    const glm::vec3 e = glm::max(max - min, glm::vec3(0.0f));
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// binned sah build over anything with a bounding box. fills nodes (root first, children always after their parent)
+// and order, the primitive indices rearranged so every leaf's primitives are contiguous
+inline void buildBvh(const std::vector<glm::vec3> &boxMin, const std::vector<glm::vec3> &boxMax,
+                     std::vector<BvhNode> &nodes, std::vector<uint32_t> &order) {
+
+    const auto count = static_cast<uint32_t>(boxMin.size());
+    nodes.clear();
+    order.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    if (count == 0) {
+        return;
+    }
+    std::vector<glm::vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        centroids[i] = (boxMin[i] + boxMax[i]) * 0.5f;
+    }
+
+    nodes.reserve(count * 2);
+    nodes.push_back({glm::vec3(0.0f), 0, glm::vec3(0.0f), count});
+    // node and its depth
+    std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        const auto [index, depth] = stack.back();
+        stack.pop_back();
+
+        const uint32_t first = nodes[index].first;
+        const uint32_t n = nodes[index].count;
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+        for (uint32_t i = first; i < first + n; i++) {
+            min = glm::min(min, boxMin[order[i]]);
+            max = glm::max(max, boxMax[order[i]]);
+            centroidMin = glm::min(centroidMin, centroids[order[i]]);
+            centroidMax = glm::max(centroidMax, centroids[order[i]]);
+        }
+        nodes[index].min = min;
+        nodes[index].max = max;
+        if (n <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH) {
+            continue;
+        }
+
+        // try BVH_BINS - 1 planes along each axis and keep the one with the lowest area * count on both sides
+        float bestCost = FLT_MAX;
+        int bestAxis = -1, bestPlane = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            const float extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0.0f) {
+                continue;
+            }
+            const float binScale = static_cast<float>(BVH_BINS) / extent;
+            glm::vec3 binMin[BVH_BINS], binMax[BVH_BINS];
+            uint32_t binCount[BVH_BINS] = {};
+            std::fill(binMin, binMin + BVH_BINS, glm::vec3(FLT_MAX));
+            std::fill(binMax, binMax + BVH_BINS, glm::vec3(-FLT_MAX));
+            for (uint32_t i = first; i < first + n; i++) {
+                const uint32_t p = order[i];
+                const int bin = std::min(BVH_BINS - 1, static_cast<int>((centroids[p][axis] - centroidMin[axis]) * binScale));
+                binCount[bin]++;
+                binMin[bin] = glm::min(binMin[bin], boxMin[p]);
+                binMax[bin] = glm::max(binMax[bin], boxMax[p]);
+            }
+
+            // sweep from the right to get the cost of everything above each plane, then from the left
+            float rightArea[BVH_BINS];
+            uint32_t rightCount[BVH_BINS];
+            glm::vec3 accMin(FLT_MAX), accMax(-FLT_MAX);
+            uint32_t acc = 0;
+            for (int b = BVH_BINS - 1; b > 0; b--) {
+                accMin = glm::min(accMin, binMin[b]);
+                accMax = glm::max(accMax, binMax[b]);
+                acc += binCount[b];
+                rightArea[b] = bvhSurfaceArea(accMin, accMax);
+                rightCount[b] = acc;
+            }
+            accMin = glm::vec3(FLT_MAX);
+            accMax = glm::vec3(-FLT_MAX);
+            acc = 0;
+            for (int b = 0; b < BVH_BINS - 1; b++) {
+                accMin = glm::min(accMin, binMin[b]);
+                accMax = glm::max(accMax, binMax[b]);
+                acc += binCount[b];
+                if (acc == 0 || rightCount[b + 1] == 0) {
+                    continue;
+                }
+                const float cost = bvhSurfaceArea(accMin, accMax) * static_cast<float>(acc) + rightArea[b + 1] * static_cast<float>(rightCount[b + 1]);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestPlane = b;
+                }
+            }
+        }
+
+        // a leaf costs one test per primitive, a split one box test (roughly the same price) plus the children
+        const float leafCost = bvhSurfaceArea(min, max) * static_cast<float>(n);
+        if ((bestAxis < 0 || bestCost >= leafCost) && n <= BVH_MAX_LEAF_SIZE) {
+            continue;
+        }
+
+        uint32_t middle;
+        if (bestAxis >= 0) {
+            const float binScale = static_cast<float>(BVH_BINS) / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+            const auto split = std::partition(order.begin() + first, order.begin() + first + n, [&](const uint32_t p) {
+                return std::min(BVH_BINS - 1, static_cast<int>((centroids[p][bestAxis] - centroidMin[bestAxis]) * binScale)) <= bestPlane;
+            });
+            middle = static_cast<uint32_t>(split - order.begin());
+        } else {
+            // every centroid in the same spot, no plane separates them so just halve the list
+            middle = first + n / 2;
+        }
+
+        const auto left = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({glm::vec3(0.0f), first, glm::vec3(0.0f), middle - first});
+        nodes.push_back({glm::vec3(0.0f), middle, glm::vec3(0.0f), first + n - middle});
+        nodes[index].first = left;
+        nodes[index].count = 0;
+        stack.push_back({left, depth + 1});
+        stack.push_back({left + 1, depth + 1});
+    }
+}
+
+// the bottom level: every triangle of a model, in the model's own space. built once per model and shared by every
+// instance of it, however it's moved around
+class MeshBvh {
+    public:
+
+        std::vector<BvhNode> nodes;
+
+        explicit MeshBvh(const Model &model) {
+
+            std::vector<glm::vec3> positions;
+            std::vector<unsigned int> indices;
+            for (const Mesh &mesh : model.meshes) {
+                const auto base = static_cast<unsigned int>(positions.size());
+                for (const Vertex &vertex : mesh.vertices) {
+                    positions.push_back(vertex.Position);
+                }
+                for (const unsigned int index : mesh.indices) {
+                    indices.push_back(base + index);
+                }
+            }
+            build(positions, indices);
+        }
+
+        // from a triangle list, in whatever space the instances' transforms take it out of
+        MeshBvh(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices) {
+            build(positions, indices);
+        }
+
+        [[nodiscard]] size_t triangleCount() const {
+            return triangles.size();
+        }
+
+        // closest hit nearer than tMax. on a hit, tMax is moved in to it and normal gets the (unnormalised) face normal
+        bool intersect(const BvhRay &ray, float &tMax, glm::vec3 &normal) const {
+
+            if (nodes.empty() || ray.intersect(nodes[0], tMax) == FLT_MAX) {
+                return false;
+            }
+            bool hit = false;
+            uint32_t stack[BVH_STACK_SIZE];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const BvhNode &node = nodes[stack[--top]];
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                        if (intersectTriangle(ray, triangles[i], tMax)) {
+                            const Triangle &t = triangles[i];
+                            normal = glm::cross(t.b - t.a, t.c - t.a);
+                            hit = true;
+                        }
+                    }
+                    continue;
+                }
+                // push the far child first so the near one is walked first, and its hit can rule the far one out
+                float nearT = ray.intersect(nodes[node.first], tMax);
+                float farT = ray.intersect(nodes[node.first + 1], tMax);
+                uint32_t nearChild = node.first, farChild = node.first + 1;
+                if (farT < nearT) {
+                    std::swap(nearT, farT);
+                    std::swap(nearChild, farChild);
+                }
+                if (farT != FLT_MAX) {
+                    stack[top++] = farChild;
+                }
+                if (nearT != FLT_MAX) {
+                    stack[top++] = nearChild;
+                }
+            }
+            return hit;
+        }
+
+    private:
+
+        struct Triangle {
+            glm::vec3 a, b, c;
+        };
+        std::vector<Triangle> triangles;
+
+        void build(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices) {
+
+            const size_t triangleCount = indices.size() / 3;
+            std::vector<glm::vec3> boxMin(triangleCount), boxMax(triangleCount);
+            for (size_t t = 0; t < triangleCount; t++) {
+                const glm::vec3 &a = positions[indices[t * 3]], &b = positions[indices[t * 3 + 1]], &c = positions[indices[t * 3 + 2]];
+                boxMin[t] = glm::min(a, glm::min(b, c));
+                boxMax[t] = glm::max(a, glm::max(b, c));
+            }
+            std::vector<uint32_t> order;
+            buildBvh(boxMin, boxMax, nodes, order);
+
+            // store the triangles in leaf order, so a leaf's triangles are next to each other in memory
+            triangles.resize(triangleCount);
+            for (size_t i = 0; i < triangleCount; i++) {
+                const size_t t = order[i];
+                triangles[i] = {positions[indices[t * 3]], positions[indices[t * 3 + 1]], positions[indices[t * 3 + 2]]};
+            }
+        }
+
+        // moller-trumbore, double sided
+        static bool intersectTriangle(const BvhRay &ray, const Triangle &t, float &tMax) {
+            const glm::vec3 e1 = t.b - t.a;
+            const glm::vec3 e2 = t.c - t.a;
+            const glm::vec3 p = glm::cross(ray.direction, e2);
+            const float det = glm::dot(e1, p);
+            if (std::abs(det) < 1e-12f) {
+                return false;
+            }
+            const float inverseDet = 1.0f / det;
+            const glm::vec3 s = ray.origin - t.a;
+            const float u = glm::dot(s, p) * inverseDet;
+            if (u < 0.0f || u > 1.0f) {
+                return false;
+            }
+            const glm::vec3 q = glm::cross(s, e1);
+            const float v = glm::dot(ray.direction, q) * inverseDet;
+            if (v < 0.0f || u + v > 1.0f) {
+                return false;
+            }
+            const float distance = glm::dot(e2, q) * inverseDet;
+            if (distance <= 0.0f || distance >= tMax) {
+                return false;
+            }
+            tMax = distance;
+            return true;
+        }
+};
+
+// the top level: a bvh over instances of MeshBvhs, each with its own transform. moving an instance only changes
+// its box, so the tree is refitted (bounds recomputed bottom up, same shape) rather than rebuilt, until the refitted
+// tree has grown past BVH_REBUILD_GROWTH
+class SceneBvh {
+    public:
+
+        // userId is whatever the caller wants back from a hit, e.g. which item it was
+        int addInstance(const MeshBvh &mesh, const glm::mat4 &transform, const int userId = -1) {
+            instances.push_back({&mesh, transform, glm::inverse(transform), glm::vec3(0.0f), glm::vec3(0.0f), userId});
+            updateBounds(instances.back());
+            needsBuild = true;
+            return static_cast<int>(instances.size()) - 1;
+        }
+
+        void setTransform(const int instance, const glm::mat4 &transform) {
+            Instance &i = instances[instance];
+            if (i.transform == transform) {
+                return;
+            }
+            i.transform = transform;
+            i.inverse = glm::inverse(transform);
+            updateBounds(i);
+            needsRefit = true;
+        }
+
+        [[nodiscard]] int userId(const int instance) const {
+            return instances[instance].userId;
+        }
+
+        // brings the tree up to date with any added or moved instances. raycast calls it, so this is only needed to
+        // control when the work happens
+        void update() {
+            if (needsRefit && !needsBuild) {
+                refit();
+                needsBuild = bvhSurfaceArea(nodes[0].min, nodes[0].max) > builtArea * BVH_REBUILD_GROWTH;
+            }
+            if (needsBuild) {
+                std::vector<glm::vec3> boxMin(instances.size()), boxMax(instances.size());
+                for (size_t i = 0; i < instances.size(); i++) {
+                    boxMin[i] = instances[i].min;
+                    boxMax[i] = instances[i].max;
+                }
+                buildBvh(boxMin, boxMax, nodes, order);
+                builtArea = nodes.empty() ? 0.0f : bvhSurfaceArea(nodes[0].min, nodes[0].max);
+            }
+            needsBuild = needsRefit = false;
+        }
+
+        RayHit raycast(const Ray &ray) {
+
+            update();
+            RayHit hit;
+            if (nodes.empty()) {
+                return hit;
+            }
+
+            const BvhRay worldRay(ray.origin, ray.direction);
+            float tMax = ray.maxDistance;
+            glm::vec3 localNormal(0.0f);
+            uint32_t stack[BVH_STACK_SIZE];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const BvhNode &node = nodes[stack[--top]];
+                if (worldRay.intersect(node, tMax) == FLT_MAX) {
+                    continue;
+                }
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                        const Instance &instance = instances[order[i]];
+                        // the direction isn't renormalised, so distances along the local ray match the world one
+                        const BvhRay localRay(glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f)), glm::mat3(instance.inverse) * ray.direction);
+                        if (instance.mesh->intersect(localRay, tMax, localNormal)) {
+                            hit.instance = static_cast<int>(order[i]);
+                        }
+                    }
+                    continue;
+                }
+                stack[top++] = node.first + 1;
+                stack[top++] = node.first;
+            }
+
+            if (hit.instance >= 0) {
+                const Instance &instance = instances[hit.instance];
+                hit.distance = tMax;
+                hit.point = ray.origin + ray.direction * tMax;
+                // normals go through the inverse transpose, so non uniform scales don't skew them
+                hit.normal = glm::normalize(glm::transpose(glm::mat3(instance.inverse)) * localNormal);
+                if (glm::dot(hit.normal, ray.direction) > 0.0f) {
+                    hit.normal = -hit.normal;
+                }
+            }
+            return hit;
+        }
+
+    private:
+
+        struct Instance {
+            const MeshBvh *mesh;
+            glm::mat4 transform;
+            glm::mat4 inverse;
+            // world space box around the mesh's root box
+            glm::vec3 min;
+            glm::vec3 max;
+            int userId;
+        };
+
+        std::vector<Instance> instances;
+        std::vector<BvhNode> nodes;
+        std::vector<uint32_t> order;
+        bool needsBuild = false;
+        bool needsRefit = false;
+        float builtArea = 0.0f;
+
+        void refit() {
+            // children always come after their parent, so walking backwards does every child before its parent
+            for (size_t n = nodes.size(); n-- > 0;) {
+                BvhNode &node = nodes[n];
+                if (node.count > 0) {
+                    node.min = glm::vec3(FLT_MAX);
+                    node.max = glm::vec3(-FLT_MAX);
+                    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                        node.min = glm::min(node.min, instances[order[i]].min);
+                        node.max = glm::max(node.max, instances[order[i]].max);
+                    }
+                } else {
+                    node.min = glm::min(nodes[node.first].min, nodes[node.first + 1].min);
+                    node.max = glm::max(nodes[node.first].max, nodes[node.first + 1].max);
+                }
+            }
+        }
+
+        static void updateBounds(Instance &instance) {
+            instance.min = glm::vec3(FLT_MAX);
+            instance.max = glm::vec3(-FLT_MAX);
+            if (instance.mesh->nodes.empty()) {
+                return;
+            }
+            const BvhNode &root = instance.mesh->nodes[0];
+            for (int corner = 0; corner < 8; corner++) {
+                const glm::vec3 local((corner & 1) ? root.max.x : root.min.x, (corner & 2) ? root.max.y : root.min.y, (corner & 4) ? root.max.z : root.min.z);
+                const glm::vec3 world = glm::vec3(instance.transform * glm::vec4(local, 1.0f));
+                instance.min = glm::min(instance.min, world);
+                instance.max = glm::max(instance.max, world);
+            }
+        }
+};
+
+#endif //BVH_H
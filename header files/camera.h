@@ -29,11 +29,17 @@ constexpr GLfloat SENSITIVITY = 0.08f;
 constexpr GLfloat ZOOM = 70.0f;
 constexpr GLfloat GRAVITY = -20.0f;
 constexpr GLfloat JUMP_HEIGHT = 7.0f;
+// how far above the ground the camera sits when walking
+constexpr GLfloat EYE_HEIGHT = 1.0f;
 constexpr bool IN_AIR = false;
 
 class Camera {
     public:
+        // the simulated position, moved by fixed steps
         glm::vec3 cameraPosition;
+        // where it was before the latest step, and where the current frame draws it (somewhere between the two)
+        glm::vec3 previousPosition;
+        glm::vec3 renderPosition;
         glm::vec3 cameraFront;
         glm::vec3 cameraUp;
         glm::vec3 cameraRight;
@@ -51,6 +57,8 @@ class Camera {
             float yaw = YAW, float pitch = PITCH, float speed = SPEED, float sensitivity = SENSITIVITY, float zoom = ZOOM, bool inAir = IN_AIR, float jumpSpeed = JUMP_SPEED ) {
 
             this->cameraPosition = position;
+            this->previousPosition = position;
+            this->renderPosition = position;
             this->cameraWorldUp = up;
             this->cameraFront = cameraFront;
             this->yaw = yaw;
@@ -65,7 +73,22 @@ class Camera {
 
         // no discard basically means "If you want my return value, you better use it!"
         [[nodiscard]] glm::mat4 getViewMatrix() const {
-            return glm::lookAt(cameraPosition, cameraPosition + cameraFront, cameraUp);
+            return glm::lookAt(renderPosition, renderPosition + cameraFront, cameraUp);
+        }
+
+        // moves straight there, without interpolating from the old position
+        void teleport(const glm::vec3 &position) {
+            cameraPosition = previousPosition = renderPosition = position;
+        }
+
+        // call before each simulation step
+        void beginStep() {
+            previousPosition = cameraPosition;
+        }
+
+        // call once a frame after the steps, with SimClock::alpha
+        void interpolate(const float alpha) {
+            renderPosition = glm::mix(previousPosition, cameraPosition, alpha);
         }
 
         void processKeyboard(const Camera_Movement direction, const double deltaTime) {
@@ -96,20 +119,21 @@ class Camera {
             }
         }
 
-        void applyGravity(const float deltaTime) {
+        // groundHeight is the height of whatever is under the camera, e.g. from Heightfield::height
+        void applyGravity(const float deltaTime, const float groundHeight) {
 
             jumpVelocity += GRAVITY * deltaTime;
             cameraPosition += glm::vec3(0.0f, jumpVelocity * deltaTime, 0.0f);
 
-            if (cameraPosition.y <= 1) {
+            if (cameraPosition.y <= groundHeight + EYE_HEIGHT) {
                 jumpVelocity = 0.0f;
-                cameraPosition.y = 1.0f;
+                cameraPosition.y = groundHeight + EYE_HEIGHT;
                 inAir = GL_FALSE;
             }
         }
 
-        void update(const float deltaTime) {
-            applyGravity(deltaTime);
+        void update(const float deltaTime, const float groundHeight = 0.0f) {
+            applyGravity(deltaTime, groundHeight);
         }
 
         void processMouseMovement(double xoffset, double yoffset, const GLboolean constrainPitch = true) {
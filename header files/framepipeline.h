@@ -0,0 +1,154 @@
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "glm/glm.hpp"
+#include "camera.h"
+#include "model.h"
+#include "profiler.h"
+
+// packets the simulation may finish ahead of the one being drawn. 1 lets it build frame N+1 while the gl thread draws
+// frame N; more only adds latency, since the gl thread can never use them faster than it swaps
+constexpr int FRAME_PIPELINE_DEPTH = 1;
+// packets alive at once: the one being built, the queued ones and the one being drawn. each gets its own FrameArena,
+// used in turn, and by the time the simulation comes back round to one the gl thread has finished with its packet
+constexpr int FRAME_PACKETS_IN_FLIGHT = FRAME_PIPELINE_DEPTH + 2;
+
+// what the gl thread hands the simulation each frame: the input it polled (glfw only allows that on the main thread)
+// and whatever its ui changed. the mouse and scroll are summed until the simulation takes them, keys are just the latest
+struct FrameInput {
+    bool forward = false;
+    bool backward = false;
+    bool left = false;
+    bool right = false;
+    bool jump = false;
+    bool grab = false;
+    bool drop = false;
+    double mouseDx = 0.0;
+    double mouseDy = 0.0;
+    double scroll = 0.0;
+    // the framebuffer, for the projection and lod selection
+    int width = 1;
+    int height = 1;
+    glm::vec3 trebScale = glm::vec3(1.0f);
+};
+
+// the latest FrameInput, passed from the gl thread to the simulation without either waiting on the other
+class InputMailbox {
+    public:
+
+        void publish(const FrameInput &input) {
+            std::lock_guard<std::mutex> lock(mutex);
+            const double dx = latest.mouseDx + input.mouseDx;
+            const double dy = latest.mouseDy + input.mouseDy;
+            const double scroll = latest.scroll + input.scroll;
+            latest = input;
+            latest.mouseDx = dx;
+            latest.mouseDy = dy;
+            latest.scroll = scroll;
+        }
+
+        // everything since the last take, after which the mouse and scroll start again from zero
+        FrameInput take() {
+            std::lock_guard<std::mutex> lock(mutex);
+            const FrameInput input = latest;
+            latest.mouseDx = latest.mouseDy = latest.scroll = 0.0;
+            return input;
+        }
+
+    private:
+        std::mutex mutex;
+        FrameInput latest;
+};
+
+struct DrawItem {
+    Model *model = nullptr;
+    glm::mat4 matrix = glm::mat4(1.0f);
+    // overrides the material's shininess, 0 keeps it
+    float shininess = 0.0f;
+    int lod = 0;
+};
+
+// everything the gl thread needs to draw one frame, built by the simulation and never changed after it's queued, so
+// the gl thread can read it while the simulation is already working on the next one
+struct RenderPacket {
+    RenderPacket() = default;
+    // the lists are allocated from memory, normally the FrameArena for this packet
+    explicit RenderPacket(std::pmr::memory_resource *memory) : draws(memory), lights(memory) {}
+
+    // the interpolated camera, for anything on the gl side that still wants one (the terrain's lod selection)
+    Camera camera;
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    std::pmr::vector<DrawItem> draws;
+    std::pmr::vector<glm::vec3> lights;
+    // what the simulation measured while building this packet, merged into the profiler by the frame that draws it
+    ProfileCapture profile;
+};
+
+// a fixed size queue between two threads. push waits while it's full and pop while it's empty, so whichever side is
+// faster is held to the pace of the slower one instead of running ahead. close() lets both go, for shutting down.
+// the slots are allocated once up front, and items are only ever move constructed, never assigned, so an item that
+// carries its own allocator (a RenderPacket on its arena) keeps it all the way through
+template<typename T>
+class BoundedQueue {
+    public:
+
+        explicit BoundedQueue(const size_t capacity) : slots(std::max<size_t>(capacity, 1)) {}
+
+        // false if the queue was closed, in which case item wasn't queued
+        bool push(T item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return closed || count < slots.size(); });
+            if (closed) {
+                return false;
+            }
+            slots[(head + count) % slots.size()].emplace(std::move(item));
+            count++;
+            notEmpty.notify_one();
+            return true;
+        }
+
+        // false once the queue is closed and empty
+        bool pop(std::optional<T> &item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return closed || count > 0; });
+            if (count == 0) {
+                return false;
+            }
+            item.reset();
+            item.emplace(std::move(*slots[head]));
+            slots[head].reset();
+            head = (head + 1) % slots.size();
+            count--;
+            notFull.notify_one();
+            return true;
+        }
+
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            notFull.notify_all();
+            notEmpty.notify_all();
+        }
+
+    private:
+        std::vector<std::optional<T>> slots;
+        size_t head = 0;
+        size_t count = 0;
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+};
+
+#endif //FRAMEPIPELINE_H
@@ -0,0 +1,57 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "glm/glm.hpp"
+
+// the 6 planes of a view frustum, pulled straight out of a clip matrix (gribb & hartmann). pass projection * view for
+// world space planes, or projection * view * model to test boxes in that model's own space
+struct Frustum {
+    // xyz is the inward facing normal, w the distance, so a point is inside when dot(n, p) + w >= 0
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4 &m) {
+        Frustum frustum{};
+        // glm is column major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        frustum.planes[0] = row3 + row0; // left
+        frustum.planes[1] = row3 - row0; // right
+        frustum.planes[2] = row3 + row1; // bottom
+        frustum.planes[3] = row3 - row1; // top
+        frustum.planes[4] = row3 + row2; // near
+        frustum.planes[5] = row3 - row2; // far
+
+        for (glm::vec4 &plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    // conservative: can say a box is visible when it's just outside a corner, never the other way round
+    [[nodiscard]] bool intersects(const glm::vec3 &min, const glm::vec3 &max) const {
+        for (const glm::vec4 &plane : planes) {
+            // the corner furthest along the plane normal
+            const glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x,
+                                     plane.y >= 0.0f ? max.y : min.y,
+                                     plane.z >= 0.0f ? max.z : min.z);
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool intersectsSphere(const glm::vec3 &centre, const float radius) const {
+        for (const glm::vec4 &plane : planes) {
+            if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif //FRUSTUM_H
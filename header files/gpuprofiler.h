@@ -0,0 +1,132 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <glad/glad.h>
+#include <cstring>
+#include <vector>
+#include <imgui.h>
+#include "profiler.h"
+
+// how many frames a gpu timer query is given before we read it back. reading any sooner stalls on the gpu
+constexpr int PROFILER_QUERY_LATENCY = 3;
+
+// the gl half of the profiler: timer queries around named stretches of gl commands, read back a few frames later and
+// recorded into the profiler as gpu timings
+class GpuProfiler {
+    public:
+
+        // no destructor on purpose: the profiler is a global and outlives the gl context, the queries go with it
+
+        // collects whatever timings have landed since last frame. call once at the start of each frame, on the gl thread
+        void beginFrame() {
+
+            frameIndex++;
+            for (Timer &timer : timers) {
+                for (int i = 0; i < PROFILER_QUERY_LATENCY; i++) {
+                    if (!timer.pending[i]) {
+                        continue;
+                    }
+                    GLint available = 0;
+                    glGetQueryObjectiv(timer.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+                    if (available) {
+                        GLuint64 nanoseconds = 0;
+                        glGetQueryObjectui64v(timer.queries[i], GL_QUERY_RESULT, &nanoseconds);
+                        profiler.recordGpu(timer.name, static_cast<double>(nanoseconds) / 1.0e6);
+                        timer.pending[i] = false;
+                    }
+                }
+            }
+        }
+
+        // GL_TIME_ELAPSED can't be nested, so only ever have one open at a time
+        void begin(const char *name) {
+
+            Timer &timer = find(name);
+            if (timer.queries[0] == 0) {
+                glGenQueries(PROFILER_QUERY_LATENCY, timer.queries);
+            }
+            const int slot = static_cast<int>(frameIndex % PROFILER_QUERY_LATENCY);
+            // if the query from PROFILER_QUERY_LATENCY frames ago still hasn't come back, skip this frame rather than stall
+            active = timer.pending[slot] ? -1 : static_cast<int>(&timer - timers.data());
+            if (active >= 0) {
+                glBeginQuery(GL_TIME_ELAPSED, timer.queries[slot]);
+            }
+        }
+
+        void end() {
+            if (active >= 0) {
+                glEndQuery(GL_TIME_ELAPSED);
+                timers[active].pending[frameIndex % PROFILER_QUERY_LATENCY] = true;
+                active = -1;
+            }
+        }
+
+    private:
+
+        struct Timer {
+            // always a string literal, like every name the profiler is given
+            const char *name = nullptr;
+            // one query per in-flight frame
+            GLuint queries[PROFILER_QUERY_LATENCY] = {};
+            bool pending[PROFILER_QUERY_LATENCY] = {};
+        };
+
+        // only the gl thread uses it, so there's no lock. an index rather than a pointer into timers, which can grow
+        // while a query's open
+        std::vector<Timer> timers;
+        int active = -1;
+        unsigned long long frameIndex = 0;
+
+        Timer &find(const char *name) {
+            for (Timer &timer : timers) {
+                if (std::strcmp(timer.name, name) == 0) {
+                    return timer;
+                }
+            }
+            timers.push_back({name});
+            return timers.back();
+        }
+};
+
+inline GpuProfiler gpuProfiler;
+
+// times the gl commands issued in the enclosing scope
+class GpuProfileScope {
+    public:
+        explicit GpuProfileScope(const char *name) {
+            gpuProfiler.begin(name);
+        }
+        ~GpuProfileScope() {
+            gpuProfiler.end();
+        }
+};
+
+// the profiler's window: every cpu and gpu timing and every counter
+inline void drawProfilerWindow() {
+    profiler.inspect([](const unsigned long long frameIndex, const std::vector<Profiler::Timing> &timings, const std::vector<Profiler::Counter> &counters) {
+        ImGui::Begin("Profiler");
+        ImGui::Text("frame %llu", frameIndex);
+        if (ImGui::CollapsingHeader("CPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+            for (const Profiler::Timing &timing : timings) {
+                if (!timing.gpu) {
+                    ImGui::Text("%-24s %7.3f ms", timing.name.c_str(), timing.averageMs);
+                }
+            }
+        }
+        if (ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+            for (const Profiler::Timing &timing : timings) {
+                if (timing.gpu) {
+                    ImGui::Text("%-24s %7.3f ms", timing.name.c_str(), timing.averageMs);
+                }
+            }
+        }
+        if (!counters.empty() && ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen)) {
+            for (const Profiler::Counter &counter : counters) {
+                ImGui::Text("%-24s %12.0f", counter.name.c_str(), counter.value);
+            }
+        }
+        ImGui::End();
+    });
+}
+
+#endif //GPUPROFILER_H
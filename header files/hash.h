@@ -0,0 +1,21 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr uint64_t FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV1A_PRIME = 0x100000001b3ull;
+
+// 64 bit fnv-1a. every cache key (baked assets, the pack, the sky and ibl caches, scene snapshots) goes through this
+// one copy, so the baker and the game can't disagree about a key. pass the last hash back in as the seed to chain
+inline uint64_t fnv1a(const void *data, const size_t length, uint64_t seed = FNV1A_OFFSET_BASIS) {
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < length; i++) {
+        seed ^= bytes[i];
+        seed *= FNV1A_PRIME;
+    }
+    return seed;
+}
+
+#endif //HASH_H
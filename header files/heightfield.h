@@ -0,0 +1,262 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "glm/glm.hpp"
+#include "model.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEIGHTFIELD_USE_SSE 1
+#endif
+
+// spacing of the height samples in world units. Terrain.obj's own grid is about 0.38, so this keeps every hill
+constexpr float HEIGHTFIELD_CELL_SIZE = 0.25f;
+
+// the terrain flattened into a regular grid of heights, so "how high is the ground here" is a couple of array reads
+// instead of a search through triangles. built once at load from the terrain mesh, in world space.
+// anywhere off the grid gets the height of the nearest edge, so walking off the end of the world doesn't drop you
+class Heightfield {
+    public:
+
+        Heightfield() = default;
+
+        Heightfield(const Model &model, const glm::mat4 &modelMatrix, const float cellSize = HEIGHTFIELD_CELL_SIZE) {
+            std::vector<glm::vec3> positions;
+            std::vector<unsigned int> indices;
+            for (const Mesh &mesh : model.meshes) {
+                const auto base = static_cast<unsigned int>(positions.size());
+                for (const Vertex &vertex : mesh.vertices) {
+                    positions.emplace_back(modelMatrix * glm::vec4(vertex.Position, 1.0f));
+                }
+                for (const unsigned int index : mesh.indices) {
+                    indices.push_back(base + index);
+                }
+            }
+            build(positions, indices, cellSize);
+        }
+
+        // from a triangle list already in world space
+        Heightfield(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices, const float cellSize = HEIGHTFIELD_CELL_SIZE) {
+            build(positions, indices, cellSize);
+        }
+
+        [[nodiscard]] bool empty() const {
+            return heights.empty();
+        }
+
+        // bilinear between the 4 surrounding samples
+        [[nodiscard]] float height(const float x, const float z) const {
+            if (heights.empty()) {
+                return 0.0f;
+            }
+            int ix, iz;
+            float fx, fz;
+            locate(x, z, ix, iz, fx, fz);
+            const float *row0 = &heights[static_cast<size_t>(iz) * width + ix];
+            const float *row1 = row0 + width;
+            const float h0 = row0[0] + (row0[1] - row0[0]) * fx;
+            const float h1 = row1[0] + (row1[1] - row1[0]) * fx;
+            return h0 + (h1 - h0) * fz;
+        }
+
+        // height() for a whole batch of points, 4 at a time. for physics and the like, which ask about lots of
+        // bodies at once and would otherwise pay for the clamping and rounding one lane at a time
+        void heightBatch(const float *x, const float *z, float *out, const size_t count) const {
+            size_t i = 0;
+            if (heights.empty()) {
+                std::fill(out, out + count, 0.0f);
+                return;
+            }
+#ifdef HEIGHTFIELD_USE_SSE
+            const __m128 ox = _mm_set1_ps(origin.x), oz = _mm_set1_ps(origin.y);
+            const __m128 inv = _mm_set1_ps(inverseCellSize);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 maxX = _mm_set1_ps(static_cast<float>(width - 1)), maxZ = _mm_set1_ps(static_cast<float>(depth - 1));
+            const __m128 lastCellX = _mm_set1_ps(static_cast<float>(width - 2)), lastCellZ = _mm_set1_ps(static_cast<float>(depth - 2));
+            const __m128 rowStride = _mm_set1_ps(static_cast<float>(width));
+            for (; i + 4 <= count; i += 4) {
+                const __m128 gx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), ox), inv), zero), maxX);
+                const __m128 gz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(z + i), oz), inv), zero), maxZ);
+                // gx and gz are never negative here, so truncating is flooring
+                const __m128 cx = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gx)), lastCellX);
+                const __m128 cz = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gz)), lastCellZ);
+                const __m128 fx = _mm_sub_ps(gx, cx);
+                const __m128 fz = _mm_sub_ps(gz, cz);
+                // the sample index in float is exact for any grid under 16 million samples, and sse2 has no 32 bit multiply
+                alignas(16) int index[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(cz, rowStride), cx)));
+
+                alignas(16) float h00[4], h10[4], h01[4], h11[4];
+                for (int lane = 0; lane < 4; lane++) {
+                    const float *row0 = &heights[static_cast<size_t>(index[lane])];
+                    h00[lane] = row0[0];
+                    h10[lane] = row0[1];
+                    h01[lane] = row0[width];
+                    h11[lane] = row0[width + 1];
+                }
+                const __m128 a = _mm_load_ps(h00), b = _mm_load_ps(h10), c = _mm_load_ps(h01), d = _mm_load_ps(h11);
+                const __m128 h0 = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fx));
+                const __m128 h1 = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), fx));
+                _mm_storeu_ps(out + i, _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), fz)));
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = height(x[i], z[i]);
+            }
+        }
+
+        // the normal of the bilinear surface, i.e. from its slope along x and z
+        [[nodiscard]] glm::vec3 normal(const float x, const float z) const {
+            float h;
+            glm::vec3 n;
+            sample(x, z, h, n);
+            return n;
+        }
+
+        // height and normal together, for when both are wanted (they share the lookup)
+        void sample(const float x, const float z, float &h, glm::vec3 &n) const {
+            if (heights.empty()) {
+                h = 0.0f;
+                n = glm::vec3(0.0f, 1.0f, 0.0f);
+                return;
+            }
+            int ix, iz;
+            float fx, fz;
+            locate(x, z, ix, iz, fx, fz);
+            const float *row0 = &heights[static_cast<size_t>(iz) * width + ix];
+            const float *row1 = row0 + width;
+            const float h0 = row0[0] + (row0[1] - row0[0]) * fx;
+            const float h1 = row1[0] + (row1[1] - row1[0]) * fx;
+            h = h0 + (h1 - h0) * fz;
+
+            const float dx = ((row0[1] - row0[0]) * (1.0f - fz) + (row1[1] - row1[0]) * fz) * inverseCellSize;
+            const float dz = (h1 - h0) * inverseCellSize;
+            n = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+        }
+
+        [[nodiscard]] glm::vec2 minCorner() const {
+            return origin;
+        }
+        [[nodiscard]] glm::vec2 maxCorner() const {
+            return origin + glm::vec2(static_cast<float>(width - 1), static_cast<float>(depth - 1)) * cellSize;
+        }
+
+    private:
+
+        std::vector<float> heights;
+        // sample counts along x and z, always at least 2 each so there's a whole cell to interpolate in
+        int width = 0;
+        int depth = 0;
+        glm::vec2 origin = glm::vec2(0.0f);
+        float cellSize = HEIGHTFIELD_CELL_SIZE;
+        float inverseCellSize = 1.0f / HEIGHTFIELD_CELL_SIZE;
+
+        // the cell (x, z) falls in and where in it, clamped onto the grid
+        void locate(const float x, const float z, int &ix, int &iz, float &fx, float &fz) const {
+            const float gx = std::clamp((x - origin.x) * inverseCellSize, 0.0f, static_cast<float>(width - 1));
+            const float gz = std::clamp((z - origin.y) * inverseCellSize, 0.0f, static_cast<float>(depth - 1));
+            ix = std::min(static_cast<int>(gx), width - 2);
+            iz = std::min(static_cast<int>(gz), depth - 2);
+            fx = gx - static_cast<float>(ix);
+            fz = gz - static_cast<float>(iz);
+        }
+
+        void build(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices, const float size) {
+
+            if (indices.empty()) {
+                std::cout << "heightfield: the terrain has no triangles, the ground will be flat" << std::endl;
+                return;
+            }
+
+            glm::vec2 min(FLT_MAX), max(-FLT_MAX);
+            for (const glm::vec3 &p : positions) {
+                min = glm::min(min, glm::vec2(p.x, p.z));
+                max = glm::max(max, glm::vec2(p.x, p.z));
+            }
+            cellSize = size;
+            inverseCellSize = 1.0f / size;
+            origin = min;
+            width = std::max(2, static_cast<int>(std::ceil((max.x - min.x) * inverseCellSize)) + 1);
+            depth = std::max(2, static_cast<int>(std::ceil((max.y - min.y) * inverseCellSize)) + 1);
+            heights.assign(static_cast<size_t>(width) * depth, -FLT_MAX);
+
+            // rasterise every triangle from above, keeping the highest surface where the terrain overhangs itself
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const glm::vec3 &a = positions[indices[i]];
+                const glm::vec3 &b = positions[indices[i + 1]];
+                const glm::vec3 &c = positions[indices[i + 2]];
+                const float area = (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+                if (std::abs(area) < 1e-12f) {
+                    continue;
+                }
+
+                const int x0 = std::max(0, static_cast<int>(std::ceil((std::min({a.x, b.x, c.x}) - origin.x) * inverseCellSize)));
+                const int x1 = std::min(width - 1, static_cast<int>(std::floor((std::max({a.x, b.x, c.x}) - origin.x) * inverseCellSize)));
+                const int z0 = std::max(0, static_cast<int>(std::ceil((std::min({a.z, b.z, c.z}) - origin.y) * inverseCellSize)));
+                const int z1 = std::min(depth - 1, static_cast<int>(std::floor((std::max({a.z, b.z, c.z}) - origin.y) * inverseCellSize)));
+
+                for (int z = z0; z <= z1; z++) {
+                    for (int x = x0; x <= x1; x++) {
+                        const float px = origin.x + static_cast<float>(x) * cellSize;
+                        const float pz = origin.y + static_cast<float>(z) * cellSize;
+                        // barycentrics in xz, with a little slack so samples on a shared edge aren't missed by both sides
+                        const float u = ((b.x - px) * (c.z - pz) - (c.x - px) * (b.z - pz)) / area;
+                        const float v = ((c.x - px) * (a.z - pz) - (a.x - px) * (c.z - pz)) / area;
+                        const float w = 1.0f - u - v;
+                        if (u < -1e-4f || v < -1e-4f || w < -1e-4f) {
+                            continue;
+                        }
+                        float &h = heights[static_cast<size_t>(z) * width + x];
+                        h = std::max(h, u * a.y + v * b.y + w * c.y);
+                    }
+                }
+            }
+
+            fillGaps();
+        }
+
+        // samples no triangle covered (the corners of a rotated terrain, holes) take the average of their covered
+        // neighbours, spreading inwards a ring at a time until the whole grid has a height
+        void fillGaps() {
+            bool missing = true;
+            for (int pass = 0; missing && pass < width + depth; pass++) {
+                missing = false;
+                std::vector<float> next = heights;
+                for (int z = 0; z < depth; z++) {
+                    for (int x = 0; x < width; x++) {
+                        if (heights[static_cast<size_t>(z) * width + x] != -FLT_MAX) {
+                            continue;
+                        }
+                        float sum = 0.0f;
+                        int count = 0;
+                        for (int dz = -1; dz <= 1; dz++) {
+                            for (int dx = -1; dx <= 1; dx++) {
+                                const int nx = x + dx, nz = z + dz;
+                                if (nx < 0 || nz < 0 || nx >= width || nz >= depth) {
+                                    continue;
+                                }
+                                const float h = heights[static_cast<size_t>(nz) * width + nx];
+                                if (h != -FLT_MAX) {
+                                    sum += h;
+                                    count++;
+                                }
+                            }
+                        }
+                        if (count > 0) {
+                            next[static_cast<size_t>(z) * width + x] = sum / static_cast<float>(count);
+                        } else {
+                            missing = true;
+                        }
+                    }
+                }
+                heights.swap(next);
+            }
+        }
+};
+
+#endif //HEIGHTFIELD_H
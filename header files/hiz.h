@@ -0,0 +1,146 @@
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <algorithm>
+#include <iostream>
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+#include "rendertarget.h"
+#include "shader.h"
+
+// local_size_x and local_size_y in hiz.comp
+constexpr GLuint HIZ_GROUP_SIZE = 8;
+// the texture unit the pyramid is bound to while culling, clear of the material and ibl units
+constexpr GLuint HIZ_TEXTURE_UNIT = 7;
+
+// a hierarchical depth pyramid, for occlusion culling on the gpu. the scene's depth is copied into a texture and
+// halved down to 1x1, each texel keeping the farthest depth under it. a box that lands on a handful of texels in the
+// right level and is nearer than none of them was hidden behind what got drawn.
+// built from last frame's depth it's tested with last frame's view projection too, and it can be wrong both ways: an
+// instance an occluder has just moved off (or the camera has turned past) would stay culled for a frame and pop in a
+// frame late. so IndirectRenderer only trusts it for a first pass, rebuilds it mid-frame from what that pass drew, and
+// tests what it culled again against that. gl 4.3 and up
+class HiZPyramid {
+    public:
+
+        HiZPyramid() : reduceShader("resources/shaders/hiz.comp") {
+            glGenFramebuffers(1, &depthFbo);
+        }
+
+        ~HiZPyramid() {
+            release();
+            glDeleteFramebuffers(1, &depthFbo);
+        }
+
+        HiZPyramid(const HiZPyramid &) = delete;
+        HiZPyramid &operator=(const HiZPyramid &) = delete;
+
+        // copies the scene's depth and builds the pyramid from it. viewProjection is what the scene was drawn with.
+        // leaves the scene's framebuffer bound, so drawing into it can carry on straight after
+        void build(const RenderTarget &scene, const glm::mat4 &viewProjection) {
+            if (!scene.hasDepth) {
+                return;
+            }
+            if (scene.width != depthWidth || scene.height != depthHeight) {
+                allocate(scene.width, scene.height);
+            }
+
+            // the scene's depth is a renderbuffer, which can't be sampled, so it goes through a texture of the same format
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, scene.fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFbo);
+            glBlitFramebuffer(0, 0, depthWidth, depthHeight, 0, 0, depthWidth, depthHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, scene.fbo);
+
+            reduceShader.use();
+            reduceShader.uploadUniformInt("source", static_cast<int>(HIZ_TEXTURE_UNIT));
+            glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+            for (int level = 0; level < levels; level++) {
+                glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : pyramid);
+                reduceShader.uploadUniformInt("sourceLevel", level == 0 ? 0 : level - 1);
+                glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+                const int width = std::max(pyramidWidth >> level, 1);
+                const int height = std::max(pyramidHeight >> level, 1);
+                glDispatchCompute((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+                // the next level reads this one
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glActiveTexture(GL_TEXTURE0);
+            builtViewProjection = viewProjection;
+            built = true;
+        }
+
+        // whether there's a pyramid to test against yet, which there isn't until the first frame has been drawn
+        [[nodiscard]] bool ready() const {
+            return built;
+        }
+
+        // binds the pyramid and points a culling shader's uniforms at it
+        void bind(const Shader &shader) const {
+            glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, pyramid);
+            glActiveTexture(GL_TEXTURE0);
+            shader.uploadUniformInt("hizMap", static_cast<int>(HIZ_TEXTURE_UNIT));
+            shader.uploadUniformInt("hizLevels", levels);
+            shader.uploadUniformIVector2("hizSize", glm::ivec2(pyramidWidth, pyramidHeight));
+            shader.uploadUniformVector2f("hizDepthSize", glm::vec2(depthWidth, depthHeight));
+            shader.uploadUniformMatrix4f("hizViewProjection", builtViewProjection);
+        }
+
+    private:
+
+        Shader reduceShader;
+        GLuint depthFbo = 0;
+        GLuint depthTexture = 0;
+        // r32f, level 0 is half the depth's size
+        GLuint pyramid = 0;
+        int depthWidth = 0;
+        int depthHeight = 0;
+        int pyramidWidth = 0;
+        int pyramidHeight = 0;
+        int levels = 0;
+        glm::mat4 builtViewProjection = glm::mat4(1.0f);
+        bool built = false;
+
+        void allocate(const int width, const int height) {
+            release();
+            depthWidth = width;
+            depthHeight = height;
+            pyramidWidth = std::max(width / 2, 1);
+            pyramidHeight = std::max(height / 2, 1);
+            levels = 1;
+            while ((std::max(pyramidWidth, pyramidHeight) >> levels) > 0) {
+                levels++;
+            }
+
+            glGenTextures(1, &depthTexture);
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, depthFbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cout << "HIZ: depth copy target " << width << "x" << height << " incomplete" << std::endl;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            glGenTextures(1, &pyramid);
+            glBindTexture(GL_TEXTURE_2D, pyramid);
+            glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, pyramidWidth, pyramidHeight);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            built = false;
+        }
+
+        void release() {
+            if (depthTexture) {
+                glDeleteTextures(1, &depthTexture);
+                glDeleteTextures(1, &pyramid);
+                depthTexture = pyramid = 0;
+            }
+        }
+};
+
+#endif //HIZ_H
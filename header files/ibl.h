@@ -0,0 +1,561 @@
+#ifndef IBL_H
+#define IBL_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/packing.hpp"
+#include "bakedcubemap.h"
+#include "hash.h"
+#include "jobs.h"
+#include "shader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IBL_USE_SSE 1
+#endif
+
+// size of the top level of the prefiltered cubemap. the source faces are 2048^2, which is far more detail than
+// a blurry reflection will ever need, so the convolving starts from the baked mip level this size
+constexpr int IBL_BASE_SIZE = 256;
+constexpr int IBL_MIP_LEVELS = 6;
+constexpr int IBL_SAMPLE_COUNT = 64;
+// bump this whenever the baked output changes, so old cache files get ignored
+constexpr uint32_t IBL_CACHE_VERSION = 2;
+constexpr uint32_t IBL_CACHE_MAGIC = 0x4C424931; // "1IBL"
+
+// the texture unit the prefiltered map lives on. Mesh::draw hands out units from 0 upwards, so keep well clear of it
+constexpr GLuint IBL_TEXTURE_UNIT = 8;
+
+// one face of a cubemap as linear rgb floats
+struct CubeFace {
+    int size = 0;
+    std::vector<float> rgb;
+
+    [[nodiscard]] const float *texel(const int x, const int y) const {
+        return &rgb[(static_cast<size_t>(y) * size + x) * 3];
+    }
+};
+
+// a whole cubemap (6 faces in GL order +X, -X, +Y, -Y, +Z, -Z) at a single mip level
+struct CubeLevel {
+    int size = 0;
+    CubeFace faces[6];
+};
+
+// the 9 coefficients of a 3 band spherical harmonic projection, already convolved with the cosine lobe and divided
+// by pi, so the shader only has to dot them with the basis to get the diffuse irradiance
+struct SH9 {
+    glm::vec3 coeffs[9];
+};
+
+class IBL {
+    public:
+
+        SH9 irradiance{};
+        GLuint prefilteredMap = 0;
+        int mipLevels = IBL_MIP_LEVELS;
+
+        // the faces only have to last the constructor
+        explicit IBL(const BakedCubemap &faces, const std::string &cacheDirectory = "resources/cache") {
+
+            // everything is made from the baked level nearest IBL_BASE_SIZE, so that and the ones below it are all
+            // the key needs
+            const uint32_t baseLevel = IBL::baseLevel(faces);
+            const uint64_t key = faces.hash(baseLevel, fnv1a(&IBL_CACHE_VERSION, sizeof(IBL_CACHE_VERSION)));
+
+            std::stringstream cacheName;
+            cacheName << cacheDirectory << "/ibl_" << std::hex << key << ".bin";
+            const std::string cachePath = cacheName.str();
+
+            std::vector<CubeLevel> levels;
+            if (!loadCache(cachePath, levels)) {
+                std::cout << "IBL cache miss, baking " << cachePath << std::endl;
+                bake(faces, baseLevel, levels);
+                irradiance = projectSH(levels[0]);
+                std::filesystem::create_directories(cacheDirectory);
+                saveCache(cachePath, levels);
+            }
+            upload(levels);
+        }
+
+        ~IBL() {
+            glDeleteTextures(1, &prefilteredMap);
+        }
+
+        IBL(const IBL &) = delete;
+        IBL &operator=(const IBL &) = delete;
+
+        // uploads the sh coefficients and binds the prefiltered map. shader has to be in use
+        void bind(const Shader &shader, const GLuint textureUnit = IBL_TEXTURE_UNIT) const {
+
+            glActiveTexture(GL_TEXTURE0 + textureUnit);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, prefilteredMap);
+            glActiveTexture(GL_TEXTURE0);
+
+            shader.uploadUniformInt("prefilteredMap", static_cast<int>(textureUnit));
+            shader.uploadUniformFloat("prefilteredMaxLod", static_cast<float>(mipLevels - 1));
+            shader.uploadUniformVector3fArray("irradianceSH", irradiance.coeffs, 9);
+        }
+
+    private:
+
+        // the first baked level no bigger than IBL_BASE_SIZE
+        static uint32_t baseLevel(const BakedCubemap &faces) {
+            uint32_t level = 0;
+            while (level + 1 < faces.levels() && bakedMipSize(faces.size(), level) > IBL_BASE_SIZE) {
+                level++;
+            }
+            return level;
+        }
+
+        // face axes in GL order: the direction through texel (u, v) in [-1, 1] is major + u * uAxis + v * vAxis
+        static constexpr float FACE_AXES[6][3][3] = {
+            {{ 1,  0,  0}, { 0,  0, -1}, { 0, -1,  0}},
+            {{-1,  0,  0}, { 0,  0,  1}, { 0, -1,  0}},
+            {{ 0,  1,  0}, { 1,  0,  0}, { 0,  0,  1}},
+            {{ 0, -1,  0}, { 1,  0,  0}, { 0,  0, -1}},
+            {{ 0,  0,  1}, { 1,  0,  0}, { 0, -1,  0}},
+            {{ 0,  0, -1}, {-1,  0,  0}, { 0, -1,  0}},
+        };
+
+        static glm::vec3 texelDirection(const int face, const float u, const float v) {
+            const auto &axes = FACE_AXES[face];
+            return glm::normalize(glm::vec3(axes[0][0] + u * axes[1][0] + v * axes[2][0],
+                                            axes[0][1] + u * axes[1][1] + v * axes[2][1],
+                                            axes[0][2] + u * axes[1][2] + v * axes[2][2]));
+        }
+
+        // bilinear lookup of a direction in one cube level, clamped at the face edges
+        static glm::vec3 sampleCube(const CubeLevel &level, const glm::vec3 &dir) {
+
+            const glm::vec3 a = glm::abs(dir);
+            int face;
+            float ma, sc, tc;
+            if (a.x >= a.y && a.x >= a.z) {
+                face = dir.x > 0 ? 0 : 1;
+                ma = a.x;
+                sc = dir.x > 0 ? -dir.z : dir.z;
+                tc = -dir.y;
+            } else if (a.y >= a.z) {
+                face = dir.y > 0 ? 2 : 3;
+                ma = a.y;
+                sc = dir.x;
+                tc = dir.y > 0 ? dir.z : -dir.z;
+            } else {
+                face = dir.z > 0 ? 4 : 5;
+                ma = a.z;
+                sc = dir.z > 0 ? dir.x : -dir.x;
+                tc = -dir.y;
+            }
+
+            const CubeFace &f = level.faces[face];
+            const float x = glm::clamp((sc / ma * 0.5f + 0.5f) * f.size - 0.5f, 0.0f, static_cast<float>(f.size - 1));
+            const float y = glm::clamp((tc / ma * 0.5f + 0.5f) * f.size - 0.5f, 0.0f, static_cast<float>(f.size - 1));
+            const int x0 = static_cast<int>(x);
+            const int y0 = static_cast<int>(y);
+            const int x1 = std::min(x0 + 1, f.size - 1);
+            const int y1 = std::min(y0 + 1, f.size - 1);
+            const float fx = x - x0;
+            const float fy = y - y0;
+
+            auto fetch = [&](const int tx, const int ty) {
+                const float *t = f.texel(tx, ty);
+                return glm::vec3(t[0], t[1], t[2]);
+            };
+            return glm::mix(glm::mix(fetch(x0, y0), fetch(x1, y0), fx), glm::mix(fetch(x0, y1), fetch(x1, y1), fx), fy);
+        }
+
+        // 2x2 box filter of every face into the next level down
+        static CubeLevel downsample(const CubeLevel &source) {
+
+            CubeLevel level;
+            level.size = source.size / 2;
+            for (int face = 0; face < 6; face++) {
+                const CubeFace &src = source.faces[face];
+                CubeFace &dst = level.faces[face];
+                dst.size = level.size;
+                dst.rgb.resize(static_cast<size_t>(dst.size) * dst.size * 3);
+
+                for (int y = 0; y < dst.size; y++) {
+                    const float *row0 = src.texel(0, y * 2);
+                    const float *row1 = src.texel(0, y * 2 + 1);
+                    float *out = &dst.rgb[static_cast<size_t>(y) * dst.size * 3];
+                    int i = 0;
+#ifdef IBL_USE_SSE
+                    // two output texels (6 floats) per iteration, reading 4 source texels per row
+                    const __m128 quarter = _mm_set1_ps(0.25f);
+                    for (; i + 2 <= dst.size; i += 2) {
+                        const float *a = row0 + i * 6;
+                        const float *b = row1 + i * 6;
+                        for (int c = 0; c < 2; c++) {
+                            const __m128 p0 = _mm_setr_ps(a[c * 6 + 0], a[c * 6 + 1], a[c * 6 + 2], 0.0f);
+                            const __m128 p1 = _mm_setr_ps(a[c * 6 + 3], a[c * 6 + 4], a[c * 6 + 5], 0.0f);
+                            const __m128 p2 = _mm_setr_ps(b[c * 6 + 0], b[c * 6 + 1], b[c * 6 + 2], 0.0f);
+                            const __m128 p3 = _mm_setr_ps(b[c * 6 + 3], b[c * 6 + 4], b[c * 6 + 5], 0.0f);
+                            alignas(16) float sum[4];
+                            _mm_store_ps(sum, _mm_mul_ps(_mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)), quarter));
+                            out[(i + c) * 3 + 0] = sum[0];
+                            out[(i + c) * 3 + 1] = sum[1];
+                            out[(i + c) * 3 + 2] = sum[2];
+                        }
+                    }
+#endif
+                    for (; i < dst.size; i++) {
+                        for (int c = 0; c < 3; c++) {
+                            out[i * 3 + c] = 0.25f * (row0[i * 6 + c] + row0[i * 6 + 3 + c] + row1[i * 6 + c] + row1[i * 6 + 3 + c]);
+                        }
+                    }
+                }
+            }
+            return level;
+        }
+
+        // converts the baked faces at baseLevel to linear. the baker already box filtered them down in linear space,
+        // so there's nothing left to shrink. faces that failed to load are black
+        static CubeLevel decodeBase(const BakedCubemap &faces, const uint32_t baseLevel) {
+
+            float srgbToLinear[256];
+            for (int i = 0; i < 256; i++) {
+                const float c = static_cast<float>(i) / 255.0f;
+                srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+
+            CubeLevel level;
+            if (!faces.loaded()) {
+                std::cout << "IBL faces missing, using black" << std::endl;
+                level.size = IBL_BASE_SIZE;
+                for (CubeFace &face : level.faces) {
+                    face.size = level.size;
+                    face.rgb.assign(static_cast<size_t>(level.size) * level.size * 3, 0.0f);
+                }
+                return level;
+            }
+            level.size = static_cast<int>(bakedMipSize(faces.size(), baseLevel));
+            jobs.parallelFor(6, [&](const int begin, const int end) {
+                for (int face = begin; face < end; face++) {
+                    const unsigned char *rgba = faces.face(face, baseLevel);
+                    CubeFace &out = level.faces[face];
+                    out.size = level.size;
+                    out.rgb.resize(static_cast<size_t>(level.size) * level.size * 3);
+                    for (size_t i = 0; i < out.rgb.size() / 3; i++) {
+                        out.rgb[i * 3 + 0] = srgbToLinear[rgba[i * 4 + 0]];
+                        out.rgb[i * 3 + 1] = srgbToLinear[rgba[i * 4 + 1]];
+                        out.rgb[i * 3 + 2] = srgbToLinear[rgba[i * 4 + 2]];
+                    }
+                }
+            });
+            return level;
+        }
+
+        // projects the cubemap onto the first 3 sh bands. each texel is weighted by its solid angle, which for a
+        // unit cube face works out as 4 / (size^2 * (1 + u^2 + v^2)^1.5)
+        static SH9 projectSH(const CubeLevel &level) {
+
+            const int size = level.size;
+            const int rows = size * 6;
+            // a sum per piece rather than per thread, since any thread can run any piece
+            const int grain = jobs.autoGrain(rows);
+            std::vector<std::array<double, 28>> partial((rows + grain - 1) / grain);
+
+            jobs.parallelFor(rows, [&](const int begin, const int end) {
+                float sums[28] = {};
+                for (int row = begin; row < end; row++) {
+                    const int face = row / size;
+                    const int y = row % size;
+                    const auto &axes = FACE_AXES[face];
+                    const float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(size) * 2.0f - 1.0f;
+                    const float texelArea = 4.0f / static_cast<float>(size * size);
+                    const CubeFace &f = level.faces[face];
+                    int x = 0;
+#ifdef IBL_USE_SSE
+                    __m128 acc[28];
+                    for (auto &a : acc) {
+                        a = _mm_setzero_ps();
+                    }
+                    const __m128 one = _mm_set1_ps(1.0f);
+                    const __m128 vv = _mm_set1_ps(v);
+                    const __m128 area = _mm_set1_ps(texelArea);
+                    for (; x + 4 <= size; x += 4) {
+                        const float step = 2.0f / static_cast<float>(size);
+                        const float u0 = (static_cast<float>(x) + 0.5f) * step - 1.0f;
+                        const __m128 u = _mm_setr_ps(u0, u0 + step, u0 + 2 * step, u0 + 3 * step);
+
+                        const __m128 lenSq = _mm_add_ps(one, _mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(vv, vv)));
+                        const __m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(lenSq));
+                        const __m128 weight = _mm_mul_ps(area, _mm_mul_ps(invLen, _mm_mul_ps(invLen, invLen)));
+
+                        __m128 d[3];
+                        for (int c = 0; c < 3; c++) {
+                            d[c] = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(axes[0][c] + v * axes[2][c]),
+                                                         _mm_mul_ps(u, _mm_set1_ps(axes[1][c]))), invLen);
+                        }
+                        const __m128 dx = d[0], dy = d[1], dz = d[2];
+
+                        __m128 basis[9];
+                        basis[0] = _mm_set1_ps(0.282095f);
+                        basis[1] = _mm_mul_ps(_mm_set1_ps(0.488603f), dy);
+                        basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), dz);
+                        basis[3] = _mm_mul_ps(_mm_set1_ps(0.488603f), dx);
+                        basis[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dy));
+                        basis[5] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dy, dz));
+                        basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(dz, dz)), one));
+                        basis[7] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(dx, dz));
+                        basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+                        const float *t = f.texel(x, y);
+                        const __m128 r = _mm_mul_ps(weight, _mm_setr_ps(t[0], t[3], t[6], t[9]));
+                        const __m128 g = _mm_mul_ps(weight, _mm_setr_ps(t[1], t[4], t[7], t[10]));
+                        const __m128 b = _mm_mul_ps(weight, _mm_setr_ps(t[2], t[5], t[8], t[11]));
+
+                        for (int k = 0; k < 9; k++) {
+                            acc[k * 3 + 0] = _mm_add_ps(acc[k * 3 + 0], _mm_mul_ps(basis[k], r));
+                            acc[k * 3 + 1] = _mm_add_ps(acc[k * 3 + 1], _mm_mul_ps(basis[k], g));
+                            acc[k * 3 + 2] = _mm_add_ps(acc[k * 3 + 2], _mm_mul_ps(basis[k], b));
+                        }
+                        acc[27] = _mm_add_ps(acc[27], weight);
+                    }
+                    for (int k = 0; k < 28; k++) {
+                        alignas(16) float lanes[4];
+                        _mm_store_ps(lanes, acc[k]);
+                        sums[k] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+                    }
+#endif
+                    for (; x < size; x++) {
+                        const float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(size) * 2.0f - 1.0f;
+                        const float lenSq = 1.0f + u * u + v * v;
+                        const float weight = texelArea / (lenSq * std::sqrt(lenSq));
+                        const glm::vec3 dir = texelDirection(face, u, v);
+                        const float basis[9] = {
+                            0.282095f,
+                            0.488603f * dir.y, 0.488603f * dir.z, 0.488603f * dir.x,
+                            1.092548f * dir.x * dir.y, 1.092548f * dir.y * dir.z,
+                            0.315392f * (3.0f * dir.z * dir.z - 1.0f),
+                            1.092548f * dir.x * dir.z, 0.546274f * (dir.x * dir.x - dir.y * dir.y)
+                        };
+                        const float *t = f.texel(x, y);
+                        for (int k = 0; k < 9; k++) {
+                            for (int c = 0; c < 3; c++) {
+                                sums[k * 3 + c] += basis[k] * t[c] * weight;
+                            }
+                        }
+                        sums[27] += weight;
+                    }
+                }
+                for (int k = 0; k < 28; k++) {
+                    partial[begin / grain][k] += sums[k];
+                }
+            }, grain);
+
+            double total[28] = {};
+            for (const auto &p : partial) {
+                for (int k = 0; k < 28; k++) {
+                    total[k] += p[k];
+                }
+            }
+
+            // the weights should add up to 4pi, renormalising soaks up the error from the discrete integration
+            const double norm = 4.0 * glm::pi<double>() / total[27];
+            // cosine lobe convolution (pi, 2pi/3, pi/4) divided by pi for lambert
+            const float band[9] = {1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+
+            SH9 sh{};
+            for (int k = 0; k < 9; k++) {
+                sh.coeffs[k] = glm::vec3(total[k * 3 + 0], total[k * 3 + 1], total[k * 3 + 2]) * static_cast<float>(norm) * band[k];
+            }
+            return sh;
+        }
+
+        static float radicalInverse(uint32_t bits) {
+            bits = (bits << 16u) | (bits >> 16u);
+            bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+            bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+            bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+            bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+            return static_cast<float>(bits) * 2.3283064365386963e-10f;
+        }
+
+        struct PrefilterSample {
+            glm::vec3 direction; // in tangent space, with the normal along +z
+            float weight;
+            int sourceLevel;
+        };
+
+        // importance samples the ggx lobe once per level. with n = v = r the reflected directions only depend on
+        // roughness, so the whole table can be reused for every texel by rotating it into that texel's frame.
+        // the source mip is picked from the sample pdf (filtered importance sampling) which hides most of the noise
+        static std::vector<PrefilterSample> buildSamples(const float roughness, const int baseSize, const int sourceLevels) {
+
+            std::vector<PrefilterSample> samples;
+            const float a = roughness * roughness;
+            const float texelSolidAngle = 4.0f * glm::pi<float>() / (6.0f * static_cast<float>(baseSize * baseSize));
+
+            for (int i = 0; i < IBL_SAMPLE_COUNT; i++) {
+                const float xi0 = static_cast<float>(i) / IBL_SAMPLE_COUNT;
+                const float xi1 = radicalInverse(static_cast<uint32_t>(i));
+
+                const float phi = 2.0f * glm::pi<float>() * xi0;
+                const float cosTheta = std::sqrt((1.0f - xi1) / (1.0f + (a * a - 1.0f) * xi1));
+                const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+                const glm::vec3 h(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+                const glm::vec3 l = 2.0f * h.z * h - glm::vec3(0.0f, 0.0f, 1.0f);
+                if (l.z <= 0.0f) {
+                    continue;
+                }
+
+                const float denom = cosTheta * cosTheta * (a * a - 1.0f) + 1.0f;
+                const float d = a * a / (glm::pi<float>() * denom * denom);
+                const float pdf = d * 0.25f + 0.0001f;
+                const float sampleSolidAngle = 1.0f / (static_cast<float>(IBL_SAMPLE_COUNT) * pdf);
+                const float lod = roughness == 0.0f ? 0.0f : 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+                samples.push_back({l, l.z, std::clamp(static_cast<int>(std::round(lod)), 0, sourceLevels - 1)});
+            }
+            return samples;
+        }
+
+        static void bake(const BakedCubemap &faces, const uint32_t baseLevel, std::vector<CubeLevel> &levels) {
+
+            // box filtered chain to pull the wide lobes from
+            std::vector<CubeLevel> source;
+            source.push_back(decodeBase(faces, baseLevel));
+            while (source.back().size > 1) {
+                source.push_back(downsample(source.back()));
+            }
+
+            levels.clear();
+            levels.push_back(source[0]);
+
+            for (int mip = 1; mip < IBL_MIP_LEVELS; mip++) {
+                const float roughness = static_cast<float>(mip) / static_cast<float>(IBL_MIP_LEVELS - 1);
+                const std::vector<PrefilterSample> samples = buildSamples(roughness, source[0].size, static_cast<int>(source.size()));
+
+                CubeLevel level;
+                level.size = std::max(1, source[0].size >> mip);
+                for (auto &face : level.faces) {
+                    face.size = level.size;
+                    face.rgb.resize(static_cast<size_t>(level.size) * level.size * 3);
+                }
+
+                jobs.parallelFor(level.size * 6, [&](const int begin, const int end) {
+                    for (int row = begin; row < end; row++) {
+                        const int face = row / level.size;
+                        const int y = row % level.size;
+                        const float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(level.size) * 2.0f - 1.0f;
+                        for (int x = 0; x < level.size; x++) {
+                            const float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(level.size) * 2.0f - 1.0f;
+                            const glm::vec3 n = texelDirection(face, u, v);
+                            const glm::vec3 up = std::abs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+                            const glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+                            const glm::vec3 bitangent = glm::cross(n, tangent);
+
+                            glm::vec3 colour(0.0f);
+                            float totalWeight = 0.0f;
+                            for (const PrefilterSample &s : samples) {
+                                const glm::vec3 l = tangent * s.direction.x + bitangent * s.direction.y + n * s.direction.z;
+                                colour += sampleCube(source[s.sourceLevel], l) * s.weight;
+                                totalWeight += s.weight;
+                            }
+                            colour /= std::max(totalWeight, 0.0001f);
+
+                            float *out = &level.faces[face].rgb[(static_cast<size_t>(y) * level.size + x) * 3];
+                            out[0] = colour.r;
+                            out[1] = colour.g;
+                            out[2] = colour.b;
+                        }
+                    }
+                });
+                levels.push_back(std::move(level));
+            }
+        }
+
+        // cache layout: magic, version, base size, mip count, 9 sh coefficients, then every level's faces as half floats
+        void saveCache(const std::string &path, const std::vector<CubeLevel> &levels) const {
+
+            std::ofstream file(path, std::ios::binary);
+            if (!file) {
+                std::cout << "IBL cache could not be written to " << path << std::endl;
+                return;
+            }
+            const uint32_t header[4] = {IBL_CACHE_MAGIC, IBL_CACHE_VERSION, static_cast<uint32_t>(levels[0].size),
+                                        static_cast<uint32_t>(levels.size())};
+            file.write(reinterpret_cast<const char *>(header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(irradiance.coeffs), sizeof(irradiance.coeffs));
+
+            std::vector<uint16_t> halves;
+            for (const CubeLevel &level : levels) {
+                for (const CubeFace &face : level.faces) {
+                    halves.resize(face.rgb.size());
+                    for (size_t i = 0; i < face.rgb.size(); i++) {
+                        halves[i] = glm::packHalf1x16(face.rgb[i]);
+                    }
+                    file.write(reinterpret_cast<const char *>(halves.data()), static_cast<std::streamsize>(halves.size() * sizeof(uint16_t)));
+                }
+            }
+        }
+
+        bool loadCache(const std::string &path, std::vector<CubeLevel> &levels) {
+
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                return false;
+            }
+            uint32_t header[4];
+            file.read(reinterpret_cast<char *>(header), sizeof(header));
+            if (!file || header[0] != IBL_CACHE_MAGIC || header[1] != IBL_CACHE_VERSION || header[3] != IBL_MIP_LEVELS) {
+                return false;
+            }
+            file.read(reinterpret_cast<char *>(irradiance.coeffs), sizeof(irradiance.coeffs));
+
+            std::vector<uint16_t> halves;
+            levels.resize(header[3]);
+            for (uint32_t mip = 0; mip < header[3]; mip++) {
+                CubeLevel &level = levels[mip];
+                level.size = std::max(1, static_cast<int>(header[2]) >> mip);
+                for (CubeFace &face : level.faces) {
+                    face.size = level.size;
+                    halves.resize(static_cast<size_t>(level.size) * level.size * 3);
+                    file.read(reinterpret_cast<char *>(halves.data()), static_cast<std::streamsize>(halves.size() * sizeof(uint16_t)));
+                    face.rgb.resize(halves.size());
+                    for (size_t i = 0; i < halves.size(); i++) {
+                        face.rgb[i] = glm::unpackHalf1x16(halves[i]);
+                    }
+                }
+            }
+            return static_cast<bool>(file);
+        }
+
+        void upload(const std::vector<CubeLevel> &levels) {
+
+            mipLevels = static_cast<int>(levels.size());
+
+            glGenTextures(1, &prefilteredMap);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, prefilteredMap);
+            for (int mip = 0; mip < mipLevels; mip++) {
+                for (GLuint face = 0; face < 6; face++) {
+                    const CubeFace &f = levels[mip].faces[face];
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB16F, f.size, f.size, 0, GL_RGB, GL_FLOAT, f.rgb.data());
+                }
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        }
+};
+
+#endif //IBL_H
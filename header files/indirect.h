@@ -0,0 +1,448 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+#include "framepipeline.h"
+#include "frustum.h"
+#include "hiz.h"
+#include "material.h"
+#include "model.h"
+#include "profiler.h"
+#include "shader.h"
+#include "uploadring.h"
+
+// shader storage binding points, as in cull.comp and vertex_indirect.glsl
+constexpr GLuint STORAGE_BLOCK_INSTANCES = 0;
+constexpr GLuint STORAGE_BLOCK_COMMANDS = 1;
+constexpr GLuint STORAGE_BLOCK_VISIBLE = 2;
+constexpr GLuint STORAGE_BLOCK_STATS = 3;
+constexpr GLuint STORAGE_BLOCK_RETEST = 4;
+// cullPhase in cull.comp
+constexpr GLint CULL_PHASE_ONLY = 0;
+constexpr GLint CULL_PHASE_FIRST = 1;
+constexpr GLint CULL_PHASE_SECOND = 2;
+// local_size_x in cull.comp
+constexpr GLuint INDIRECT_CULL_GROUP_SIZE = 64;
+// the per instance attribute vertex_indirect.glsl reads its instance index from
+constexpr GLuint INDIRECT_INSTANCE_ATTRIBUTE = 3;
+// how many frames the cull statistics are given before they're read back, like the profiler's queries
+constexpr int INDIRECT_STATS_LATENCY = 3;
+
+// the layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// one mesh of one drawn model, std430 as declared in cull.comp and vertex_indirect.glsl
+struct IndirectInstance {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    // world space bounding sphere of the whole model, centre and radius
+    glm::vec4 sphere;
+    // which draw command the mesh (at its level of detail) is drawn by
+    GLuint command;
+    GLint materialIndex;
+    // overrides the material's, 0 keeps it
+    float shininess;
+    float padding;
+};
+static_assert(sizeof(IndirectInstance) == 160, "IndirectInstance has to match the std430 layout in the shaders");
+
+// the gpu driven path for gl 4.3 and up. every registered mesh is copied into one shared vertex and element buffer
+// behind one VAO, and each mesh's level of detail gets a draw command. each frame the draws become instances in a
+// storage buffer, a compute shader frustum culls them and appends the visible ones to their command's range of the
+// visible list (counting them into the command's instanceCount), and glMultiDrawElementsIndirect draws straight from
+// those commands, one call per set of texture arrays. the cpu only lists what exists, the gpu decides what's drawn.
+// given last frame's depth pyramid the compute shader also drops instances hidden behind it, see hiz.h. last frame's
+// depth can be wrong about this frame (an occluder moved away), so that's only the first of two phases: what it drops
+// is kept in a retest list, the pyramid is rebuilt from the depth the first phase's draws just left, and a second
+// pass tests just those against it and draws what's really visible. nothing pops in a frame late, for the price of
+// a second pyramid build, dispatch and set of draw calls.
+// on a 3.3 context main.cpp draws each model itself, culled on the cpu with the same sphere test
+class IndirectRenderer {
+    public:
+
+        // whether the context can run this path at all
+        static bool supported() {
+            return GLAD_GL_VERSION_4_3 != 0;
+        }
+
+        IndirectRenderer() : cullShader("resources/shaders/cull.comp"),
+                             drawShader("resources/shaders/vertex_indirect.glsl", "resources/shaders/fragment_001.glsl") {
+            drawShader.use();
+            drawShader.bindUniformBlock("PerFrame", UNIFORM_BLOCK_FRAME);
+            glGenBuffers(1, &vertexBuffer);
+            glGenBuffers(1, &elementBuffer);
+            glGenBuffers(1, &instanceBuffer);
+            glGenBuffers(1, &commandBuffer);
+            glGenBuffers(1, &visibleBuffer);
+            glGenBuffers(1, &secondCommandBuffer);
+            glGenBuffers(1, &retestBuffer);
+            glGenBuffers(INDIRECT_STATS_LATENCY, statsBuffers);
+            for (const GLuint buffer : statsBuffers) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(CullStats), nullptr, GL_DYNAMIC_READ);
+            }
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            glGenVertexArrays(1, &VAO);
+        }
+
+        ~IndirectRenderer() {
+            glDeleteVertexArrays(1, &VAO);
+            for (const GLuint buffer : {vertexBuffer, elementBuffer, instanceBuffer, commandBuffer, visibleBuffer, secondCommandBuffer, retestBuffer}) {
+                glDeleteBuffers(1, &buffer);
+            }
+            glDeleteBuffers(INDIRECT_STATS_LATENCY, statsBuffers);
+            for (const GLsync fence : statsFences) {
+                glDeleteSync(fence);
+            }
+        }
+
+        IndirectRenderer(const IndirectRenderer &) = delete;
+        IndirectRenderer &operator=(const IndirectRenderer &) = delete;
+
+        // the program the instances are drawn with, for setting up lights, ibl and materials like any other
+        [[nodiscard]] const Shader &shader() const {
+            return drawShader;
+        }
+
+        // queues a model's meshes to be copied in. call for every model before finalize()
+        void addModel(const Model &model) {
+            if (firstMesh.contains(&model)) {
+                return;
+            }
+            firstMesh[&model] = static_cast<int>(meshes.size());
+            for (const Mesh &mesh : model.meshes) {
+                meshes.push_back({&mesh, 0, 0, 0, materials.slot(mesh.material)});
+            }
+        }
+
+        // copies every queued mesh into the shared buffers (gpu to gpu) and lays out the draw commands in material
+        // order, so the commands sharing texture arrays are next to each other and go out in one call. after
+        // materials.finalize(), so the material slots are known
+        void finalize() {
+            GLsizeiptr vertexBytes = 0, elementBytes = 0;
+            for (MeshRecord &record : meshes) {
+                record.baseVertex = static_cast<GLint>(vertexBytes / static_cast<GLsizeiptr>(sizeof(Vertex)));
+                record.firstIndex = static_cast<GLuint>(elementBytes / static_cast<GLsizeiptr>(sizeof(GLuint)));
+                vertexBytes += static_cast<GLsizeiptr>(record.mesh->vertices.size() * sizeof(Vertex));
+                elementBytes += static_cast<GLsizeiptr>(record.mesh->elementCount() * sizeof(GLuint));
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+            for (const MeshRecord &record : meshes) {
+                glBindBuffer(GL_COPY_READ_BUFFER, record.mesh->vertexBuffer());
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, record.baseVertex * static_cast<GLintptr>(sizeof(Vertex)),
+                                    static_cast<GLsizeiptr>(record.mesh->vertices.size() * sizeof(Vertex)));
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, elementBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, elementBytes, nullptr, GL_STATIC_DRAW);
+            for (const MeshRecord &record : meshes) {
+                glBindBuffer(GL_COPY_READ_BUFFER, record.mesh->elementBuffer());
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, record.firstIndex * static_cast<GLintptr>(sizeof(GLuint)),
+                                    static_cast<GLsizeiptr>(record.mesh->elementCount() * sizeof(GLuint)));
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            // one command per mesh per level, sorted by material. the mesh's index list is relative to its own
+            // vertices, so baseVertex is where those start in the shared buffer
+            std::vector<std::pair<int, int>> order;
+            for (int m = 0; m < static_cast<int>(meshes.size()); m++) {
+                meshes[m].firstLod = static_cast<int>(order.size());
+                for (int lod = 0; lod < static_cast<int>(meshes[m].mesh->lods.size()); lod++) {
+                    order.emplace_back(m, lod);
+                }
+            }
+            std::vector<int> sorted(order.size());
+            for (int i = 0; i < static_cast<int>(sorted.size()); i++) {
+                sorted[i] = i;
+            }
+            std::stable_sort(sorted.begin(), sorted.end(), [&](const int a, const int b) {
+                return meshes[order[a].first].materialSlot < meshes[order[b].first].materialSlot;
+            });
+            lodCommands.resize(order.size());
+            commandTemplate.clear();
+            groups.clear();
+            for (const int i : sorted) {
+                const MeshRecord &record = meshes[order[i].first];
+                const MeshLod &level = record.mesh->lods[order[i].second];
+                lodCommands[i] = static_cast<GLuint>(commandTemplate.size());
+                commandTemplate.push_back({static_cast<GLuint>(level.indexCount), 0, record.firstIndex + level.firstIndex, record.baseVertex, 0});
+
+                // a material without a texture samples nothing from that array, so it fits in any group
+                const glm::ivec2 arrays = materials.textureArrays(record.mesh->material);
+                Group *group = groups.empty() ? nullptr : &groups.back();
+                const bool fits = group && (arrays.x < 0 || group->arrays.x < 0 || arrays.x == group->arrays.x)
+                                        && (arrays.y < 0 || group->arrays.y < 0 || arrays.y == group->arrays.y);
+                if (!fits) {
+                    groups.push_back({static_cast<int>(commandTemplate.size()) - 1, 0, arrays});
+                    group = &groups.back();
+                }
+                group->count++;
+                group->arrays = glm::max(group->arrays, arrays);
+            }
+            commands.resize(commandTemplate.size());
+            secondCommands.resize(commandTemplate.size());
+            commandCounts.resize(commandTemplate.size());
+
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), static_cast<void *>(nullptr));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, Normal)));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, TexCoords)));
+            // the visible list, one entry per instance starting at each command's baseInstance
+            glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+            glEnableVertexAttribArray(INDIRECT_INSTANCE_ATTRIBUTE);
+            glVertexAttribIPointer(INDIRECT_INSTANCE_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), static_cast<void *>(nullptr));
+            glVertexAttribDivisor(INDIRECT_INSTANCE_ATTRIBUTE, 1);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        // culls and draws the frame's draws. the PerFrame block and the material table have to be bound already,
+        // and the draw shader's lights and ibl set up. draws of models that were never added are skipped.
+        // occluders is last frame's depth pyramid, or nullptr to frustum cull only. given the scene target being drawn
+        // into as well, the culling is done in two phases and the pyramid is rebuilt in between from that target's
+        // depth, which leaves it holding this frame's indirect draws rather than last frame's everything
+        void draw(const DrawItem *draws, const size_t count, const glm::mat4 &viewProjection, HiZPyramid *occluders = nullptr,
+                  const RenderTarget *scene = nullptr) {
+            readStats();
+            buildInstances(draws, count);
+            if (instances.empty()) {
+                return;
+            }
+            const bool occlusion = occluders && occluders->ready();
+            const bool twoPhase = occlusion && scene && scene->hasDepth;
+            upload(twoPhase);
+            const Frustum frustum = Frustum::fromMatrix(viewProjection);
+            cull(frustum, occlusion ? occluders : nullptr, twoPhase ? CULL_PHASE_FIRST : CULL_PHASE_ONLY);
+            drawVisible(commandBuffer);
+            if (twoPhase) {
+                occluders->build(*scene, viewProjection);
+                cull(frustum, occluders, CULL_PHASE_SECOND);
+                drawVisible(secondCommandBuffer);
+            }
+            profiler.addCounter("Indirect instances", static_cast<double>(instances.size()));
+            profiler.addCounter("Indirect draw calls", static_cast<double>(groups.size() * (twoPhase ? 2 : 1)));
+        }
+
+    private:
+
+        struct MeshRecord {
+            const Mesh *mesh;
+            // where the mesh's vertices and elements start in the shared buffers
+            GLint baseVertex;
+            GLuint firstIndex;
+            // into lodCommands
+            int firstLod;
+            int materialSlot;
+        };
+
+        // the Stats block in cull.comp
+        struct CullStats {
+            GLuint frustumCulled;
+            GLuint occlusionCulled;
+            GLuint trianglesOcclusionCulled;
+        };
+
+        // a run of commands drawn in one call, with the texture arrays they sample
+        struct Group {
+            int first;
+            int count;
+            glm::ivec2 arrays;
+        };
+
+        Shader cullShader;
+        Shader drawShader;
+        GLuint VAO = 0;
+        GLuint vertexBuffer = 0;
+        GLuint elementBuffer = 0;
+        GLuint instanceBuffer = 0;
+        GLuint commandBuffer = 0;
+        // the first phase's visible instances, then the second's after them
+        GLuint visibleBuffer = 0;
+        // the second phase's commands, their ranges in the second half of the visible list
+        GLuint secondCommandBuffer = 0;
+        GLuint retestBuffer = 0;
+        // bytes allocated in the per frame buffers, grown when a frame needs more
+        GLsizeiptr instanceCapacity = 0;
+        GLsizeiptr visibleCapacity = 0;
+        GLsizeiptr retestCapacity = 0;
+        // one per frame in flight, each read back once its fence says the culling that wrote it is done
+        GLuint statsBuffers[INDIRECT_STATS_LATENCY] = {};
+        GLsync statsFences[INDIRECT_STATS_LATENCY] = {};
+        GLuint statsInstances[INDIRECT_STATS_LATENCY] = {};
+        unsigned frame = 0;
+
+        std::vector<MeshRecord> meshes;
+        std::unordered_map<const Model *, int> firstMesh;
+        // the command for each mesh's level, by the mesh's firstLod plus the level
+        std::vector<GLuint> lodCommands;
+        // the commands with everything but the per frame instance range filled in
+        std::vector<DrawElementsIndirectCommand> commandTemplate;
+        std::vector<Group> groups;
+
+        // per frame, kept so they stop allocating once they've grown
+        std::vector<IndirectInstance> instances;
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<DrawElementsIndirectCommand> secondCommands;
+        std::vector<GLuint> commandCounts;
+
+        // an instance per mesh per draw, and each command's range of the visible list sized for all its instances
+        void buildInstances(const DrawItem *draws, const size_t count) {
+            instances.clear();
+            std::fill(commandCounts.begin(), commandCounts.end(), 0);
+            for (size_t i = 0; i < count; i++) {
+                const DrawItem &draw = draws[i];
+                const auto found = firstMesh.find(draw.model);
+                if (found == firstMesh.end()) {
+                    continue;
+                }
+                const glm::vec4 sphere = draw.model->worldSphere(draw.matrix);
+                const glm::mat4 normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(draw.matrix))));
+                for (size_t m = 0; m < draw.model->meshes.size(); m++) {
+                    const MeshRecord &record = meshes[found->second + m];
+                    const int lod = std::min(draw.lod, static_cast<int>(record.mesh->lods.size()) - 1);
+                    const GLuint command = lodCommands[record.firstLod + lod];
+                    instances.push_back({draw.matrix, normalMatrix, sphere, command, record.materialSlot, draw.shininess, 0.0f});
+                    commandCounts[command]++;
+                }
+            }
+            GLuint next = 0;
+            for (size_t c = 0; c < commands.size(); c++) {
+                commands[c] = commandTemplate[c];
+                commands[c].baseInstance = next;
+                secondCommands[c] = commands[c];
+                secondCommands[c].baseInstance += static_cast<GLuint>(instances.size());
+                next += commandCounts[c];
+            }
+        }
+
+        void upload(const bool twoPhase) {
+            const auto instanceBytes = static_cast<GLsizeiptr>(instances.size() * sizeof(IndirectInstance));
+            const auto visibleBytes = static_cast<GLsizeiptr>(instances.size() * sizeof(GLuint) * (twoPhase ? 2 : 1));
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+            if (instanceBytes > instanceCapacity) {
+                instanceCapacity = instanceBytes * 2;
+                glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCapacity, nullptr, GL_STREAM_DRAW);
+            }
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instanceBytes, instances.data());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+            if (visibleBytes > visibleCapacity) {
+                visibleCapacity = visibleBytes * 2;
+                glBufferData(GL_SHADER_STORAGE_BUFFER, visibleCapacity, nullptr, GL_DYNAMIC_COPY);
+            }
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            // the commands are small and rewritten whole, so the buffers are just replaced
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(commands.size() * sizeof(DrawElementsIndirectCommand)), commands.data(), GL_STREAM_DRAW);
+            if (twoPhase) {
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, secondCommandBuffer);
+                glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(secondCommands.size() * sizeof(DrawElementsIndirectCommand)),
+                             secondCommands.data(), GL_STREAM_DRAW);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+            // the count, then room for every instance
+            const auto retestBytes = static_cast<GLsizeiptr>((instances.size() + 1) * sizeof(GLuint));
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, retestBuffer);
+            if (retestBytes > retestCapacity) {
+                retestCapacity = retestBytes * 2;
+                glBufferData(GL_SHADER_STORAGE_BUFFER, retestCapacity, nullptr, GL_DYNAMIC_COPY);
+            }
+            constexpr GLuint none = 0;
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &none);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        // the stats are zeroed before the first (or only) phase and fenced after the last
+        void cull(const Frustum &frustum, const HiZPyramid *occluders, const GLint phase) {
+            cullShader.use();
+            cullShader.uploadUniformVector4fArray("frustumPlanes", frustum.planes, 6);
+            cullShader.uploadUniformUint("instanceCount", static_cast<GLuint>(instances.size()));
+            cullShader.uploadUniformInt("cullPhase", phase);
+            cullShader.uploadUniformBool("occlusionCulling", occluders != nullptr);
+            if (occluders) {
+                occluders->bind(cullShader);
+            }
+
+            const int slot = static_cast<int>(frame % INDIRECT_STATS_LATENCY);
+            if (phase != CULL_PHASE_SECOND) {
+                constexpr CullStats zero = {};
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffers[slot]);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CullStats), &zero);
+            }
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_INSTANCES, instanceBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_COMMANDS, phase == CULL_PHASE_SECOND ? secondCommandBuffer : commandBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_VISIBLE, visibleBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_STATS, statsBuffers[slot]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_RETEST, retestBuffer);
+            // the second phase only has the retest list to go through, but how long it is stays on the gpu, so it's
+            // dispatched for every instance and the extra invocations return straight away
+            const auto groupCount = static_cast<GLuint>((instances.size() + INDIRECT_CULL_GROUP_SIZE - 1) / INDIRECT_CULL_GROUP_SIZE);
+            glDispatchCompute(groupCount, 1, 1);
+            // the commands are read as draw parameters and the visible list as a vertex attribute from here on, the
+            // retest list by the second phase and the stats with glGetBufferSubData
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+                            GL_BUFFER_UPDATE_BARRIER_BIT);
+            if (phase != CULL_PHASE_FIRST) {
+                statsFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                statsInstances[slot] = static_cast<GLuint>(instances.size());
+                frame++;
+            }
+        }
+
+        void drawVisible(const GLuint commandsToDraw) {
+            drawShader.use();
+            glBindVertexArray(VAO);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_INSTANCES, instanceBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandsToDraw);
+            for (const Group &group : groups) {
+                materials.bindArrays(group.arrays);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                            reinterpret_cast<void *>(group.first * sizeof(DrawElementsIndirectCommand)),
+                                            group.count, sizeof(DrawElementsIndirectCommand));
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            glBindVertexArray(0);
+        }
+
+        // publishes the oldest frame's cull statistics, if the gpu is done with them. it never waits, a frame that
+        // isn't done yet is just skipped
+        void readStats() {
+            const int slot = static_cast<int>(frame % INDIRECT_STATS_LATENCY);
+            if (!statsFences[slot]) {
+                return;
+            }
+            const GLenum status = glClientWaitSync(statsFences[slot], 0, 0);
+            glDeleteSync(statsFences[slot]);
+            statsFences[slot] = nullptr;
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                return;
+            }
+            CullStats stats = {};
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffers[slot]);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(CullStats), &stats);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            const GLuint tested = statsInstances[slot] - stats.frustumCulled;
+            profiler.setCounter("Instances frustum culled", stats.frustumCulled);
+            profiler.setCounter("Instances occlusion culled", stats.occlusionCulled);
+            profiler.setCounter("Occlusion cull rate %", tested ? 100.0 * stats.occlusionCulled / tested : 0.0);
+            profiler.setCounter("Triangles occlusion culled", stats.trianglesOcclusionCulled);
+        }
+};
+
+#endif //INDIRECT_H
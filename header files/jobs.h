@@ -0,0 +1,393 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "arena.h"
+#include "profiler.h"
+
+// jobs a thread can have queued before more are just run straight away by whoever queued them. a power of two
+constexpr int JOB_DEQUE_CAPACITY = 4096;
+// parallelFor aims for this many pieces per thread, so a thread that finishes early has something left to steal
+constexpr int JOB_SPLITS_PER_THREAD = 4;
+// times an idle worker looks round for work again before going to sleep until more is queued
+constexpr int JOB_IDLE_SPINS = 64;
+
+class JobSystem;
+
+// counts unfinished jobs. pass one to run() for each job it should count, then wait() on it or use it as a
+// dependency for runAfter(). must outlive the jobs counted on it
+class JobCounter {
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter &) = delete;
+        JobCounter &operator=(const JobCounter &) = delete;
+
+        [[nodiscard]] bool done() const {
+            return value.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+        struct Job;
+
+        std::atomic<int> value{0};
+        // guards the last decrement as well as continuations, so a waiter can't see 0 and destroy the counter while
+        // the job that finished it is still handing out its continuations
+        std::mutex mutex;
+        std::vector<Job *> continuations;
+};
+
+struct JobCounter::Job {
+    std::function<void()> work;
+    JobCounter *counter = nullptr;
+};
+
+// a fixed set of worker threads (one fewer than there are cores, the main thread being the other) that run small
+// jobs. every worker, and the main thread, has its own chase-lev deque: the owner pushes and pops jobs at the
+// bottom without locking, and a thread with nothing to do steals from the top of someone else's. other threads
+// hand their jobs in through a shared queue instead.
+// waiting on a counter runs jobs rather than blocking, so it's fine to wait inside a job, and on a single core
+// machine (no workers) everything simply runs on the thread that waits
+class JobSystem {
+    public:
+
+        explicit JobSystem(const int workerCount = std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1)) {
+            // the constructing thread is treated as the main thread and owns queue 0
+            queues = std::vector<std::unique_ptr<WorkStealingDeque>>(workerCount + 1);
+            stats = std::vector<ThreadStats>(workerCount + 1);
+            for (auto &queue : queues) {
+                queue = std::make_unique<WorkStealingDeque>();
+            }
+            queueIndex = 0;
+            for (int i = 0; i < workerCount; i++) {
+                workers.emplace_back([this, i] { workerLoop(i + 1); });
+            }
+        }
+
+        ~JobSystem() {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            wakeWorkers.notify_all();
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        }
+
+        JobSystem(const JobSystem &) = delete;
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        // workers plus the thread that waits
+        [[nodiscard]] int threadCount() const {
+            return static_cast<int>(workers.size()) + 1;
+        }
+
+        void run(std::function<void()> work, JobCounter *counter = nullptr) {
+            if (counter) {
+                counter->value.fetch_add(1, std::memory_order_relaxed);
+            }
+            push(makeJob(std::move(work), counter));
+        }
+
+        // queues work once everything counted on dependency has finished (straight away if it already has)
+        void runAfter(JobCounter &dependency, std::function<void()> work, JobCounter *counter = nullptr) {
+            if (counter) {
+                counter->value.fetch_add(1, std::memory_order_relaxed);
+            }
+            Job *job = makeJob(std::move(work), counter);
+            {
+                std::lock_guard<std::mutex> lock(dependency.mutex);
+                if (dependency.value.load(std::memory_order_acquire) != 0) {
+                    dependency.continuations.push_back(job);
+                    return;
+                }
+            }
+            push(job);
+        }
+
+        // runs queued jobs until everything counted on counter has finished
+        void wait(JobCounter &counter) {
+            while (!counter.done()) {
+                if (Job *job = findJob(queueIndex)) {
+                    execute(job);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            // the job that finished the counter may still be inside its lock; once we have it, it's let go
+            std::lock_guard<std::mutex> lock(counter.mutex);
+        }
+
+        // calls function(begin, end) over pieces of [0, count) on every thread and returns once all are done.
+        // grain is the size of a piece; 0 picks one from the count and the number of threads
+        template<typename Function>
+        void parallelFor(const int count, Function function, int grain = 0) {
+            if (count <= 0) {
+                return;
+            }
+            if (grain <= 0) {
+                grain = autoGrain(count);
+            }
+            if (count <= grain) {
+                function(0, count);
+                return;
+            }
+            JobCounter counter;
+            for (int begin = grain; begin < count; begin += grain) {
+                const int end = std::min(count, begin + grain);
+                run([&function, begin, end] { function(begin, end); }, &counter);
+            }
+            // the first piece is done here rather than queued, the thread would only be waiting otherwise
+            function(0, std::min(count, grain));
+            wait(counter);
+        }
+
+        // what parallelFor picks for grain = 0. exposed so callers can size per-piece scratch space up front
+        [[nodiscard]] int autoGrain(const int count) const {
+            return std::max(1, count / (threadCount() * JOB_SPLITS_PER_THREAD));
+        }
+
+        struct Stats {
+            uint64_t jobsRun = 0;
+            uint64_t steals = 0;
+            uint64_t stealAttempts = 0;
+        };
+
+        // jobs run and steals since the last call, summed over every thread
+        Stats takeStats() {
+            Stats total;
+            for (ThreadStats &s : stats) {
+                total.jobsRun += s.jobsRun.exchange(0, std::memory_order_relaxed);
+                total.steals += s.steals.exchange(0, std::memory_order_relaxed);
+                total.stealAttempts += s.stealAttempts.exchange(0, std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+        // takeStats into the profiler. once a frame from the main thread
+        void publishStats() {
+            const Stats total = takeStats();
+            profiler.setCounter("Job threads", static_cast<double>(threadCount()));
+            profiler.addCounter("Jobs run", static_cast<double>(total.jobsRun));
+            profiler.addCounter("Job steals", static_cast<double>(total.steals));
+            profiler.addCounter("Job steal attempts", static_cast<double>(total.stealAttempts));
+        }
+
+    private:
+
+        using Job = JobCounter::Job;
+
+        // chase and lev's deque, with the memory orders from le et al, "correct and efficient work-stealing for weak
+        // memory models". fixed size, push reports when it's full instead of growing
+        class WorkStealingDeque {
+            public:
+                // owner only
+                bool push(Job *job) {
+                    const int64_t b = bottom.load(std::memory_order_relaxed);
+                    const int64_t t = top.load(std::memory_order_acquire);
+                    if (b - t >= JOB_DEQUE_CAPACITY) {
+                        return false;
+                    }
+                    buffer[b & (JOB_DEQUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_release);
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                    return true;
+                }
+
+                // owner only, newest first
+                Job *pop() {
+                    const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+                    bottom.store(b, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    int64_t t = top.load(std::memory_order_relaxed);
+                    if (t > b) {
+                        bottom.store(b + 1, std::memory_order_relaxed);
+                        return nullptr;
+                    }
+                    Job *job = buffer[b & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+                    if (t == b) {
+                        // the last one, which a thief might be taking at the same moment
+                        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                            job = nullptr;
+                        }
+                        bottom.store(b + 1, std::memory_order_relaxed);
+                    }
+                    return job;
+                }
+
+                // any thread, oldest first. nullptr if empty or another thread got there first
+                Job *steal() {
+                    int64_t t = top.load(std::memory_order_acquire);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    const int64_t b = bottom.load(std::memory_order_acquire);
+                    if (t >= b) {
+                        return nullptr;
+                    }
+                    Job *job = buffer[t & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                        return nullptr;
+                    }
+                    return job;
+                }
+
+            private:
+                // apart, so thieves bumping top don't keep taking the cache line the owner is using for bottom
+                alignas(64) std::atomic<int64_t> top{0};
+                alignas(64) std::atomic<int64_t> bottom{0};
+                alignas(64) std::array<std::atomic<Job *>, JOB_DEQUE_CAPACITY> buffer{};
+        };
+
+        struct alignas(64) ThreadStats {
+            std::atomic<uint64_t> jobsRun{0};
+            std::atomic<uint64_t> steals{0};
+            std::atomic<uint64_t> stealAttempts{0};
+        };
+
+        // the queue this thread owns, -1 for threads that aren't the main thread or a worker
+        static inline thread_local int queueIndex = -1;
+        static inline thread_local uint32_t randomState = 0x9e3779b9u;
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<WorkStealingDeque>> queues;
+        std::vector<ThreadStats> stats;
+        // every Job comes from here rather than new, there are thousands a frame and they're all the same size
+        PoolResource jobPool{sizeof(Job)};
+        // jobs from threads without a queue of their own. the deque's blocks are recycled through its own pool,
+        // which sharedMutex already guards
+        std::mutex sharedMutex;
+        std::pmr::unsynchronized_pool_resource sharedPool;
+        std::pmr::deque<Job *> shared{&sharedPool};
+        std::atomic<int> sharedCount{0};
+        // queued jobs nobody has started yet, which is what idle workers sleep on
+        std::atomic<int> pending{0};
+        std::atomic<int> sleeping{0};
+        std::mutex sleepMutex;
+        std::condition_variable wakeWorkers;
+        bool stopping = false;
+
+        Job *makeJob(std::function<void()> work, JobCounter *counter) {
+            return new (jobPool.allocate(sizeof(Job), alignof(Job))) Job{std::move(work), counter};
+        }
+
+        void destroyJob(Job *job) {
+            job->~Job();
+            jobPool.deallocate(job, sizeof(Job), alignof(Job));
+        }
+
+        void push(Job *job) {
+            if (queueIndex >= 0) {
+                if (!queues[queueIndex]->push(job)) {
+                    // the deque is full, so this thread is well ahead of the others anyway
+                    execute(job);
+                    return;
+                }
+            } else {
+                std::lock_guard<std::mutex> lock(sharedMutex);
+                shared.push_back(job);
+                sharedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            pending.fetch_add(1, std::memory_order_seq_cst);
+            if (sleeping.load(std::memory_order_seq_cst) > 0) {
+                // taking the lock means a worker can't be between checking pending and starting to wait
+                { std::lock_guard<std::mutex> lock(sleepMutex); }
+                wakeWorkers.notify_one();
+            }
+        }
+
+        // own queue first (newest, so still in cache), then the shared one, then a steal from a random other thread
+        Job *findJob(const int self) {
+            Job *job = self >= 0 ? queues[self]->pop() : nullptr;
+            if (!job && sharedCount.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(sharedMutex);
+                if (!shared.empty()) {
+                    job = shared.front();
+                    shared.pop_front();
+                    sharedCount.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            if (!job && queues.size() > 1 && pending.load(std::memory_order_relaxed) > 0) {
+                ThreadStats &mine = stats[std::max(self, 0)];
+                const auto count = static_cast<uint32_t>(queues.size());
+                // xorshift, just to spread thieves over victims
+                randomState ^= randomState << 13;
+                randomState ^= randomState >> 17;
+                randomState ^= randomState << 5;
+                const uint32_t start = randomState % count;
+                for (uint32_t i = 0; i < count && !job; i++) {
+                    const auto victim = static_cast<int>((start + i) % count);
+                    if (victim == self) {
+                        continue;
+                    }
+                    mine.stealAttempts.fetch_add(1, std::memory_order_relaxed);
+                    job = queues[victim]->steal();
+                    if (job) {
+                        mine.steals.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+            if (job) {
+                pending.fetch_sub(1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        void execute(Job *job) {
+            job->work();
+            stats[std::max(queueIndex, 0)].jobsRun.fetch_add(1, std::memory_order_relaxed);
+            if (JobCounter *counter = job->counter) {
+                std::vector<Job *> ready;
+                {
+                    std::lock_guard<std::mutex> lock(counter->mutex);
+                    if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        ready.swap(counter->continuations);
+                    }
+                }
+                for (Job *next : ready) {
+                    push(next);
+                }
+            }
+            destroyJob(job);
+        }
+
+        void workerLoop(const int index) {
+            queueIndex = index;
+            randomState = 0x9e3779b9u * static_cast<uint32_t>(index + 1);
+            int idle = 0;
+            while (true) {
+                if (Job *job = findJob(index)) {
+                    execute(job);
+                    idle = 0;
+                    continue;
+                }
+                if (++idle < JOB_IDLE_SPINS) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                idle = 0;
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleeping.fetch_add(1, std::memory_order_seq_cst);
+                wakeWorkers.wait(lock, [this] { return stopping || pending.load(std::memory_order_seq_cst) > 0; });
+                sleeping.fetch_sub(1, std::memory_order_seq_cst);
+                if (stopping) {
+                    return;
+                }
+            }
+        }
+};
+
+// the one job system, started before main so anything can use it
+inline JobSystem jobs;
+
+#endif //JOBS_H
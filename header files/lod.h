@@ -0,0 +1,54 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <algorithm>
+#include <cmath>
+#include "glm/glm.hpp"
+#include "camera.h"
+#include "model.h"
+
+// how many pixels a level's geometric error is allowed to cover before we switch to a finer one
+constexpr float LOD_PIXEL_THRESHOLD = 1.0f;
+// a coarser level is only picked once its error is this far under the threshold, so an object sitting right at the
+// boundary doesn't flick between two levels every frame
+constexpr float LOD_HYSTERESIS = 0.7f;
+
+// per drawn instance, since the same model can be drawn at several distances (e.g. both orbos)
+struct LodState {
+    int level = 0;
+};
+
+// projects each level's error onto the screen using the camera's field of view (Camera::zoom, in degrees) and picks
+// the coarsest level that stays under LOD_PIXEL_THRESHOLD. distances are from the interpolated camera (the packet's),
+// the one the frame is actually drawn from
+inline int selectLod(const Model &model, LodState &state, const glm::mat4 &modelMatrix, const Camera &camera, const float viewportHeight) {
+
+    const int levels = model.lodCount();
+    if (levels <= 1) {
+        state.level = 0;
+        return 0;
+    }
+
+    const float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+                                 std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+    const glm::vec3 centre = glm::vec3(modelMatrix * glm::vec4(model.boundsCentre, 1.0f));
+    // distance to the nearest point of the bounding sphere, so big models close up don't get coarsened
+    const float distance = std::max(glm::length(centre - camera.renderPosition) - model.boundsRadius * scale, 0.1f);
+    const float pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(camera.zoom) * 0.5f) * distance);
+
+    auto pixelError = [&](const int level) {
+        return model.lodError(level) * scale * pixelsPerUnit;
+    };
+
+    int level = std::min(state.level, levels - 1);
+    while (level > 0 && pixelError(level) > LOD_PIXEL_THRESHOLD) {
+        level--;
+    }
+    while (level + 1 < levels && pixelError(level + 1) <= LOD_PIXEL_THRESHOLD * LOD_HYSTERESIS) {
+        level++;
+    }
+    state.level = level;
+    return level;
+}
+
+#endif //LOD_H
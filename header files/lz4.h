@@ -0,0 +1,164 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// the lz4 block format (no frame around it), so blobs can be checked with any lz4 tool that reads raw blocks.
+// each sequence is a token (literal count in the high nibble, match length - 4 in the low, 15 meaning more length
+// bytes follow), the literals, a 2 byte little endian offset back into what's been decoded, then the match's extra
+// length bytes. the block ends with a sequence that's only literals
+
+constexpr size_t LZ4_MIN_MATCH = 4;
+// the format's end rules: the last match starts at least 12 bytes from the end and the last 5 are always literals
+constexpr size_t LZ4_MATCH_FIND_LIMIT = 12;
+constexpr size_t LZ4_LAST_LITERALS = 5;
+constexpr size_t LZ4_MAX_OFFSET = 65535;
+constexpr int LZ4_HASH_BITS = 16;
+
+// worst case compressed size, for incompressible input
+inline size_t lz4Bound(const size_t size) {
+    return size + size / 255 + 16;
+}
+
+// greedy compression with one candidate per hash, which is what the reference's fast mode does. runs of input that
+// won't match are skipped over faster the longer they go on, so incompressible data costs little
+inline void lz4Compress(const unsigned char *source, const size_t size, std::vector<unsigned char> &out) {
+
+    out.clear();
+    out.reserve(lz4Bound(size));
+    const auto read32 = [source](const size_t at) {
+        uint32_t value;
+        std::memcpy(&value, source + at, sizeof(value));
+        return value;
+    };
+    const auto writeLength = [&out](size_t length) {
+        while (length >= 255) {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(static_cast<unsigned char>(length));
+    };
+    const auto emit = [&](const size_t literalStart, const size_t literalCount, const size_t offset, const size_t matchLength) {
+        const size_t matchCode = matchLength ? matchLength - LZ4_MIN_MATCH : 0;
+        out.push_back(static_cast<unsigned char>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+        if (literalCount >= 15) {
+            writeLength(literalCount - 15);
+        }
+        out.insert(out.end(), source + literalStart, source + literalStart + literalCount);
+        if (matchLength) {
+            out.push_back(static_cast<unsigned char>(offset & 0xFF));
+            out.push_back(static_cast<unsigned char>(offset >> 8));
+            if (matchCode >= 15) {
+                writeLength(matchCode - 15);
+            }
+        }
+    };
+
+    size_t anchor = 0;
+    if (size > LZ4_MATCH_FIND_LIMIT) {
+        // positions + 1, so 0 is empty
+        std::vector<uint32_t> table(size_t(1) << LZ4_HASH_BITS, 0);
+        const size_t matchLimit = size - LZ4_LAST_LITERALS;
+        size_t i = 0;
+        while (i + LZ4_MATCH_FIND_LIMIT <= size) {
+            const uint32_t sequence = read32(i);
+            const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+            const size_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > LZ4_MAX_OFFSET || read32(candidate - 1) != sequence) {
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+            const size_t match = candidate - 1;
+            size_t length = LZ4_MIN_MATCH;
+            while (i + length < matchLimit && source[match + length] == source[i + length]) {
+                length++;
+            }
+            emit(anchor, i - anchor, i - match, length);
+            i += length;
+            anchor = i;
+        }
+    }
+    emit(anchor, size - anchor, 0, 0);
+}
+
+// decodes a block into exactly size bytes. false if the block is damaged: it runs off either buffer, points back
+// before the start, or doesn't come out at exactly size
+inline bool lz4Decompress(const unsigned char *source, const size_t sourceSize, unsigned char *destination, const size_t size) {
+
+    size_t in = 0, out = 0;
+    const auto readLength = [&](size_t length) -> size_t {
+        if (length != 15) {
+            return length;
+        }
+        unsigned char extra;
+        do {
+            if (in >= sourceSize) {
+                return SIZE_MAX;
+            }
+            extra = source[in++];
+            length += extra;
+        } while (extra == 255);
+        return length;
+    };
+
+    while (in < sourceSize) {
+        const unsigned char token = source[in++];
+        const size_t literals = readLength(token >> 4);
+        if (literals == SIZE_MAX || literals > sourceSize - in || literals > size - out) {
+            return false;
+        }
+        // short runs copy a fixed 16 bytes when both buffers have room past them, which compiles to a couple of moves
+        // rather than a call. whatever lands past the run is written over by what comes next
+        if (literals <= 16 && sourceSize - in >= 16 && size - out >= 16) {
+            std::memcpy(destination + out, source + in, 16);
+        } else if (literals) {
+            std::memcpy(destination + out, source + in, literals);
+        }
+        in += literals;
+        out += literals;
+        if (in == sourceSize) {
+            break;
+        }
+
+        if (sourceSize - in < 2) {
+            return false;
+        }
+        const size_t offset = source[in] | (static_cast<size_t>(source[in + 1]) << 8);
+        in += 2;
+        size_t length = readLength(token & 0x0F);
+        if (length == SIZE_MAX || offset == 0 || offset > out) {
+            return false;
+        }
+        length += LZ4_MIN_MATCH;
+        if (length > size - out) {
+            return false;
+        }
+        unsigned char *copy = destination + out;
+        if (offset >= 8 && size - out >= length + 8) {
+            // 8 bytes at a time, each read from bytes already written, running up to 7 past the match
+            for (size_t k = 0; k < length; k += 8) {
+                std::memcpy(copy + k, copy + k - offset, 8);
+            }
+        } else if (offset >= length) {
+            std::memcpy(copy, copy - offset, length);
+        } else {
+            // a match that overlaps what it's writing repeats the offset bytes before it (a flat texture is long runs
+            // of one 4 byte texel). write the pattern once, then keep doubling what's been written
+            std::memcpy(copy, copy - offset, offset);
+            size_t done = offset;
+            while (done < length) {
+                const size_t chunk = std::min(done, length - done);
+                std::memcpy(copy + done, copy, chunk);
+                done += chunk;
+            }
+        }
+        out += length;
+    }
+    return out == size;
+}
+
+#endif //LZ4_H
@@ -0,0 +1,147 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// a whole file mapped read only into memory. the os pages it in as it's touched, so "loading" a big file is just
+// the map call, and the pages are shared with the file cache instead of being copied into a buffer
+class MappedFile {
+    public:
+
+        MappedFile() = default;
+
+        explicit MappedFile(const std::string &path) {
+            open(path);
+        }
+
+        ~MappedFile() {
+            close();
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        MappedFile(MappedFile &&other) noexcept {
+            *this = std::move(other);
+        }
+
+        MappedFile &operator=(MappedFile &&other) noexcept {
+            if (this != &other) {
+                close();
+                bytes = std::exchange(other.bytes, nullptr);
+                length = std::exchange(other.length, 0);
+#ifdef _WIN32
+                file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+                mapping = std::exchange(other.mapping, nullptr);
+#endif
+            }
+            return *this;
+        }
+
+        // false if the file doesn't exist or can't be mapped. an empty file opens fine, with no data
+        bool open(const std::string &path) {
+            close();
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size)) {
+                close();
+                return false;
+            }
+            length = static_cast<size_t>(size.QuadPart);
+            if (length == 0) {
+                return true;
+            }
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) {
+                close();
+                return false;
+            }
+            bytes = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            const int descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor < 0) {
+                return false;
+            }
+            struct stat info {};
+            if (fstat(descriptor, &info) != 0) {
+                ::close(descriptor);
+                return false;
+            }
+            length = static_cast<size_t>(info.st_size);
+            if (length == 0) {
+                ::close(descriptor);
+                return true;
+            }
+            void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            // the mapping keeps the file alive by itself
+            ::close(descriptor);
+            bytes = mapped == MAP_FAILED ? nullptr : static_cast<const unsigned char *>(mapped);
+#endif
+            if (!bytes) {
+                std::cout << "MAPPED FILE: failed to map " << path << std::endl;
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+#ifdef _WIN32
+            if (bytes) {
+                UnmapViewOfFile(bytes);
+            }
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+            }
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (bytes) {
+                munmap(const_cast<unsigned char *>(bytes), length);
+            }
+#endif
+            bytes = nullptr;
+            length = 0;
+        }
+
+        [[nodiscard]] const unsigned char *data() const {
+            return bytes;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return length;
+        }
+
+    private:
+
+        const unsigned char *bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+};
+
+#endif //MAPPEDFILE_H
@@ -0,0 +1,346 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "glm/glm.hpp"
+#include "assetpack.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "shader.h"
+
+// entries in the gpu material table. MAX_MATERIALS in fragment_001.glsl has to match, and 256 of them (48 bytes
+// each) stay inside the 16KB every gl 3.3 implementation allows a uniform block
+constexpr int MATERIAL_TABLE_SIZE = 256;
+// the last entry is never given to a material, it's a plain untextured white for any that don't fit in the table, so
+// they show up as obviously missing rather than looking like whichever material happened to get the last slot
+constexpr int MATERIAL_OVERFLOW_SLOT = MATERIAL_TABLE_SIZE - 1;
+// the material table's uniform block binding point, after uploadring.h's per frame and per draw ones
+constexpr GLuint UNIFORM_BLOCK_MATERIALS = 2;
+// texture units the two texture arrays a material samples from are bound to
+constexpr GLuint MATERIAL_DIFFUSE_UNIT = 0;
+constexpr GLuint MATERIAL_SPECULAR_UNIT = 1;
+
+// what a mesh looks like, as read from its model file. the texture fields are handles from MaterialRegistry::addTexture
+struct Material {
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float shininess = 32.0f;
+    int diffuseTexture = -1;
+    int specularTexture = -1;
+
+    bool operator<(const Material &other) const {
+        return std::tie(diffuse.x, diffuse.y, diffuse.z, specular.x, specular.y, specular.z, ambient.x, ambient.y,
+                        ambient.z, shininess, diffuseTexture, specularTexture)
+             < std::tie(other.diffuse.x, other.diffuse.y, other.diffuse.z, other.specular.x, other.specular.y,
+                        other.specular.z, other.ambient.x, other.ambient.y, other.ambient.z, other.shininess,
+                        other.diffuseTexture, other.specularTexture);
+    }
+};
+
+// every material of every model, deduplicated, in one uniform buffer, and every texture they use packed into
+// GL_TEXTURE_2D_ARRAYs, one per size and colour space. a mesh then draws with just its material's index and the two
+// arrays that material samples; materials are numbered so the ones sharing arrays are next to each other, and draws
+// in material order hardly ever rebind anything.
+// models register their materials while they load and finalize() builds the gpu side once they all have, so every
+// texture of a size is known before its array is allocated
+class MaterialRegistry {
+    public:
+
+        // queues an image for the texture arrays, by its source path. the same file asked for twice (in the same colour
+        // space) is the same handle. nothing is read until finalize, which reads what the asset baker made of it
+        int addTexture(const std::string &path, const bool srgb) {
+            const auto key = std::make_pair(path, srgb);
+            const auto found = textureHandles.find(key);
+            if (found != textureHandles.end()) {
+                return found->second;
+            }
+            const int handle = static_cast<int>(textures.size());
+            TextureSource &texture = textures.emplace_back();
+            texture.path = path;
+            texture.srgb = srgb;
+            textureHandles.emplace(key, handle);
+            return handle;
+        }
+
+        // returns a handle for the material, shared with any identical material registered before
+        int add(const Material &material) {
+            const auto found = materialHandles.find(material);
+            if (found != materialHandles.end()) {
+                return found->second;
+            }
+            const int handle = static_cast<int>(entries.size());
+            entries.push_back({material});
+            materialHandles.emplace(material, handle);
+            return handle;
+        }
+
+        // reads every texture's baked mips out of the asset pack (as jobs, so compressed ones decode in parallel), packs
+        // them into arrays, sorts the materials and uploads the table. call once, after the last model has loaded and
+        // before the first draw
+        void finalize() {
+            if (finalized) {
+                return;
+            }
+            finalized = true;
+
+            jobs.parallelFor(static_cast<int>(textures.size()), [&](const int begin, const int end) {
+                for (int i = begin; i < end; i++) {
+                    open(textures[i]);
+                }
+            }, 1);
+            buildArrays();
+
+            // sorted by the arrays they sample, so neighbouring slots (and draws sorted by slot) share their bindings
+            std::vector<int> order(entries.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = static_cast<int>(i);
+            }
+            std::sort(order.begin(), order.end(), [&](const int a, const int b) {
+                return std::make_tuple(arrayOf(entries[a].material.diffuseTexture), arrayOf(entries[a].material.specularTexture), a)
+                     < std::make_tuple(arrayOf(entries[b].material.diffuseTexture), arrayOf(entries[b].material.specularTexture), b);
+            });
+            if (static_cast<int>(order.size()) > MATERIAL_OVERFLOW_SLOT) {
+                std::cout << "MATERIALS: error: " << order.size() << " materials but the table only holds " << MATERIAL_OVERFLOW_SLOT
+                          << ", the other " << order.size() - MATERIAL_OVERFLOW_SLOT << " draw plain white (raise MATERIAL_TABLE_SIZE"
+                          << " and MAX_MATERIALS in fragment_001.glsl together)" << std::endl;
+            }
+
+            std::vector<GpuMaterial> table(MATERIAL_TABLE_SIZE);
+            for (size_t slot = 0; slot < order.size(); slot++) {
+                Entry &entry = entries[order[slot]];
+                if (static_cast<int>(slot) >= MATERIAL_OVERFLOW_SLOT) {
+                    entry.slot = MATERIAL_OVERFLOW_SLOT;
+                    entry.diffuseArray = entry.specularArray = -1;
+                    continue;
+                }
+                entry.slot = static_cast<int>(slot);
+                entry.diffuseArray = arrayOf(entry.material.diffuseTexture);
+                entry.specularArray = arrayOf(entry.material.specularTexture);
+                GpuMaterial &gpu = table[slot];
+                gpu.diffuse = glm::vec4(entry.material.diffuse, entry.material.shininess);
+                gpu.specular = glm::vec4(entry.material.specular, 0.0f);
+                gpu.layers = glm::ivec4(layerOf(entry.material.diffuseTexture), layerOf(entry.material.specularTexture), 0, 0);
+            }
+
+            glGenBuffers(1, &tableBuffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, tableBuffer);
+            glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(table.size() * sizeof(GpuMaterial)), table.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+            std::cout << "Materials: " << entries.size() << " materials, " << textures.size() << " textures in "
+                      << arrays.size() << " texture arrays" << std::endl;
+        }
+
+        // points the shader's material table and texture arrays at ours. once per shader, after finalize
+        void setupShader(const Shader &shader) const {
+            shader.use();
+            shader.bindUniformBlock("Materials", UNIFORM_BLOCK_MATERIALS);
+            shader.uploadUniformInt("diffuseMaps", MATERIAL_DIFFUSE_UNIT);
+            shader.uploadUniformInt("specularMaps", MATERIAL_SPECULAR_UNIT);
+        }
+
+        // binds the table and forgets which arrays are bound, since other passes use the same units. call at the start
+        // of each frame's scene pass, before any bind()
+        void beginPass() {
+            glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_MATERIALS, tableBuffer);
+            boundDiffuse = boundSpecular = 0;
+            boundProgram = 0;
+        }
+
+        // gets ready to draw with material: binds its arrays if they aren't already and sets its index
+        void bind(const Shader &shader, const int material) {
+            if (material < 0 || material >= static_cast<int>(entries.size())) {
+                return;
+            }
+            const Entry &entry = entries[material];
+            bindArrays({entry.diffuseArray, entry.specularArray});
+            if (shader.ID != boundProgram) {
+                boundProgram = shader.ID;
+                materialIndexLocation = glGetUniformLocation(shader.ID, "materialIndex");
+            }
+            glUniform1i(materialIndexLocation, entry.slot);
+        }
+
+        // the texture arrays (indices, not gl names) the material samples, -1 where it has no texture. materials with
+        // the same arrays can be drawn together without rebinding anything
+        [[nodiscard]] glm::ivec2 textureArrays(const int material) const {
+            if (material < 0 || material >= static_cast<int>(entries.size())) {
+                return glm::ivec2(-1);
+            }
+            return {entries[material].diffuseArray, entries[material].specularArray};
+        }
+
+        // binds the arrays from textureArrays, skipping any already bound, for draws that look the material up
+        // themselves. a material without one of the textures leaves whatever array is there, the shader won't sample it
+        void bindArrays(const glm::ivec2 &textureArrays) {
+            const GLuint diffuse = textureArrays.x >= 0 ? arrays[textureArrays.x].texture : 0;
+            const GLuint specular = textureArrays.y >= 0 ? arrays[textureArrays.y].texture : 0;
+            if (diffuse != boundDiffuse && diffuse != 0) {
+                glActiveTexture(GL_TEXTURE0 + MATERIAL_DIFFUSE_UNIT);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, diffuse);
+                boundDiffuse = diffuse;
+                profiler.addCounter("Texture array binds", 1.0);
+            }
+            if (specular != boundSpecular && specular != 0) {
+                glActiveTexture(GL_TEXTURE0 + MATERIAL_SPECULAR_UNIT);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, specular);
+                glActiveTexture(GL_TEXTURE0);
+                boundSpecular = specular;
+                profiler.addCounter("Texture array binds", 1.0);
+            }
+        }
+
+        // where the material is in the table, which is also the order draws should go in to share bindings
+        [[nodiscard]] int slot(const int material) const {
+            return material >= 0 && material < static_cast<int>(entries.size()) ? entries[material].slot : 0;
+        }
+
+    private:
+
+        // the std140 layout of one element of the Materials block
+        struct GpuMaterial {
+            // rgb colour used when there's no diffuse texture, a is the shininess
+            glm::vec4 diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 32.0f);
+            glm::vec4 specular = glm::vec4(0.0f);
+            // layer of the diffuse and specular texture in their array, -1 for none
+            glm::ivec4 layers = glm::ivec4(-1, -1, 0, 0);
+        };
+
+        struct TextureSource {
+            std::string path;
+            bool srgb = false;
+            // filled in by finalize. pixels is every mip level back to back, inside blob
+            int width = 0;
+            int height = 0;
+            int levels = 0;
+            AssetPack::Blob blob;
+            const unsigned char *pixels = nullptr;
+            int array = -1;
+            int layer = -1;
+        };
+
+        struct TextureArray {
+            GLuint texture = 0;
+            int width = 0;
+            int height = 0;
+            bool srgb = false;
+            int levels = 0;
+            int layers = 0;
+        };
+
+        struct Entry {
+            Material material;
+            int slot = 0;
+            int diffuseArray = -1;
+            int specularArray = -1;
+        };
+
+        std::vector<TextureSource> textures;
+        std::map<std::pair<std::string, bool>, int> textureHandles;
+        std::vector<Entry> entries;
+        std::map<Material, int> materialHandles;
+        std::vector<TextureArray> arrays;
+        GLuint tableBuffer = 0;
+        bool finalized = false;
+
+        GLuint boundDiffuse = 0;
+        GLuint boundSpecular = 0;
+        GLuint boundProgram = 0;
+        GLint materialIndexLocation = -1;
+
+        // always 4 channels with a full mip chain, so textures only need to match in size (and colour space) to share
+        // an array. a texture stored in the pack as it is gets uploaded from where it's mapped, only a compressed one
+        // is decoded first
+        static void open(TextureSource &texture) {
+            texture.blob = assetPack.read(texture.path, true, texture.srgb);
+            BakedTextureView view;
+            if (!readBakedTexture(texture.blob.data(), texture.blob.size, view)) {
+                texture.blob = {};
+                return;
+            }
+            texture.width = static_cast<int>(view.width);
+            texture.height = static_cast<int>(view.height);
+            texture.levels = static_cast<int>(view.levels);
+            texture.pixels = view.pixels;
+        }
+
+        void buildArrays() {
+            GLint maxLayers = 256;
+            glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+            // group by size and colour space, splitting any group bigger than an array can hold
+            std::map<std::tuple<int, int, bool>, int> open;
+            for (TextureSource &texture : textures) {
+                if (!texture.pixels) {
+                    std::cout << "Texture failed to load at path: " << texture.path << " (missing from the asset pack or baked wrong, run AssetBaker)" << std::endl;
+                    continue;
+                }
+                const auto key = std::make_tuple(texture.width, texture.height, texture.srgb);
+                auto found = open.find(key);
+                if (found == open.end() || arrays[found->second].layers >= maxLayers) {
+                    arrays.push_back({0, texture.width, texture.height, texture.srgb, texture.levels, 0});
+                    found = open.insert_or_assign(key, static_cast<int>(arrays.size()) - 1).first;
+                }
+                texture.array = found->second;
+                texture.layer = arrays[found->second].layers++;
+            }
+
+            for (int a = 0; a < static_cast<int>(arrays.size()); a++) {
+                TextureArray &array = arrays[a];
+                glGenTextures(1, &array.texture);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+                // the baker already made the mips, so each level is uploaded rather than generated
+                for (int level = 0; level < array.levels; level++) {
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, static_cast<GLsizei>(bakedMipSize(array.width, level)),
+                                 static_cast<GLsizei>(bakedMipSize(array.height, level)), array.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                }
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+                for (const TextureSource &texture : textures) {
+                    if (texture.array != a) {
+                        continue;
+                    }
+                    const unsigned char *pixels = texture.pixels;
+                    for (int level = 0; level < array.levels; level++) {
+                        const uint32_t width = bakedMipSize(texture.width, level);
+                        const uint32_t height = bakedMipSize(texture.height, level);
+                        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, texture.layer, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 1,
+                                        GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                        pixels += static_cast<size_t>(width) * height * 4;
+                    }
+                }
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+            for (TextureSource &texture : textures) {
+                if (texture.pixels) {
+                    std::cout << "Loaded texture with path: " << texture.path << std::endl;
+                    texture.blob = {};
+                    texture.pixels = nullptr;
+                }
+            }
+        }
+
+        [[nodiscard]] int arrayOf(const int texture) const {
+            return texture >= 0 ? textures[texture].array : -1;
+        }
+
+        [[nodiscard]] int layerOf(const int texture) const {
+            return texture >= 0 ? textures[texture].layer : -1;
+        }
+};
+
+inline MaterialRegistry materials;
+
+#endif //MATERIAL_H
@@ -1,27 +1,24 @@
 #pragma once
 #include "shader.h"
 #include "glad/glad.h"
+#include "material.h"
+#include "profiler.h"
+#include "simplify.h"
 
 #ifndef MESH_H
 #define MESH_H
 
-struct Texture {
-    unsigned int id;
-    std::string type;
-    aiString path;
-};
-
 struct Vertex {
     glm::vec3 Position;
     glm::vec3 Normal;
     glm::vec2 TexCoords;
 };
 
-struct Material {
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-    glm::vec3 ambient;
-    float shininess;
+// one level of detail: a range of the shared element buffer, and how far (in model units) it strays from level 0
+struct MeshLod {
+    GLuint firstIndex;
+    GLsizei indexCount;
+    float error;
 };
 
 class Mesh {
@@ -30,57 +27,80 @@ class Mesh {
 
         std::vector<Vertex> vertices;
         std::vector<unsigned int> indices;
-        std::vector<Texture> textures;
-        Material material;
+        // handle in the MaterialRegistry
+        int material = -1;
+        // level 0 is the full index list, the rest are simplified copies living after it in the same element buffer
+        std::vector<MeshLod> lods;
 
         GLuint VAO;
 
-        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, const std::vector<Texture> &textures) {
+        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, const int material,
+             const std::vector<SimplifyResult> &simplifiedLevels = {}) {
             this->vertices = vertices;
             this->indices = indices;
-            this->textures = textures;
+            this->material = material;
+
+            // every level of detail goes in the one element buffer, back to back
+            std::vector<GLuint> allIndices(indices.begin(), indices.end());
+            lods.push_back({0, static_cast<GLsizei>(indices.size()), 0.0f});
+            for (const SimplifyResult &level : simplifiedLevels) {
+                lods.push_back({static_cast<GLuint>(allIndices.size()), static_cast<GLsizei>(level.indices.size()), level.error});
+                allIndices.insert(allIndices.end(), level.indices.begin(), level.indices.end());
+            }
+            prepareMesh(this->vertices.data(), this->vertices.size(), allIndices.data(), allIndices.size());
+        }
 
-            prepareMesh();
+        // a mesh from the asset baker, its levels of detail already back to back in elements with level 0 first. the
+        // gpu buffers are filled straight from vertexData and elements, which point into the asset pack; the cpu copies
+        // are only for the bvh, heightfield and occlusion code that read them
+        Mesh(const Vertex *vertexData, const size_t vertexCount, const GLuint *elements, const size_t elementCount, std::vector<MeshLod> levels,
+             const int material) {
+            this->vertices.assign(vertexData, vertexData + vertexCount);
+            this->indices.assign(elements, elements + levels.front().indexCount);
+            this->material = material;
+            lods = std::move(levels);
+
+            prepareMesh(vertexData, vertexCount, elements, elementCount);
         }
 
-        void draw(const Shader &shader) const {
-
-            GLuint diffuseNr = 1;
-            GLuint specularNr = 1;
-            GLuint normalNr = 1;
-            GLuint heightNr = 1;
-
-            for (unsigned int i = 0; i < textures.size(); i++) {
-                glActiveTexture(GL_TEXTURE0 + i);
-
-                std::string num;
-                std::string name = textures[i].type;
-                if (name == "diffuseTex") {
-                    num = std::to_string(diffuseNr++);
-                } else if (name == "specularTex") {
-                    num = std::to_string(specularNr++);
-                } else if (name == "normalTex") {
-                    num = std::to_string(normalNr++);
-                } else if (name == "heightTex") {
-                    num = std::to_string(heightNr++);
-                } else {
-                    std::cout << name << " is not a valid texture type!" << std::endl;
-                }
-                glUniform1i(glGetUniformLocation(shader.ID, (name + num).c_str()), i);
-
-                glBindTexture(GL_TEXTURE_2D, textures[i].id);
-            }
+        void draw(const Shader &shader, const int lod = 0) const {
+
+            materials.bind(shader, material);
+
+            const MeshLod &level = lods[std::min(lod, static_cast<int>(lods.size()) - 1)];
+            profiler.addCounter("Triangles drawn", level.indexCount / 3);
+            profiler.addCounter("Triangles full LOD", static_cast<double>(indices.size() / 3));
 
             glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, nullptr);
+            glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, reinterpret_cast<void *>(level.firstIndex * sizeof(GLuint)));
             glBindVertexArray(0);
-            glActiveTexture(GL_TEXTURE0);
+        }
+
+        // the buffers behind the VAO, for copying the mesh somewhere else. the element buffer holds every level, back to back
+        [[nodiscard]] GLuint vertexBuffer() const {
+            return vboID;
+        }
+
+        [[nodiscard]] GLuint elementBuffer() const {
+            return eboID;
+        }
+
+        [[nodiscard]] GLuint elementCount() const {
+            return lods.back().firstIndex + static_cast<GLuint>(lods.back().indexCount);
+        }
+
+        // frees the gpu side. meshes are copied around by value, so this is never done automatically
+        void release() {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &vboID);
+            glDeleteBuffers(1, &eboID);
+            VAO = vboID = eboID = 0;
         }
 
     private:
         unsigned int vboID, eboID;
 
-        void prepareMesh() {
+        void prepareMesh(const Vertex *vertexData, const size_t vertexCount, const GLuint *elements, const size_t elementCount) {
             //generates the vertex arrays and buffers
             glGenVertexArrays(1, &VAO);
             glGenBuffers(1, &vboID);
@@ -91,10 +111,10 @@ class Mesh {
             //binds the buffer so we can store data in it
             glBindBuffer(GL_ARRAY_BUFFER, vboID);
 
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCount * sizeof(Vertex)), vertexData, GL_STATIC_DRAW);
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboID);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(elementCount * sizeof(GLuint)), elements, GL_STATIC_DRAW);
             //let me break it down for you Mark.
             //the size is the number of elements in the attribute. e.g. a vec3 would have 3 and a vec2 would have 2
             //the stride is the total number of elements multiplied by the float size in bytes. e.g. a vec2 and vec3 would have a combined size of 5
@@ -1,213 +1,151 @@
 #ifndef MODEL_H
 #define MODEL_H
-#include "assimp/mesh.h"
+#include <cstring>
 #include <vector>
-#include "assimp/postprocess.h"
-#include "assimp/scene.h"
-#include "assimp/Importer.hpp"
 #include <string>
+#include "assetpack.h"
 #include "mesh.h"
-#include "stb_image.h"
-
-struct aiMaterial;
+#include "glm/gtc/type_ptr.hpp"
 
 using namespace std;
 
+static_assert(sizeof(Vertex) == sizeof(BakedVertex), "baked vertices are copied straight into Vertex");
+
 class Model {
     public:
 
-        vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
         vector<Mesh>    meshes;
-        string directory;
+        // bounding sphere in model space, used to work out how big the model is on screen
+        glm::vec3 boundsCentre = glm::vec3(0.0f);
+        float boundsRadius = 0.0f;
 
         Model(const string &filepath) {
             loadModel(filepath);
         }
-        void draw(Shader &shader) {
+        void draw(Shader &shader, const int lod = 0) {
 
             for (GLuint i = 0; i < meshes.size(); i++) {
-                meshes[i].draw(shader);
+                meshes[i].draw(shader, lod);
             }
         }
 
-    private:
-
-        static GLuint loadTexture(const char* path, const std::string &directory) {
-
-            string filename = string(path);
-            filename = directory + '/' + filename;
-
-            GLuint textureID;
-            glGenTextures(1, &textureID);
-
-            int width, height, nrComponents;
-
-            if (unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0)) {
-
-                GLenum format = 0;
-                if (nrComponents == 1)
-                    format = GL_RED;
-                else if (nrComponents == 3)
-                    format = GL_RGB;
-                else if (nrComponents == 4)
-                    format = GL_RGBA;
-
-                glBindTexture(GL_TEXTURE_2D, textureID);
-                glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-                glGenerateMipmap(GL_TEXTURE_2D);
-
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-                stbi_image_free(data);
-                std::cout << "Loaded texture with path: " << filename << std::endl;
-            }
-            else
-            {
-                std::cout << "Texture failed to load at path: " << path << std::endl;
+        // where the model falls in material order (its first mesh's slot), for sorting draws so that models sharing
+        // texture arrays are drawn one after another
+        [[nodiscard]] int materialKey() const {
+            return meshes.empty() ? 0 : materials.slot(meshes.front().material);
+        }
 
-                stbi_image_free(data);
+        [[nodiscard]] int lodCount() const {
+            size_t count = 1;
+            for (const Mesh &mesh : meshes) {
+                count = std::max(count, mesh.lods.size());
             }
-
-            return textureID;
+            return static_cast<int>(count);
         }
-        std::vector<Texture> loadMaterialTex(const aiMaterial *material, const aiTextureType type, const std::string &typeName) {
-
-            std::vector<Texture> textures;
-            for (GLuint i = 0; i < material->GetTextureCount(type); i++) {
 
-                aiString str;
-                material->GetTexture(type, i, &str);
-                bool skip = false;
-                for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-
-                    if (std::strcmp(textures_loaded[j].path.C_Str(), str.C_Str()) == 0) {
-
-                        textures.push_back(textures_loaded[j]);
-                        skip = true;
-                        break;
-                    }
-                }
-                if (!skip) {
-                    Texture texture;
-                    texture.id = loadTexture(str.C_Str(), directory);
-                    texture.type = typeName;
-                    texture.path = str;
-                    textures.push_back(texture);
-                    textures_loaded.push_back(texture);
-                }
+        // the worst geometric error (model units) of any mesh at this level. meshes with fewer levels use their last
+        [[nodiscard]] float lodError(const int lod) const {
+            float error = 0.0f;
+            for (const Mesh &mesh : meshes) {
+                error = std::max(error, mesh.lods[std::min(lod, static_cast<int>(mesh.lods.size()) - 1)].error);
             }
-            return textures;
+            return error;
         }
-        static Material loadMaterial(const aiMaterial *mat) {
-
-            Material material;
-            aiColor3D colour(0.0f, 0.0f, 0.0f);
-            float shininess;
-
-            mat->Get(AI_MATKEY_COLOR_DIFFUSE, colour);
-            material.diffuse = glm::vec3(colour[0], colour[1], colour[2]);
-
-            mat->Get(AI_MATKEY_COLOR_AMBIENT, colour);
-            material.ambient = glm::vec3(colour[0], colour[1], colour[2]);
-
-            mat->Get(AI_MATKEY_COLOR_SPECULAR, colour);
-            material.specular = glm::vec3(colour[0], colour[1], colour[2]);
-
-            mat->Get(AI_MATKEY_SHININESS, shininess);
-            material.shininess = shininess;
 
-            return material;
+        // the bounding sphere in world space, centre in xyz and radius in w. the radius grows by the largest scale
+        [[nodiscard]] glm::vec4 worldSphere(const glm::mat4 &modelMatrix) const {
+            const float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+                                         std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+            return {glm::vec3(modelMatrix * glm::vec4(boundsCentre, 1.0f)), boundsRadius * scale};
         }
 
-        Mesh processMesh(aiMesh *mesh, const aiScene *scene) {
-
-            //for the input mesh, it will create a list of vertices, indies and textures for it
-            std::vector<Vertex> vertices;
-            std::vector<unsigned int> indices;
-            std::vector<Texture> textures;
-
-            for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-                Vertex vertex;
-
-                glm::vec3 vector;
-                vector.x = mesh->mVertices[i].x;
-                vector.y = mesh->mVertices[i].y;
-                vector.z = mesh->mVertices[i].z;
-                vertex.Position = vector;
-
-                glm::vec3 normal;
-                normal.x = mesh->mNormals[i].x;
-                normal.y = mesh->mNormals[i].y;
-                normal.z = mesh->mNormals[i].z;
-                vertex.Normal = normal;
-
-                if (mesh->mTextureCoords[0]) {
-                    glm::vec2 tex;
-                    tex.x = mesh->mTextureCoords[0][i].x;
-                    tex.y = mesh->mTextureCoords[0][i].y;
-                    vertex.TexCoords = tex;
-                } else {
-                    vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-                }
-                vertices.push_back(vertex);
-            }
-
-            for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-
-                aiFace face = mesh->mFaces[i];
-                for (int j = 0; j < face.mNumIndices; j++) {
-                    indices.push_back(face.mIndices[j]);
-                }
-            }
-
-            aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-
-            // 1. diffuse maps
-            vector<Texture> diffuseMaps = loadMaterialTex(material, aiTextureType_DIFFUSE, "diffuseTex");
-            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            // 2. specular maps
-            vector<Texture> specularMaps = loadMaterialTex(material, aiTextureType_SPECULAR, "specularTex");
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-            // 3. normal maps
-            std::vector<Texture> normalMaps = loadMaterialTex(material, aiTextureType_HEIGHT, "normalTex");
-            textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-            // 4. height maps
-            std::vector<Texture> heightMaps = loadMaterialTex(material, aiTextureType_AMBIENT, "heightTex");
-            textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-            return Mesh(vertices, indices, textures);
+        // a world space box around the bounding sphere, for the broad phase. loose, but it doesn't change as the model spins
+        void worldBounds(const glm::mat4 &modelMatrix, glm::vec3 &min, glm::vec3 &max) const {
+            const glm::vec4 sphere = worldSphere(modelMatrix);
+            min = glm::vec3(sphere) - glm::vec3(sphere.w);
+            max = glm::vec3(sphere) + glm::vec3(sphere.w);
         }
 
-        //this function takes in a node and recursively creates a mesh for each of its children, then adds it to the mesh
-        void processNode(const aiNode *node, const aiScene *scene) {
-
-            for (GLuint i = 0; i < node->mNumMeshes; i++) {
-                aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-                meshes.push_back(processMesh(mesh, scene));
-            }
-            for (GLuint i = 0; i < node->mNumChildren; i++) {
-                processNode(node->mChildren[i], scene);
-            }
-
-        }
+    private:
 
+        // everything comes out of the asset pack's blob for filepath, which already has the node transforms applied,
+        // the levels of detail simplified and the bounds worked out. the textures are only queued here, by source path;
+        // the registry reads them from the pack when it builds its arrays
         void loadModel(const std::string &filepath) {
-            Assimp::Importer importer;
-            const aiScene *scene = importer.ReadFile(filepath, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
-
-            if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-                std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+            const AssetPack::Blob blob = assetPack.read(filepath);
+            if (!blob || blob.size < sizeof(BakedModelHeader)) {
+                std::cout << "MODEL: " << filepath << " isn't in the asset pack, run AssetBaker" << std::endl;
+                return;
+            }
+            const unsigned char *bytes = blob.data();
+            const auto *header = reinterpret_cast<const BakedModelHeader *>(bytes);
+            // whether count things of size bytes starting at offset are all inside the blob, written so a corrupt
+            // offset or count can't wrap the sum round
+            const auto fits = [&blob](const uint64_t offset, const uint64_t count, const uint64_t size) {
+                return offset <= blob.size && count <= (blob.size - offset) / size;
+            };
+            if (std::memcmp(header->magic, BAKED_MODEL_MAGIC, sizeof(header->magic)) != 0 || header->version != BAKED_ASSET_VERSION ||
+                !fits(sizeof(BakedModelHeader), header->meshCount, sizeof(BakedMeshRecord)) || !fits(header->stringOffset, header->stringBytes, 1)) {
+                std::cout << "MODEL: baked " << filepath << " is damaged, run AssetBaker" << std::endl;
                 return;
             }
-            //calls the process node for the root node, meaning all subsequent meshes will be added to the
-            //mesh vertex list
-            directory = filepath.substr(0, filepath.find_last_of('/'));
+            const auto *records = reinterpret_cast<const BakedMeshRecord *>(bytes + sizeof(BakedModelHeader));
+            const char *strings = reinterpret_cast<const char *>(bytes + header->stringOffset);
+            // a texture path has to start inside the strings and end with a nul before they do
+            const auto validString = [&](const uint32_t offset) {
+                return offset == BAKED_NO_TEXTURE ||
+                       (offset < header->stringBytes && std::memchr(strings + offset, '\0', header->stringBytes - offset) != nullptr);
+            };
+
+            for (uint32_t i = 0; i < header->meshCount; i++) {
+                const BakedMeshRecord &record = records[i];
+                if (record.lodCount == 0 || !fits(record.vertexOffset, record.vertexCount, sizeof(BakedVertex)) ||
+                    !fits(record.indexOffset, record.indexCount, sizeof(GLuint)) || !fits(record.lodOffset, record.lodCount, sizeof(BakedLodRecord))) {
+                    std::cout << "MODEL: mesh " << i << " of " << filepath << " runs off the end of its baked file" << std::endl;
+                    continue;
+                }
+                const auto *vertices = reinterpret_cast<const Vertex *>(bytes + record.vertexOffset);
+                const auto *elements = reinterpret_cast<const GLuint *>(bytes + record.indexOffset);
+                const auto *levels = reinterpret_cast<const BakedLodRecord *>(bytes + record.lodOffset);
+
+                // everything the gpu will be pointed at: each level inside the element list, and every element naming
+                // a vertex that's there. a bad index would otherwise be read past the vertex buffer by the driver
+                bool valid = validString(record.diffuseTexture) && validString(record.specularTexture);
+                for (uint32_t lod = 0; lod < record.lodCount && valid; lod++) {
+                    valid = static_cast<uint64_t>(levels[lod].firstIndex) + levels[lod].indexCount <= record.indexCount;
+                }
+                for (uint32_t element = 0; element < record.indexCount && valid; element++) {
+                    valid = elements[element] < record.vertexCount;
+                }
+                if (!valid) {
+                    std::cout << "MODEL: mesh " << i << " of " << filepath << " is damaged, run AssetBaker" << std::endl;
+                    continue;
+                }
+                std::vector<MeshLod> lods(record.lodCount);
+                for (uint32_t lod = 0; lod < record.lodCount; lod++) {
+                    lods[lod] = {levels[lod].firstIndex, static_cast<GLsizei>(levels[lod].indexCount), levels[lod].error};
+                }
 
-            processNode(scene->mRootNode, scene);
+                Material material;
+                material.diffuse = glm::make_vec3(record.diffuse);
+                material.specular = glm::make_vec3(record.specular);
+                material.ambient = glm::make_vec3(record.ambient);
+                material.shininess = record.shininess;
+                // colour textures are stored as srgb so the shader samples them in linear space, which the hdr target
+                // and tonemapper expect. data textures (specular) are already linear
+                if (record.diffuseTexture != BAKED_NO_TEXTURE) {
+                    material.diffuseTexture = materials.addTexture(strings + record.diffuseTexture, true);
+                }
+                if (record.specularTexture != BAKED_NO_TEXTURE) {
+                    material.specularTexture = materials.addTexture(strings + record.specularTexture, false);
+                }
+                meshes.emplace_back(vertices, record.vertexCount, elements, record.indexCount, std::move(lods), materials.add(material));
+            }
 
+            if (!meshes.empty()) {
+                boundsCentre = glm::make_vec3(header->boundsCentre);
+                boundsRadius = header->boundsRadius;
+            }
         }
 };
 #endif //MODEL_H
@@ -0,0 +1,492 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "glm/glm.hpp"
+#include "jobs.h"
+#include "profiler.h"
+#include "simplify.h"
+
+// see transformbatch.h, same split between the sse2 every x86-64 cpu has and the avx2 only some do
+#if defined(__x86_64__) || defined(_M_X64)
+#define OCCLUSION_USE_SSE 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define OCCLUSION_AVX2 __attribute__((target("avx2")))
+#else
+#include <intrin.h>
+#define OCCLUSION_AVX2
+#endif
+#endif
+
+// the software depth buffer's size. low res on purpose, it only has to be good enough to hide whole objects
+constexpr int OCCLUSION_WIDTH = 320;
+constexpr int OCCLUSION_HEIGHT = 192;
+// the buffer is split into tiles that are rasterised in parallel. the width is a multiple of 8, the widest simd row
+constexpr int OCCLUSION_TILE_WIDTH = 32;
+constexpr int OCCLUSION_TILE_HEIGHT = 16;
+constexpr int OCCLUSION_TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+constexpr int OCCLUSION_TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+static_assert(OCCLUSION_WIDTH % OCCLUSION_TILE_WIDTH == 0 && OCCLUSION_HEIGHT % OCCLUSION_TILE_HEIGHT == 0, "the tiles have to cover the buffer exactly");
+// occluder triangles are clipped this many screen widths out, so the edge equations stay well inside float precision
+constexpr float OCCLUSION_GUARD_BAND = 4.0f;
+// occluder meshes are simplified to about this fraction of their triangles, stopping where a collapse would cost more
+// than this fraction of the model's size (as a quadric error, see simplify.h)
+constexpr float OCCLUDER_SIMPLIFY_RATIO = 0.1f;
+constexpr float OCCLUDER_MAX_ERROR = 0.01f;
+
+// a cut down copy of a model's geometry, in the model's own space, for drawing into an OcclusionBuffer
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+
+    [[nodiscard]] size_t triangleCount() const {
+        return indices.size() / 3;
+    }
+
+    // every mesh of the model, simplified inward only. moving vertices onto their neighbours alone would still cut
+    // corners outwards wherever the surface is concave, and an occluder reaching past the model hides things that
+    // should be drawn. inward only it sits inside, so what it hides the model would have too. meshes that aren't
+    // closed or don't wind anticlockwise from outside keep that only as far as each triangle's own neighbourhood
+    template<typename ModelType>
+    static OccluderMesh fromModel(const ModelType &model, const float ratio = OCCLUDER_SIMPLIFY_RATIO) {
+        OccluderMesh occluder;
+        for (const auto &mesh : model.meshes) {
+            std::vector<glm::vec3> positions;
+            positions.reserve(mesh.vertices.size());
+            for (const auto &vertex : mesh.vertices) {
+                positions.push_back(vertex.Position);
+            }
+            const std::vector<unsigned int> indices(mesh.indices.begin(), mesh.indices.end());
+            const auto target = static_cast<size_t>(static_cast<float>(indices.size()) * ratio) / 3 * 3;
+            const SimplifyResult simplified = simplifyMesh(positions, {}, indices, target, model.boundsRadius * OCCLUDER_MAX_ERROR, true);
+
+            const auto base = static_cast<unsigned int>(occluder.positions.size());
+            occluder.positions.insert(occluder.positions.end(), positions.begin(), positions.end());
+            for (const unsigned int index : simplified.indices) {
+                occluder.indices.push_back(base + index);
+            }
+        }
+        return occluder;
+    }
+};
+
+// a cpu depth buffer for occlusion culling where the gpu can't do it (no compute shaders, or reading back from it
+// costs too much). the big occluders are rasterised into it at low res, then objects' bounding boxes are tested
+// against it: a box whose nearest point is behind the depth everywhere it covers is hidden.
+// triangles are set up and binned into tiles as they're added, then each tile is rasterised on its own through the
+// job system with the widest simd the cpu has, keeping the farthest depth in each tile so most box tests never
+// look at a pixel. like masked occlusion culling it's conservative in one direction only: an occluder pixel counts
+// when its centre is covered, so a gap thinner than a pixel can be missed, but nothing is hidden by an occluder
+// that isn't there. depths are window space as gl writes them, 0 near to 1 far, and row 0 is the bottom
+class OcclusionBuffer {
+    public:
+
+        // one occluder triangle ready to rasterise. the edge functions are positive inside, and with the depth
+        // they're planes in pixel coordinates, evaluated at pixel centres
+        struct Triangle {
+            float edgeA[3], edgeB[3], edgeC[3];
+            float depthA, depthB, depthC;
+            // the pixels it can touch, inclusive and on screen
+            int minX, minY, maxX, maxY;
+        };
+
+        using TileKernel = void (*)(const Triangle *triangles, const int *bin, size_t count, int tileX, int tileY, float *tile);
+
+        OcclusionBuffer() : depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f), tileFarthest(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 1.0f),
+                            bins(OCCLUSION_TILES_X * OCCLUSION_TILES_Y) {}
+
+        // empties the buffer for a new view
+        void begin(const glm::mat4 &viewProjection) {
+            this->viewProjection = viewProjection;
+            triangles.clear();
+            for (std::vector<int> &bin : bins) {
+                bin.clear();
+            }
+        }
+
+        // clips, sets up and bins the occluder's triangles. model places the occluder in the world
+        void addOccluder(const OccluderMesh &occluder, const glm::mat4 &model) {
+            const glm::mat4 transform = viewProjection * model;
+            vertices.resize(occluder.positions.size());
+            for (size_t i = 0; i < occluder.positions.size(); i++) {
+                ClipVertex &vertex = vertices[i];
+                vertex.clip = transform * glm::vec4(occluder.positions[i], 1.0f);
+                vertex.outside = outcode(vertex.clip);
+                if (!(vertex.outside & OUTSIDE_NEEDS_CLIPPING)) {
+                    vertex.screen = toScreen(vertex.clip);
+                }
+            }
+            for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+                const ClipVertex &a = vertices[occluder.indices[i]];
+                const ClipVertex &b = vertices[occluder.indices[i + 1]];
+                const ClipVertex &c = vertices[occluder.indices[i + 2]];
+                // all three past the same plane, so none of it is on screen
+                if (a.outside & b.outside & c.outside) {
+                    continue;
+                }
+                if ((a.outside | b.outside | c.outside) & OUTSIDE_NEEDS_CLIPPING) {
+                    clipTriangle(a.clip, b.clip, c.clip);
+                } else {
+                    setup(a.screen, b.screen, c.screen);
+                }
+            }
+        }
+
+        // rasterises everything added since begin()
+        void rasterize() {
+            rasterize(kernel());
+        }
+
+        // the same with a particular kernel, for checking them against each other
+        void rasterize(const TileKernel tileKernel) {
+            const auto start = std::chrono::steady_clock::now();
+            jobs.parallelFor(static_cast<int>(bins.size()), [this, tileKernel](const int begin, const int end) {
+                for (int t = begin; t < end; t++) {
+                    float *tile = &depth[static_cast<size_t>(t) * OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT];
+                    std::fill(tile, tile + OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT, 1.0f);
+                    const int tileX = t % OCCLUSION_TILES_X * OCCLUSION_TILE_WIDTH;
+                    const int tileY = t / OCCLUSION_TILES_X * OCCLUSION_TILE_HEIGHT;
+                    tileKernel(triangles.data(), bins[t].data(), bins[t].size(), tileX, tileY, tile);
+                    tileFarthest[t] = *std::max_element(tile, tile + OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT);
+                }
+            });
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            profiler.setCounter("Occluder triangles", static_cast<double>(triangles.size()));
+            profiler.setCounter("Occluder triangles/ms", ms > 0.0 ? static_cast<double>(triangles.size()) / ms : 0.0);
+        }
+
+        // whether a world space box is certainly hidden behind the occluders. off screen counts as not hidden,
+        // that's for frustum culling to decide
+        [[nodiscard]] bool occluded(const glm::vec3 &min, const glm::vec3 &max) const {
+            glm::vec2 low(1e30f), high(-1e30f);
+            float nearest = 1.0f;
+            for (int corner = 0; corner < 8; corner++) {
+                const glm::vec3 point((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+                const glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+                // reaching past the near plane, so in front of everything
+                if (clip.z < -clip.w) {
+                    return false;
+                }
+                const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                low = glm::min(low, glm::vec2(ndc));
+                high = glm::max(high, glm::vec2(ndc));
+                nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+            }
+            const int minX = std::max(static_cast<int>(std::floor((low.x * 0.5f + 0.5f) * OCCLUSION_WIDTH)), 0);
+            const int minY = std::max(static_cast<int>(std::floor((low.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT)), 0);
+            const int maxX = std::min(static_cast<int>(std::floor((high.x * 0.5f + 0.5f) * OCCLUSION_WIDTH)), OCCLUSION_WIDTH - 1);
+            const int maxY = std::min(static_cast<int>(std::floor((high.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT)), OCCLUSION_HEIGHT - 1);
+            if (minX > maxX || minY > maxY) {
+                return false;
+            }
+
+            for (int ty = minY / OCCLUSION_TILE_HEIGHT; ty <= maxY / OCCLUSION_TILE_HEIGHT; ty++) {
+                for (int tx = minX / OCCLUSION_TILE_WIDTH; tx <= maxX / OCCLUSION_TILE_WIDTH; tx++) {
+                    const int t = ty * OCCLUSION_TILES_X + tx;
+                    // behind the farthest thing in the tile, so behind all of it
+                    if (nearest > tileFarthest[t]) {
+                        continue;
+                    }
+                    const float *tile = &depth[static_cast<size_t>(t) * OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT];
+                    const int x0 = std::max(minX - tx * OCCLUSION_TILE_WIDTH, 0);
+                    const int x1 = std::min(maxX - tx * OCCLUSION_TILE_WIDTH, OCCLUSION_TILE_WIDTH - 1);
+                    const int y0 = std::max(minY - ty * OCCLUSION_TILE_HEIGHT, 0);
+                    const int y1 = std::min(maxY - ty * OCCLUSION_TILE_HEIGHT, OCCLUSION_TILE_HEIGHT - 1);
+                    for (int y = y0; y <= y1; y++) {
+                        for (int x = x0; x <= x1; x++) {
+                            if (tile[y * OCCLUSION_TILE_WIDTH + x] >= nearest) {
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        // the depth at a pixel, row 0 at the bottom
+        [[nodiscard]] float depthAt(const int x, const int y) const {
+            const int t = y / OCCLUSION_TILE_HEIGHT * OCCLUSION_TILES_X + x / OCCLUSION_TILE_WIDTH;
+            return depth[static_cast<size_t>(t) * OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT
+                         + (y % OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_WIDTH + x % OCCLUSION_TILE_WIDTH];
+        }
+
+        [[nodiscard]] size_t triangleCount() const {
+            return triangles.size();
+        }
+
+        // writes the buffer as a 16 bit greyscale pgm, top row first, for comparing against a known good image.
+        // near is black
+        bool saveDepth(const char *path) const {
+            FILE *file = std::fopen(path, "wb");
+            if (!file) {
+                return false;
+            }
+            std::fprintf(file, "P5\n%d %d\n65535\n", OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+            for (int y = OCCLUSION_HEIGHT - 1; y >= 0; y--) {
+                for (int x = 0; x < OCCLUSION_WIDTH; x++) {
+                    const auto value = static_cast<unsigned>(std::clamp(depthAt(x, y), 0.0f, 1.0f) * 65535.0f + 0.5f);
+                    const unsigned char bytes[2] = {static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value & 0xff)};
+                    std::fwrite(bytes, 1, 2, file);
+                }
+            }
+            return std::fclose(file) == 0;
+        }
+
+        // which kernel rasterize() runs on this cpu
+        static const char *path() {
+#ifdef OCCLUSION_USE_SSE
+            return hasAvx2() ? "avx2" : "sse";
+#else
+            return "scalar";
+#endif
+        }
+
+        // one pixel at a time, what the simd kernels have to match exactly
+        static void rasterizeTileScalar(const Triangle *triangles, const int *bin, const size_t count, const int tileX, const int tileY, float *tile) {
+            for (size_t i = 0; i < count; i++) {
+                const Triangle &tri = triangles[bin[i]];
+                const int x0 = std::max(tri.minX, tileX), x1 = std::min(tri.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+                const int y0 = std::max(tri.minY, tileY), y1 = std::min(tri.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+                for (int y = y0; y <= y1; y++) {
+                    const float py = static_cast<float>(y) + 0.5f;
+                    float *row = tile + (y - tileY) * OCCLUSION_TILE_WIDTH;
+                    for (int x = x0; x <= x1; x++) {
+                        const float px = static_cast<float>(x) + 0.5f;
+                        const float e0 = tri.edgeA[0] * px + (tri.edgeB[0] * py + tri.edgeC[0]);
+                        const float e1 = tri.edgeA[1] * px + (tri.edgeB[1] * py + tri.edgeC[1]);
+                        const float e2 = tri.edgeA[2] * px + (tri.edgeB[2] * py + tri.edgeC[2]);
+                        if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                            const float z = tri.depthA * px + (tri.depthB * py + tri.depthC);
+                            row[x - tileX] = std::min(row[x - tileX], z);
+                        }
+                    }
+                }
+            }
+        }
+
+#ifdef OCCLUSION_USE_SSE
+        // 4 pixels of a row at a time. rows start on a multiple of 4 from the tile's edge, which keeps every group
+        // inside the tile
+        static void rasterizeTileSse(const Triangle *triangles, const int *bin, const size_t count, const int tileX, const int tileY, float *tile) {
+            const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            for (size_t i = 0; i < count; i++) {
+                const Triangle &tri = triangles[bin[i]];
+                const int x0 = tileX + ((std::max(tri.minX, tileX) - tileX) & ~3), x1 = std::min(tri.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+                const int y0 = std::max(tri.minY, tileY), y1 = std::min(tri.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+                const __m128 a0 = _mm_set1_ps(tri.edgeA[0]), a1 = _mm_set1_ps(tri.edgeA[1]), a2 = _mm_set1_ps(tri.edgeA[2]);
+                const __m128 depthA = _mm_set1_ps(tri.depthA);
+                for (int y = y0; y <= y1; y++) {
+                    const float py = static_cast<float>(y) + 0.5f;
+                    const __m128 row0 = _mm_set1_ps(tri.edgeB[0] * py + tri.edgeC[0]);
+                    const __m128 row1 = _mm_set1_ps(tri.edgeB[1] * py + tri.edgeC[1]);
+                    const __m128 row2 = _mm_set1_ps(tri.edgeB[2] * py + tri.edgeC[2]);
+                    const __m128 rowDepth = _mm_set1_ps(tri.depthB * py + tri.depthC);
+                    float *row = tile + (y - tileY) * OCCLUSION_TILE_WIDTH;
+                    for (int x = x0; x <= x1; x += 4) {
+                        const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                        const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), row0), zero),
+                                                                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), row1), zero)),
+                                                         _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), row2), zero));
+                        if (_mm_movemask_ps(inside) == 0) {
+                            continue;
+                        }
+                        const __m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), rowDepth);
+                        const __m128 current = _mm_loadu_ps(row + x - tileX);
+                        const __m128 nearer = _mm_min_ps(current, z);
+                        _mm_storeu_ps(row + x - tileX, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                    }
+                }
+            }
+        }
+
+        // the same, 8 pixels at a time
+        OCCLUSION_AVX2 static void rasterizeTileAvx2(const Triangle *triangles, const int *bin, const size_t count, const int tileX, const int tileY, float *tile) {
+            const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            for (size_t i = 0; i < count; i++) {
+                const Triangle &tri = triangles[bin[i]];
+                const int x0 = tileX + ((std::max(tri.minX, tileX) - tileX) & ~7), x1 = std::min(tri.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+                const int y0 = std::max(tri.minY, tileY), y1 = std::min(tri.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+                const __m256 a0 = _mm256_set1_ps(tri.edgeA[0]), a1 = _mm256_set1_ps(tri.edgeA[1]), a2 = _mm256_set1_ps(tri.edgeA[2]);
+                const __m256 depthA = _mm256_set1_ps(tri.depthA);
+                for (int y = y0; y <= y1; y++) {
+                    const float py = static_cast<float>(y) + 0.5f;
+                    const __m256 row0 = _mm256_set1_ps(tri.edgeB[0] * py + tri.edgeC[0]);
+                    const __m256 row1 = _mm256_set1_ps(tri.edgeB[1] * py + tri.edgeC[1]);
+                    const __m256 row2 = _mm256_set1_ps(tri.edgeB[2] * py + tri.edgeC[2]);
+                    const __m256 rowDepth = _mm256_set1_ps(tri.depthB * py + tri.depthC);
+                    float *row = tile + (y - tileY) * OCCLUSION_TILE_WIDTH;
+                    for (int x = x0; x <= x1; x += 8) {
+                        const __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+                        const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a0, px), row0), zero, _CMP_GE_OQ),
+                                                                          _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a1, px), row1), zero, _CMP_GE_OQ)),
+                                                            _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a2, px), row2), zero, _CMP_GE_OQ));
+                        if (_mm256_movemask_ps(inside) == 0) {
+                            continue;
+                        }
+                        const __m256 z = _mm256_add_ps(_mm256_mul_ps(depthA, px), rowDepth);
+                        const __m256 current = _mm256_loadu_ps(row + x - tileX);
+                        _mm256_storeu_ps(row + x - tileX, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+                    }
+                }
+            }
+        }
+#endif
+
+    private:
+
+        // tile by tile, each tile's rows one after another
+        std::vector<float> depth;
+        std::vector<float> tileFarthest;
+        std::vector<Triangle> triangles;
+        // the triangles touching each tile
+        std::vector<std::vector<int>> bins;
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+
+        // which planes a clip space position is past, a bit each. the screen edges and far plane only ever reject
+        // whole triangles, the near plane and guard band are clipped against
+        static constexpr unsigned OUTSIDE_NEAR = 1 << 0;
+        static constexpr unsigned OUTSIDE_GUARD_BAND = 0xf << 1;
+        static constexpr unsigned OUTSIDE_NEEDS_CLIPPING = OUTSIDE_NEAR | OUTSIDE_GUARD_BAND;
+
+        struct ClipVertex {
+            glm::vec4 clip;
+            // pixel x and y and window depth, only when it doesn't need clipping
+            glm::vec3 screen;
+            unsigned outside;
+        };
+        // scratch, kept so adding occluders stops allocating once it's grown
+        std::vector<ClipVertex> vertices;
+
+        static unsigned outcode(const glm::vec4 &p) {
+            const float band = OCCLUSION_GUARD_BAND * p.w;
+            return (p.z < -p.w ? OUTSIDE_NEAR : 0u)
+                 | (p.x < -band ? 1u << 1 : 0u) | (p.x > band ? 1u << 2 : 0u) | (p.y < -band ? 1u << 3 : 0u) | (p.y > band ? 1u << 4 : 0u)
+                 | (p.x < -p.w ? 1u << 5 : 0u) | (p.x > p.w ? 1u << 6 : 0u) | (p.y < -p.w ? 1u << 7 : 0u) | (p.y > p.w ? 1u << 8 : 0u)
+                 | (p.z > p.w ? 1u << 9 : 0u);
+        }
+
+        static glm::vec3 toScreen(const glm::vec4 &clip) {
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            return {(ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f};
+        }
+
+        static TileKernel kernel() {
+#ifdef OCCLUSION_USE_SSE
+            static const TileKernel chosen = hasAvx2() ? rasterizeTileAvx2 : rasterizeTileSse;
+            return chosen;
+#else
+            return rasterizeTileScalar;
+#endif
+        }
+
+#ifdef OCCLUSION_USE_SSE
+        static bool hasAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+            static const bool supported = __builtin_cpu_supports("avx2");
+#else
+            static const bool supported = [] {
+                int info[4];
+                __cpuid(info, 1);
+                if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+                    return false;
+                }
+                __cpuidex(info, 7, 0);
+                return (info[1] & (1 << 5)) != 0;
+            }();
+#endif
+            return supported;
+        }
+#endif
+
+        // clips against the near plane and the guard band, then sets up and bins what's left as a fan
+        void clipTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+            // each plane as the dot product that's positive on the inside
+            static const glm::vec4 planes[5] = {
+                {0.0f, 0.0f, 1.0f, 1.0f},
+                {-1.0f, 0.0f, 0.0f, OCCLUSION_GUARD_BAND}, {1.0f, 0.0f, 0.0f, OCCLUSION_GUARD_BAND},
+                {0.0f, -1.0f, 0.0f, OCCLUSION_GUARD_BAND}, {0.0f, 1.0f, 0.0f, OCCLUSION_GUARD_BAND},
+            };
+            // a triangle clipped by 5 planes has at most 8 corners
+            glm::vec4 polygon[8] = {a, b, c};
+            glm::vec4 clipped[8];
+            int count = 3;
+            for (const glm::vec4 &plane : planes) {
+                int kept = 0;
+                for (int i = 0; i < count; i++) {
+                    const glm::vec4 &from = polygon[i];
+                    const glm::vec4 &to = polygon[(i + 1) % count];
+                    const float dFrom = glm::dot(plane, from), dTo = glm::dot(plane, to);
+                    if (dFrom >= 0.0f) {
+                        clipped[kept++] = from;
+                    }
+                    if ((dFrom >= 0.0f) != (dTo >= 0.0f)) {
+                        clipped[kept++] = glm::mix(from, to, dFrom / (dFrom - dTo));
+                    }
+                }
+                count = kept;
+                if (count < 3) {
+                    return;
+                }
+                std::copy(clipped, clipped + count, polygon);
+            }
+
+            glm::vec3 screen[8];
+            for (int i = 0; i < count; i++) {
+                screen[i] = toScreen(polygon[i]);
+            }
+            for (int i = 1; i + 1 < count; i++) {
+                setup(screen[0], screen[i], screen[i + 1]);
+            }
+        }
+
+        void setup(const glm::vec3 &v0, glm::vec3 v1, glm::vec3 v2) {
+            float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+            // both windings are drawn, turned round so inside is always positive
+            if (area < 0.0f) {
+                std::swap(v1, v2);
+                area = -area;
+            }
+            if (area <= 1e-8f) {
+                return;
+            }
+
+            Triangle tri;
+            tri.minX = std::max(static_cast<int>(std::floor(std::min({v0.x, v1.x, v2.x}))), 0);
+            tri.minY = std::max(static_cast<int>(std::floor(std::min({v0.y, v1.y, v2.y}))), 0);
+            tri.maxX = std::min(static_cast<int>(std::floor(std::max({v0.x, v1.x, v2.x}))), OCCLUSION_WIDTH - 1);
+            tri.maxY = std::min(static_cast<int>(std::floor(std::max({v0.y, v1.y, v2.y}))), OCCLUSION_HEIGHT - 1);
+            if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+                return;
+            }
+            const glm::vec3 *corners[3] = {&v0, &v1, &v2};
+            for (int e = 0; e < 3; e++) {
+                // the edge opposite corner e, positive on the same side as it
+                const glm::vec3 &from = *corners[(e + 1) % 3];
+                const glm::vec3 &to = *corners[(e + 2) % 3];
+                tri.edgeA[e] = from.y - to.y;
+                tri.edgeB[e] = to.x - from.x;
+                tri.edgeC[e] = from.x * to.y - from.y * to.x;
+            }
+            tri.depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+            tri.depthB = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            tri.depthC = v0.z - tri.depthA * v0.x - tri.depthB * v0.y;
+
+            const auto index = static_cast<int>(triangles.size());
+            triangles.push_back(tri);
+            for (int ty = tri.minY / OCCLUSION_TILE_HEIGHT; ty <= tri.maxY / OCCLUSION_TILE_HEIGHT; ty++) {
+                for (int tx = tri.minX / OCCLUSION_TILE_WIDTH; tx <= tri.maxX / OCCLUSION_TILE_WIDTH; tx++) {
+                    bins[ty * OCCLUSION_TILES_X + tx].push_back(index);
+                }
+            }
+        }
+};
+
+#endif //OCCLUSION_H
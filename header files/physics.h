@@ -0,0 +1,816 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "heightfield.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "spatialhash.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PHYSICS_USE_SSE 1
+#endif
+
+constexpr float PHYSICS_GRAVITY = -9.81f;
+// velocity passes over every island's contacts per step. more is stiffer stacking, fewer is cheaper
+constexpr int PHYSICS_SOLVER_ITERATIONS = 8;
+// how much of the remaining overlap is pushed out per step, and how much overlap is left alone so resting
+// contacts don't jitter in and out of touching
+constexpr float PHYSICS_BAUMGARTE = 0.2f;
+constexpr float PHYSICS_PENETRATION_SLOP = 0.005f;
+// contacts are made a little before things touch, so fast bodies don't tunnel a frame's worth into the ground
+constexpr float PHYSICS_CONTACT_MARGIN = 0.02f;
+// closing speeds below this don't bounce, otherwise resting bodies buzz forever
+constexpr float PHYSICS_RESTITUTION_THRESHOLD = 1.0f;
+// per second, so a thrown prop eventually stops rolling even on a flat floor
+constexpr float PHYSICS_LINEAR_DAMPING = 0.05f;
+constexpr float PHYSICS_ANGULAR_DAMPING = 0.3f;
+// an island that stays slower than this for long enough stops being simulated until something touches it
+constexpr float PHYSICS_SLEEP_SPEED = 0.05f;
+constexpr float PHYSICS_SLEEP_TIME = 0.5f;
+// below this many contacts in a step, handing islands out as jobs costs more than they take to solve
+constexpr int PHYSICS_PARALLEL_MIN_CONTACTS = 256;
+// props are around a metre or smaller, so a finer grid than the default keeps the pairs per cell down
+constexpr float PHYSICS_BROADPHASE_CELL_SIZE = 1.0f;
+
+enum ShapeType {
+    SHAPE_SPHERE,
+    SHAPE_BOX,
+    SHAPE_CAPSULE
+};
+
+// what addBody needs to know. position is the centre of the shape; capsules stand along their local y axis
+struct BodyDesc {
+    ShapeType shape = SHAPE_SPHERE;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    // sphere and capsule
+    float radius = 0.5f;
+    // capsule: half the length of the straight part, not counting the caps
+    float halfHeight = 0.5f;
+    // box
+    glm::vec3 halfExtents = glm::vec3(0.5f);
+    // 0 makes a static body that never moves
+    float mass = 1.0f;
+    float friction = 0.5f;
+    float restitution = 0.2f;
+    // for things like characters that should slide and stand but never tip over
+    bool lockRotation = false;
+    int userId = -1;
+};
+
+// a small rigid body world for props. bodies are kept as structure-of-arrays so the integration, which touches
+// every body every step, runs 4 at a time; contacts are against the terrain heightfield and between bodies, solved
+// with sequential impulses one island (a group of bodies touching each other) at a time, islands in parallel when
+// there are enough of them.
+// boxes collide with the ground by their corners, but with other bodies as the capsule that best fits inside them,
+// which is exact for the long thin props here and good enough for anything else this small
+class PhysicsWorld {
+    public:
+
+        PhysicsWorld() : broadphase(PHYSICS_BROADPHASE_CELL_SIZE) {}
+
+        int addBody(const BodyDesc &desc) {
+            const int body = static_cast<int>(userIds.size());
+            px.push_back(desc.position.x);
+            py.push_back(desc.position.y);
+            pz.push_back(desc.position.z);
+            previousPosition.push_back(desc.position);
+            vx.push_back(0.0f);
+            vy.push_back(0.0f);
+            vz.push_back(0.0f);
+            wx.push_back(0.0f);
+            wy.push_back(0.0f);
+            wz.push_back(0.0f);
+            orientations.push_back(glm::normalize(desc.orientation));
+            previousOrientation.push_back(orientations.back());
+            active.push_back(0.0f);
+
+            Shape shape;
+            shape.type = desc.shape;
+            shape.friction = desc.friction;
+            shape.restitution = desc.restitution;
+            glm::vec3 inertia(0.0f);
+            const float mass = desc.mass;
+            if (desc.shape == SHAPE_SPHERE) {
+                shape.radius = desc.radius;
+                inertia = glm::vec3(0.4f * mass * desc.radius * desc.radius);
+            } else if (desc.shape == SHAPE_CAPSULE) {
+                shape.radius = desc.radius;
+                shape.halfHeight = desc.halfHeight;
+                // treated as a cylinder of the full height, close enough for a capsule that's mostly straight part
+                const float r2 = desc.radius * desc.radius;
+                const float h = 2.0f * (desc.halfHeight + desc.radius);
+                const float across = mass * (3.0f * r2 + h * h) / 12.0f;
+                inertia = glm::vec3(across, 0.5f * mass * r2, across);
+            } else {
+                const glm::vec3 e = desc.halfExtents;
+                shape.halfExtents = e;
+                inertia = glm::vec3(e.y * e.y + e.z * e.z, e.x * e.x + e.z * e.z, e.x * e.x + e.y * e.y) * (mass / 3.0f);
+                // the capsule used against other bodies lies along the longest side, as thick as the next longest
+                shape.axis = e.x >= e.y && e.x >= e.z ? 0 : (e.y >= e.z ? 1 : 2);
+                shape.radius = std::max(e[(shape.axis + 1) % 3], e[(shape.axis + 2) % 3]);
+                shape.halfHeight = std::max(e[shape.axis] - shape.radius, 0.0f);
+            }
+            shapes.push_back(shape);
+
+            invMass.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+            glm::vec3 invInertia(0.0f);
+            if (mass > 0.0f && !desc.lockRotation) {
+                invInertia = glm::vec3(1.0f) / glm::max(inertia, glm::vec3(1e-6f));
+            }
+            invInertiaLocal.push_back(invInertia);
+            invInertiaWorld.emplace_back(0.0f);
+            kinematic.push_back(0);
+            hasTarget.push_back(0);
+            kinematicTarget.push_back(desc.position);
+            asleep.push_back(0);
+            sleepTime.push_back(0.0f);
+            userIds.push_back(desc.userId);
+            island.push_back(body);
+
+            glm::vec3 min, max;
+            bounds(body, 0.0f, min, max);
+            proxies.push_back(broadphase.insert(min, max, body));
+            return body;
+        }
+
+        [[nodiscard]] size_t bodyCount() const {
+            return userIds.size();
+        }
+        [[nodiscard]] int userId(const int body) const {
+            return userIds[body];
+        }
+
+        [[nodiscard]] glm::vec3 position(const int body) const {
+            return {px[body], py[body], pz[body]};
+        }
+        [[nodiscard]] glm::quat orientation(const int body) const {
+            return orientations[body];
+        }
+        [[nodiscard]] glm::vec3 velocity(const int body) const {
+            return {vx[body], vy[body], vz[body]};
+        }
+        [[nodiscard]] bool sleeping(const int body) const {
+            return asleep[body] != 0;
+        }
+
+        // between the state before the last step (0) and after it (1), for rendering between steps
+        [[nodiscard]] glm::vec3 renderPosition(const int body, const float alpha) const {
+            return glm::mix(previousPosition[body], position(body), alpha);
+        }
+        [[nodiscard]] glm::quat renderOrientation(const int body, const float alpha) const {
+            return glm::slerp(previousOrientation[body], orientations[body], alpha);
+        }
+
+        // a kinematic body is moved by hand with moveKinematic and pushes dynamic bodies without being pushed back.
+        // its velocity follows from how far it was moved, so switching back to dynamic carries that on (a throw)
+        void setKinematic(const int body, const bool isKinematic) {
+            kinematic[body] = isKinematic ? 1 : 0;
+            hasTarget[body] = 0;
+            wake(body);
+            if (isKinematic) {
+                wx[body] = wy[body] = wz[body] = 0.0f;
+            }
+        }
+        [[nodiscard]] bool isKinematic(const int body) const {
+            return kinematic[body] != 0;
+        }
+
+        // where a kinematic body should be by the end of the next step
+        void moveKinematic(const int body, const glm::vec3 &target, const glm::quat &rotation) {
+            kinematicTarget[body] = target;
+            orientations[body] = glm::normalize(rotation);
+            hasTarget[body] = 1;
+        }
+
+        // puts a body somewhere without it having travelled there, so it isn't interpolated or given a velocity
+        void teleport(const int body, const glm::vec3 &p) {
+            px[body] = p.x;
+            py[body] = p.y;
+            pz[body] = p.z;
+            previousPosition[body] = p;
+            vx[body] = vy[body] = vz[body] = 0.0f;
+            wx[body] = wy[body] = wz[body] = 0.0f;
+            hasTarget[body] = 0;
+            wake(body);
+        }
+
+        void applyImpulse(const int body, const glm::vec3 &impulse) {
+            wake(body);
+            vx[body] += impulse.x * invMass[body];
+            vy[body] += impulse.y * invMass[body];
+            vz[body] += impulse.z * invMass[body];
+        }
+
+        void step(const float dt, const Heightfield &ground) {
+            CpuProfileScope scope("Physics");
+            const size_t count = bodyCount();
+            for (size_t i = 0; i < count; i++) {
+                previousPosition[i] = position(static_cast<int>(i));
+                previousOrientation[i] = orientations[i];
+                active[i] = invMass[i] > 0.0f && !kinematic[i] && !asleep[i] ? 1.0f : 0.0f;
+            }
+
+            moveKinematics(dt);
+            integrateVelocities(dt);
+            updateBroadphase(dt);
+            contacts.clear();
+            findBodyContacts();
+            findGroundContacts(ground);
+            buildIslands();
+            solveIslands(dt);
+            integratePositions(dt);
+            updateSleep(dt);
+
+            size_t awake = 0;
+            for (size_t i = 0; i < count; i++) {
+                awake += active[i] != 0.0f;
+            }
+            profiler.setCounter("Physics bodies", static_cast<double>(count));
+            profiler.setCounter("Physics awake", static_cast<double>(awake));
+            profiler.addCounter("Physics contacts", static_cast<double>(contacts.size()));
+            profiler.addCounter("Physics islands", static_cast<double>(islandCount));
+        }
+
+    private:
+
+        struct Shape {
+            ShapeType type = SHAPE_SPHERE;
+            float radius = 0.0f;
+            float halfHeight = 0.0f;
+            glm::vec3 halfExtents = glm::vec3(0.0f);
+            // for boxes, the local axis their collision capsule runs along
+            int axis = 1;
+            float friction = 0.5f;
+            float restitution = 0.2f;
+        };
+
+        // b is -1 for the ground. the normal points from b towards a
+        struct Contact {
+            int a = -1;
+            int b = -1;
+            glm::vec3 point = glm::vec3(0.0f);
+            glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            float depth = 0.0f;
+            float friction = 0.5f;
+            float restitution = 0.0f;
+            // filled in before solving
+            glm::vec3 rA = glm::vec3(0.0f), rB = glm::vec3(0.0f);
+            glm::vec3 tangent[2] = {glm::vec3(0.0f), glm::vec3(0.0f)};
+            float normalMass = 0.0f;
+            float tangentMass[2] = {0.0f, 0.0f};
+            float bias = 0.0f;
+            float normalImpulse = 0.0f;
+            float tangentImpulse[2] = {0.0f, 0.0f};
+        };
+
+        // positions and velocities, one array per component so 4 bodies fit in a register
+        std::vector<float> px, py, pz;
+        std::vector<float> vx, vy, vz;
+        std::vector<float> wx, wy, wz;
+        // 1 for bodies being simulated this step (dynamic and awake), 0 otherwise. multiplied in rather than branched on
+        std::vector<float> active;
+        std::vector<float> invMass;
+        std::vector<glm::vec3> previousPosition;
+        std::vector<glm::quat> orientations;
+        std::vector<glm::quat> previousOrientation;
+        std::vector<glm::vec3> invInertiaLocal;
+        std::vector<glm::mat3> invInertiaWorld;
+        std::vector<Shape> shapes;
+        std::vector<uint8_t> kinematic;
+        std::vector<uint8_t> hasTarget;
+        std::vector<glm::vec3> kinematicTarget;
+        std::vector<uint8_t> asleep;
+        std::vector<float> sleepTime;
+        std::vector<int> userIds;
+
+        SpatialHash broadphase;
+        std::vector<int> proxies;
+        // each body's core() for this step, worked out once rather than for every pair it's in
+        std::vector<glm::vec3> coreStart, coreEnd;
+        std::vector<int> nearby;
+        std::vector<Contact> contacts;
+        // union-find parents while building islands
+        std::vector<int> island;
+        // contact indices of each island, and the bodies in it. only the first islandCount are this step's; the rest
+        // are kept from earlier steps so their memory is reused rather than freed and allocated again every step
+        std::vector<std::vector<int>> islands;
+        std::vector<std::vector<int>> islandBodies;
+        size_t islandCount = 0;
+        std::vector<int> islandIndex;
+        std::vector<float> groundHeights;
+
+        [[nodiscard]] glm::vec3 linearVelocity(const int body) const {
+            return {vx[body], vy[body], vz[body]};
+        }
+        [[nodiscard]] glm::vec3 angularVelocity(const int body) const {
+            return {wx[body], wy[body], wz[body]};
+        }
+        void addVelocity(const int body, const glm::vec3 &linear, const glm::vec3 &angular) {
+            vx[body] += linear.x;
+            vy[body] += linear.y;
+            vz[body] += linear.z;
+            wx[body] += angular.x;
+            wy[body] += angular.y;
+            wz[body] += angular.z;
+        }
+
+        void wake(const int body) {
+            asleep[body] = 0;
+            sleepTime[body] = 0.0f;
+            if (invMass[body] > 0.0f && !kinematic[body]) {
+                active[body] = 1.0f;
+            }
+        }
+
+        // the segment at the middle of a body's collision capsule (a point for spheres)
+        void core(const int body, glm::vec3 &a, glm::vec3 &b) const {
+            const Shape &shape = shapes[body];
+            const glm::vec3 centre = position(body);
+            if (shape.type == SHAPE_SPHERE || shape.halfHeight == 0.0f) {
+                a = b = centre;
+                return;
+            }
+            glm::vec3 axis(0.0f);
+            axis[shape.type == SHAPE_CAPSULE ? 1 : shape.axis] = shape.halfHeight;
+            axis = orientations[body] * axis;
+            a = centre - axis;
+            b = centre + axis;
+        }
+
+        void bounds(const int body, const float padding, glm::vec3 &min, glm::vec3 &max) const {
+            const Shape &shape = shapes[body];
+            float reach;
+            if (shape.type == SHAPE_BOX) {
+                // the box corners, not just its capsule, so it finds the ground contacts' neighbours too
+                reach = glm::length(shape.halfExtents);
+            } else {
+                reach = shape.radius + shape.halfHeight;
+            }
+            const glm::vec3 centre = position(body);
+            min = centre - glm::vec3(reach + padding);
+            max = centre + glm::vec3(reach + padding);
+        }
+
+        void moveKinematics(const float dt) {
+            for (size_t i = 0; i < bodyCount(); i++) {
+                if (!kinematic[i]) {
+                    continue;
+                }
+                if (hasTarget[i]) {
+                    const glm::vec3 v = (kinematicTarget[i] - position(static_cast<int>(i))) / dt;
+                    vx[i] = v.x;
+                    vy[i] = v.y;
+                    vz[i] = v.z;
+                } else {
+                    vx[i] = vy[i] = vz[i] = 0.0f;
+                }
+            }
+        }
+
+        // v += g * dt, then damping, for every active body, 4 at a time
+        void integrateVelocities(const float dt) {
+            const size_t count = bodyCount();
+            const float linearDamping = 1.0f / (1.0f + dt * PHYSICS_LINEAR_DAMPING);
+            const float angularDamping = 1.0f / (1.0f + dt * PHYSICS_ANGULAR_DAMPING);
+            size_t i = 0;
+#ifdef PHYSICS_USE_SSE
+            const __m128 gravity = _mm_set1_ps(PHYSICS_GRAVITY * dt);
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 linear = _mm_set1_ps(linearDamping - 1.0f);
+            const __m128 angular = _mm_set1_ps(angularDamping - 1.0f);
+            for (; i + 4 <= count; i += 4) {
+                const __m128 mask = _mm_loadu_ps(&active[i]);
+                // 1 for active lanes, 1 + (d - 1) * 0 = 1 for the rest, so inactive bodies keep their velocity
+                const __m128 dampV = _mm_add_ps(one, _mm_mul_ps(linear, mask));
+                const __m128 dampW = _mm_add_ps(one, _mm_mul_ps(angular, mask));
+                _mm_storeu_ps(&vx[i], _mm_mul_ps(_mm_loadu_ps(&vx[i]), dampV));
+                _mm_storeu_ps(&vy[i], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&vy[i]), _mm_mul_ps(gravity, mask)), dampV));
+                _mm_storeu_ps(&vz[i], _mm_mul_ps(_mm_loadu_ps(&vz[i]), dampV));
+                _mm_storeu_ps(&wx[i], _mm_mul_ps(_mm_loadu_ps(&wx[i]), dampW));
+                _mm_storeu_ps(&wy[i], _mm_mul_ps(_mm_loadu_ps(&wy[i]), dampW));
+                _mm_storeu_ps(&wz[i], _mm_mul_ps(_mm_loadu_ps(&wz[i]), dampW));
+            }
+#endif
+            for (; i < count; i++) {
+                if (active[i] == 0.0f) {
+                    continue;
+                }
+                vy[i] += PHYSICS_GRAVITY * dt;
+                vx[i] *= linearDamping;
+                vy[i] *= linearDamping;
+                vz[i] *= linearDamping;
+                wx[i] *= angularDamping;
+                wy[i] *= angularDamping;
+                wz[i] *= angularDamping;
+            }
+        }
+
+        // p += v * dt for every active or kinematic body, 4 at a time, then the orientations one by one
+        void integratePositions(const float dt) {
+            const size_t count = bodyCount();
+            size_t i = 0;
+#ifdef PHYSICS_USE_SSE
+            const __m128 step = _mm_set1_ps(dt);
+            for (; i + 4 <= count; i += 4) {
+                const __m128 scale = _mm_mul_ps(_mm_loadu_ps(&active[i]), step);
+                _mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(_mm_loadu_ps(&vx[i]), scale)));
+                _mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(_mm_loadu_ps(&vy[i]), scale)));
+                _mm_storeu_ps(&pz[i], _mm_add_ps(_mm_loadu_ps(&pz[i]), _mm_mul_ps(_mm_loadu_ps(&vz[i]), scale)));
+            }
+#endif
+            for (; i < count; i++) {
+                const float scale = active[i] * dt;
+                px[i] += vx[i] * scale;
+                py[i] += vy[i] * scale;
+                pz[i] += vz[i] * scale;
+            }
+
+            for (i = 0; i < count; i++) {
+                if (kinematic[i]) {
+                    // land exactly on the target rather than wherever the derived velocity rounds to
+                    if (hasTarget[i]) {
+                        px[i] = kinematicTarget[i].x;
+                        py[i] = kinematicTarget[i].y;
+                        pz[i] = kinematicTarget[i].z;
+                        hasTarget[i] = 0;
+                    }
+                    continue;
+                }
+                if (active[i] == 0.0f) {
+                    continue;
+                }
+                const glm::vec3 w = angularVelocity(static_cast<int>(i));
+                if (w == glm::vec3(0.0f)) {
+                    continue;
+                }
+                const glm::quat &q = orientations[i];
+                orientations[i] = glm::normalize(q + glm::quat(0.0f, w.x, w.y, w.z) * q * (0.5f * dt));
+            }
+        }
+
+        void updateBroadphase(const float dt) {
+            coreStart.resize(bodyCount());
+            coreEnd.resize(bodyCount());
+            for (size_t i = 0; i < bodyCount(); i++) {
+                core(static_cast<int>(i), coreStart[i], coreEnd[i]);
+                if (asleep[i] || (invMass[i] == 0.0f && !kinematic[i])) {
+                    continue;
+                }
+                const auto body = static_cast<int>(i);
+                glm::vec3 min, max;
+                // padded by how far the body could go this step, so contacts are found before it gets there
+                bounds(body, PHYSICS_CONTACT_MARGIN + glm::length(linearVelocity(body)) * dt, min, max);
+                broadphase.update(proxies[i], min, max);
+            }
+        }
+
+        static void closestPointsOnSegments(const glm::vec3 &p1, const glm::vec3 &q1, const glm::vec3 &p2,
+                                            const glm::vec3 &q2, glm::vec3 &c1, glm::vec3 &c2) {
+            const glm::vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+            const float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+            float s = 0.0f, t = 0.0f;
+            if (a <= 1e-8f && e <= 1e-8f) {
+                c1 = p1;
+                c2 = p2;
+                return;
+            }
+            if (a <= 1e-8f) {
+                t = std::clamp(f / e, 0.0f, 1.0f);
+            } else {
+                const float c = glm::dot(d1, r);
+                if (e <= 1e-8f) {
+                    s = std::clamp(-c / a, 0.0f, 1.0f);
+                } else {
+                    const float b = glm::dot(d1, d2);
+                    const float denominator = a * e - b * b;
+                    s = denominator > 1e-8f ? std::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+                    t = (b * s + f) / e;
+                    if (t < 0.0f) {
+                        t = 0.0f;
+                        s = std::clamp(-c / a, 0.0f, 1.0f);
+                    } else if (t > 1.0f) {
+                        t = 1.0f;
+                        s = std::clamp((b - c) / a, 0.0f, 1.0f);
+                    }
+                }
+            }
+            c1 = p1 + d1 * s;
+            c2 = p2 + d2 * t;
+        }
+
+        // every pair whose capsules come within the contact margin, found from the awake bodies' side so two
+        // sleeping bodies are never tested against each other
+        void findBodyContacts() {
+            for (size_t i = 0; i < bodyCount(); i++) {
+                const auto a = static_cast<int>(i);
+                if (active[a] == 0.0f && !(kinematic[a] && hasTarget[a])) {
+                    continue;
+                }
+                nearby.clear();
+                broadphase.queryAabb(broadphase.boundsMin(proxies[a]), broadphase.boundsMax(proxies[a]), nearby);
+                for (const int proxy : nearby) {
+                    const int b = broadphase.userId(proxy);
+                    if (b == a) {
+                        continue;
+                    }
+                    const bool otherMoving = active[b] != 0.0f || (kinematic[b] && hasTarget[b]);
+                    // a pair of moving bodies is found from both sides, so only keep it from the lower one
+                    if (otherMoving && b < a) {
+                        continue;
+                    }
+                    // two bodies that can't be pushed have nothing to solve
+                    if (active[a] == 0.0f && (kinematic[b] || invMass[b] == 0.0f)) {
+                        continue;
+                    }
+                    collide(a, b);
+                }
+            }
+        }
+
+        void collide(int a, int b) {
+            const float radii = shapes[a].radius + shapes[b].radius;
+            // boxes overlapping in the broad phase mostly still miss, and the bounding spheres say so cheaply
+            const float reach = radii + shapes[a].halfHeight + shapes[b].halfHeight + PHYSICS_CONTACT_MARGIN;
+            const glm::vec3 centres = position(a) - position(b);
+            if (glm::dot(centres, centres) > reach * reach) {
+                return;
+            }
+            glm::vec3 ca, cb;
+            closestPointsOnSegments(coreStart[a], coreEnd[a], coreStart[b], coreEnd[b], ca, cb);
+            const glm::vec3 delta = ca - cb;
+            const float distanceSq = glm::dot(delta, delta);
+            if (distanceSq > (radii + PHYSICS_CONTACT_MARGIN) * (radii + PHYSICS_CONTACT_MARGIN)) {
+                return;
+            }
+            // the solver wants a to be the one that moves
+            if (active[a] == 0.0f && asleep[a] == 0) {
+                std::swap(a, b);
+                std::swap(ca, cb);
+            }
+            if (asleep[a]) {
+                wake(a);
+            }
+            if (asleep[b]) {
+                wake(b);
+            }
+            const float distance = std::sqrt(distanceSq);
+            Contact contact;
+            contact.a = a;
+            contact.b = b;
+            contact.normal = distance > 1e-6f ? (ca - cb) / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+            contact.depth = radii - distance;
+            contact.point = 0.5f * (ca - contact.normal * shapes[a].radius + cb + contact.normal * shapes[b].radius);
+            contact.friction = std::sqrt(shapes[a].friction * shapes[b].friction);
+            contact.restitution = std::max(shapes[a].restitution, shapes[b].restitution);
+            contacts.push_back(contact);
+        }
+
+        void addGroundContact(const int body, const glm::vec3 &point, const glm::vec3 &normal, const float depth) {
+            Contact contact;
+            contact.a = body;
+            contact.normal = normal;
+            contact.point = point;
+            contact.depth = depth;
+            contact.friction = shapes[body].friction;
+            contact.restitution = shapes[body].restitution;
+            contacts.push_back(contact);
+        }
+
+        // sphere-ish shapes test the ends of their core against the tangent plane of the ground under them; boxes
+        // test each corner. the heights for every active body's centre come from one batched lookup, which is enough
+        // to skip anything clearly in the air without touching the heightfield again
+        void findGroundContacts(const Heightfield &ground) {
+            const size_t count = bodyCount();
+            groundHeights.resize(count);
+            ground.heightBatch(px.data(), pz.data(), groundHeights.data(), count);
+
+            for (size_t i = 0; i < count; i++) {
+                const auto body = static_cast<int>(i);
+                if (active[body] == 0.0f) {
+                    continue;
+                }
+                const Shape &shape = shapes[body];
+                const float reach = shape.type == SHAPE_BOX ? glm::length(shape.halfExtents) : shape.radius + shape.halfHeight;
+                // how far the ground can rise within the body's footprint isn't known, so allow for a 45 degree slope
+                if (py[body] - reach - PHYSICS_CONTACT_MARGIN > groundHeights[body] + reach) {
+                    continue;
+                }
+
+                if (shape.type == SHAPE_BOX) {
+                    for (int corner = 0; corner < 8; corner++) {
+                        const glm::vec3 local((corner & 1) ? shape.halfExtents.x : -shape.halfExtents.x,
+                                              (corner & 2) ? shape.halfExtents.y : -shape.halfExtents.y,
+                                              (corner & 4) ? shape.halfExtents.z : -shape.halfExtents.z);
+                        const glm::vec3 p = position(body) + orientations[body] * local;
+                        float h;
+                        glm::vec3 n;
+                        ground.sample(p.x, p.z, h, n);
+                        const float distance = (p.y - h) * n.y;
+                        if (distance < PHYSICS_CONTACT_MARGIN) {
+                            addGroundContact(body, p, n, -distance);
+                        }
+                    }
+                    continue;
+                }
+
+                glm::vec3 ends[2];
+                core(body, ends[0], ends[1]);
+                const int endCount = ends[0] == ends[1] ? 1 : 2;
+                for (int e = 0; e < endCount; e++) {
+                    float h;
+                    glm::vec3 n;
+                    ground.sample(ends[e].x, ends[e].z, h, n);
+                    const float distance = (ends[e].y - h) * n.y - shape.radius;
+                    if (distance < PHYSICS_CONTACT_MARGIN) {
+                        addGroundContact(body, ends[e] - n * shape.radius, n, -distance);
+                    }
+                }
+            }
+        }
+
+        int findIsland(int body) {
+            while (island[body] != body) {
+                island[body] = island[island[body]];
+                body = island[body];
+            }
+            return body;
+        }
+
+        // bodies joined by contacts end up in one island. static and kinematic bodies don't join anything, since
+        // they aren't changed by the solver, so islands never share a body that's written to and can run side by side
+        void buildIslands() {
+            const size_t count = bodyCount();
+            for (size_t i = 0; i < count; i++) {
+                island[i] = static_cast<int>(i);
+            }
+            for (const Contact &contact : contacts) {
+                if (contact.b >= 0 && active[contact.b] != 0.0f) {
+                    const int a = findIsland(contact.a), b = findIsland(contact.b);
+                    if (a != b) {
+                        island[std::max(a, b)] = std::min(a, b);
+                    }
+                }
+            }
+
+            islandIndex.assign(count, -1);
+            for (size_t i = 0; i < islandCount; i++) {
+                islands[i].clear();
+                islandBodies[i].clear();
+            }
+            islandCount = 0;
+            for (size_t i = 0; i < count; i++) {
+                if (active[i] == 0.0f) {
+                    continue;
+                }
+                const int root = findIsland(static_cast<int>(i));
+                if (islandIndex[root] < 0) {
+                    islandIndex[root] = static_cast<int>(islandCount++);
+                    if (islandCount > islands.size()) {
+                        islands.emplace_back();
+                        islandBodies.emplace_back();
+                    }
+                }
+                islandBodies[islandIndex[root]].push_back(static_cast<int>(i));
+            }
+            for (size_t c = 0; c < contacts.size(); c++) {
+                islands[islandIndex[findIsland(contacts[c].a)]].push_back(static_cast<int>(c));
+            }
+        }
+
+        void solveIslands(const float dt) {
+            for (size_t i = 0; i < bodyCount(); i++) {
+                if (active[i] == 0.0f) {
+                    invInertiaWorld[i] = glm::mat3(0.0f);
+                    continue;
+                }
+                const glm::mat3 rotation = glm::mat3_cast(orientations[i]);
+                const glm::vec3 &d = invInertiaLocal[i];
+                invInertiaWorld[i] = rotation * glm::mat3(d.x, 0, 0, 0, d.y, 0, 0, 0, d.z) * glm::transpose(rotation);
+            }
+
+            if (contacts.size() >= static_cast<size_t>(PHYSICS_PARALLEL_MIN_CONTACTS) && islandCount > 1) {
+                jobs.parallelFor(static_cast<int>(islandCount), [&](const int begin, const int end) {
+                    for (int i = begin; i < end; i++) {
+                        solveIsland(islands[i], dt);
+                    }
+                });
+            } else {
+                for (size_t i = 0; i < islandCount; i++) {
+                    solveIsland(islands[i], dt);
+                }
+            }
+        }
+
+        [[nodiscard]] float effectiveInvMass(const int body) const {
+            return body >= 0 ? invMass[body] * active[body] : 0.0f;
+        }
+        [[nodiscard]] glm::vec3 pointVelocity(const int body, const glm::vec3 &r) const {
+            if (body < 0) {
+                return glm::vec3(0.0f);
+            }
+            return linearVelocity(body) + glm::cross(angularVelocity(body), r);
+        }
+        [[nodiscard]] float massAlong(const Contact &contact, const glm::vec3 &direction) const {
+            float k = effectiveInvMass(contact.a);
+            k += glm::dot(direction, glm::cross(invInertiaWorld[contact.a] * glm::cross(contact.rA, direction), contact.rA));
+            if (contact.b >= 0 && active[contact.b] != 0.0f) {
+                k += effectiveInvMass(contact.b);
+                k += glm::dot(direction, glm::cross(invInertiaWorld[contact.b] * glm::cross(contact.rB, direction), contact.rB));
+            }
+            return k > 0.0f ? 1.0f / k : 0.0f;
+        }
+        void applyContactImpulse(const Contact &contact, const glm::vec3 &impulse) {
+            addVelocity(contact.a, impulse * effectiveInvMass(contact.a), invInertiaWorld[contact.a] * glm::cross(contact.rA, impulse));
+            if (contact.b >= 0 && active[contact.b] != 0.0f) {
+                addVelocity(contact.b, -impulse * effectiveInvMass(contact.b), invInertiaWorld[contact.b] * glm::cross(contact.rB, -impulse));
+            }
+        }
+
+        // sequential impulses: each contact in turn gets whatever impulse stops it closing, clamped so contacts only
+        // ever push, with friction limited by the normal impulse. only touches the island's own bodies
+        void solveIsland(const std::vector<int> &islandContacts, const float dt) {
+            for (const int c : islandContacts) {
+                Contact &contact = contacts[c];
+                contact.rA = contact.point - position(contact.a);
+                contact.rB = contact.b >= 0 ? contact.point - position(contact.b) : glm::vec3(0.0f);
+                const glm::vec3 &n = contact.normal;
+                contact.tangent[0] = std::abs(n.x) > 0.57f ? glm::normalize(glm::vec3(n.y, -n.x, 0.0f))
+                                                           : glm::normalize(glm::vec3(0.0f, n.z, -n.y));
+                contact.tangent[1] = glm::cross(n, contact.tangent[0]);
+                contact.normalMass = massAlong(contact, n);
+                contact.tangentMass[0] = massAlong(contact, contact.tangent[0]);
+                contact.tangentMass[1] = massAlong(contact, contact.tangent[1]);
+
+                const float closing = glm::dot(pointVelocity(contact.a, contact.rA) - pointVelocity(contact.b, contact.rB), n);
+                if (contact.depth < 0.0f) {
+                    // not touching yet: allow exactly enough approach to close the gap this step
+                    contact.bias = -contact.depth / dt;
+                } else {
+                    contact.bias = -PHYSICS_BAUMGARTE / dt * std::max(contact.depth - PHYSICS_PENETRATION_SLOP, 0.0f);
+                    if (closing < -PHYSICS_RESTITUTION_THRESHOLD) {
+                        contact.bias = std::min(contact.bias, contact.restitution * closing);
+                    }
+                }
+                contact.normalImpulse = 0.0f;
+                contact.tangentImpulse[0] = contact.tangentImpulse[1] = 0.0f;
+            }
+
+            for (int iteration = 0; iteration < PHYSICS_SOLVER_ITERATIONS; iteration++) {
+                for (const int c : islandContacts) {
+                    Contact &contact = contacts[c];
+                    const glm::vec3 relative = pointVelocity(contact.a, contact.rA) - pointVelocity(contact.b, contact.rB);
+
+                    const float closing = glm::dot(relative, contact.normal);
+                    const float lambda = -(closing + contact.bias) * contact.normalMass;
+                    const float total = std::max(contact.normalImpulse + lambda, 0.0f);
+                    const float applied = total - contact.normalImpulse;
+                    contact.normalImpulse = total;
+                    applyContactImpulse(contact, contact.normal * applied);
+
+                    const float limit = contact.friction * contact.normalImpulse;
+                    for (int t = 0; t < 2; t++) {
+                        const glm::vec3 v = pointVelocity(contact.a, contact.rA) - pointVelocity(contact.b, contact.rB);
+                        const float slide = -glm::dot(v, contact.tangent[t]) * contact.tangentMass[t];
+                        const float tangentTotal = std::clamp(contact.tangentImpulse[t] + slide, -limit, limit);
+                        const float tangentApplied = tangentTotal - contact.tangentImpulse[t];
+                        contact.tangentImpulse[t] = tangentTotal;
+                        applyContactImpulse(contact, contact.tangent[t] * tangentApplied);
+                    }
+                }
+            }
+        }
+
+        // an island only sleeps as a whole, once every body in it has been slow for a while, so a stack doesn't
+        // freeze with its top still sliding
+        void updateSleep(const float dt) {
+            const float limit = PHYSICS_SLEEP_SPEED * PHYSICS_SLEEP_SPEED;
+            for (size_t i = 0; i < islandCount; i++) {
+                const std::vector<int> &bodies = islandBodies[i];
+                bool restful = true;
+                for (const int body : bodies) {
+                    const float speed = glm::dot(linearVelocity(body), linearVelocity(body)) +
+                                        glm::dot(angularVelocity(body), angularVelocity(body));
+                    sleepTime[body] = speed < limit ? sleepTime[body] + dt : 0.0f;
+                    restful = restful && sleepTime[body] >= PHYSICS_SLEEP_TIME;
+                }
+                if (!restful) {
+                    continue;
+                }
+                for (const int body : bodies) {
+                    asleep[body] = 1;
+                    vx[body] = vy[body] = vz[body] = 0.0f;
+                    wx[body] = wy[body] = wz[body] = 0.0f;
+                }
+            }
+        }
+};
+
+#endif //PHYSICS_H
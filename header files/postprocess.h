@@ -0,0 +1,340 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+#include <imgui.h>
+#include "glm/glm.hpp"
+#include "gpuprofiler.h"
+#include "rendertarget.h"
+#include "shader.h"
+
+// the scene is rendered into one of these, everything after it is post processing
+constexpr GLenum HDR_COLOUR_FORMAT = GL_RGBA16F;
+constexpr int BLOOM_MAX_LEVELS = 6;
+
+// state handed from pass to pass while the chain runs
+struct PostProcessContext {
+    RenderTargetManager &targets;
+    // the colour image the next pass should read
+    GLuint source = 0;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    // side outputs, 0 when the pass that makes them is switched off
+    GLuint bloomTexture = 0;
+    // targets that have to stay alive until the end of the chain, not just the end of their pass
+    std::vector<const RenderTarget *> held;
+};
+
+class PostProcessPass {
+    public:
+
+        const char *name;
+        bool enabled = true;
+
+        explicit PostProcessPass(const char *name) : name(name) {}
+        virtual ~PostProcessPass() = default;
+
+        // false for passes that only produce side outputs for later passes (bloom), rather than a new colour image
+        [[nodiscard]] virtual bool producesColour() const {
+            return true;
+        }
+        [[nodiscard]] virtual GLenum outputFormat() const {
+            return HDR_COLOUR_FORMAT;
+        }
+        // the target (or the backbuffer) is already bound with the viewport set when this is called
+        virtual void execute(PostProcessContext &context) = 0;
+        virtual void drawUi() {}
+
+    protected:
+
+        static void drawFullscreenTriangle() {
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+};
+
+// thresholds the scene into half res, then builds a downsample pyramid and walks back up it with a tent filter,
+// adding each level onto the one above. the result is left in context.bloomTexture for the tonemapper to add
+class BloomPass : public PostProcessPass {
+    public:
+
+        float threshold = 1.0f;
+        float knee = 0.5f;
+        float radius = 1.0f;
+        int levels = 5;
+
+        BloomPass() : PostProcessPass("Bloom"),
+                      prefilter("resources/shaders/postProcessVertex.glsl", "resources/shaders/bloomPrefilterFragment.glsl"),
+                      downsample("resources/shaders/postProcessVertex.glsl", "resources/shaders/bloomDownsampleFragment.glsl"),
+                      upsample("resources/shaders/postProcessVertex.glsl", "resources/shaders/bloomUpsampleFragment.glsl") {}
+
+        [[nodiscard]] bool producesColour() const override {
+            return false;
+        }
+
+        void execute(PostProcessContext &context) override {
+
+            const RenderTarget *pyramid[BLOOM_MAX_LEVELS] = {};
+            int count = 0;
+            for (; count < levels && count < BLOOM_MAX_LEVELS; count++) {
+                if ((context.width >> (count + 1)) < 2 || (context.height >> (count + 1)) < 2) {
+                    break;
+                }
+                pyramid[count] = context.targets.acquire({1.0f / static_cast<float>(2 << count), GL_R11F_G11F_B10F, false});
+            }
+            if (count == 0) {
+                return;
+            }
+
+            glActiveTexture(GL_TEXTURE0);
+
+            prefilter.use();
+            prefilter.uploadUniformInt("source", 0);
+            prefilter.uploadUniformVector2f("texelSize", glm::vec2(1.0f / static_cast<float>(context.width), 1.0f / static_cast<float>(context.height)));
+            prefilter.uploadUniformFloat("threshold", threshold);
+            prefilter.uploadUniformFloat("knee", knee);
+            pyramid[0]->bind();
+            glBindTexture(GL_TEXTURE_2D, context.source);
+            drawFullscreenTriangle();
+
+            downsample.use();
+            downsample.uploadUniformInt("source", 0);
+            for (int i = 1; i < count; i++) {
+                downsample.uploadUniformVector2f("texelSize", texelSize(*pyramid[i - 1]));
+                pyramid[i]->bind();
+                glBindTexture(GL_TEXTURE_2D, pyramid[i - 1]->colour);
+                drawFullscreenTriangle();
+            }
+
+            upsample.use();
+            upsample.uploadUniformInt("source", 0);
+            upsample.uploadUniformFloat("radius", radius);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            for (int i = count - 1; i > 0; i--) {
+                upsample.uploadUniformVector2f("texelSize", texelSize(*pyramid[i]));
+                pyramid[i - 1]->bind();
+                glBindTexture(GL_TEXTURE_2D, pyramid[i]->colour);
+                drawFullscreenTriangle();
+            }
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDisable(GL_BLEND);
+
+            // the top of the pyramid is what gets read later, everything below it can go straight back in the pool
+            context.bloomTexture = pyramid[0]->colour;
+            context.held.push_back(pyramid[0]);
+            for (int i = 1; i < count; i++) {
+                context.targets.release(pyramid[i]);
+            }
+        }
+
+        void drawUi() override {
+            ImGui::SliderFloat("Bloom threshold", &threshold, 0.0f, 4.0f);
+            ImGui::SliderFloat("Bloom knee", &knee, 0.0f, 1.0f);
+            ImGui::SliderFloat("Bloom radius", &radius, 0.5f, 3.0f);
+            ImGui::SliderInt("Bloom levels", &levels, 1, BLOOM_MAX_LEVELS);
+        }
+
+    private:
+
+        Shader prefilter;
+        Shader downsample;
+        Shader upsample;
+
+        static glm::vec2 texelSize(const RenderTarget &target) {
+            return {1.0f / static_cast<float>(target.width), 1.0f / static_cast<float>(target.height)};
+        }
+};
+
+// exposure, bloom composite, aces and gamma. everything after this is ldr
+class TonemapPass : public PostProcessPass {
+    public:
+
+        float exposure = 1.0f;
+        float bloomIntensity = 0.05f;
+
+        TonemapPass() : PostProcessPass("Tonemap"),
+                        shader("resources/shaders/postProcessVertex.glsl", "resources/shaders/tonemapFragment.glsl") {}
+
+        [[nodiscard]] GLenum outputFormat() const override {
+            return GL_RGBA8;
+        }
+
+        void execute(PostProcessContext &context) override {
+
+            shader.use();
+            shader.uploadUniformInt("source", 0);
+            shader.uploadUniformInt("bloomTexture", 1);
+            shader.uploadUniformBool("useBloom", context.bloomTexture != 0);
+            shader.uploadUniformFloat("bloomIntensity", bloomIntensity);
+            shader.uploadUniformFloat("exposure", exposure);
+
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, context.bloomTexture);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, context.source);
+            drawFullscreenTriangle();
+        }
+
+        void drawUi() override {
+            ImGui::SliderFloat("Exposure", &exposure, 0.1f, 4.0f);
+            ImGui::SliderFloat("Bloom intensity", &bloomIntensity, 0.0f, 0.5f);
+        }
+
+    private:
+
+        Shader shader;
+};
+
+class FxaaPass : public PostProcessPass {
+    public:
+
+        FxaaPass() : PostProcessPass("FXAA"),
+                     shader("resources/shaders/postProcessVertex.glsl", "resources/shaders/fxaaFragment.glsl") {}
+
+        [[nodiscard]] GLenum outputFormat() const override {
+            return GL_RGBA8;
+        }
+
+        void execute(PostProcessContext &context) override {
+
+            shader.use();
+            shader.uploadUniformInt("source", 0);
+            shader.uploadUniformVector2f("texelSize", glm::vec2(1.0f / static_cast<float>(context.width), 1.0f / static_cast<float>(context.height)));
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, context.source);
+            drawFullscreenTriangle();
+        }
+
+    private:
+
+        Shader shader;
+};
+
+// runs the enabled passes in order, ping-ponging between transient targets. the last pass that makes a colour image
+// writes straight to the backbuffer, so there's no extra copy at the end
+class PostProcessChain {
+    public:
+
+        std::vector<std::unique_ptr<PostProcessPass>> passes;
+
+        explicit PostProcessChain(RenderTargetManager &targets) : targets(targets),
+            present("resources/shaders/postProcessVertex.glsl", "resources/shaders/postProcessFragment.glsl") {
+
+            // core profile won't draw without a vao bound, even though the fullscreen triangle has no attributes
+            glGenVertexArrays(1, &emptyVAO);
+
+            passes.push_back(std::make_unique<BloomPass>());
+            passes.push_back(std::make_unique<TonemapPass>());
+            passes.push_back(std::make_unique<FxaaPass>());
+        }
+
+        ~PostProcessChain() {
+            glDeleteVertexArrays(1, &emptyVAO);
+        }
+
+        PostProcessChain(const PostProcessChain &) = delete;
+        PostProcessChain &operator=(const PostProcessChain &) = delete;
+
+        // sceneColour is a full res target from the manager, the result ends up in the default framebuffer
+        void execute(const GLuint sceneColour) {
+
+            const GLsizei backbufferWidth = targets.backbufferWidthPixels();
+            const GLsizei backbufferHeight = targets.backbufferHeightPixels();
+            PostProcessContext context{targets, sceneColour, targets.width(), targets.height(), 0, {}};
+
+            int last = -1;
+            for (int i = 0; i < static_cast<int>(passes.size()); i++) {
+                if (passes[i]->enabled && passes[i]->producesColour()) {
+                    last = i;
+                }
+            }
+
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_CULL_FACE);
+            glDisable(GL_BLEND);
+            glBindVertexArray(emptyVAO);
+
+            const RenderTarget *current = nullptr;
+            for (int i = 0; i < static_cast<int>(passes.size()); i++) {
+                PostProcessPass &pass = *passes[i];
+                if (!pass.enabled) {
+                    continue;
+                }
+                GpuProfileScope scope(pass.name);
+
+                if (!pass.producesColour()) {
+                    pass.execute(context);
+                    continue;
+                }
+
+                const RenderTarget *output = nullptr;
+                if (i == last) {
+                    bindBackbuffer(backbufferWidth, backbufferHeight);
+                } else {
+                    output = targets.acquire({1.0f, pass.outputFormat(), false});
+                    output->bind();
+                }
+                pass.execute(context);
+
+                if (current) {
+                    targets.release(current);
+                }
+                current = output;
+                if (output) {
+                    context.source = output->colour;
+                }
+            }
+
+            if (last < 0) {
+                GpuProfileScope scope("Present");
+                bindBackbuffer(backbufferWidth, backbufferHeight);
+                present.use();
+                present.uploadUniformInt("screenTexture", 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, context.source);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+
+            for (const RenderTarget *target : context.held) {
+                targets.release(target);
+            }
+            if (current) {
+                targets.release(current);
+            }
+
+            glBindVertexArray(0);
+            glEnable(GL_DEPTH_TEST);
+            glEnable(GL_CULL_FACE);
+            glEnable(GL_BLEND);
+        }
+
+        void drawWindow() {
+            ImGui::Begin("Post processing");
+            for (const auto &pass : passes) {
+                ImGui::PushID(pass.get());
+                ImGui::Checkbox(pass->name, &pass->enabled);
+                ImGui::SameLine();
+                ImGui::Text("%6.3f ms", profiler.averageMs(pass->name));
+                if (pass->enabled) {
+                    pass->drawUi();
+                }
+                ImGui::PopID();
+            }
+            ImGui::End();
+        }
+
+    private:
+
+        RenderTargetManager &targets;
+        Shader present;
+        GLuint emptyVAO = 0;
+
+        static void bindBackbuffer(const GLsizei width, const GLsizei height) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, width, height);
+        }
+};
+
+#endif //POSTPROCESS_H
@@ -0,0 +1,248 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// weight of the newest sample in the smoothed timings
+constexpr double PROFILER_SMOOTHING = 0.1;
+// counters and cpu timings one ProfileCapture holds. anything past that goes straight to the profiler as usual
+constexpr int PROFILER_CAPTURE_ENTRIES = 48;
+
+// the counters and cpu timings one thread recorded for one frame of work, kept apart from the profiler's own until
+// they're merged in. the simulation thread records into one of these per RenderPacket, so what it measured while
+// building a packet lands in the frame that draws that packet, rather than being zeroed half way through by the gl
+// thread starting its next frame. fixed size, so recording into it never allocates
+class ProfileCapture {
+    public:
+
+        enum Kind {
+            SET_COUNTER,
+            ADD_COUNTER,
+            CPU_TIMING
+        };
+
+        struct Entry {
+            // always a string literal, like every name the profiler is given
+            const char *name = nullptr;
+            Kind kind = SET_COUNTER;
+            double value = 0.0;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        void clear() {
+            count = 0;
+        }
+
+        [[nodiscard]] int size() const {
+            return count;
+        }
+
+        [[nodiscard]] const Entry &operator[](const int i) const {
+            return entries[i];
+        }
+
+        // nullptr once it's full
+        Entry *find(const char *name, const Kind kind) {
+            for (int i = 0; i < count; i++) {
+                if (entries[i].kind == kind && std::strcmp(entries[i].name, name) == 0) {
+                    return &entries[i];
+                }
+            }
+            if (count == PROFILER_CAPTURE_ENTRIES) {
+                return nullptr;
+            }
+            entries[count] = {name, kind, 0.0, {}};
+            return &entries[count++];
+        }
+
+    private:
+        std::array<Entry, PROFILER_CAPTURE_ENTRIES> entries;
+        int count = 0;
+};
+
+// timings and counters from anywhere in the program. only the cpu side lives here, so the tools and tests that
+// share the engine's headers don't need gl or imgui: gpu timings are measured by gpuprofiler.h and recorded here, and
+// the window that shows it all is drawn from there too
+class Profiler {
+    public:
+
+        struct Timing {
+            std::string name;
+            double lastMs = 0.0;
+            double averageMs = 0.0;
+            bool gpu = false;
+            std::chrono::steady_clock::time_point start;
+        };
+
+        struct Counter {
+            std::string name;
+            double value = 0.0;
+            // accumulated with addCounter and cleared every frame, rather than set outright
+            bool perFrame = false;
+        };
+
+        // clears the per frame counters. call once at the start of each frame
+        void beginFrame() {
+
+            std::lock_guard<std::mutex> lock(mutex);
+            frameIndex++;
+            for (Counter &counter : counters) {
+                if (counter.perFrame) {
+                    counter.value = 0.0;
+                }
+            }
+        }
+
+        // from now on this thread's counters and cpu timings go into target instead, until it's called with nullptr.
+        // for threads working a frame ahead of the one calling beginFrame, which merge() the capture in when the
+        // frame they worked on is the one being shown
+        static void captureInto(ProfileCapture *target) {
+            capture = target;
+        }
+
+        // everything a capture recorded, as if it had been recorded here and now. call after beginFrame
+        void merge(const ProfileCapture &recorded) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < recorded.size(); i++) {
+                const ProfileCapture::Entry &entry = recorded[i];
+                if (entry.kind == ProfileCapture::CPU_TIMING) {
+                    record(find(entry.name, false), entry.value);
+                } else {
+                    Counter &counter = findCounter(entry.name, entry.kind == ProfileCapture::ADD_COUNTER);
+                    counter.value = entry.kind == ProfileCapture::ADD_COUNTER ? counter.value + entry.value : entry.value;
+                }
+            }
+        }
+
+        // a name should only ever be timed from one thread, the start time is kept per name
+        void beginCpu(const char *name) {
+            if (capture) {
+                if (ProfileCapture::Entry *entry = capture->find(name, ProfileCapture::CPU_TIMING)) {
+                    entry->start = std::chrono::steady_clock::now();
+                    return;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            find(name, false).start = std::chrono::steady_clock::now();
+        }
+
+        void endCpu(const char *name) {
+            const auto now = std::chrono::steady_clock::now();
+            if (capture) {
+                if (ProfileCapture::Entry *entry = capture->find(name, ProfileCapture::CPU_TIMING)) {
+                    entry->value = std::chrono::duration<double, std::milli>(now - entry->start).count();
+                    return;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            Timing &timing = find(name, false);
+            record(timing, std::chrono::duration<double, std::milli>(now - timing.start).count());
+        }
+
+        // a gpu timing that's come back, from GpuProfiler
+        void recordGpu(const char *name, const double ms) {
+            std::lock_guard<std::mutex> lock(mutex);
+            record(find(name, true), ms);
+        }
+
+        void setCounter(const char *name, const double value) {
+            if (capture) {
+                if (ProfileCapture::Entry *entry = capture->find(name, ProfileCapture::SET_COUNTER)) {
+                    entry->value = value;
+                    return;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            findCounter(name, false).value = value;
+        }
+
+        // adds to a counter that starts from zero each frame, e.g. triangles drawn
+        void addCounter(const char *name, const double value) {
+            if (capture) {
+                if (ProfileCapture::Entry *entry = capture->find(name, ProfileCapture::ADD_COUNTER)) {
+                    entry->value += value;
+                    return;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            findCounter(name, true).value += value;
+        }
+
+        [[nodiscard]] double averageMs(const char *name) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const Timing &timing : timings) {
+                if (timing.name == name) {
+                    return timing.averageMs;
+                }
+            }
+            return 0.0;
+        }
+
+        // show(frameIndex, timings, counters) with the lock held, for drawing them without copying them out
+        template<typename Show>
+        void inspect(Show &&show) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            show(frameIndex, timings, counters);
+        }
+
+    private:
+
+        std::vector<Timing> timings;
+        std::vector<Counter> counters;
+        unsigned long long frameIndex = 0;
+        // threads that aren't capturing (job workers, the gl thread) time themselves and set counters while the gl
+        // thread merges captures and draws the window
+        mutable std::mutex mutex;
+        static inline thread_local ProfileCapture *capture = nullptr;
+
+        Counter &findCounter(const char *name, const bool perFrame) {
+            for (Counter &counter : counters) {
+                if (counter.name == name) {
+                    return counter;
+                }
+            }
+            counters.push_back({name, 0.0, perFrame});
+            return counters.back();
+        }
+
+        // linear search on purpose, there's only a couple dozen entries and it saves building a string per lookup
+        Timing &find(const char *name, const bool gpu) {
+            for (Timing &timing : timings) {
+                if (timing.gpu == gpu && timing.name == name) {
+                    return timing;
+                }
+            }
+            timings.push_back({});
+            timings.back().name = name;
+            timings.back().gpu = gpu;
+            return timings.back();
+        }
+
+        static void record(Timing &timing, const double ms) {
+            timing.lastMs = ms;
+            timing.averageMs = timing.averageMs == 0.0 ? ms : timing.averageMs + (ms - timing.averageMs) * PROFILER_SMOOTHING;
+        }
+};
+
+// one profiler for the whole program, so anything that wants to report a timing or a counter can
+inline Profiler profiler;
+
+// times the enclosing scope on the cpu
+class CpuProfileScope {
+    public:
+        explicit CpuProfileScope(const char *name) : name(name) {
+            profiler.beginCpu(name);
+        }
+        ~CpuProfileScope() {
+            profiler.endCpu(name);
+        }
+    private:
+        const char *name;
+};
+
+#endif //PROFILER_H
@@ -0,0 +1,290 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "profiler.h"
+
+// how many frames an unused target is kept around before its memory is given back
+constexpr int RENDER_TARGET_IDLE_FRAMES = 8;
+// how many frames the backbuffer has to hold the same size before the targets follow it. dragging a window edge
+// changes the size every frame, and reallocating every target each time is far worse than stretching for a moment
+constexpr int RENDER_TARGET_SETTLE_FRAMES = 12;
+
+struct RenderTargetDesc {
+    // size relative to the render size (which follows the backbuffer), e.g. 0.5 for a half res target
+    float scale = 1.0f;
+    GLenum colourFormat = GL_RGBA16F;
+    // adds a depth-stencil renderbuffer
+    bool depth = false;
+    // fixed size in pixels, only used when scale is 0
+    GLsizei width = 0;
+    GLsizei height = 0;
+};
+
+// a framebuffer with one colour texture and optionally a depth-stencil renderbuffer
+struct RenderTarget {
+    GLenum colourFormat = GL_RGBA16F;
+    bool hasDepth = false;
+    GLsizei width = 0;
+    GLsizei height = 0;
+    GLuint fbo = 0;
+    GLuint colour = 0;
+    GLuint depth = 0;
+
+    void bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+    }
+};
+
+// owns every offscreen target. descriptions are relative to the backbuffer, so resizing the window is just a matter
+// of telling the manager the new size; the targets catch up lazily once the size stops changing.
+// transient targets are acquired for as long as a pass needs them and released straight after, so two targets
+// whose lifetimes don't overlap end up sharing the same memory
+class RenderTargetManager {
+    public:
+
+        RenderTargetManager(const GLsizei width, const GLsizei height) {
+            backbufferWidth = renderWidth = pendingWidth = std::max(width, 1);
+            backbufferHeight = renderHeight = pendingHeight = std::max(height, 1);
+        }
+
+        RenderTargetManager(const RenderTargetManager &) = delete;
+        RenderTargetManager &operator=(const RenderTargetManager &) = delete;
+
+        ~RenderTargetManager() {
+            for (const auto &entry : entries) {
+                destroy(*entry.target);
+            }
+        }
+
+        // call from the framebuffer size callback. a minimised window reports 0x0, which is ignored
+        void setBackbufferSize(const GLsizei width, const GLsizei height) {
+            if (width <= 0 || height <= 0) {
+                return;
+            }
+            backbufferWidth = width;
+            backbufferHeight = height;
+            if (width != pendingWidth || height != pendingHeight) {
+                pendingWidth = width;
+                pendingHeight = height;
+                framesSinceResize = 0;
+            }
+        }
+
+        // applies a settled resize. call once at the start of each frame, before acquiring anything
+        void beginFrame() {
+            framesSinceResize++;
+            if ((pendingWidth != renderWidth || pendingHeight != renderHeight) && framesSinceResize >= RENDER_TARGET_SETTLE_FRAMES) {
+                renderWidth = pendingWidth;
+                renderHeight = pendingHeight;
+            }
+            requestedBytes = 0;
+            requests = 0;
+        }
+
+        // returns a free target matching the description, creating one if there isn't one
+        RenderTarget *acquire(const RenderTargetDesc &desc) {
+
+            GLsizei width, height;
+            resolve(desc, width, height);
+            requests++;
+            requestedBytes += bytes(desc.colourFormat, desc.depth, width, height);
+
+            for (Entry &entry : entries) {
+                const RenderTarget &t = *entry.target;
+                if (!entry.inUse && t.width == width && t.height == height && t.colourFormat == desc.colourFormat && t.hasDepth == desc.depth) {
+                    entry.inUse = true;
+                    entry.lastUsedFrame = frame;
+                    return entry.target.get();
+                }
+            }
+
+            Entry entry;
+            entry.target = std::make_unique<RenderTarget>(create(desc.colourFormat, desc.depth, width, height));
+            entry.inUse = true;
+            entry.lastUsedFrame = frame;
+            entries.push_back(std::move(entry));
+            return entries.back().target.get();
+        }
+
+        void release(const RenderTarget *target) {
+            for (Entry &entry : entries) {
+                if (entry.target.get() == target) {
+                    entry.inUse = false;
+                    entry.lastUsedFrame = frame;
+                    return;
+                }
+            }
+        }
+
+        // frees targets nobody has asked for in a while (e.g. the old sizes after a resize) and reports memory use
+        void endFrame() {
+            frame++;
+            for (size_t i = 0; i < entries.size();) {
+                if (!entries[i].inUse && frame - entries[i].lastUsedFrame > RENDER_TARGET_IDLE_FRAMES) {
+                    destroy(*entries[i].target);
+                    entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(i));
+                } else {
+                    i++;
+                }
+            }
+
+            profiler.setCounter("RT memory (KB)", static_cast<double>(totalBytes()) / 1024.0);
+            profiler.setCounter("RT unaliased (KB)", static_cast<double>(requestedBytes) / 1024.0);
+            profiler.setCounter("RT physical", static_cast<double>(entries.size()));
+            profiler.setCounter("RT requests", static_cast<double>(requests));
+        }
+
+        // memory held by every attachment the manager owns, in use or not
+        [[nodiscard]] size_t totalBytes() const {
+            size_t total = 0;
+            for (const Entry &entry : entries) {
+                const RenderTarget &t = *entry.target;
+                total += bytes(t.colourFormat, t.hasDepth, t.width, t.height);
+            }
+            return total;
+        }
+
+        // the size full res targets are allocated at. lags the backbuffer while a resize settles
+        [[nodiscard]] GLsizei width() const {
+            return renderWidth;
+        }
+        [[nodiscard]] GLsizei height() const {
+            return renderHeight;
+        }
+        [[nodiscard]] GLsizei backbufferWidthPixels() const {
+            return backbufferWidth;
+        }
+        [[nodiscard]] GLsizei backbufferHeightPixels() const {
+            return backbufferHeight;
+        }
+        [[nodiscard]] float aspectRatio() const {
+            return static_cast<float>(backbufferWidth) / static_cast<float>(backbufferHeight);
+        }
+
+    private:
+
+        struct Entry {
+            std::unique_ptr<RenderTarget> target;
+            bool inUse = false;
+            long long lastUsedFrame = 0;
+        };
+
+        std::vector<Entry> entries;
+        long long frame = 0;
+
+        GLsizei backbufferWidth, backbufferHeight;
+        GLsizei pendingWidth, pendingHeight;
+        GLsizei renderWidth, renderHeight;
+        int framesSinceResize = 0;
+
+        size_t requestedBytes = 0;
+        int requests = 0;
+
+        void resolve(const RenderTargetDesc &desc, GLsizei &width, GLsizei &height) const {
+            if (desc.scale > 0.0f) {
+                width = std::max(1, static_cast<GLsizei>(std::floor(static_cast<float>(renderWidth) * desc.scale)));
+                height = std::max(1, static_cast<GLsizei>(std::floor(static_cast<float>(renderHeight) * desc.scale)));
+            } else {
+                width = desc.width;
+                height = desc.height;
+            }
+        }
+
+        static size_t bytesPerPixel(const GLenum format) {
+            switch (format) {
+                case GL_R8:
+                    return 1;
+                case GL_RG8:
+                case GL_R16F:
+                    return 2;
+                case GL_RGB8:
+                    return 3;
+                case GL_RGBA16F:
+                    return 8;
+                case GL_RGB16F:
+                    return 6;
+                case GL_RGBA32F:
+                    return 16;
+                default:
+                    // GL_RGBA8, GL_R11F_G11F_B10F, GL_R32F, GL_RG16F
+                    return 4;
+            }
+        }
+
+        static size_t bytes(const GLenum format, const bool depth, const GLsizei width, const GLsizei height) {
+            const size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+            return pixels * bytesPerPixel(format) + (depth ? pixels * 4 : 0);
+        }
+
+        static GLenum uploadFormat(const GLenum internalFormat) {
+            switch (internalFormat) {
+                case GL_R16F:
+                case GL_R32F:
+                case GL_R8:
+                    return GL_RED;
+                case GL_RG16F:
+                case GL_RG8:
+                    return GL_RG;
+                case GL_RGB16F:
+                case GL_RGB8:
+                case GL_R11F_G11F_B10F:
+                    return GL_RGB;
+                default:
+                    return GL_RGBA;
+            }
+        }
+
+        static RenderTarget create(const GLenum colourFormat, const bool depth, const GLsizei width, const GLsizei height) {
+
+            RenderTarget target;
+            target.colourFormat = colourFormat;
+            target.hasDepth = depth;
+            target.width = width;
+            target.height = height;
+
+            glGenFramebuffers(1, &target.fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+
+            glGenTextures(1, &target.colour);
+            glBindTexture(GL_TEXTURE_2D, target.colour);
+            glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(colourFormat), width, height, 0, uploadFormat(colourFormat), GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colour, 0);
+
+            if (depth) {
+                glGenRenderbuffers(1, &target.depth);
+                glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+                glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+                glBindRenderbuffer(GL_RENDERBUFFER, 0);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+            }
+
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cout << "failed to create render target " << width << "x" << height << std::endl;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return target;
+        }
+
+        static void destroy(RenderTarget &target) {
+            glDeleteFramebuffers(1, &target.fbo);
+            glDeleteTextures(1, &target.colour);
+            if (target.depth) {
+                glDeleteRenderbuffers(1, &target.depth);
+            }
+            target = {};
+        }
+};
+
+#endif //RENDERTARGET_H
@@ -0,0 +1,426 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <rapidjson/document.h>
+#include <rapidjson/error/en.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include "glm/glm.hpp"
+#include "camera.h"
+#include "hash.h"
+#include "mappedfile.h"
+#include "transform.h"
+
+// bump whenever the snapshot layout changes, so old snapshots are rebuilt rather than misread
+constexpr uint32_t SCENE_SNAPSHOT_VERSION = 3;
+constexpr char SCENE_SNAPSHOT_MAGIC[4] = {'S', 'C', 'N', 'B'};
+// where the camera is saved on exit and restored from on startup
+constexpr char SCENE_CAMERA_STATE[] = "resources/cache/camera.json";
+
+// the snapshot is these records back to back: a SceneHeader, modelCount SceneModelRecords, entityCount
+// SceneEntityRecords, then stringBytes of nul terminated strings that the name and path fields are offsets into.
+// everything is plain data at its natural alignment, so a mapped snapshot is used where it lies without parsing
+
+struct SceneCameraRecord {
+    float position[3] = {0.0f, 0.0f, 0.0f};
+    float yaw = YAW;
+    float pitch = PITCH;
+    float zoom = ZOOM;
+};
+
+struct SceneHeader {
+    char magic[4];
+    uint32_t version;
+    // the json file it was compiled from, to tell when it's out of date
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t modelCount;
+    uint32_t entityCount;
+    uint32_t stringBytes;
+    uint32_t reserved;
+    SceneCameraRecord camera;
+};
+
+struct SceneModelRecord {
+    uint32_t name;
+    uint32_t path;
+};
+
+struct SceneEntityRecord {
+    uint32_t name;
+    // index into the models, -1 for an entity without one
+    int32_t model;
+    // index of the entity this one's transform is relative to, always an earlier one. -1 if it's placed in the world
+    int32_t parent;
+    float position[3];
+    // quaternion, x y z w. the json has euler angles in degrees, converted once when it's compiled
+    float rotation[4];
+    float scale[3];
+    // overrides the model's material shininess, 0 keeps it
+    float shininess;
+};
+
+// a scene: the models it uses, its entities (name, model, parent, transform, material overrides) and where the camera
+// starts. it's written by hand as json, and compiled on first load into a binary snapshot in the cache directory,
+// which every later load just maps. the snapshot is rebuilt whenever the json's size or modification time changes
+class Scene {
+    public:
+
+        explicit Scene(const std::string &path, const std::string &cacheDirectory = "resources/cache") {
+            std::error_code error;
+            const auto sourceSize = static_cast<uint64_t>(std::filesystem::file_size(path, error));
+            if (error) {
+                std::cout << "SCENE: can't read " << path << std::endl;
+                return;
+            }
+            const int64_t sourceTime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+            std::stringstream cacheName;
+            cacheName << cacheDirectory << "/scene_" << std::hex << fnv1a(path.data(), path.size()) << ".bin";
+            const std::string cachePath = cacheName.str();
+
+            if (snapshot.open(cachePath) && attach(snapshot.data(), snapshot.size(), sourceSize, sourceTime)) {
+                return;
+            }
+
+            std::cout << "Scene snapshot out of date, compiling " << path << std::endl;
+            std::ifstream file(path, std::ios::binary);
+            const std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            if (!compile(json, sourceSize, sourceTime, compiled)) {
+                compiled.clear();
+                return;
+            }
+            std::filesystem::create_directories(cacheDirectory, error);
+            std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char *>(compiled.data()), static_cast<std::streamsize>(compiled.size()));
+            out.close();
+            // the freshly written snapshot is used like any other, so the compiled copy can go. if it couldn't be
+            // written (read only install), the copy in memory does instead
+            if (out && snapshot.open(cachePath) && attach(snapshot.data(), snapshot.size(), sourceSize, sourceTime)) {
+                compiled = {};
+                return;
+            }
+            attach(compiled.data(), compiled.size(), sourceSize, sourceTime);
+        }
+
+        Scene(const Scene &) = delete;
+        Scene &operator=(const Scene &) = delete;
+
+        [[nodiscard]] bool loaded() const {
+            return header != nullptr;
+        }
+
+        [[nodiscard]] uint32_t modelCount() const {
+            return header ? header->modelCount : 0;
+        }
+
+        [[nodiscard]] const char *modelName(const uint32_t model) const {
+            return strings + models[model].name;
+        }
+
+        [[nodiscard]] const char *modelPath(const uint32_t model) const {
+            return strings + models[model].path;
+        }
+
+        [[nodiscard]] uint32_t entityCount() const {
+            return header ? header->entityCount : 0;
+        }
+
+        [[nodiscard]] const SceneEntityRecord &entity(const uint32_t index) const {
+            return entities[index];
+        }
+
+        [[nodiscard]] const char *entityName(const uint32_t index) const {
+            return strings + entities[index].name;
+        }
+
+        // -1 if there's no entity called name
+        [[nodiscard]] int findEntity(const char *name) const {
+            for (uint32_t i = 0; i < entityCount(); i++) {
+                if (std::strcmp(strings + entities[i].name, name) == 0) {
+                    return static_cast<int>(i);
+                }
+            }
+            return -1;
+        }
+
+        [[nodiscard]] Transform transform(const uint32_t index) const {
+            const SceneEntityRecord &record = entities[index];
+            return {glm::vec3(record.position[0], record.position[1], record.position[2]),
+                    glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]),
+                    glm::vec3(record.scale[0], record.scale[1], record.scale[2])};
+        }
+
+        // puts the camera where the scene says it starts
+        void placeCamera(Camera &camera) const {
+            const SceneCameraRecord record = header ? header->camera : SceneCameraRecord{};
+            applyCamera(record, camera);
+        }
+
+        // turns json into a snapshot. false (with the reason printed) if the json is malformed
+        static bool compile(const std::string &json, const uint64_t sourceSize, const int64_t sourceTime, std::vector<unsigned char> &out) {
+            rapidjson::Document document;
+            document.Parse(json.c_str(), json.size());
+            if (document.HasParseError() || !document.IsObject()) {
+                std::cout << "SCENE: json error at offset " << document.GetErrorOffset() << ": "
+                          << rapidjson::GetParseError_En(document.GetParseError()) << std::endl;
+                return false;
+            }
+
+            SceneHeader header{};
+            std::memcpy(header.magic, SCENE_SNAPSHOT_MAGIC, sizeof(header.magic));
+            header.version = SCENE_SNAPSHOT_VERSION;
+            header.sourceSize = sourceSize;
+            header.sourceTime = sourceTime;
+            header.camera = SceneCameraRecord{};
+            if (document.HasMember("camera") && document["camera"].IsObject()) {
+                header.camera = readCamera(document["camera"]);
+            }
+
+            std::vector<char> strings;
+            const auto addString = [&strings](const char *text) {
+                const auto offset = static_cast<uint32_t>(strings.size());
+                strings.insert(strings.end(), text, text + std::strlen(text) + 1);
+                return offset;
+            };
+
+            std::vector<SceneModelRecord> models;
+            std::vector<std::string> modelNames;
+            if (document.HasMember("models") && document["models"].IsObject()) {
+                for (const auto &model : document["models"].GetObject()) {
+                    if (!model.value.IsString()) {
+                        std::cout << "SCENE: model " << model.name.GetString() << " needs a path" << std::endl;
+                        return false;
+                    }
+                    models.push_back({addString(model.name.GetString()), addString(model.value.GetString())});
+                    modelNames.emplace_back(model.name.GetString());
+                }
+            }
+
+            std::vector<SceneEntityRecord> entities;
+            std::unordered_map<std::string, int32_t> entityIndices;
+            if (document.HasMember("entities") && document["entities"].IsArray()) {
+                const auto &list = document["entities"].GetArray();
+                entities.reserve(list.Size());
+                for (const auto &value : list) {
+                    if (!value.IsObject() || !value.HasMember("name") || !value["name"].IsString()) {
+                        std::cout << "SCENE: entity " << entities.size() << " needs a name" << std::endl;
+                        return false;
+                    }
+                    SceneEntityRecord record{};
+                    record.name = addString(value["name"].GetString());
+                    record.model = -1;
+                    record.parent = -1;
+                    // both are names, never indices, so nothing here can produce anything below -1
+                    for (const char *field : {"model", "parent"}) {
+                        if (value.HasMember(field) && !value[field].IsString()) {
+                            std::cout << "SCENE: entity " << value["name"].GetString() << " has a " << field
+                                      << " that isn't a name" << std::endl;
+                            return false;
+                        }
+                    }
+                    if (value.HasMember("model") && value["model"].IsString()) {
+                        const char *model = value["model"].GetString();
+                        for (size_t m = 0; m < modelNames.size(); m++) {
+                            if (modelNames[m] == model) {
+                                record.model = static_cast<int32_t>(m);
+                            }
+                        }
+                        if (record.model < 0) {
+                            std::cout << "SCENE: entity " << value["name"].GetString() << " uses unknown model " << model << std::endl;
+                        }
+                    }
+                    // parents have to come first, so entities can be created in file order and a loop is impossible
+                    if (value.HasMember("parent") && value["parent"].IsString()) {
+                        const auto parent = entityIndices.find(value["parent"].GetString());
+                        if (parent == entityIndices.end()) {
+                            std::cout << "SCENE: entity " << value["name"].GetString() << " has parent " << value["parent"].GetString()
+                                      << ", which isn't an entity listed before it" << std::endl;
+                            return false;
+                        }
+                        record.parent = parent->second;
+                    }
+                    readVec3(value, "position", 0.0f, record.position);
+                    float euler[3];
+                    readVec3(value, "rotation", 0.0f, euler);
+                    const glm::quat rotation(glm::radians(glm::vec3(euler[0], euler[1], euler[2])));
+                    record.rotation[0] = rotation.x;
+                    record.rotation[1] = rotation.y;
+                    record.rotation[2] = rotation.z;
+                    record.rotation[3] = rotation.w;
+                    readVec3(value, "scale", 1.0f, record.scale);
+                    record.shininess = value.HasMember("shininess") && value["shininess"].IsNumber() ? value["shininess"].GetFloat() : 0.0f;
+                    entityIndices.emplace(value["name"].GetString(), static_cast<int32_t>(entities.size()));
+                    entities.push_back(record);
+                }
+            }
+
+            header.modelCount = static_cast<uint32_t>(models.size());
+            header.entityCount = static_cast<uint32_t>(entities.size());
+            header.stringBytes = static_cast<uint32_t>(strings.size());
+
+            out.resize(sizeof(SceneHeader) + models.size() * sizeof(SceneModelRecord)
+                       + entities.size() * sizeof(SceneEntityRecord) + strings.size());
+            unsigned char *cursor = out.data();
+            const auto append = [&cursor](const void *data, const size_t bytes) {
+                if (bytes > 0) {
+                    std::memcpy(cursor, data, bytes);
+                    cursor += bytes;
+                }
+            };
+            append(&header, sizeof(header));
+            append(models.data(), models.size() * sizeof(SceneModelRecord));
+            append(entities.data(), entities.size() * sizeof(SceneEntityRecord));
+            append(strings.data(), strings.size());
+            return true;
+        }
+
+        // the camera as it was last left, so the next run starts there. false if there's no saved camera yet
+        static bool loadCamera(const std::string &path, Camera &camera) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                return false;
+            }
+            const std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            rapidjson::Document document;
+            document.Parse(json.c_str(), json.size());
+            if (document.HasParseError() || !document.IsObject()) {
+                std::cout << "SCENE: ignoring unreadable camera state " << path << std::endl;
+                return false;
+            }
+            applyCamera(readCamera(document), camera);
+            return true;
+        }
+
+        static void saveCamera(const std::string &path, const Camera &camera) {
+            rapidjson::StringBuffer buffer;
+            rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+            writer.StartObject();
+            writer.Key("position");
+            writer.StartArray();
+            for (int i = 0; i < 3; i++) {
+                writer.Double(camera.cameraPosition[i]);
+            }
+            writer.EndArray();
+            writer.Key("yaw");
+            writer.Double(camera.yaw);
+            writer.Key("pitch");
+            writer.Double(camera.pitch);
+            writer.Key("zoom");
+            writer.Double(camera.zoom);
+            writer.EndObject();
+
+            std::error_code error;
+            std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file << buffer.GetString();
+            if (!file) {
+                std::cout << "SCENE: failed to save the camera to " << path << std::endl;
+            }
+        }
+
+    private:
+
+        MappedFile snapshot;
+        // only used when the snapshot couldn't be written
+        std::vector<unsigned char> compiled;
+        const SceneHeader *header = nullptr;
+        const SceneModelRecord *models = nullptr;
+        const SceneEntityRecord *entities = nullptr;
+        const char *strings = nullptr;
+
+        // points the accessors into a snapshot after checking it's complete, current and can't send them out of
+        // bounds. the checks are one pass over the records, far cheaper than parsing anything
+        bool attach(const unsigned char *data, const size_t size, const uint64_t sourceSize, const int64_t sourceTime) {
+            header = nullptr;
+            if (!data || size < sizeof(SceneHeader)) {
+                return false;
+            }
+            const auto *candidate = reinterpret_cast<const SceneHeader *>(data);
+            if (std::memcmp(candidate->magic, SCENE_SNAPSHOT_MAGIC, sizeof(candidate->magic)) != 0
+                || candidate->version != SCENE_SNAPSHOT_VERSION
+                || candidate->sourceSize != sourceSize || candidate->sourceTime != sourceTime) {
+                return false;
+            }
+            const size_t expected = sizeof(SceneHeader) + static_cast<size_t>(candidate->modelCount) * sizeof(SceneModelRecord)
+                                  + static_cast<size_t>(candidate->entityCount) * sizeof(SceneEntityRecord) + candidate->stringBytes;
+            // the strings end in a nul, so the last one can't run off the end. with no strings there's nothing that
+            // could point into them, an empty scene
+            if (size != expected || (candidate->stringBytes > 0 && data[size - 1] != '\0')) {
+                return false;
+            }
+
+            const auto *modelRecords = reinterpret_cast<const SceneModelRecord *>(data + sizeof(SceneHeader));
+            const auto *entityRecords = reinterpret_cast<const SceneEntityRecord *>(modelRecords + candidate->modelCount);
+            const uint32_t stringBytes = candidate->stringBytes;
+            for (uint32_t i = 0; i < candidate->modelCount; i++) {
+                if (modelRecords[i].name >= stringBytes || modelRecords[i].path >= stringBytes) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < candidate->entityCount; i++) {
+                // -1 is no model or no parent, anything lower is a corrupt record
+                if (entityRecords[i].name >= stringBytes
+                    || entityRecords[i].model < -1 || entityRecords[i].model >= static_cast<int32_t>(candidate->modelCount)
+                    || entityRecords[i].parent < -1 || entityRecords[i].parent >= static_cast<int32_t>(i)) {
+                    return false;
+                }
+            }
+
+            header = candidate;
+            models = modelRecords;
+            entities = entityRecords;
+            strings = reinterpret_cast<const char *>(entityRecords + candidate->entityCount);
+            return true;
+        }
+
+        static void applyCamera(const SceneCameraRecord &record, Camera &camera) {
+            camera.teleport(glm::vec3(record.position[0], record.position[1], record.position[2]));
+            camera.yaw = record.yaw;
+            camera.pitch = record.pitch;
+            camera.zoom = record.zoom;
+            camera.updateCameraVectors();
+        }
+
+        static SceneCameraRecord readCamera(const rapidjson::Value &value) {
+            SceneCameraRecord record;
+            readVec3(value, "position", 0.0f, record.position);
+            if (value.HasMember("yaw") && value["yaw"].IsNumber()) {
+                record.yaw = value["yaw"].GetFloat();
+            }
+            if (value.HasMember("pitch") && value["pitch"].IsNumber()) {
+                record.pitch = value["pitch"].GetFloat();
+            }
+            if (value.HasMember("zoom") && value["zoom"].IsNumber()) {
+                record.zoom = value["zoom"].GetFloat();
+            }
+            return record;
+        }
+
+        // a [x, y, z] array, or a single number for all three (handy for uniform scales)
+        static void readVec3(const rapidjson::Value &object, const char *key, const float fallback, float out[3]) {
+            out[0] = out[1] = out[2] = fallback;
+            if (!object.HasMember(key)) {
+                return;
+            }
+            const rapidjson::Value &value = object[key];
+            if (value.IsNumber()) {
+                out[0] = out[1] = out[2] = value.GetFloat();
+            } else if (value.IsArray() && value.Size() == 3) {
+                for (rapidjson::SizeType i = 0; i < 3; i++) {
+                    out[i] = value[i].IsNumber() ? value[i].GetFloat() : fallback;
+                }
+            }
+        }
+};
+
+#endif //SCENE_H
@@ -0,0 +1,225 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <algorithm>
+#include <vector>
+#include "glm/glm.hpp"
+#include "jobs.h"
+#include "profiler.h"
+
+// below this many dirty nodes an update just runs on the calling thread, handing out jobs would cost more
+constexpr int SCENE_GRAPH_PARALLEL_NODES = 2048;
+// dirty subtrees bigger than this are split into their children's subtrees so they can be spread over threads
+constexpr int SCENE_GRAPH_SPLIT_NODES = 512;
+
+// a hierarchy of transforms. each node has a local matrix relative to its parent, and update() works out the world
+// matrices for whatever has changed since the last update.
+// the nodes are kept in depth first order in flat arrays, so a node's parent always comes before it and its whole
+// subtree is the run of nodes straight after it. updating a changed node is then one forward sweep over its run,
+// every parent done before its children, and nothing outside that run is touched. separate runs don't share any
+// nodes, so they're updated in parallel.
+// handles stay the same for a node's lifetime, the index it lives at can move when nodes are added
+class SceneGraph {
+    public:
+
+        // parent is a handle from an earlier addNode, or -1 for a root
+        int addNode(const glm::mat4 &local, const int parent = -1) {
+            const int handle = static_cast<int>(indexOf.size());
+            indexOf.push_back(static_cast<int>(locals.size()));
+            handles.push_back(handle);
+            parents.push_back(parent >= 0 ? indexOf[parent] : -1);
+            locals.push_back(local);
+            worlds.push_back(local);
+            dirty.push_back(0);
+            // the new node goes on the end, out of order, so the arrays are sorted again before the next update
+            layoutStale = true;
+            return handle;
+        }
+
+        void setLocal(const int handle, const glm::mat4 &local) {
+            const int index = indexOf[handle];
+            locals[index] = local;
+            if (!dirty[index]) {
+                dirty[index] = 1;
+                dirtyNodes.push_back(index);
+            }
+        }
+
+        [[nodiscard]] const glm::mat4 &local(const int handle) const {
+            return locals[indexOf[handle]];
+        }
+
+        // as of the last update()
+        [[nodiscard]] const glm::mat4 &world(const int handle) const {
+            return worlds[indexOf[handle]];
+        }
+
+        [[nodiscard]] int parent(const int handle) const {
+            const int index = parents[indexOf[handle]];
+            return index >= 0 ? handles[index] : -1;
+        }
+
+        [[nodiscard]] int size() const {
+            return static_cast<int>(locals.size());
+        }
+
+        // brings the world matrices of every changed node and everything under it up to date. returns how many
+        // nodes it recomputed
+        int update() {
+            if (layoutStale) {
+                relayout();
+            }
+            if (dirtyNodes.empty()) {
+                profiler.setCounter("Scene nodes updated", 0.0);
+                return 0;
+            }
+
+            // a changed node inside another changed node's subtree is covered by that one. in index order the
+            // subtrees come before anything inside them, so one pass drops those
+            std::sort(dirtyNodes.begin(), dirtyNodes.end());
+            roots.clear();
+            int coveredUntil = 0;
+            int total = 0;
+            for (const int index : dirtyNodes) {
+                dirty[index] = 0;
+                if (index >= coveredUntil) {
+                    roots.push_back(index);
+                    coveredUntil = subtreeEnd[index];
+                    total += subtreeEnd[index] - index;
+                }
+            }
+            dirtyNodes.clear();
+
+            if (total < SCENE_GRAPH_PARALLEL_NODES) {
+                for (const int root : roots) {
+                    updateRun(root, subtreeEnd[root]);
+                }
+            } else {
+                // one big subtree would leave the other threads idle, so big ones have their own node done here and
+                // their children's subtrees handed out instead. each run's parent is then already up to date
+                for (size_t i = 0; i < roots.size(); i++) {
+                    const int root = roots[i];
+                    if (subtreeEnd[root] - root > SCENE_GRAPH_SPLIT_NODES) {
+                        updateNode(root);
+                        roots[i] = -1;
+                        for (int child = root + 1; child < subtreeEnd[root]; child = subtreeEnd[child]) {
+                            roots.push_back(child);
+                        }
+                    }
+                }
+                std::erase(roots, -1);
+                jobs.parallelFor(static_cast<int>(roots.size()), [this](const int begin, const int end) {
+                    for (int i = begin; i < end; i++) {
+                        updateRun(roots[i], subtreeEnd[roots[i]]);
+                    }
+                });
+            }
+            profiler.setCounter("Scene nodes updated", total);
+            return total;
+        }
+
+    private:
+
+        // all by index, in depth first order
+        std::vector<int> parents;
+        // one past the last node in each node's subtree
+        std::vector<int> subtreeEnd;
+        std::vector<glm::mat4> locals;
+        std::vector<glm::mat4> worlds;
+        std::vector<char> dirty;
+        std::vector<int> handles;
+
+        // by handle
+        std::vector<int> indexOf;
+
+        std::vector<int> dirtyNodes;
+        // scratch for update, kept so it doesn't allocate once it's grown
+        std::vector<int> roots;
+        bool layoutStale = false;
+
+        void updateNode(const int index) {
+            worlds[index] = parents[index] >= 0 ? worlds[parents[index]] * locals[index] : locals[index];
+        }
+
+        void updateRun(const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                updateNode(i);
+            }
+        }
+
+        // puts the nodes back in depth first order after some were added, and recomputes every world matrix.
+        // only happens while a scene is being built
+        void relayout() {
+            const int count = size();
+            // children per node, as counts turned into offsets into one list
+            std::vector<int> childStart(count + 1, 0);
+            for (int i = 0; i < count; i++) {
+                if (parents[i] >= 0) {
+                    childStart[parents[i] + 1]++;
+                }
+            }
+            for (int i = 0; i < count; i++) {
+                childStart[i + 1] += childStart[i];
+            }
+            std::vector<int> children(childStart[count]);
+            std::vector<int> filled(childStart.begin(), childStart.end() - 1);
+            for (int i = 0; i < count; i++) {
+                if (parents[i] >= 0) {
+                    children[filled[parents[i]]++] = i;
+                }
+            }
+
+            // iterative so a deep hierarchy can't run out of stack. children are pushed in reverse to come out in
+            // the order they were added
+            std::vector<int> order;
+            order.reserve(count);
+            std::vector<int> stack;
+            for (int i = count - 1; i >= 0; i--) {
+                if (parents[i] < 0) {
+                    stack.push_back(i);
+                }
+            }
+            while (!stack.empty()) {
+                const int node = stack.back();
+                stack.pop_back();
+                order.push_back(node);
+                for (int c = childStart[node + 1] - 1; c >= childStart[node]; c--) {
+                    stack.push_back(children[c]);
+                }
+            }
+
+            std::vector<int> newIndex(count);
+            for (int i = 0; i < count; i++) {
+                newIndex[order[i]] = i;
+            }
+            std::vector<int> sortedParents(count), sortedHandles(count);
+            std::vector<glm::mat4> sortedLocals(count);
+            for (int i = 0; i < count; i++) {
+                const int old = order[i];
+                sortedParents[i] = parents[old] >= 0 ? newIndex[parents[old]] : -1;
+                sortedHandles[i] = handles[old];
+                sortedLocals[i] = locals[old];
+                indexOf[handles[old]] = i;
+            }
+            parents = std::move(sortedParents);
+            handles = std::move(sortedHandles);
+            locals = std::move(sortedLocals);
+
+            // a node's subtree ends where the next node that isn't below it starts. walking backwards, each node's
+            // end is the furthest end of its children, or just past itself
+            subtreeEnd.assign(count, 0);
+            for (int i = count - 1; i >= 0; i--) {
+                subtreeEnd[i] = std::max(subtreeEnd[i], i + 1);
+                if (parents[i] >= 0) {
+                    subtreeEnd[parents[i]] = std::max(subtreeEnd[parents[i]], subtreeEnd[i]);
+                }
+            }
+
+            std::fill(dirty.begin(), dirty.end(), 0);
+            dirtyNodes.clear();
+            updateRun(0, count);
+            layoutStale = false;
+        }
+};
+
+#endif //SCENEGRAPH_H
@@ -63,37 +63,105 @@ public:
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
+        checkLinked(vertexPath);
 
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
 
+    // a compute shader program, gl 4.3 and up. glCompileShader doesn't stop anything when it fails and a broken
+    // compute shader just does nothing, so the log is printed
+    explicit Shader(const char *computePath) {
+        std::ifstream file(computePath);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        if (!file) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << computePath << std::endl;
+        }
+        const std::string computeCode = stream.str();
+        const char *cShaderCode = computeCode.c_str();
+
+        const unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, nullptr);
+        glCompileShader(compute);
+        GLint compiled = GL_FALSE;
+        glGetShaderiv(compute, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char log[1024];
+            glGetShaderInfoLog(compute, sizeof(log), nullptr, log);
+            std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED " << computePath << "\n" << log << std::endl;
+        }
+
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkLinked(computePath);
+        glDeleteShader(compute);
+    }
+
     // activate the shader
     void use() const {
         glUseProgram(ID);
     }
-    // utility uniform functions
-    void uploadUniformBool(const std::string &name, const bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    // utility uniform functions. names are plain c strings so a literal doesn't turn into a std::string (and, past
+    // 15 characters, a heap allocation) on every call
+    void uploadUniformBool(const char *name, const bool value) const {
+        glUniform1i(glGetUniformLocation(ID, name), (int)value);
+    }
+    void uploadUniformInt(const char *name, const int value) const {
+        glUniform1i(glGetUniformLocation(ID, name), value);
+    }
+    void uploadUniformUint(const char *name, const GLuint value) const {
+        glUniform1ui(glGetUniformLocation(ID, name), value);
     }
-    void uploadUniformInt(const std::string &name, const int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void uploadUniformFloat(const char *name, const float value) const {
+        glUniform1f(glGetUniformLocation(ID, name), value);
     }
-    void uploadUniformFloat(const std::string &name, const float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void uploadUniformDouble(const char *name, const double value) const {
+        glUniform1d(glGetUniformLocation(ID, name), value);
     }
-    void uploadUniformDouble(const std::string &name, const double value) const {
-        glUniform1d(glGetUniformLocation(ID, name.c_str()), value);
+    void uploadUniformVector2f(const char *name, const glm::vec2 &vec) const {
+        glUniform2fv(glGetUniformLocation(ID, name), 1, &vec[0]);
     }
-    void uploadUniformVector3f(const std::string &name, const glm::vec3 &vec) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &vec[0]);
+    void uploadUniformIVector2(const char *name, const glm::ivec2 &vec) const {
+        glUniform2iv(glGetUniformLocation(ID, name), 1, &vec[0]);
     }
-    void uploadUniformVector4f(const std::string &name, const glm::vec4 &vec) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &vec[0]);
+    void uploadUniformVector3f(const char *name, const glm::vec3 &vec) const {
+        glUniform3fv(glGetUniformLocation(ID, name), 1, &vec[0]);
     }
-    void uploadUniformMatrix4f(const std::string &name, const glm::mat4 &mat4) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat4[0][0]);
+    void uploadUniformVector3fArray(const char *name, const glm::vec3 *vecs, const int count) const {
+        glUniform3fv(glGetUniformLocation(ID, name), count, &vecs[0][0]);
+    }
+    void uploadUniformVector4f(const char *name, const glm::vec4 &vec) const {
+        glUniform4fv(glGetUniformLocation(ID, name), 1, &vec[0]);
+    }
+    void uploadUniformVector4fArray(const char *name, const glm::vec4 *vecs, const int count) const {
+        glUniform4fv(glGetUniformLocation(ID, name), count, &vecs[0][0]);
+    }
+    void uploadUniformMatrix4f(const char *name, const glm::mat4 &mat4) const {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat4[0][0]);
+    }
+    // points a uniform block at a binding point. glsl 330 has no layout(binding) so it has to be done from here,
+    // once after linking. blocks the shader doesn't have (or that were optimised out) are skipped
+    void bindUniformBlock(const std::string &name, const GLuint binding) const {
+        const GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(ID, index, binding);
+        }
+    }
+
+private:
+
+    // a program that fails to link draws (or dispatches) nothing and says nothing, so the log is printed
+    void checkLinked(const char *path) const {
+        GLint linked = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char log[1024];
+            glGetProgramInfoLog(ID, sizeof(log), nullptr, log);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED " << path << "\n" << log << std::endl;
+        }
     }
 
 };
@@ -0,0 +1,84 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+#include <algorithm>
+#include "profiler.h"
+
+// the simulation always moves forward in steps of exactly this long, however fast or slow frames are
+constexpr double SIM_TIMESTEP = 1.0 / 60.0;
+// most steps run in one frame. after a long stall (loading, a breakpoint, dragging the window) the rest of the
+// backlog is thrown away, otherwise catching up makes the next frame slow too and it never recovers
+constexpr int SIM_MAX_STEPS_PER_FRAME = 5;
+// how close (in steps) the accumulator has to get to a whole step to count as one. frames exactly a step long (a
+// 60hz vsync) otherwise come out a hair short from rounding now and then, and run no step and then two
+constexpr double SIM_STEP_TOLERANCE = 1e-6;
+
+// turns real frame times into a whole number of fixed simulation steps. real time is added to an accumulator each
+// frame and spent a step at a time; what's left over (less than a step) becomes alpha(), how far the frame is
+// between the last two simulation states, which rendering uses to interpolate so motion doesn't judder
+class SimClock {
+    public:
+
+        explicit SimClock(const double timestep = SIM_TIMESTEP, const int maxSteps = SIM_MAX_STEPS_PER_FRAME)
+            : timestep(timestep), maxSteps(maxSteps) {}
+
+        // call once at the start of each frame with the current time, then run the returned number of steps
+        int advance(const double now) {
+            if (!started) {
+                started = true;
+                lastTime = now;
+            }
+            frameDelta = std::max(now - lastTime, 0.0);
+            lastTime = now;
+
+            accumulator += frameDelta;
+            // can leave the accumulator a rounding error below zero, which is carried rather than lost
+            const int due = static_cast<int>(accumulator / timestep + SIM_STEP_TOLERANCE);
+            int steps = due;
+            if (steps > maxSteps) {
+                droppedSteps += steps - maxSteps;
+                steps = maxSteps;
+            }
+            // the whole backlog comes off even when some of it was dropped, keeping the fraction so alpha carries on
+            // smoothly from where it was
+            accumulator -= static_cast<double>(due) * timestep;
+            totalSteps += steps;
+
+            profiler.addCounter("Sim steps", steps);
+            profiler.setCounter("Sim steps dropped", static_cast<double>(droppedSteps));
+            return steps;
+        }
+
+        // length of one step in seconds, the only delta anything in a step should use
+        [[nodiscard]] float step() const {
+            return static_cast<float>(timestep);
+        }
+
+        // 0 renders the previous simulation state, 1 the latest one
+        [[nodiscard]] float alpha() const {
+            return std::clamp(static_cast<float>(accumulator / timestep), 0.0f, 1.0f);
+        }
+
+        // real time since the last frame, for things that should follow the frame rate (ui, mouse look)
+        [[nodiscard]] double realDelta() const {
+            return frameDelta;
+        }
+
+        // simulated time since the start, which unlike glfwGetTime stands still while the simulation is behind
+        [[nodiscard]] double time() const {
+            return static_cast<double>(totalSteps) * timestep;
+        }
+
+    private:
+
+        double timestep;
+        int maxSteps;
+        bool started = false;
+        double lastTime = 0.0;
+        double frameDelta = 0.0;
+        double accumulator = 0.0;
+        long long totalSteps = 0;
+        long long droppedSteps = 0;
+};
+
+#endif //SIMCLOCK_H
@@ -0,0 +1,367 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "glm/glm.hpp"
+
+// quadric error metric edge collapse (garland & heckbert), without any gl in it so it can be run on its own.
+// every collapse moves a vertex onto one of its existing neighbours, so the simplified index buffers can all share the
+// original vertex buffer and only the indices change between levels of detail
+
+// symmetric 4x4 matrix, sum of the squared distance to a set of planes
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+
+    static Quadric fromPlane(const glm::dvec3 &n, const double d, const double weight = 1.0) {
+        Quadric q;
+        q.a2 = n.x * n.x * weight; q.ab = n.x * n.y * weight; q.ac = n.x * n.z * weight; q.ad = n.x * d * weight;
+        q.b2 = n.y * n.y * weight; q.bc = n.y * n.z * weight; q.bd = n.y * d * weight;
+        q.c2 = n.z * n.z * weight; q.cd = n.z * d * weight;
+        q.d2 = d * d * weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o) {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+        b2 += o.b2; bc += o.bc; bd += o.bd;
+        c2 += o.c2; cd += o.cd;
+        d2 += o.d2;
+        return *this;
+    }
+
+    [[nodiscard]] double error(const glm::dvec3 &p) const {
+        const double x = p.x, y = p.y, z = p.z;
+        const double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                       + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                       + c2 * z * z + 2 * cd * z
+                       + d2;
+        return std::max(e, 0.0);
+    }
+};
+
+struct SimplifyResult {
+    std::vector<unsigned int> indices;
+    // the largest collapse cost accepted, as a distance in the mesh's own units
+    float error = 0.0f;
+};
+
+// weight of the planes that pin open borders in place, so holes and outlines don't shrink away
+constexpr double SIMPLIFY_BORDER_WEIGHT = 10.0;
+// each pass looks at the cheapest 1/n of the edges
+constexpr size_t SIMPLIFY_PASS_FRACTION = 5;
+
+// reduces a triangle list to about targetIndexCount indices, stopping early if the next collapse would cost more
+// than maxError. texCoords can be empty; when given it is used to pick the right copy of a vertex that was split
+// along a uv seam.
+// collapsing onto a neighbour still moves the surface, outwards where it's concave. with inwardOnly a collapse is only
+// allowed if the vertex it moves onto is on or behind the plane of every triangle around the one going away (and
+// inside the outline, at an open border), so the simplified mesh only ever cuts into the solid and never reaches
+// past it, as long as the triangles wind anticlockwise seen from outside
+inline SimplifyResult simplifyMesh(const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &texCoords,
+                                   const std::vector<unsigned int> &indices, const size_t targetIndexCount, const float maxError,
+                                   const bool inwardOnly = false) {
+
+    SimplifyResult result;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || indices.size() <= targetIndexCount) {
+        result.indices = indices;
+        return result;
+    }
+
+    // 1. weld vertices with identical positions, so uv and normal seams don't stop edges collapsing
+    struct PositionHash {
+        size_t operator()(const glm::vec3 &p) const {
+            uint32_t bits[3];
+            std::memcpy(bits, &p, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> welded;
+    std::vector<unsigned int> canonical(positions.size());
+    std::vector<glm::dvec3> canonicalPosition;
+    std::vector<std::vector<unsigned int>> copies;
+    for (unsigned int v = 0; v < positions.size(); v++) {
+        auto [it, inserted] = welded.try_emplace(positions[v], static_cast<unsigned int>(canonicalPosition.size()));
+        if (inserted) {
+            canonicalPosition.emplace_back(positions[v]);
+            copies.emplace_back();
+        }
+        canonical[v] = it->second;
+        copies[it->second].push_back(v);
+    }
+    const size_t vertexCount = canonicalPosition.size();
+
+    // welded vertices whose copies disagree on uv sit on a seam. one can only be collapsed onto another seam vertex,
+    // since moving it onto a vertex with a single uv would drag the triangles on the far side of the seam across the
+    // whole texture
+    std::vector<char> seam(vertexCount);
+    if (!texCoords.empty()) {
+        for (size_t v = 0; v < vertexCount; v++) {
+            for (const unsigned int copy : copies[v]) {
+                seam[v] |= texCoords[copy] != texCoords[copies[v][0]];
+            }
+        }
+    }
+
+    // each triangle keeps both its welded vertices (what the algorithm works on) and the original corners (what ends up
+    // in the output)
+    std::vector<std::array<unsigned int, 3>> triangles;
+    std::vector<std::array<unsigned int, 3>> corners;
+    triangles.reserve(triangleCount);
+    corners.reserve(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        const std::array<unsigned int, 3> c = {indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]};
+        const std::array<unsigned int, 3> w = {canonical[c[0]], canonical[c[1]], canonical[c[2]]};
+        if (w[0] == w[1] || w[1] == w[2] || w[0] == w[2]) {
+            continue;
+        }
+        triangles.push_back(w);
+        corners.push_back(c);
+    }
+
+    // 2. quadrics: every vertex starts with the planes of the triangles around it
+    std::vector<Quadric> quadrics(vertexCount);
+    std::unordered_map<uint64_t, int> edgeUse;
+    auto edgeKey = [](const unsigned int a, const unsigned int b) {
+        return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+    };
+    for (const auto &t : triangles) {
+        const glm::dvec3 &p0 = canonicalPosition[t[0]];
+        const glm::dvec3 cross = glm::cross(canonicalPosition[t[1]] - p0, canonicalPosition[t[2]] - p0);
+        const double length = glm::length(cross);
+        if (length <= 0.0) {
+            continue;
+        }
+        const glm::dvec3 n = cross / length;
+        const Quadric q = Quadric::fromPlane(n, -glm::dot(n, p0));
+        for (int k = 0; k < 3; k++) {
+            quadrics[t[k]] += q;
+            edgeUse[edgeKey(t[k], t[(k + 1) % 3])]++;
+        }
+    }
+    // border edges (used by one triangle) get a plane through the edge, perpendicular to the triangle
+    for (const auto &t : triangles) {
+        const glm::dvec3 &p0 = canonicalPosition[t[0]];
+        const glm::dvec3 faceNormal = glm::cross(canonicalPosition[t[1]] - p0, canonicalPosition[t[2]] - p0);
+        for (int k = 0; k < 3; k++) {
+            const unsigned int a = t[k];
+            const unsigned int b = t[(k + 1) % 3];
+            if (edgeUse[edgeKey(a, b)] != 1) {
+                continue;
+            }
+            const glm::dvec3 edge = canonicalPosition[b] - canonicalPosition[a];
+            const glm::dvec3 perpendicular = glm::cross(edge, faceNormal);
+            const double length = glm::length(perpendicular);
+            if (length <= 0.0) {
+                continue;
+            }
+            const glm::dvec3 n = perpendicular / length;
+            const Quadric q = Quadric::fromPlane(n, -glm::dot(n, canonicalPosition[a]), SIMPLIFY_BORDER_WEIGHT);
+            quadrics[a] += q;
+            quadrics[b] += q;
+        }
+    }
+
+    // 3. collapse in passes. each pass costs every edge, then greedily takes the cheapest ones whose neighbourhoods
+    // haven't been touched yet this pass, which keeps the flip checks valid without a priority queue
+    const size_t targetTriangles = targetIndexCount / 3;
+    const double maxErrorSq = static_cast<double>(maxError) * static_cast<double>(maxError);
+    double acceptedError = 0.0;
+
+    struct Collapse {
+        double cost;
+        unsigned int from;
+        unsigned int to;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> adjacencyStart(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<char> touched(vertexCount);
+
+    // whether moving from onto to would push the surface out, see inwardOnly. a little slack, so collapses across a
+    // flat or nearly flat patch aren't lost to rounding
+    auto pushesOut = [&](const unsigned int from, const unsigned int to) {
+        const glm::dvec3 move = canonicalPosition[to] - canonicalPosition[from];
+        for (unsigned int i = adjacencyStart[from]; i < adjacencyStart[from + 1]; i++) {
+            const auto &t = triangles[adjacency[i]];
+            const glm::dvec3 &p0 = canonicalPosition[t[0]];
+            const glm::dvec3 n = glm::cross(canonicalPosition[t[1]] - p0, canonicalPosition[t[2]] - p0);
+            if (glm::dot(n, move) > 1e-9 * glm::length(n) * glm::length(move)) {
+                return true;
+            }
+            for (int k = 0; k < 3; k++) {
+                const unsigned int a = t[k];
+                const unsigned int b = t[(k + 1) % 3];
+                if ((a != from && b != from) || edgeUse[edgeKey(a, b)] != 1) {
+                    continue;
+                }
+                // outwards from the triangle, as for the border quadrics above
+                const glm::dvec3 perpendicular = glm::cross(canonicalPosition[b] - canonicalPosition[a], n);
+                if (glm::dot(perpendicular, move) > 1e-9 * glm::length(perpendicular) * glm::length(move)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    while (triangles.size() > targetTriangles) {
+
+        // vertex -> triangle adjacency, as one flat array
+        std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for (const auto &t : triangles) {
+            adjacencyStart[t[0] + 1]++;
+            adjacencyStart[t[1] + 1]++;
+            adjacencyStart[t[2] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        }
+        adjacency.resize(triangles.size() * 3);
+        {
+            std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (unsigned int t = 0; t < triangles.size(); t++) {
+                for (int k = 0; k < 3; k++) {
+                    adjacency[fill[triangles[t][k]]++] = t;
+                }
+            }
+        }
+
+        collapses.clear();
+        for (const auto &t : triangles) {
+            for (int k = 0; k < 3; k++) {
+                const unsigned int a = t[k];
+                const unsigned int b = t[(k + 1) % 3];
+                // each interior edge shows up twice (once per triangle), only cost it from one side
+                if (a > b && edgeUse[edgeKey(a, b)] > 1) {
+                    continue;
+                }
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                const double toB = (seam[a] && !seam[b]) || (inwardOnly && pushesOut(a, b)) ? INFINITY : q.error(canonicalPosition[b]);
+                const double toA = (seam[b] && !seam[a]) || (inwardOnly && pushesOut(b, a)) ? INFINITY : q.error(canonicalPosition[a]);
+                collapses.push_back(toB <= toA ? Collapse{toB, a, b} : Collapse{toA, b, a});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &l, const Collapse &r) { return l.cost < r.cost; });
+
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+
+        // only the cheapest slice of edges is considered each pass. taking everything the budget allows in one go
+        // would reach into expensive collapses while cheaper ones are still waiting behind a locked neighbourhood
+        size_t removed = 0;
+        const size_t wanted = triangles.size() - targetTriangles;
+        const size_t considered = std::max<size_t>(1, collapses.size() / SIMPLIFY_PASS_FRACTION);
+        for (size_t i = 0; i < considered; i++) {
+            const Collapse &c = collapses[i];
+            if (removed >= wanted || c.cost > maxErrorSq) {
+                break;
+            }
+            if (touched[c.from] || touched[c.to]) {
+                continue;
+            }
+
+            // reject the collapse if it would flip any triangle around the vertex being moved
+            bool flips = false;
+            size_t degenerate = 0;
+            for (unsigned int i = adjacencyStart[c.from]; i < adjacencyStart[c.from + 1] && !flips; i++) {
+                const auto &t = triangles[adjacency[i]];
+                if (t[0] == c.to || t[1] == c.to || t[2] == c.to) {
+                    degenerate++;
+                    continue;
+                }
+                glm::dvec3 before[3], after[3];
+                for (int k = 0; k < 3; k++) {
+                    before[k] = canonicalPosition[t[k]];
+                    after[k] = t[k] == c.from ? canonicalPosition[c.to] : before[k];
+                }
+                const glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(n0, n1) <= 0.0;
+            }
+            if (flips) {
+                continue;
+            }
+
+            remap[c.from] = c.to;
+            quadrics[c.to] += quadrics[c.from];
+            acceptedError = std::max(acceptedError, c.cost);
+            removed += degenerate;
+            // lock the one ring, anything in it moving again this pass would invalidate the flip check above
+            for (unsigned int i = adjacencyStart[c.from]; i < adjacencyStart[c.from + 1]; i++) {
+                for (const unsigned int v : triangles[adjacency[i]]) {
+                    touched[v] = 1;
+                }
+            }
+        }
+
+        if (removed == 0) {
+            break;
+        }
+
+        // apply the collapses, move corners onto the copy of the target vertex with the closest uv, drop degenerates
+        size_t write = 0;
+        for (size_t t = 0; t < triangles.size(); t++) {
+            std::array<unsigned int, 3> w = triangles[t];
+            std::array<unsigned int, 3> c = corners[t];
+            for (int k = 0; k < 3; k++) {
+                if (remap[w[k]] == w[k]) {
+                    continue;
+                }
+                w[k] = remap[w[k]];
+                const std::vector<unsigned int> &candidates = copies[w[k]];
+                unsigned int best = candidates[0];
+                if (!texCoords.empty()) {
+                    float bestDistance = INFINITY;
+                    for (const unsigned int candidate : candidates) {
+                        const glm::vec2 d = texCoords[candidate] - texCoords[c[k]];
+                        const float distance = glm::dot(d, d);
+                        if (distance < bestDistance) {
+                            bestDistance = distance;
+                            best = candidate;
+                        }
+                    }
+                }
+                c[k] = best;
+            }
+            if (w[0] == w[1] || w[1] == w[2] || w[0] == w[2]) {
+                continue;
+            }
+            triangles[write] = w;
+            corners[write] = c;
+            write++;
+        }
+        triangles.resize(write);
+        corners.resize(write);
+
+        // edge use counts change as triangles disappear, rebuild them for the border test next pass
+        edgeUse.clear();
+        for (const auto &t : triangles) {
+            for (int k = 0; k < 3; k++) {
+                edgeUse[edgeKey(t[k], t[(k + 1) % 3])]++;
+            }
+        }
+    }
+
+    result.indices.reserve(corners.size() * 3);
+    for (const auto &c : corners) {
+        result.indices.insert(result.indices.end(), c.begin(), c.end());
+    }
+    result.error = static_cast<float>(std::sqrt(acceptedError));
+    return result;
+}
+
+#endif //SIMPLIFY_H
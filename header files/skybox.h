@@ -0,0 +1,238 @@
+#ifndef SKYBOX_H
+#define SKYBOX_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+#include "bakedcubemap.h"
+#include "hash.h"
+#include "mappedfile.h"
+#include "shader.h"
+
+// bump this whenever the cache layout changes, so old cache files get ignored
+constexpr uint32_t SKYBOX_CACHE_VERSION = 2;
+constexpr uint32_t SKYBOX_CACHE_MAGIC = 0x594B5331; // "1SKY"
+
+// the cache is a SkyboxCacheHeader, then for every mip level from the top down a uint32 of how many bytes one face of
+// it is, followed by the 6 faces' compressed blocks in GL order. the asset pack's content key is kept so rebaked faces
+// are noticed, and the renderer's name is part of the file name since the block format is the driver's pick
+struct SkyboxCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t internalFormat;
+    int32_t size;
+    int32_t levels;
+    uint32_t padding;
+    uint64_t contentKey;
+};
+
+// the sky: a mipmapped, seamless cubemap drawn as one triangle over the whole screen after everything else. the
+// triangle sits on the far plane, so with GL_LEQUAL only the pixels nothing was drawn over are shaded, and each one
+// looks up the direction through it from the inverse view projection. the faces come out of the asset pack already
+// decoded and mipped, get compressed by the driver the first time round, then the compressed blocks are cached and
+// uploaded as they are
+class Skybox {
+    public:
+
+        GLuint cubeMap = 0;
+
+        // the faces only have to last the constructor
+        explicit Skybox(const BakedCubemap &faces, const std::string &cacheDirectory = "resources/cache")
+            : shader("resources/shaders/skyboxVertex.glsl", "resources/shaders/skyboxFragment.glsl") {
+
+            // without this every face edge shows as a seam once the lower mips get sampled
+            glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+            glGenVertexArrays(1, &emptyVao);
+
+            const std::string renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+            const uint64_t key = fnv1a(renderer.data(), renderer.size(), faces.sourceKey());
+
+            std::stringstream cacheName;
+            cacheName << cacheDirectory << "/skybox_" << std::hex << key << ".bin";
+            const std::string cachePath = cacheName.str();
+
+            glGenTextures(1, &cubeMap);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
+            // without the faces there's nothing to check the cache against either, so it's black either way
+            if (!faces.loaded()) {
+                uploadBlack();
+            } else if (!loadCache(cachePath, faces.contentKey())) {
+                std::cout << "Skybox cache miss, compressing " << cachePath << std::endl;
+                if (bake(faces)) {
+                    std::error_code error;
+                    std::filesystem::create_directories(cacheDirectory, error);
+                    saveCache(cachePath, faces.contentKey());
+                }
+            }
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        }
+
+        ~Skybox() {
+            glDeleteTextures(1, &cubeMap);
+            glDeleteVertexArrays(1, &emptyVao);
+        }
+
+        Skybox(const Skybox &) = delete;
+        Skybox &operator=(const Skybox &) = delete;
+
+        // draws the sky behind what's already in the depth buffer. call it after the opaque geometry
+        void draw(const glm::mat4 &projection, const glm::mat4 &view) const {
+
+            // the sky is infinitely far away, so the camera's position doesn't come into it
+            const glm::mat4 skyViewProjection = projection * glm::mat4(glm::mat3(view));
+
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+            shader.use();
+            shader.uploadUniformMatrix4f("inverseViewProjection", glm::inverse(skyViewProjection));
+            shader.uploadUniformInt("skybox", 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMap);
+            // the vertex shader makes the triangle from gl_VertexID, there's nothing to fetch
+            glBindVertexArray(emptyVao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
+
+    private:
+
+        Shader shader;
+        GLuint emptyVao = 0;
+        GLenum internalFormat = 0;
+        int size = 0;
+        int levels = 0;
+
+        static int levelCount(const int baseSize) {
+            int count = 1;
+            while ((baseSize >> count) > 0) {
+                count++;
+            }
+            return count;
+        }
+
+        // uploads every baked level for the driver to compress. false if it kept them uncompressed, in which case
+        // the pack already holds the smaller thing to keep around
+        bool bake(const BakedCubemap &faces) {
+
+            size = static_cast<int>(faces.size());
+            levels = static_cast<int>(faces.levels());
+            for (int level = 0; level < levels; level++) {
+                const int levelSize = static_cast<int>(bakedMipSize(faces.size(), level));
+                for (int face = 0; face < CUBEMAP_FACES; face++) {
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_COMPRESSED_SRGB, levelSize, levelSize, 0, GL_RGBA,
+                                 GL_UNSIGNED_BYTE, faces.face(face, level));
+                }
+            }
+
+            GLint compressed = GL_FALSE, format = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_COMPRESSED, &compressed);
+            glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+            internalFormat = static_cast<GLenum>(format);
+            return compressed == GL_TRUE;
+        }
+
+        // a single black texel per face, so sampling the sky still works
+        void uploadBlack() {
+            const unsigned char black[4] = {0, 0, 0, 255};
+            size = 1;
+            levels = 1;
+            for (int face = 0; face < CUBEMAP_FACES; face++) {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_SRGB8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, black);
+            }
+        }
+
+        void saveCache(const std::string &path, const uint64_t contentKey) const {
+
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                std::cout << "SKYBOX: cache could not be written to " << path << std::endl;
+                return;
+            }
+            const SkyboxCacheHeader header{SKYBOX_CACHE_MAGIC, SKYBOX_CACHE_VERSION, internalFormat, size, levels, 0, contentKey};
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+            std::vector<char> blocks;
+            for (int level = 0; level < levels; level++) {
+                GLint bytes = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+                const auto levelBytes = static_cast<uint32_t>(bytes);
+                file.write(reinterpret_cast<const char *>(&levelBytes), sizeof(levelBytes));
+                blocks.resize(static_cast<size_t>(bytes));
+                for (int face = 0; face < CUBEMAP_FACES; face++) {
+                    glGetCompressedTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, blocks.data());
+                    file.write(blocks.data(), bytes);
+                }
+            }
+        }
+
+        // uploads straight out of the mapped file. false if there's no cache, it's stale, or the driver won't take
+        // the blocks back, any of which means baking again
+        bool loadCache(const std::string &path, const uint64_t contentKey) {
+
+            MappedFile file;
+            if (!file.open(path) || file.size() < sizeof(SkyboxCacheHeader)) {
+                return false;
+            }
+            SkyboxCacheHeader header{};
+            std::memcpy(&header, file.data(), sizeof(header));
+            if (header.magic != SKYBOX_CACHE_MAGIC || header.version != SKYBOX_CACHE_VERSION || header.size <= 0 ||
+                header.levels != levelCount(header.size) || header.contentKey != contentKey) {
+                return false;
+            }
+
+            // walk the levels first so a truncated file is caught before anything is uploaded
+            std::vector<size_t> offsets(header.levels);
+            size_t offset = sizeof(header);
+            for (int level = 0; level < header.levels; level++) {
+                uint32_t levelBytes = 0;
+                if (offset + sizeof(levelBytes) > file.size()) {
+                    return false;
+                }
+                std::memcpy(&levelBytes, file.data() + offset, sizeof(levelBytes));
+                offsets[level] = offset;
+                offset += sizeof(levelBytes) + static_cast<size_t>(levelBytes) * CUBEMAP_FACES;
+                if (offset > file.size()) {
+                    return false;
+                }
+            }
+
+            while (glGetError() != GL_NO_ERROR) {}
+            for (int level = 0; level < header.levels; level++) {
+                uint32_t levelBytes = 0;
+                std::memcpy(&levelBytes, file.data() + offsets[level], sizeof(levelBytes));
+                const unsigned char *blocks = file.data() + offsets[level] + sizeof(levelBytes);
+                const int levelSize = std::max(header.size >> level, 1);
+                for (int face = 0; face < CUBEMAP_FACES; face++) {
+                    glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, header.internalFormat, levelSize, levelSize, 0,
+                                           static_cast<GLsizei>(levelBytes), blocks + static_cast<size_t>(levelBytes) * face);
+                }
+            }
+            if (glGetError() != GL_NO_ERROR) {
+                std::cout << "SKYBOX: driver rejected the cached format " << std::hex << header.internalFormat << std::dec << std::endl;
+                return false;
+            }
+            internalFormat = header.internalFormat;
+            size = header.size;
+            levels = header.levels;
+            return true;
+        }
+};
+
+#endif //SKYBOX_H
@@ -0,0 +1,347 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "glm/glm.hpp"
+
+// side of a grid cell in world units. about the size of a typical prop, so most of them only touch a few cells
+constexpr float SPATIAL_HASH_CELL_SIZE = 2.0f;
+// anything touching more cells than this (the terrain, a huge trigger volume) goes in a separate list that every
+// query just checks, instead of being copied into hundreds of cells
+constexpr int SPATIAL_HASH_MAX_CELLS = 64;
+// cells that empty out are kept, so props moving back and forth between a few cells don't free and allocate them
+// every frame. once there are more empty ones than this and than occupied ones, they're all dropped in one sweep
+constexpr size_t SPATIAL_HASH_KEEP_EMPTY_CELLS = 256;
+
+// broad phase for dynamic objects: every box is filed under each grid cell it touches, and the cells live in a hash
+// map so the world doesn't need a size up front. queries only look at the cells their region touches, so the cost
+// goes with how crowded an area is rather than how many objects there are in total.
+// handles are stable for the life of an object and get reused after remove. queries share some scratch state, so
+// they mustn't run on several threads at once
+class SpatialHash {
+    public:
+
+        explicit SpatialHash(const float cellSize = SPATIAL_HASH_CELL_SIZE) : cellSize(cellSize), inverseCellSize(1.0f / cellSize) {}
+
+        // userId is handed back by userId(), e.g. the entity or item the box belongs to
+        int insert(const glm::vec3 &min, const glm::vec3 &max, const int userId = -1) {
+            int handle;
+            if (!freeHandles.empty()) {
+                handle = freeHandles.back();
+                freeHandles.pop_back();
+            } else {
+                handle = static_cast<int>(proxies.size());
+                proxies.emplace_back();
+            }
+            Proxy &proxy = proxies[handle];
+            proxy = {};
+            proxy.min = min;
+            proxy.max = max;
+            proxy.userId = userId;
+            cellRange(min, max, proxy.cellMin, proxy.cellMax);
+            link(handle);
+            return handle;
+        }
+
+        // cheap when the box stays within the same cells, which for something moving a bit each frame is most frames
+        void update(const int handle, const glm::vec3 &min, const glm::vec3 &max) {
+            Proxy &proxy = proxies[handle];
+            proxy.min = min;
+            proxy.max = max;
+            glm::ivec3 cellMin, cellMax;
+            cellRange(min, max, cellMin, cellMax);
+            if (cellMin == proxy.cellMin && cellMax == proxy.cellMax) {
+                return;
+            }
+            unlink(handle);
+            proxy.cellMin = cellMin;
+            proxy.cellMax = cellMax;
+            link(handle);
+            pruneEmptyCells();
+        }
+
+        void remove(const int handle) {
+            unlink(handle);
+            freeHandles.push_back(handle);
+            pruneEmptyCells();
+        }
+
+        [[nodiscard]] int userId(const int handle) const {
+            return proxies[handle].userId;
+        }
+        [[nodiscard]] glm::vec3 boundsMin(const int handle) const {
+            return proxies[handle].min;
+        }
+        [[nodiscard]] glm::vec3 boundsMax(const int handle) const {
+            return proxies[handle].max;
+        }
+        [[nodiscard]] size_t size() const {
+            return proxies.size() - freeHandles.size();
+        }
+        // cells in the map, the empty ones that haven't been pruned yet included
+        [[nodiscard]] size_t cellCount() const {
+            return cells.size();
+        }
+
+        // handles of every box overlapping [min, max], each once, in no particular order. appends to out
+        void queryAabb(const glm::vec3 &min, const glm::vec3 &max, std::vector<int> &out) const {
+            const uint32_t stamp = nextStamp();
+            auto visit = [&](const int handle) {
+                const Proxy &proxy = proxies[handle];
+                if (proxy.stamp != stamp && overlaps(proxy, min, max)) {
+                    out.push_back(handle);
+                }
+                proxy.stamp = stamp;
+            };
+            glm::ivec3 cellMin, cellMax;
+            cellRange(min, max, cellMin, cellMax);
+            forEachCell(cellMin, cellMax, visit);
+            for (const int handle : large) {
+                visit(handle);
+            }
+        }
+
+        // handles of every box that comes within radius of centre. appends to out
+        void queryRadius(const glm::vec3 &centre, const float radius, std::vector<int> &out) const {
+            const uint32_t stamp = nextStamp();
+            const float radiusSq = radius * radius;
+            auto visit = [&](const int handle) {
+                const Proxy &proxy = proxies[handle];
+                if (proxy.stamp != stamp && distanceSq(proxy, centre) <= radiusSq) {
+                    out.push_back(handle);
+                }
+                proxy.stamp = stamp;
+            };
+            glm::ivec3 cellMin, cellMax;
+            cellRange(centre - glm::vec3(radius), centre + glm::vec3(radius), cellMin, cellMax);
+            forEachCell(cellMin, cellMax, visit);
+            for (const int handle : large) {
+                visit(handle);
+            }
+        }
+
+        // the k boxes closest to point (0 if the point is inside), nearest first. searches outwards a shell of cells
+        // at a time and stops once nothing further out could beat the k-th best so far. replaces out
+        void queryNearest(const glm::vec3 &point, const size_t k, std::vector<int> &out) const {
+
+            out.clear();
+            if (k == 0 || size() == 0) {
+                return;
+            }
+            const uint32_t stamp = nextStamp();
+            // a max heap on distance, so the worst of the current k is always on top to be replaced
+            std::vector<std::pair<float, int>> best;
+            auto visit = [&](const int handle) {
+                const Proxy &proxy = proxies[handle];
+                if (proxy.stamp == stamp) {
+                    return;
+                }
+                proxy.stamp = stamp;
+                const float d = distanceSq(proxy, point);
+                if (best.size() < k) {
+                    best.emplace_back(d, handle);
+                    std::push_heap(best.begin(), best.end());
+                } else if (d < best.front().first) {
+                    std::pop_heap(best.begin(), best.end());
+                    best.back() = {d, handle};
+                    std::push_heap(best.begin(), best.end());
+                }
+            };
+
+            for (const int handle : large) {
+                visit(handle);
+            }
+            const glm::ivec3 centre = cellOf(point);
+            // no occupied cell is further than this many shells out, so past it there's nothing left to find
+            int maxShell = -1;
+            if (occupiedMin.x <= occupiedMax.x) {
+                const glm::ivec3 reach = glm::max(glm::abs(occupiedMin - centre), glm::abs(occupiedMax - centre));
+                maxShell = std::max(reach.x, std::max(reach.y, reach.z));
+            }
+            for (int shell = 0; shell <= maxShell; shell++) {
+                forEachShellCell(centre, shell, visit);
+                // anything not seen yet misses every cell up to this shell, so it's at least shell cells away
+                const float bound = static_cast<float>(shell) * cellSize;
+                if (best.size() == k && best.front().first <= bound * bound) {
+                    break;
+                }
+            }
+
+            std::sort_heap(best.begin(), best.end());
+            for (const auto &[distance, handle] : best) {
+                out.push_back(handle);
+            }
+        }
+
+    private:
+
+        struct Proxy {
+            glm::vec3 min = glm::vec3(0.0f);
+            glm::vec3 max = glm::vec3(0.0f);
+            int userId = -1;
+            glm::ivec3 cellMin = glm::ivec3(0);
+            glm::ivec3 cellMax = glm::ivec3(0);
+            bool isLarge = false;
+            // the last query that looked at this proxy, so one touching several cells is only reported once
+            mutable uint32_t stamp = 0;
+        };
+
+        float cellSize;
+        float inverseCellSize;
+        std::vector<Proxy> proxies;
+        std::vector<int> freeHandles;
+        std::unordered_map<uint64_t, std::vector<int>> cells;
+        size_t emptyCells = 0;
+        std::vector<int> large;
+        // bounds of every cell that has ever been used, for knowing when a nearest search can give up
+        glm::ivec3 occupiedMin = glm::ivec3(INT32_MAX);
+        glm::ivec3 occupiedMax = glm::ivec3(INT32_MIN);
+        mutable uint32_t stamp = 0;
+
+        uint32_t nextStamp() const {
+            if (++stamp == 0) {
+                // wrapped round, so clear the old stamps rather than risk one matching by accident
+                for (const Proxy &proxy : proxies) {
+                    proxy.stamp = 0;
+                }
+                stamp = 1;
+            }
+            return stamp;
+        }
+
+        [[nodiscard]] glm::ivec3 cellOf(const glm::vec3 &p) const {
+            return glm::ivec3(glm::floor(p * inverseCellSize));
+        }
+
+        void cellRange(const glm::vec3 &min, const glm::vec3 &max, glm::ivec3 &cellMin, glm::ivec3 &cellMax) const {
+            cellMin = cellOf(min);
+            cellMax = cellOf(max);
+        }
+
+        // 21 bits per axis, which covers +-1 million cells each way
+        static uint64_t key(const int x, const int y, const int z) {
+            constexpr uint64_t mask = (1u << 21) - 1;
+            return (static_cast<uint64_t>(x) & mask) | ((static_cast<uint64_t>(y) & mask) << 21) | ((static_cast<uint64_t>(z) & mask) << 42);
+        }
+
+        static bool overlaps(const Proxy &proxy, const glm::vec3 &min, const glm::vec3 &max) {
+            return proxy.min.x <= max.x && proxy.max.x >= min.x && proxy.min.y <= max.y && proxy.max.y >= min.y && proxy.min.z <= max.z &&
+                   proxy.max.z >= min.z;
+        }
+
+        static float distanceSq(const Proxy &proxy, const glm::vec3 &p) {
+            const glm::vec3 d = glm::max(glm::max(proxy.min - p, p - proxy.max), glm::vec3(0.0f));
+            return glm::dot(d, d);
+        }
+
+        template <typename Visit>
+        void forEachCell(const glm::ivec3 &cellMin, const glm::ivec3 &cellMax, Visit &visit) const {
+            // a query bigger than the occupied area only needs the part that overlaps it
+            const glm::ivec3 from = glm::max(cellMin, occupiedMin);
+            const glm::ivec3 to = glm::min(cellMax, occupiedMax);
+            for (int z = from.z; z <= to.z; z++) {
+                for (int y = from.y; y <= to.y; y++) {
+                    for (int x = from.x; x <= to.x; x++) {
+                        const auto it = cells.find(key(x, y, z));
+                        if (it == cells.end()) {
+                            continue;
+                        }
+                        for (const int handle : it->second) {
+                            visit(handle);
+                        }
+                    }
+                }
+            }
+        }
+
+        // the cells exactly `shell` steps away from centre (the surface of a (2 * shell + 1)^3 block), leaving out any
+        // outside the occupied area. the clipping matters most in y, where the world is usually only a few cells tall
+        template <typename Visit>
+        void forEachShellCell(const glm::ivec3 &centre, const int shell, Visit &visit) const {
+            const glm::ivec3 from = glm::max(centre - glm::ivec3(shell), occupiedMin);
+            const glm::ivec3 to = glm::min(centre + glm::ivec3(shell), occupiedMax);
+            auto visitCell = [&](const int x, const int y, const int z) {
+                const auto it = cells.find(key(x, y, z));
+                if (it != cells.end()) {
+                    for (const int handle : it->second) {
+                        visit(handle);
+                    }
+                }
+            };
+            for (int z = from.z; z <= to.z; z++) {
+                for (int y = from.y; y <= to.y; y++) {
+                    if (std::abs(z - centre.z) == shell || std::abs(y - centre.y) == shell) {
+                        for (int x = from.x; x <= to.x; x++) {
+                            visitCell(x, y, z);
+                        }
+                    } else {
+                        // inside the block only the two x faces are on the shell
+                        if (centre.x - shell >= from.x) {
+                            visitCell(centre.x - shell, y, z);
+                        }
+                        if (shell > 0 && centre.x + shell <= to.x) {
+                            visitCell(centre.x + shell, y, z);
+                        }
+                    }
+                }
+            }
+        }
+
+        void link(const int handle) {
+            Proxy &proxy = proxies[handle];
+            const glm::ivec3 extent = proxy.cellMax - proxy.cellMin + glm::ivec3(1);
+            proxy.isLarge = static_cast<int64_t>(extent.x) * extent.y * extent.z > SPATIAL_HASH_MAX_CELLS;
+            if (proxy.isLarge) {
+                large.push_back(handle);
+                return;
+            }
+            occupiedMin = glm::min(occupiedMin, proxy.cellMin);
+            occupiedMax = glm::max(occupiedMax, proxy.cellMax);
+            for (int z = proxy.cellMin.z; z <= proxy.cellMax.z; z++) {
+                for (int y = proxy.cellMin.y; y <= proxy.cellMax.y; y++) {
+                    for (int x = proxy.cellMin.x; x <= proxy.cellMax.x; x++) {
+                        std::vector<int> &list = cells[key(x, y, z)];
+                        emptyCells -= list.empty() && list.capacity() > 0;
+                        list.push_back(handle);
+                    }
+                }
+            }
+        }
+
+        void unlink(const int handle) {
+            const Proxy &proxy = proxies[handle];
+            if (proxy.isLarge) {
+                large.erase(std::find(large.begin(), large.end(), handle));
+                return;
+            }
+            for (int z = proxy.cellMin.z; z <= proxy.cellMax.z; z++) {
+                for (int y = proxy.cellMin.y; y <= proxy.cellMax.y; y++) {
+                    for (int x = proxy.cellMin.x; x <= proxy.cellMax.x; x++) {
+                        const auto it = cells.find(key(x, y, z));
+                        std::vector<int> &list = it->second;
+                        // order within a cell doesn't matter, so swap with the last rather than shifting everything
+                        *std::find(list.begin(), list.end(), handle) = list.back();
+                        list.pop_back();
+                        emptyCells += list.empty();
+                    }
+                }
+            }
+        }
+
+        // a prop wandering across the world would otherwise leave a trail of empty cells behind it
+        void pruneEmptyCells() {
+            if (emptyCells <= SPATIAL_HASH_KEEP_EMPTY_CELLS || emptyCells * 2 <= cells.size()) {
+                return;
+            }
+            std::erase_if(cells, [](const auto &cell) { return cell.second.empty(); });
+            emptyCells = 0;
+        }
+};
+
+#endif //SPATIALHASH_H
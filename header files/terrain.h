@@ -0,0 +1,394 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "glm/glm.hpp"
+#include "camera.h"
+#include "frustum.h"
+#include "lod.h"
+#include "mesh.h"
+#include "model.h"
+#include "profiler.h"
+#include "simplify.h"
+
+// a node stops splitting once it holds this many triangles, and every coarser node is simplified down to about this
+constexpr size_t TERRAIN_CHUNK_TRIANGLES = 512;
+constexpr int TERRAIN_MAX_DEPTH = 8;
+// skirts hang this far below a chunk's edges, plus twice its error, to hide cracks against a neighbour at another level
+constexpr float TERRAIN_SKIRT_MIN_DEPTH = 0.05f;
+// how many chunks may be uploaded in one frame, the rest wait for the next one
+constexpr int TERRAIN_UPLOADS_PER_FRAME = 4;
+// chunks nobody has drawn or needed for this many frames lose their gpu buffers
+constexpr int TERRAIN_EVICT_FRAMES = 120;
+
+// splits a terrain model into a quadtree of chunks. leaves hold the original triangles, every node above holds a
+// simplified copy of its four children, so the whole terrain can be drawn with a handful of chunks at any distance.
+// each frame the tree is walked top down: chunks outside the frustum are skipped, and a chunk is only split into its
+// children while its error covers more than LOD_PIXEL_THRESHOLD pixels. the cpu copy of every chunk is kept, but the
+// gpu buffers are streamed in on demand under a per frame budget and dropped again once a chunk goes unused
+class Terrain {
+    public:
+
+        // chunks draw with the model's materials
+        explicit Terrain(const Model &model) {
+            for (const Mesh &mesh : model.meshes) {
+                buildTree(mesh);
+            }
+            // the roots are always resident, so there's always something to fall back to while children stream in
+            for (const int root : roots) {
+                upload(nodes[root]);
+            }
+        }
+
+        ~Terrain() {
+            for (Node &node : nodes) {
+                if (node.mesh) {
+                    node.mesh->release();
+                }
+            }
+        }
+
+        Terrain(const Terrain &) = delete;
+        Terrain &operator=(const Terrain &) = delete;
+
+        // the caller uploads modelMatrix to the shader itself, like for any other model
+        void draw(const Shader &shader, const glm::mat4 &modelMatrix, const glm::mat4 &viewProjection, const Camera &camera, const float viewportHeight) {
+
+            frame++;
+            drawn = culled = 0;
+            // whatever didn't fit in last frame's budget asks again below if it's still wanted
+            for (const int index : pending) {
+                nodes[index].requested = false;
+            }
+            pending.clear();
+
+            // everything is tested in the terrain's own space. the error is in model units too, so with a uniform scale
+            // the scale cancels out between the error and the distance. the eye is the interpolated one the view matrix
+            // was made from, so chunks are picked for where the camera is drawn rather than where the last step left it
+            const Frustum frustum = Frustum::fromMatrix(viewProjection * modelMatrix);
+            const glm::vec3 eye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(camera.renderPosition, 1.0f));
+            const float pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(camera.zoom) * 0.5f));
+
+            for (const int root : roots) {
+                gather(root, shader, frustum, eye, pixelsPerUnit);
+            }
+
+            // coarse chunks are requested before fine ones, so the budget goes to whatever is closest to being drawable
+            int uploads = 0;
+            for (const int index : pending) {
+                if (uploads++ >= TERRAIN_UPLOADS_PER_FRAME) {
+                    break;
+                }
+                upload(nodes[index]);
+            }
+
+            int resident = 0;
+            for (Node &node : nodes) {
+                if (node.mesh && !node.root && frame - node.lastUsedFrame > TERRAIN_EVICT_FRAMES) {
+                    node.mesh->release();
+                    node.mesh.reset();
+                }
+                resident += node.mesh ? 1 : 0;
+            }
+
+            profiler.addCounter("Terrain chunks drawn", drawn);
+            profiler.addCounter("Terrain chunks culled", culled);
+            profiler.addCounter("Terrain uploads", std::min(uploads, TERRAIN_UPLOADS_PER_FRAME));
+            profiler.setCounter("Terrain chunks resident", resident);
+        }
+
+        [[nodiscard]] size_t chunkCount() const {
+            return nodes.size();
+        }
+
+    private:
+
+        struct Node {
+            // surface triangles come first, skirt triangles after surfaceIndexCount
+            std::vector<Vertex> vertices;
+            std::vector<unsigned int> indices;
+            size_t surfaceIndexCount = 0;
+            int material = -1;
+
+            glm::vec3 min = glm::vec3(FLT_MAX);
+            glm::vec3 max = glm::vec3(-FLT_MAX);
+            // how far (model units) this chunk strays from the full res terrain, including everything it was built from
+            float error = 0.0f;
+            int children[4] = {-1, -1, -1, -1};
+            bool leaf = true;
+            bool root = false;
+            bool refined = false;
+
+            std::optional<Mesh> mesh;
+            bool requested = false;
+            long long lastUsedFrame = 0;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<int> roots;
+        std::vector<int> pending;
+        long long frame = 0;
+        int drawn = 0;
+        int culled = 0;
+
+        // edges along the outside of the source mesh. skirts there would only show up as walls at the edge of the world
+        std::unordered_set<uint64_t> outerEdges;
+
+        void gather(const int index, const Shader &shader, const Frustum &frustum, const glm::vec3 &eye, const float pixelsPerUnit) {
+
+            Node &node = nodes[index];
+            if (!frustum.intersects(node.min, node.max)) {
+                culled++;
+                return;
+            }
+            node.lastUsedFrame = frame;
+
+            // distance to the nearest point of the box, so the chunk the camera stands on is always the finest
+            const glm::vec3 nearest = glm::clamp(eye, node.min, node.max);
+            const float distance = std::max(glm::length(nearest - eye), 0.1f);
+            const float pixelError = node.error * pixelsPerUnit / distance;
+            const float threshold = node.refined ? LOD_PIXEL_THRESHOLD * LOD_HYSTERESIS : LOD_PIXEL_THRESHOLD;
+
+            if (!node.leaf && pixelError > threshold) {
+                // only split once every visible child can be drawn, otherwise there'd be a hole where one is missing
+                bool ready = true;
+                for (const int child : node.children) {
+                    if (child < 0) {
+                        continue;
+                    }
+                    Node &c = nodes[child];
+                    if (!c.mesh && frustum.intersects(c.min, c.max)) {
+                        c.lastUsedFrame = frame;
+                        request(child);
+                        ready = false;
+                    }
+                }
+                if (ready) {
+                    node.refined = true;
+                    for (const int child : node.children) {
+                        if (child >= 0) {
+                            gather(child, shader, frustum, eye, pixelsPerUnit);
+                        }
+                    }
+                    return;
+                }
+            }
+
+            // a chunk is only reached once its parent found it resident, so this is always drawable
+            node.refined = false;
+            if (node.mesh) {
+                node.mesh->draw(shader);
+                drawn++;
+            }
+        }
+
+        void request(const int index) {
+            if (!nodes[index].requested) {
+                nodes[index].requested = true;
+                pending.push_back(index);
+            }
+        }
+
+        void upload(Node &node) {
+            node.mesh.emplace(node.vertices, node.indices, node.material);
+            node.requested = false;
+            node.lastUsedFrame = frame;
+        }
+
+        // edges are matched by position rather than index, since chunks and the source mesh all number vertices differently
+        static uint64_t positionEdgeKey(const glm::vec3 &a, const glm::vec3 &b) {
+            auto hash = [](const glm::vec3 &p) {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return static_cast<uint64_t>((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u));
+            };
+            const uint64_t ha = hash(a), hb = hash(b);
+            // order independent, so a->b and b->a give the same key
+            return (std::min(ha, hb) << 32) ^ std::max(ha, hb);
+        }
+
+        // edges used by exactly one triangle, as pairs of corner indices in winding order
+        static std::vector<std::pair<unsigned int, unsigned int>> boundaryEdges(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, const size_t indexCount) {
+            std::unordered_map<uint64_t, int> uses;
+            for (size_t i = 0; i < indexCount; i += 3) {
+                for (int e = 0; e < 3; e++) {
+                    uses[positionEdgeKey(vertices[indices[i + e]].Position, vertices[indices[i + (e + 1) % 3]].Position)]++;
+                }
+            }
+            std::vector<std::pair<unsigned int, unsigned int>> edges;
+            for (size_t i = 0; i < indexCount; i += 3) {
+                for (int e = 0; e < 3; e++) {
+                    const unsigned int a = indices[i + e];
+                    const unsigned int b = indices[i + (e + 1) % 3];
+                    if (uses[positionEdgeKey(vertices[a].Position, vertices[b].Position)] == 1) {
+                        edges.emplace_back(a, b);
+                    }
+                }
+            }
+            return edges;
+        }
+
+        void buildTree(const Mesh &mesh) {
+
+            const size_t triangleCount = mesh.indices.size() / 3;
+            if (triangleCount == 0) {
+                return;
+            }
+            for (const auto &[a, b] : boundaryEdges(mesh.vertices, mesh.indices, mesh.indices.size())) {
+                outerEdges.insert(positionEdgeKey(mesh.vertices[a].Position, mesh.vertices[b].Position));
+            }
+
+            std::vector<unsigned int> triangles(triangleCount);
+            for (unsigned int t = 0; t < triangleCount; t++) {
+                triangles[t] = t;
+            }
+            const int root = buildNode(mesh, triangles, 0);
+            nodes[root].root = true;
+            roots.push_back(root);
+        }
+
+        // returns the index of the new node. children are built first, since a parent is simplified from them
+        int buildNode(const Mesh &mesh, const std::vector<unsigned int> &triangles, const int depth) {
+
+            glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+            for (const unsigned int t : triangles) {
+                for (int c = 0; c < 3; c++) {
+                    const glm::vec3 &p = mesh.vertices[mesh.indices[t * 3 + c]].Position;
+                    min = glm::min(min, p);
+                    max = glm::max(max, p);
+                }
+            }
+
+            Node node;
+            node.material = mesh.material;
+
+            if (triangles.size() > TERRAIN_CHUNK_TRIANGLES && depth < TERRAIN_MAX_DEPTH) {
+                // split on the centre of the xz bounds, by which quadrant each triangle's centroid falls in
+                const glm::vec2 centre = (glm::vec2(min.x, min.z) + glm::vec2(max.x, max.z)) * 0.5f;
+                std::vector<unsigned int> quadrants[4];
+                for (const unsigned int t : triangles) {
+                    const glm::vec3 centroid = (mesh.vertices[mesh.indices[t * 3]].Position + mesh.vertices[mesh.indices[t * 3 + 1]].Position +
+                                                mesh.vertices[mesh.indices[t * 3 + 2]].Position) / 3.0f;
+                    quadrants[(centroid.x >= centre.x ? 1 : 0) + (centroid.z >= centre.y ? 2 : 0)].push_back(t);
+                }
+
+                // a long thin strip can put everything in one quadrant, in which case it just becomes a big leaf
+                int filled = 0;
+                for (const auto &quadrant : quadrants) {
+                    filled += quadrant.empty() ? 0 : 1;
+                }
+                if (filled > 1) {
+                    node.leaf = false;
+                    int child = 0;
+                    for (const auto &quadrant : quadrants) {
+                        if (!quadrant.empty()) {
+                            node.children[child++] = buildNode(mesh, quadrant, depth + 1);
+                        }
+                    }
+                }
+            }
+
+            std::vector<unsigned int> sourceIndices;
+            if (node.leaf) {
+                sourceIndices.reserve(triangles.size() * 3);
+                for (const unsigned int t : triangles) {
+                    sourceIndices.insert(sourceIndices.end(), {mesh.indices[t * 3], mesh.indices[t * 3 + 1], mesh.indices[t * 3 + 2]});
+                }
+                compact(node, mesh.vertices, sourceIndices);
+            } else {
+                simplifyFromChildren(node);
+            }
+
+            node.min = glm::min(node.min, min);
+            node.max = glm::max(node.max, max);
+            // the root is only ever drawn on its own, so it has no neighbours to leave cracks against
+            if (depth > 0) {
+                addSkirts(node);
+            }
+
+            nodes.push_back(std::move(node));
+            return static_cast<int>(nodes.size()) - 1;
+        }
+
+        // copies the vertices the indices use into the node, renumbering the indices to match
+        static void compact(Node &node, const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices) {
+            std::unordered_map<unsigned int, unsigned int> remap;
+            node.vertices.clear();
+            node.indices.clear();
+            node.indices.reserve(indices.size());
+            for (const unsigned int index : indices) {
+                auto [it, inserted] = remap.try_emplace(index, static_cast<unsigned int>(node.vertices.size()));
+                if (inserted) {
+                    node.vertices.push_back(vertices[index]);
+                }
+                node.indices.push_back(it->second);
+            }
+            node.surfaceIndexCount = node.indices.size();
+        }
+
+        // a parent is simplified from its children's surfaces rather than the original triangles, so building a level
+        // only ever touches about 4 chunks' worth of triangles however big the terrain is
+        void simplifyFromChildren(Node &node) {
+
+            std::vector<Vertex> vertices;
+            std::vector<unsigned int> indices;
+            float childError = 0.0f;
+            for (const int child : node.children) {
+                if (child < 0) {
+                    continue;
+                }
+                const Node &c = nodes[child];
+                const auto base = static_cast<unsigned int>(vertices.size());
+                vertices.insert(vertices.end(), c.vertices.begin(), c.vertices.end());
+                for (size_t j = 0; j < c.surfaceIndexCount; j++) {
+                    indices.push_back(base + c.indices[j]);
+                }
+                childError = std::max(childError, c.error);
+                node.min = glm::min(node.min, c.min);
+                node.max = glm::max(node.max, c.max);
+            }
+
+            std::vector<glm::vec3> positions(vertices.size());
+            std::vector<glm::vec2> texCoords(vertices.size());
+            for (size_t v = 0; v < vertices.size(); v++) {
+                positions[v] = vertices[v].Position;
+                texCoords[v] = vertices[v].TexCoords;
+            }
+            // the chunk borders are pinned by the simplifier's border planes, so neighbours mostly still line up
+            const SimplifyResult result = simplifyMesh(positions, texCoords, indices, TERRAIN_CHUNK_TRIANGLES * 3, FLT_MAX);
+            compact(node, vertices, result.indices);
+            node.error = childError + result.error;
+        }
+
+        // hangs a strip down from every edge that isn't shared with another triangle in the chunk. neighbouring chunks at
+        // different levels don't meet exactly, and the skirt fills the gap. they're emitted double sided since which side
+        // faces the camera depends on where the neighbour's edge ended up
+        void addSkirts(Node &node) {
+
+            const float depth = TERRAIN_SKIRT_MIN_DEPTH + node.error * 2.0f;
+            for (const auto &[a, b] : boundaryEdges(node.vertices, node.indices, node.surfaceIndexCount)) {
+                if (outerEdges.count(positionEdgeKey(node.vertices[a].Position, node.vertices[b].Position))) {
+                    continue;
+                }
+                const auto base = static_cast<unsigned int>(node.vertices.size());
+                Vertex lowA = node.vertices[a];
+                Vertex lowB = node.vertices[b];
+                lowA.Position.y -= depth;
+                lowB.Position.y -= depth;
+                node.vertices.push_back(lowA);
+                node.vertices.push_back(lowB);
+                node.indices.insert(node.indices.end(), {a, base, b, b, base, base + 1});
+                node.indices.insert(node.indices.end(), {a, b, base, b, base + 1, base});
+            }
+            node.min.y -= depth;
+        }
+};
+
+#endif //TERRAIN_H
@@ -1,20 +1,81 @@
 #ifndef TRANSFORM_H
 #define TRANSFORM_H
 #include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
 
+// where something is, which way it faces and how big it is. applied scale first, then rotation, then position
 class Transform {
 
     public:
 
-        glm::vec3 position;
-        glm::vec3 rotation;
-        glm::vec3 scale;
+        glm::vec3 position = glm::vec3(0.0f);
+        // unit length
+        glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 scale = glm::vec3(1.0f);
 
-        Transform(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale){
+        Transform() = default;
+
+        Transform(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale) {
             this->position = position;
             this->rotation = rotation;
             this->scale = scale;
         }
 
+        // euler angles in radians, (pitch, yaw, roll) about x, y and z
+        static Transform fromEuler(const glm::vec3 &position, const glm::vec3 &euler, const glm::vec3 &scale) {
+            return {position, glm::quat(euler), scale};
+        }
+
+        void setEuler(const glm::vec3 &euler) {
+            rotation = glm::quat(euler);
+        }
+
+        [[nodiscard]] glm::vec3 euler() const {
+            return glm::eulerAngles(rotation);
+        }
+
+        // turns it by angle (radians) about an axis of its own, on top of the rotation it already has. renormalised
+        // so repeated small turns don't drift away from unit length
+        void rotate(const float angle, const glm::vec3 &axis) {
+            rotation = glm::normalize(rotation * glm::angleAxis(angle, axis));
+        }
+
+        // the model matrix's top three rows, one per vec4: that row of the scaled rotation, then the position. it's
+        // the whole of an affine transform since the bottom row is always (0, 0, 0, 1), and each row dotted with
+        // (p, 1) gives one coordinate of a moved point
+        [[nodiscard]] glm::mat3x4 affine() const {
+            const float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+            const float xx = x * x, yy = y * y, zz = z * z;
+            const float xy = x * y, xz = x * z, yz = y * z;
+            const float wx = w * x, wy = w * y, wz = w * z;
+
+            glm::mat3x4 rows;
+            rows[0] = glm::vec4(glm::vec3(1.0f - 2.0f * (yy + zz), 2.0f * (xy - wz), 2.0f * (xz + wy)) * scale, position.x);
+            rows[1] = glm::vec4(glm::vec3(2.0f * (xy + wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz - wx)) * scale, position.y);
+            rows[2] = glm::vec4(glm::vec3(2.0f * (xz - wy), 2.0f * (yz + wx), 1.0f - 2.0f * (xx + yy)) * scale, position.z);
+            return rows;
+        }
+
+        // the same terms as a whole mat4, for the scene graph and the shaders, which take whole matrices. built column
+        // by column rather than by widening affine(), which costs a transpose
+        [[nodiscard]] glm::mat4 matrix() const {
+            const float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+            const float xx = x * x, yy = y * y, zz = z * z;
+            const float xy = x * y, xz = x * z, yz = y * z;
+            const float wx = w * x, wy = w * y, wz = w * z;
+
+            glm::mat4 result;
+            result[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * scale.x;
+            result[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * scale.y;
+            result[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * scale.z;
+            result[3] = glm::vec4(position, 1.0f);
+            return result;
+        }
+
+        // puts back the (0, 0, 0, 1) bottom row. transposed, the rows are glm's columns
+        static glm::mat4 widen(const glm::mat3x4 &rows) {
+            return glm::mat4(glm::transpose(rows));
+        }
+
 };
 #endif //TRANSFORM_H
@@ -0,0 +1,245 @@
+#ifndef TRANSFORMBATCH_H
+#define TRANSFORMBATCH_H
+
+#include <cstddef>
+#include <vector>
+#include "glm/glm.hpp"
+#include "transform.h"
+
+// x86-64 always has sse2. avx2 is only there on some cpus, so that path is compiled for it alone and picked when the
+// program starts
+#if defined(__x86_64__) || defined(_M_X64)
+#define TRANSFORM_BATCH_USE_SSE 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TRANSFORM_BATCH_AVX2 __attribute__((target("avx2")))
+#else
+#include <intrin.h>
+#define TRANSFORM_BATCH_AVX2
+#endif
+#endif
+
+// a lot of transforms as structure of arrays, one array per component, so a batch of them can be turned into
+// matrices several at a time. a Transform for each is set() in, then build() writes all the matrices in one go
+class TransformBatch {
+    public:
+
+        std::vector<float> px, py, pz;
+        // unit quaternions
+        std::vector<float> qx, qy, qz, qw;
+        std::vector<float> sx, sy, sz;
+
+        [[nodiscard]] size_t size() const {
+            return px.size();
+        }
+
+        // new transforms start as the identity: at the origin, unrotated and unscaled
+        void resize(const size_t count) {
+            for (std::vector<float> *component : {&px, &py, &pz, &qx, &qy, &qz}) {
+                component->resize(count, 0.0f);
+            }
+            for (std::vector<float> *component : {&qw, &sx, &sy, &sz}) {
+                component->resize(count, 1.0f);
+            }
+        }
+
+        void set(const size_t i, const Transform &transform) {
+            px[i] = transform.position.x;
+            py[i] = transform.position.y;
+            pz[i] = transform.position.z;
+            qx[i] = transform.rotation.x;
+            qy[i] = transform.rotation.y;
+            qz[i] = transform.rotation.z;
+            qw[i] = transform.rotation.w;
+            sx[i] = transform.scale.x;
+            sy[i] = transform.scale.y;
+            sz[i] = transform.scale.z;
+        }
+
+        [[nodiscard]] Transform get(const size_t i) const {
+            return {glm::vec3(px[i], py[i], pz[i]), glm::quat(qw[i], qx[i], qy[i], qz[i]), glm::vec3(sx[i], sy[i], sz[i])};
+        }
+
+        // writes models[i] = Transform::matrix() for every transform, and when normals isn't null, normals[i] = the
+        // inverse transpose of its upper 3x3 (the rotation with the scale divided out instead of multiplied in, so no
+        // inverse is needed) in a mat4, as the shaders take it
+        void build(glm::mat4 *models, glm::mat4 *normals = nullptr) const {
+            kernel()(*this, 0, size(), models, normals);
+        }
+
+        // which kernel build() runs on this cpu
+        static const char *path() {
+#ifdef TRANSFORM_BATCH_USE_SSE
+            return hasAvx2() ? "avx2" : "sse";
+#else
+            return "scalar";
+#endif
+        }
+
+        // the one transform at a time version, which the others fall back to for what's left over after the
+        // last full group
+        static void buildScalar(const TransformBatch &batch, const size_t begin, const size_t end, glm::mat4 *models, glm::mat4 *normals) {
+            for (size_t i = begin; i < end; i++) {
+                const float x = batch.qx[i], y = batch.qy[i], z = batch.qz[i], w = batch.qw[i];
+                const glm::vec3 c0(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y));
+                const glm::vec3 c1(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x));
+                const glm::vec3 c2(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y));
+                models[i][0] = glm::vec4(c0 * batch.sx[i], 0.0f);
+                models[i][1] = glm::vec4(c1 * batch.sy[i], 0.0f);
+                models[i][2] = glm::vec4(c2 * batch.sz[i], 0.0f);
+                models[i][3] = glm::vec4(batch.px[i], batch.py[i], batch.pz[i], 1.0f);
+                if (normals) {
+                    normals[i][0] = glm::vec4(c0 / batch.sx[i], 0.0f);
+                    normals[i][1] = glm::vec4(c1 / batch.sy[i], 0.0f);
+                    normals[i][2] = glm::vec4(c2 / batch.sz[i], 0.0f);
+                    normals[i][3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+                }
+            }
+        }
+
+#ifdef TRANSFORM_BATCH_USE_SSE
+        // 4 transforms at a time. each matrix column is worked out for all 4 as one register per component, then
+        // transposed so each transform's column can be stored whole
+        static void buildSse(const TransformBatch &batch, const size_t begin, const size_t end, glm::mat4 *models, glm::mat4 *normals) {
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 two = _mm_set1_ps(2.0f);
+            const __m128 zero = _mm_setzero_ps();
+            size_t i = begin;
+            for (; i + 4 <= end; i += 4) {
+                const __m128 x = _mm_loadu_ps(&batch.qx[i]), y = _mm_loadu_ps(&batch.qy[i]);
+                const __m128 z = _mm_loadu_ps(&batch.qz[i]), w = _mm_loadu_ps(&batch.qw[i]);
+                const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+                const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+                const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+                // r<column><row>
+                const __m128 r00 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+                const __m128 r01 = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+                const __m128 r02 = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+                const __m128 r10 = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+                const __m128 r11 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+                const __m128 r12 = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+                const __m128 r20 = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+                const __m128 r21 = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+                const __m128 r22 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+                const __m128 scaleX = _mm_loadu_ps(&batch.sx[i]), scaleY = _mm_loadu_ps(&batch.sy[i]), scaleZ = _mm_loadu_ps(&batch.sz[i]);
+                storeColumnSse(models + i, 0, _mm_mul_ps(r00, scaleX), _mm_mul_ps(r01, scaleX), _mm_mul_ps(r02, scaleX), zero);
+                storeColumnSse(models + i, 1, _mm_mul_ps(r10, scaleY), _mm_mul_ps(r11, scaleY), _mm_mul_ps(r12, scaleY), zero);
+                storeColumnSse(models + i, 2, _mm_mul_ps(r20, scaleZ), _mm_mul_ps(r21, scaleZ), _mm_mul_ps(r22, scaleZ), zero);
+                storeColumnSse(models + i, 3, _mm_loadu_ps(&batch.px[i]), _mm_loadu_ps(&batch.py[i]), _mm_loadu_ps(&batch.pz[i]), one);
+                if (normals) {
+                    const __m128 inverseX = _mm_div_ps(one, scaleX), inverseY = _mm_div_ps(one, scaleY), inverseZ = _mm_div_ps(one, scaleZ);
+                    storeColumnSse(normals + i, 0, _mm_mul_ps(r00, inverseX), _mm_mul_ps(r01, inverseX), _mm_mul_ps(r02, inverseX), zero);
+                    storeColumnSse(normals + i, 1, _mm_mul_ps(r10, inverseY), _mm_mul_ps(r11, inverseY), _mm_mul_ps(r12, inverseY), zero);
+                    storeColumnSse(normals + i, 2, _mm_mul_ps(r20, inverseZ), _mm_mul_ps(r21, inverseZ), _mm_mul_ps(r22, inverseZ), zero);
+                    storeColumnSse(normals + i, 3, zero, zero, zero, one);
+                }
+            }
+            buildScalar(batch, i, end, models, normals);
+        }
+
+        // 8 at a time, the same way. the transpose works within each 128 bit half, so the low halves hold
+        // transforms 0-3 and the high halves 4-7
+        TRANSFORM_BATCH_AVX2 static void buildAvx2(const TransformBatch &batch, const size_t begin, const size_t end, glm::mat4 *models, glm::mat4 *normals) {
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256 two = _mm256_set1_ps(2.0f);
+            const __m256 zero = _mm256_setzero_ps();
+            size_t i = begin;
+            for (; i + 8 <= end; i += 8) {
+                const __m256 x = _mm256_loadu_ps(&batch.qx[i]), y = _mm256_loadu_ps(&batch.qy[i]);
+                const __m256 z = _mm256_loadu_ps(&batch.qz[i]), w = _mm256_loadu_ps(&batch.qw[i]);
+                const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+                const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+                const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+                const __m256 r00 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+                const __m256 r01 = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+                const __m256 r02 = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+                const __m256 r10 = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+                const __m256 r11 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+                const __m256 r12 = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+                const __m256 r20 = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+                const __m256 r21 = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+                const __m256 r22 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+
+                const __m256 scaleX = _mm256_loadu_ps(&batch.sx[i]), scaleY = _mm256_loadu_ps(&batch.sy[i]), scaleZ = _mm256_loadu_ps(&batch.sz[i]);
+                storeColumnAvx2(models + i, 0, _mm256_mul_ps(r00, scaleX), _mm256_mul_ps(r01, scaleX), _mm256_mul_ps(r02, scaleX), zero);
+                storeColumnAvx2(models + i, 1, _mm256_mul_ps(r10, scaleY), _mm256_mul_ps(r11, scaleY), _mm256_mul_ps(r12, scaleY), zero);
+                storeColumnAvx2(models + i, 2, _mm256_mul_ps(r20, scaleZ), _mm256_mul_ps(r21, scaleZ), _mm256_mul_ps(r22, scaleZ), zero);
+                storeColumnAvx2(models + i, 3, _mm256_loadu_ps(&batch.px[i]), _mm256_loadu_ps(&batch.py[i]), _mm256_loadu_ps(&batch.pz[i]), one);
+                if (normals) {
+                    const __m256 inverseX = _mm256_div_ps(one, scaleX), inverseY = _mm256_div_ps(one, scaleY), inverseZ = _mm256_div_ps(one, scaleZ);
+                    storeColumnAvx2(normals + i, 0, _mm256_mul_ps(r00, inverseX), _mm256_mul_ps(r01, inverseX), _mm256_mul_ps(r02, inverseX), zero);
+                    storeColumnAvx2(normals + i, 1, _mm256_mul_ps(r10, inverseY), _mm256_mul_ps(r11, inverseY), _mm256_mul_ps(r12, inverseY), zero);
+                    storeColumnAvx2(normals + i, 2, _mm256_mul_ps(r20, inverseZ), _mm256_mul_ps(r21, inverseZ), _mm256_mul_ps(r22, inverseZ), zero);
+                    storeColumnAvx2(normals + i, 3, zero, zero, zero, one);
+                }
+            }
+            // so the sse code after this doesn't pay for switching out of avx
+            _mm256_zeroupper();
+            buildSse(batch, i, end, models, normals);
+        }
+#endif
+
+    private:
+
+        using Kernel = void (*)(const TransformBatch &, size_t, size_t, glm::mat4 *, glm::mat4 *);
+
+        static Kernel kernel() {
+#ifdef TRANSFORM_BATCH_USE_SSE
+            static const Kernel chosen = hasAvx2() ? buildAvx2 : buildSse;
+            return chosen;
+#else
+            return buildScalar;
+#endif
+        }
+
+#ifdef TRANSFORM_BATCH_USE_SSE
+        static bool hasAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+            static const bool supported = __builtin_cpu_supports("avx2");
+#else
+            // avx2 on the cpu, and the os saving the ymm registers on context switches
+            static const bool supported = [] {
+                int info[4];
+                __cpuid(info, 1);
+                if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+                    return false;
+                }
+                __cpuidex(info, 7, 0);
+                return (info[1] & (1 << 5)) != 0;
+            }();
+#endif
+            return supported;
+        }
+
+        // x, y, z and w are one column's components for 4 transforms
+        static void storeColumnSse(glm::mat4 *out, const int column, __m128 x, __m128 y, __m128 z, __m128 w) {
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(&out[0][column][0], x);
+            _mm_storeu_ps(&out[1][column][0], y);
+            _mm_storeu_ps(&out[2][column][0], z);
+            _mm_storeu_ps(&out[3][column][0], w);
+        }
+
+        TRANSFORM_BATCH_AVX2 static void storeColumnAvx2(glm::mat4 *out, const int column, const __m256 x, const __m256 y, const __m256 z, const __m256 w) {
+            const __m256 xyLow = _mm256_unpacklo_ps(x, y), xyHigh = _mm256_unpackhi_ps(x, y);
+            const __m256 zwLow = _mm256_unpacklo_ps(z, w), zwHigh = _mm256_unpackhi_ps(z, w);
+            const __m256 first = _mm256_shuffle_ps(xyLow, zwLow, 0x44);
+            const __m256 second = _mm256_shuffle_ps(xyLow, zwLow, 0xee);
+            const __m256 third = _mm256_shuffle_ps(xyHigh, zwHigh, 0x44);
+            const __m256 fourth = _mm256_shuffle_ps(xyHigh, zwHigh, 0xee);
+            _mm_storeu_ps(&out[0][column][0], _mm256_castps256_ps128(first));
+            _mm_storeu_ps(&out[1][column][0], _mm256_castps256_ps128(second));
+            _mm_storeu_ps(&out[2][column][0], _mm256_castps256_ps128(third));
+            _mm_storeu_ps(&out[3][column][0], _mm256_castps256_ps128(fourth));
+            _mm_storeu_ps(&out[4][column][0], _mm256_extractf128_ps(first, 1));
+            _mm_storeu_ps(&out[5][column][0], _mm256_extractf128_ps(second, 1));
+            _mm_storeu_ps(&out[6][column][0], _mm256_extractf128_ps(third, 1));
+            _mm_storeu_ps(&out[7][column][0], _mm256_extractf128_ps(fourth, 1));
+        }
+#endif
+};
+
+#endif //TRANSFORMBATCH_H
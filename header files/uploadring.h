@@ -0,0 +1,211 @@
+#ifndef UPLOADRING_H
+#define UPLOADRING_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "profiler.h"
+
+// frames the ring is split into. the cpu writes one while the gpu may still be reading the other two, so with
+// double buffering in the driver on top it almost never has to wait on a fence
+constexpr int UPLOAD_RING_FRAMES = 3;
+// bytes each frame gets. a draw takes one uniform buffer alignment (256 on most cards), so this is ~4000 draws
+constexpr GLsizeiptr UPLOAD_RING_FRAME_SIZE = 1 << 20;
+// how long to wait on a fence before complaining and trying again, in nanoseconds
+constexpr GLuint64 UPLOAD_RING_FENCE_TIMEOUT = 1000000000;
+
+// uniform block binding points, shared by every shader that declares the blocks
+constexpr GLuint UNIFORM_BLOCK_FRAME = 0;
+constexpr GLuint UNIFORM_BLOCK_DRAW = 1;
+
+// the std140 layout of the PerFrame block in vertex_001.glsl and fragment_001.glsl
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    // a vec3 takes a whole vec4 in std140
+    glm::vec4 viewPos;
+};
+
+// the std140 layout of the PerDraw block. the normal matrix is worked out here once per draw rather than for every
+// vertex in the shader
+struct DrawUniforms {
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+    // 0 for the material's own
+    float shininess;
+    float padding[3];
+};
+
+// one big uniform buffer that per frame data (transforms, material params) is bump allocated out of and bound by
+// offset, instead of a glUniform call per value per draw. it's split into UPLOAD_RING_FRAMES regions used in turn,
+// each fenced when its frame is submitted, so the cpu never writes over anything the gpu hasn't finished with.
+// on gl 4.4 the buffer is mapped once, persistently and coherently, and written straight into. below that each
+// frame's region is mapped unsynchronized (the fence already guarantees it's free) and unmapped by flush()
+class UploadRing {
+    public:
+
+        UploadRing() {
+            GLint uniformAlignment = 256;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+            alignment = std::max<GLintptr>(uniformAlignment, 16);
+
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            const GLsizeiptr totalSize = UPLOAD_RING_FRAME_SIZE * UPLOAD_RING_FRAMES;
+            if (GLAD_GL_VERSION_4_4) {
+                const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_UNIFORM_BUFFER, totalSize, nullptr, flags);
+                mapped = static_cast<char *>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalSize, flags));
+                persistent = mapped != nullptr;
+            }
+            if (!persistent) {
+                if (GLAD_GL_VERSION_4_4) {
+                    // immutable storage can't be respecified, so start again with a plain buffer
+                    std::cout << "UPLOAD RING: persistent map failed, falling back to unsynchronized maps" << std::endl;
+                    glDeleteBuffers(1, &buffer);
+                    glGenBuffers(1, &buffer);
+                    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+                }
+                glBufferData(GL_UNIFORM_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+                mapped = nullptr;
+            }
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        UploadRing(const UploadRing &) = delete;
+        UploadRing &operator=(const UploadRing &) = delete;
+
+        ~UploadRing() {
+            for (GLsync &fence : fences) {
+                if (fence) {
+                    glDeleteSync(fence);
+                }
+            }
+            if (mapped) {
+                glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+                glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &buffer);
+        }
+
+        // moves on to the next region, waiting for the gpu if it's still reading what was written there
+        // UPLOAD_RING_FRAMES frames ago. call once per frame before allocating anything
+        void beginFrame() {
+            frame = (frame + 1) % UPLOAD_RING_FRAMES;
+            GLsync &fence = fences[frame];
+            if (fence) {
+                GLenum result = glClientWaitSync(fence, 0, 0);
+                if (result == GL_TIMEOUT_EXPIRED) {
+                    const auto start = std::chrono::steady_clock::now();
+                    do {
+                        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_RING_FENCE_TIMEOUT);
+                        if (result == GL_TIMEOUT_EXPIRED) {
+                            std::cout << "UPLOAD RING: still waiting on the gpu for frame " << frame << std::endl;
+                        }
+                    } while (result == GL_TIMEOUT_EXPIRED);
+                    const std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - start;
+                    profiler.addCounter("Upload ring stalls", 1.0);
+                    profiler.addCounter("Upload ring stall ms", waited.count());
+                }
+                if (result == GL_WAIT_FAILED) {
+                    std::cout << "UPLOAD RING: fence wait failed" << std::endl;
+                }
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+            frameStart = cursor = static_cast<GLintptr>(frame) * UPLOAD_RING_FRAME_SIZE;
+            frameEnd = frameStart + UPLOAD_RING_FRAME_SIZE;
+        }
+
+        // copies size bytes into this frame's region and returns the offset to bind them at, or -1 if the region is
+        // full (in which case nothing was copied)
+        GLintptr allocate(const void *data, const GLsizeiptr size) {
+            const GLintptr offset = (cursor + alignment - 1) / alignment * alignment;
+            if (offset + size > frameEnd) {
+                if (!overflowReported) {
+                    std::cout << "UPLOAD RING: frame region of " << UPLOAD_RING_FRAME_SIZE << " bytes is full" << std::endl;
+                    overflowReported = true;
+                }
+                profiler.addCounter("Upload ring overflows", 1.0);
+                return -1;
+            }
+
+            char *destination;
+            if (persistent) {
+                destination = mapped + offset;
+            } else {
+                if (!writeMapping) {
+                    // everything from here to the end of the region, in one map however many allocations follow
+                    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+                    writeMapping = static_cast<char *>(glMapBufferRange(GL_UNIFORM_BUFFER, offset, frameEnd - offset,
+                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+                    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+                    if (!writeMapping) {
+                        std::cout << "UPLOAD RING: failed to map the buffer" << std::endl;
+                        return -1;
+                    }
+                    writeMappingStart = offset;
+                }
+                destination = writeMapping + (offset - writeMappingStart);
+            }
+            std::memcpy(destination, data, static_cast<size_t>(size));
+            cursor = offset + size;
+            return offset;
+        }
+
+        template<typename T>
+        GLintptr push(const T &value) {
+            return allocate(&value, sizeof(T));
+        }
+
+        // binds size bytes at offset to a uniform block binding point
+        void bindUniform(const GLuint binding, const GLintptr offset, const GLsizeiptr size) const {
+            glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+        }
+
+        // makes what's been written so far visible to the gpu. call after the allocations and before the draws that
+        // read them; nothing to do when the buffer is persistently mapped, since it's coherent
+        void flush() {
+            if (writeMapping) {
+                glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+                glBindBuffer(GL_UNIFORM_BUFFER, 0);
+                writeMapping = nullptr;
+            }
+        }
+
+        // fences this frame's region. call once the last draw using it has been submitted
+        void endFrame() {
+            flush();
+            fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            profiler.setCounter("Upload ring KB", static_cast<double>(cursor - frameStart) / 1024.0);
+        }
+
+        [[nodiscard]] bool isPersistent() const {
+            return persistent;
+        }
+
+    private:
+
+        GLuint buffer = 0;
+        GLintptr alignment = 256;
+        bool persistent = false;
+        // the whole buffer, when it's persistently mapped
+        char *mapped = nullptr;
+        // the current frame's map when it isn't, starting at writeMappingStart
+        char *writeMapping = nullptr;
+        GLintptr writeMappingStart = 0;
+
+        GLsync fences[UPLOAD_RING_FRAMES] = {};
+        int frame = UPLOAD_RING_FRAMES - 1;
+        GLintptr frameStart = 0;
+        GLintptr frameEnd = 0;
+        GLintptr cursor = 0;
+        bool overflowReported = false;
+};
+
+#endif //UPLOADRING_H
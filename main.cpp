@@ -6,10 +6,38 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/ext.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include "header files/arena.h"
+#include "header files/assetpack.h"
+#include "header files/bvh.h"
 #include "header files/camera.h"
-#include "header files/entity.h"
+#include "header files/framepipeline.h"
+#include "header files/gpuprofiler.h"
+#include "header files/heightfield.h"
+#include "header files/hiz.h"
 #include "header files/model.h"
+#include "header files/occlusion.h"
+#include "header files/ibl.h"
+#include "header files/indirect.h"
+#include "header files/jobs.h"
+#include "header files/lod.h"
+#include "header files/material.h"
+#include "header files/physics.h"
+#include "header files/postprocess.h"
+#include "header files/profiler.h"
+#include "header files/scene.h"
+#include "header files/scenegraph.h"
+#include "header files/simclock.h"
+#include "header files/skybox.h"
+#include "header files/spatialhash.h"
+#include "header files/terrain.h"
+#include "header files/transformbatch.h"
+#include "header files/uploadring.h"
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
@@ -18,7 +46,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void processInput(const FrameInput &input, float step);
 
 void OrbitLight(glm::mat4 &light, glm::vec3 &lightPos, const glm::vec3 &pivotPos, float radius, int offsetMultiplier);
 
@@ -33,7 +61,10 @@ void uploadDirectionLightUniforms(Shader &shader, const glm::vec3 &direction, fl
 void uploadLightUniforms(const Shader &shader, int index, const glm::vec3 &lightPos, glm::vec3 lightColour,
     float linear, float quadratic);
 
-GLuint loadCubemapTextures(const std::vector<std::string> &faces);
+DrawUniforms makeDrawUniforms(const glm::mat4 &modelMatrix, float shininess);
+
+
+void updatePropBounds(SpatialHash &props, int prop, const Model &model, const glm::mat4 &modelMatrix);
 
 #define log(x) std::cout << x << std::endl
 
@@ -44,9 +75,9 @@ float ASPECT_RATIO = static_cast<float>(WIDTH) / static_cast<float>(HEIGHT);
 typedef glm::vec3 Vector3f;
 typedef glm::mat4 Matrix4f;
 
-double deltaTime = 0.0;
-double lastFrame = 0.0;
-double currentFrame = 0.0;
+SimClock simClock;
+// input gathered by the glfw callbacks since it was last handed to the simulation
+FrameInput polledInput;
 
 float lastScroll = 0;
 double lastX = (WIDTH) / 2.0;
@@ -61,6 +92,11 @@ Vector3f lightPos2 = glm::vec3(3.0f, 1.0f, 3.0f);
 glm::vec3 cacheCameraPos = glm::vec3(0.0f, 0.0f, 0.0f);
 Camera camera(cacheCameraPos);
 
+// how far away an item can be picked up from
+constexpr float PICK_DISTANCE = 2.0f;
+// the npc orbo's model stands on its origin, its physics capsule is centred this far above it
+const glm::vec3 NPC_ORBO_CENTRE = glm::vec3(0.0f, 0.52f, 0.0f);
+
 enum heldItem {
     NONE,
     ORBO,
@@ -76,13 +112,18 @@ int main()
     // glfw: initialize and configure
     glfwInit();
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // 4.3 for the gpu driven draw path (indirect.h), dropping back to 3.3 where the driver doesn't have it
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 4);
 
     // glfw window creation
     GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "All hail Orbo", nullptr, nullptr);
+    if (window == nullptr) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(WIDTH, HEIGHT, "All hail Orbo", nullptr, nullptr);
+    }
     if (window == nullptr)
     {
         std::cerr << "Failed to create GLFW window" << std::endl;
@@ -115,164 +156,436 @@ int main()
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
-    camera.cameraPosition = glm::vec3(0.0f, 0.0f, 0.0f);
-
     // build and compile our shader program
     Shader shader("resources/shaders/vertex.glsl", "resources/shaders/fragment.glsl"); // you can name your shader files however you like
     Shader shader_001("resources/shaders/vertex_001.glsl", "resources/shaders/fragment_001.glsl");
-    Shader screenShader("resources/shaders/postProcessVertex.glsl", "resources/shaders/postProcessFragment.glsl");
-    Shader skyboxShader("resources/shaders/skyboxVertex.glsl", "resources/shaders/skyboxFragment.glsl");
-
-    float quadVertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
-        // positions   // texCoords
-        -1.0f,  1.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f, 0.0f,
-
-        -1.0f,  1.0f,  0.0f, 1.0f,
-         1.0f, -1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f,  1.0f, 1.0f
-    };
-
-    GLuint quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
-    glBindVertexArray(quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), static_cast<void*>(nullptr));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), reinterpret_cast<void *>(2 * sizeof(float)));
 
     //makes sure that the shader is currently being used
     shader_001.use();
+    shader_001.bindUniformBlock("PerFrame", UNIFORM_BLOCK_FRAME);
+    shader_001.bindUniformBlock("PerDraw", UNIFORM_BLOCK_DRAW);
 
-    Model orboModel("resources/models/orbo/Orbo_Obj.obj");
-    Model floorTiles("resources/models/floor Tiles/tiles.obj");
-    Model trebModel("resources/models/treb/Trebushay.obj");
-    Model vecModel("resources/models/vec/Vector_001.obj");
-    Model pcModel("resources/models/pc/pc.obj");
-    Model ballModel("resources/models/ball/bally.obj");
-    Model terrainModel("resources/models/terrain/Terrain.obj");
-
-    Transform terrainTransform(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f));
-    Transform ballTransform(glm::vec3(0.0f, 1.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.25f));
-    Transform pcTransform(glm::vec3(3.0f, 0.0f, 3.0f), glm::vec3(0.0f, 4.0f, 0.0f), glm::vec3(0.5f));
-    Transform npcOrboTransform(glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.75f));
-    Transform vecTransform(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-    Transform trebTransform(glm::vec3(-2.0f, 1.75f, 9.5f), glm::vec3(0.0f, 0.01f, 0.0f), glm::vec3(0.1f));
-    Transform orbotransform(glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-    Transform floortransform(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
-
-    GLuint fbo;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, WIDTH, HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-
-    GLuint rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WIDTH, HEIGHT);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        log("failed to create framebuffer");
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    std::vector<std::string> cubeMapTexturePaths = {
-                                                    "resources/skybox/back.jpg",
-                                                "resources/skybox/left.jpg",
-                                                "resources/skybox/top.jpg",
-                                                "resources/skybox/bottom.jpg",
-                                                "resources/skybox/front.jpg",
-                                                "resources/skybox/back.jpg"
-    };
+    // per frame and per draw uniforms are written here and bound by offset
+    UploadRing uploadRing;
 
-    float skyboxVertices[] = {
-        // positions
-        -1.0f,  1.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-
-        -1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-
-        -1.0f, -1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,
-
-        -1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,
-         1.0f,  1.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,
-        -1.0f,  1.0f, -1.0f,
-
-        -1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,
-        -1.0f, -1.0f,  1.0f,
-         1.0f, -1.0f,  1.0f
+    // what's in the world and where. the json is only parsed when it changes, normally this maps its snapshot
+    Scene scene("resources/scenes/default.json");
+    // models and their textures are loaded from the pack the asset baker made of them, never from the obj and png files
+    if (!assetPack.open(ASSET_PACK_PATH)) {
+        std::cout << "ASSETS: no usable asset pack at " << ASSET_PACK_PATH << ", run AssetBaker in the project directory" << std::endl;
+    }
+    std::vector<std::unique_ptr<Model>> sceneModels;
+    for (uint32_t i = 0; i < scene.modelCount(); i++) {
+        sceneModels.push_back(std::make_unique<Model>(scene.modelPath(i)));
+    }
+    // the game below drives these entities by name, so the scene has to have every one of them
+    bool sceneComplete = scene.loaded();
+    const auto sceneEntity = [&scene, &sceneComplete](const char *name) {
+        const int index = scene.findEntity(name);
+        if (index < 0 || scene.entity(index).model < 0) {
+            std::cout << "SCENE: no entity " << name << " with a model" << std::endl;
+            sceneComplete = false;
+            return 0u;
+        }
+        return static_cast<uint32_t>(index);
     };
-    GLuint skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glBindVertexArray(skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, static_cast<void *>(nullptr));
+    const uint32_t terrainEntity = sceneEntity("terrain");
+    const uint32_t ballEntity = sceneEntity("ball");
+    const uint32_t pcEntity = sceneEntity("pc");
+    const uint32_t npcOrboEntity = sceneEntity("npcOrbo");
+    const uint32_t vecEntity = sceneEntity("vector");
+    const uint32_t trebEntity = sceneEntity("treb");
+    const uint32_t orboEntity = sceneEntity("orbo");
+    const uint32_t floorEntity = sceneEntity("floor");
+    if (!sceneComplete) {
+        glfwTerminate();
+        return -1;
+    }
+    Model &orboModel = *sceneModels[scene.entity(orboEntity).model];
+    Model &floorTiles = *sceneModels[scene.entity(floorEntity).model];
+    Model &trebModel = *sceneModels[scene.entity(trebEntity).model];
+    Model &vecModel = *sceneModels[scene.entity(vecEntity).model];
+    Model &pcModel = *sceneModels[scene.entity(pcEntity).model];
+    Model &ballModel = *sceneModels[scene.entity(ballEntity).model];
+    Model &terrainModel = *sceneModels[scene.entity(terrainEntity).model];
+
+    // start where the camera was left last time, or where the scene says on a first run
+    if (!Scene::loadCamera(SCENE_CAMERA_STATE, camera)) {
+        scene.placeCamera(camera);
+    }
+    Terrain terrain(terrainModel);
+    // every model has registered its materials by now, so their textures can go into arrays
+    materials.finalize();
+    materials.setupShader(shader_001);
+    // the sky's faces come baked out of the pack too, gl order, +X -X +Y -Y +Z -Z. they're let go of before it's closed
+    auto skyFaces = std::make_unique<BakedCubemap>(std::vector<std::string>{
+        "resources/skybox/right.jpg",
+        "resources/skybox/left.jpg",
+        "resources/skybox/top.jpg",
+        "resources/skybox/bottom.jpg",
+        "resources/skybox/front.jpg",
+        "resources/skybox/back.jpg"
+    });
+    // compresses the faces, or loads the compressed ones from resources/cache
+    Skybox skybox(*skyFaces);
+    // bakes (or loads from resources/cache) the sh irradiance and ggx prefiltered maps for the ambient lighting
+    IBL ibl(*skyFaces);
+    skyFaces.reset();
+    // everything's on the gpu (or copied out for the cpu side) now, so the pack can be unmapped
+    std::cout << "ASSETS: read " << assetPack.blobCount() << " assets, " << assetPack.readBytes() / 1024 << " KB from the pack and "
+              << assetPack.decompressedBytes() / 1024 << " KB decompressed" << std::endl;
+    assetPack.close();
+
+    // on gl 4.3 the scene's models are culled and drawn by the gpu, against last frame's depth as well as the view.
+    // the terrain keeps its own chunked path either way
+    std::optional<IndirectRenderer> indirect;
+    std::optional<HiZPyramid> hiz;
+    bool occlusionCulling = true;
+    if (IndirectRenderer::supported()) {
+        hiz.emplace();
+        indirect.emplace();
+        for (const auto &model : sceneModels) {
+            if (model.get() != &terrainModel) {
+                indirect->addModel(*model);
+            }
+        }
+        indirect->finalize();
+        materials.setupShader(indirect->shader());
+    }
+    // without it, the big occluders are rasterised on the cpu instead (occlusion.h) and what they hide never makes
+    // it into a packet. simplified up front, only when they'll be used
+    const bool cpuOcclusionCulling = !indirect;
+    OcclusionBuffer occlusionBuffer;
+    OccluderMesh terrainOccluder, pcOccluder;
+    if (cpuOcclusionCulling) {
+        terrainOccluder = OccluderMesh::fromModel(terrainModel);
+        pcOccluder = OccluderMesh::fromModel(pcModel);
+    }
 
-    GLuint cubeMapTexture = loadCubemapTextures(cubeMapTexturePaths);
+    Transform ballTransform = scene.transform(ballEntity);
+    Transform npcOrboTransform = scene.transform(npcOrboEntity);
+    // how far the npc orbo has spun on the spot since the start, and before the latest simulation step to
+    // interpolate from. it turns about its own up on top of the scene's rotation
+    float npcOrboSpin = 0.0f;
+    float npcOrboPreviousSpin = 0.0f;
+    Transform vecTransform = scene.transform(vecEntity);
+    Transform trebTransform = scene.transform(trebEntity);
+
+    // every entity's place in the world, relative to its parent's. the static ones are set here once and the moving
+    // ones each frame, and only what changed (and whatever hangs off it) has its world matrix worked out again
+    // their local matrices are built as one batch, which stays quick however many entities the scene has
+    TransformBatch entityTransforms;
+    entityTransforms.resize(scene.entityCount());
+    for (uint32_t i = 0; i < scene.entityCount(); i++) {
+        entityTransforms.set(i, scene.transform(i));
+    }
+    std::vector<glm::mat4> entityLocals(scene.entityCount());
+    entityTransforms.build(entityLocals.data());
+    SceneGraph sceneGraph;
+    std::vector<int> entityNodes(scene.entityCount());
+    for (uint32_t i = 0; i < scene.entityCount(); i++) {
+        const int parent = scene.entity(i).parent;
+        entityNodes[i] = sceneGraph.addNode(entityLocals[i], parent >= 0 ? entityNodes[parent] : -1);
+    }
+    sceneGraph.update();
+
+    // the terrain never moves, so the ground heights built from it are worked out once
+    const glm::mat4 terrainModelMat = sceneGraph.world(entityNodes[terrainEntity]);
+    Heightfield ground(terrainModel, terrainModelMat);
+
+    // picking casts a ray from the camera into this. everything goes in, not just the items, so an item behind a wall
+    // can't be grabbed through it. the ids are the heldItem each instance is, NONE for scenery
+    MeshBvh orboBvh(orboModel), floorBvh(floorTiles), trebBvh(trebModel), vecBvh(vecModel), pcBvh(pcModel), ballBvh(ballModel), terrainBvh(terrainModel);
+    SceneBvh pickScene;
+    const int orboPick = pickScene.addInstance(orboBvh, glm::mat4(1.0f), NONE);
+    const int npcOrboPick = pickScene.addInstance(orboBvh, glm::mat4(1.0f), ORBO);
+    const int ballPick = pickScene.addInstance(ballBvh, glm::mat4(1.0f), BALL);
+    const int vecPick = pickScene.addInstance(vecBvh, glm::mat4(1.0f), VECTOR);
+    const int floorPick = pickScene.addInstance(floorBvh, glm::mat4(1.0f), NONE);
+    const int trebPick = pickScene.addInstance(trebBvh, glm::mat4(1.0f), NONE);
+    const int pcPick = pickScene.addInstance(pcBvh, glm::mat4(1.0f), NONE);
+    pickScene.addInstance(terrainBvh, terrainModelMat, NONE);
+
+    // the things that can be picked up, so a key press can cheaply check there's something in reach before raycasting
+    SpatialHash props;
+    const int npcOrboProp = props.insert(glm::vec3(0.0f), glm::vec3(0.0f), ORBO);
+    const int ballProp = props.insert(glm::vec3(0.0f), glm::vec3(0.0f), BALL);
+    const int vecProp = props.insert(glm::vec3(0.0f), glm::vec3(0.0f), VECTOR);
+    std::vector<int> propsInReach;
+
+    // the props fall, roll and can be thrown. bodies are placed by the centre of their shape, which for the ball and
+    // the vector is their origin, and start turned the same way their model matrices turn them
+    PhysicsWorld physics;
+    BodyDesc ballDesc;
+    ballDesc.shape = SHAPE_SPHERE;
+    ballDesc.position = ballTransform.position;
+    ballDesc.orientation = ballTransform.rotation;
+    ballDesc.radius = ballTransform.scale.x;
+    ballDesc.mass = 0.5f;
+    ballDesc.restitution = 0.6f;
+    ballDesc.userId = BALL;
+    const int ballBody = physics.addBody(ballDesc);
+    BodyDesc vecDesc;
+    vecDesc.shape = SHAPE_BOX;
+    vecDesc.position = vecTransform.position;
+    vecDesc.orientation = vecTransform.rotation;
+    vecDesc.halfExtents = glm::vec3(0.5f, 0.05f, 0.05f) * vecTransform.scale;
+    vecDesc.mass = 1.0f;
+    vecDesc.userId = VECTOR;
+    const int vecBody = physics.addBody(vecDesc);
+    // upright whatever bumps into it, it spins on its own
+    BodyDesc npcOrboDesc;
+    npcOrboDesc.shape = SHAPE_CAPSULE;
+    npcOrboDesc.position = npcOrboTransform.position + NPC_ORBO_CENTRE;
+    npcOrboDesc.radius = 0.31f;
+    npcOrboDesc.halfHeight = 0.19f;
+    npcOrboDesc.mass = 5.0f;
+    npcOrboDesc.lockRotation = true;
+    npcOrboDesc.userId = ORBO;
+    const int npcOrboBody = physics.addBody(npcOrboDesc);
+
+    // one per drawn object, the chosen level sticks between frames for the hysteresis
+    LodState ballLod, pcLod, npcOrboLod, vecLod, trebLod, orboLod, floorLod;
+
+    // the scene renders into an hdr target from the manager, then the post processing chain takes it to the screen.
+    // targets are sized relative to the framebuffer, which on high dpi screens isn't the window size
+    glfwGetFramebufferSize(window, &WIDTH, &HEIGHT);
+    ASPECT_RATIO = static_cast<float>(WIDTH) / static_cast<float>(HEIGHT);
+    RenderTargetManager renderTargets(WIDTH, HEIGHT);
+    PostProcessChain postProcess(renderTargets);
 
     glEnable(GL_CULL_FACE);
 
-    glEnable(GL_MULTISAMPLE);
     glEnable(GL_BLEND);
 
+    // the frame runs as a two stage pipeline. the simulation thread moves everything on, works out what to draw and
+    // with which matrices, and queues that as a RenderPacket; this thread, the only one with the gl context, polls
+    // input for it and draws the packets. while one frame is drawn the next is simulated, so a frame costs about the
+    // slower of the two rather than both, for one frame more of latency
+    InputMailbox inputs;
+    BoundedQueue<RenderPacket> packets(FRAME_PIPELINE_DEPTH);
+    // the packets' draw and light lists live in these, one per packet in flight, so building one allocates nothing
+    FrameArena packetArenas[FRAME_PACKETS_IN_FLIGHT];
+    // the treb scale is edited from the ui on this thread and handed over with the input
+    glm::vec3 trebScale = trebTransform.scale;
+    // so the first frame is simulated for the real framebuffer size
+    polledInput.width = WIDTH;
+    polledInput.height = HEIGHT;
+    polledInput.trebScale = trebScale;
+    inputs.publish(polledInput);
+
+    std::thread simulation([&] {
+        // everything this thread measures goes with the packet it's building, and reaches the profiler when that packet
+        // is drawn. the gl thread resets the per frame counters on its own schedule, which isn't this thread's
+        ProfileCapture capture;
+        Profiler::captureInto(&capture);
+        for (unsigned long long packetIndex = 0;; packetIndex++) {
+            capture.clear();
+            profiler.beginCpu("Sim frame");
+            const FrameInput input = inputs.take();
+            const float viewportHeight = static_cast<float>(input.height);
+            if (input.trebScale != trebTransform.scale) {
+                trebTransform.scale = input.trebScale;
+                sceneGraph.setLocal(entityNodes[trebEntity], trebTransform.matrix());
+            }
+            camera.processMouseMovement(input.mouseDx, input.mouseDy);
+            if (input.scroll != 0.0) {
+                camera.processMouseScroll(input.scroll);
+            }
+
+            // movement, gravity and anything else that changes over time happens in fixed steps, so it comes out the
+            // same at any frame rate. rendering then draws from between the last two steps
+            const int simSteps = simClock.advance(glfwGetTime());
+            profiler.beginCpu("Simulation");
+            for (int i = 0; i < simSteps; i++) {
+                camera.beginStep();
+                npcOrboPreviousSpin = npcOrboSpin;
+
+                processInput(input, simClock.step());
+                camera.update(simClock.step(), ground.height(camera.cameraPosition.x, camera.cameraPosition.z));
+                if (item != ORBO) {
+                    npcOrboSpin += simClock.step();
+                }
+
+                // the held prop is carried in front of the camera. once let go it's dynamic again, keeping the speed
+                // it was being carried at, so it can be thrown
+                const int heldBody = item == ORBO ? npcOrboBody : item == VECTOR ? vecBody : item == BALL ? ballBody : -1;
+                for (const int body : {npcOrboBody, vecBody, ballBody}) {
+                    if (physics.isKinematic(body) != (body == heldBody)) {
+                        physics.setKinematic(body, body == heldBody);
+                    }
+                }
+                if (heldBody == npcOrboBody) {
+                    physics.moveKinematic(heldBody, camera.cameraPosition + camera.cameraFront - glm::vec3(0.0f, 0.6f, 0.0f) + NPC_ORBO_CENTRE,
+                                          physics.orientation(heldBody));
+                } else if (heldBody >= 0) {
+                    physics.moveKinematic(heldBody, camera.cameraPosition + camera.cameraFront, physics.orientation(heldBody));
+                }
+                physics.step(simClock.step(), ground);
+            }
+            profiler.endCpu("Simulation");
+            camera.interpolate(simClock.alpha());
+
+            if (in_hand && input.grab) {
+                in_hand = false;
+                item = NONE;
+            }
+            // whatever is under the crosshair within reach. the transforms are last frame's, as set below
+            propsInReach.clear();
+            if (input.grab) {
+                props.queryRadius(camera.renderPosition, PICK_DISTANCE, propsInReach);
+            }
+            if (!propsInReach.empty()) {
+                const RayHit hit = pickScene.raycast({camera.renderPosition, camera.cameraFront, PICK_DISTANCE});
+                if (hit.instance >= 0 && pickScene.userId(hit.instance) != NONE) {
+                    in_hand = true;
+                    item = static_cast<heldItem>(pickScene.userId(hit.instance));
+                }
+            }
+
+            if (input.drop) {
+                in_hand = false;
+                item = NONE;
+            }
+
+            if (!input.grab) {
+                in_hand = false;
+            }
+
+            // FRAME_PACKETS_IN_FLIGHT packets ago, which the gl thread is done with by now
+            FrameArena &packetArena = packetArenas[packetIndex % FRAME_PACKETS_IN_FLIGHT];
+            packetArena.reset();
+            RenderPacket packet(&packetArena);
+            packet.camera = camera;
+            packet.projection = glm::perspective(glm::radians(camera.zoom), static_cast<float>(input.width) / viewportHeight, 0.1f, 100.0f);
+            packet.view = camera.getViewMatrix();
+            packet.viewPos = camera.renderPosition;
+            packet.lights = {lightPos, lightPos2};
+
+            // the props are wherever the physics has them this frame
+            const Transform ballLocal(physics.renderPosition(ballBody, simClock.alpha()), physics.renderOrientation(ballBody, simClock.alpha()), ballTransform.scale);
+            sceneGraph.setLocal(entityNodes[ballEntity], ballLocal.matrix());
+
+            const Transform vecLocal(physics.renderPosition(vecBody, simClock.alpha()), physics.renderOrientation(vecBody, simClock.alpha()), vecTransform.scale);
+            sceneGraph.setLocal(entityNodes[vecEntity], vecLocal.matrix());
+
+            Transform npcOrboRender = npcOrboTransform;
+            npcOrboRender.position = physics.renderPosition(npcOrboBody, simClock.alpha()) - NPC_ORBO_CENTRE;
+            npcOrboRender.rotate(glm::mix(npcOrboPreviousSpin, npcOrboSpin, simClock.alpha()), glm::vec3(0.0f, 1.0f, 0.0f));
+            sceneGraph.setLocal(entityNodes[npcOrboEntity], npcOrboRender.matrix());
+
+            sceneGraph.update();
+
+            const glm::mat4 &orboModelMat = sceneGraph.world(entityNodes[orboEntity]);
+            pickScene.setTransform(orboPick, orboModelMat);
+            packet.draws.push_back({&orboModel, orboModelMat, scene.entity(orboEntity).shininess, selectLod(orboModel, orboLod, orboModelMat, packet.camera, viewportHeight)});
+
+            const glm::mat4 &ballModelMat = sceneGraph.world(entityNodes[ballEntity]);
+            pickScene.setTransform(ballPick, ballModelMat);
+            updatePropBounds(props, ballProp, ballModel, ballModelMat);
+            packet.draws.push_back({&ballModel, ballModelMat, scene.entity(ballEntity).shininess, selectLod(ballModel, ballLod, ballModelMat, packet.camera, viewportHeight)});
+
+            const glm::mat4 &vecModelMat = sceneGraph.world(entityNodes[vecEntity]);
+            pickScene.setTransform(vecPick, vecModelMat);
+            updatePropBounds(props, vecProp, vecModel, vecModelMat);
+            packet.draws.push_back({&vecModel, vecModelMat, scene.entity(vecEntity).shininess, selectLod(vecModel, vecLod, vecModelMat, packet.camera, viewportHeight)});
+
+            const glm::mat4 &floorModelMat = sceneGraph.world(entityNodes[floorEntity]);
+            pickScene.setTransform(floorPick, floorModelMat);
+            packet.draws.push_back({&floorTiles, floorModelMat, scene.entity(floorEntity).shininess, selectLod(floorTiles, floorLod, floorModelMat, packet.camera, viewportHeight)});
+
+            const glm::mat4 &trebModelMat = sceneGraph.world(entityNodes[trebEntity]);
+            pickScene.setTransform(trebPick, trebModelMat);
+            packet.draws.push_back({&trebModel, trebModelMat, scene.entity(trebEntity).shininess, selectLod(trebModel, trebLod, trebModelMat, packet.camera, viewportHeight)});
+
+            const glm::mat4 &pcModelMat = sceneGraph.world(entityNodes[pcEntity]);
+            pickScene.setTransform(pcPick, pcModelMat);
+            packet.draws.push_back({&pcModel, pcModelMat, scene.entity(pcEntity).shininess, selectLod(pcModel, pcLod, pcModelMat, packet.camera, viewportHeight)});
+
+            const glm::mat4 &npcOrboModelMat = sceneGraph.world(entityNodes[npcOrboEntity]);
+            pickScene.setTransform(npcOrboPick, npcOrboModelMat);
+            updatePropBounds(props, npcOrboProp, orboModel, npcOrboModelMat);
+            packet.draws.push_back({&orboModel, npcOrboModelMat, scene.entity(npcOrboEntity).shininess, selectLod(orboModel, npcOrboLod, npcOrboModelMat, packet.camera, viewportHeight)});
+
+            if (cpuOcclusionCulling) {
+                profiler.beginCpu("Occlusion culling");
+                occlusionBuffer.begin(packet.projection * packet.view);
+                occlusionBuffer.addOccluder(terrainOccluder, terrainModelMat);
+                occlusionBuffer.addOccluder(pcOccluder, pcModelMat);
+                occlusionBuffer.rasterize();
+                const size_t drawn = packet.draws.size();
+                std::erase_if(packet.draws, [&](const DrawItem &draw) {
+                    glm::vec3 min, max;
+                    draw.model->worldBounds(draw.matrix, min, max);
+                    return occlusionBuffer.occluded(min, max);
+                });
+                profiler.setCounter("Draws occlusion culled", static_cast<double>(drawn - packet.draws.size()));
+                profiler.endCpu("Occlusion culling");
+            }
+
+            // in material order, so models sharing texture arrays are drawn back to back without rebinding
+            std::sort(packet.draws.begin(), packet.draws.end(), [](const DrawItem &a, const DrawItem &b) {
+                return a.model->materialKey() < b.model->materialKey();
+            });
+
+            profiler.setCounter("Packet arena KB", static_cast<double>(packetArena.bytesReserved()) / 1024.0);
+            profiler.endCpu("Sim frame");
+            packet.profile = capture;
+
+            // waits here while the gl thread is still a packet behind
+            if (!packets.push(std::move(packet))) {
+                return;
+            }
+        }
+    });
+
+    // where each of the packet's draws landed in the upload ring, kept between frames so it doesn't reallocate
+    std::vector<GLintptr> drawUniformOffsets;
+
     // render loop
     while (!glfwWindowShouldClose(window))
     {
-        currentFrame = glfwGetTime();
-        processInput(window);
+        profiler.beginFrame();
+        gpuProfiler.beginFrame();
+        jobs.publishStats();
+#ifdef TRACK_HEAP_ALLOCATIONS
+        profiler.setCounter("Heap allocations", static_cast<double>(heapAllocations.exchange(0)));
+#endif
+        profiler.beginCpu("Frame");
+
+        glfwPollEvents();
+        FrameInput input = polledInput;
+        polledInput.mouseDx = polledInput.mouseDy = polledInput.scroll = 0.0;
+        if (!ui_mode) {
+            input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+            input.backward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+            input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+            input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+            input.jump = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+        }
+        input.grab = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+        input.drop = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+        input.width = WIDTH;
+        input.height = HEIGHT;
+        input.trebScale = trebScale;
+        inputs.publish(input);
+
+        std::optional<RenderPacket> queued;
+        profiler.beginCpu("Wait for packet");
+        if (!packets.pop(queued)) {
+            break;
+        }
+        profiler.endCpu("Wait for packet");
+        const RenderPacket &packet = *queued;
+        profiler.merge(packet.profile);
 
-        camera.update(static_cast<float>(deltaTime));
-        glm::mat4 projection = glm::perspective(glm::radians(camera.zoom), ASPECT_RATIO, 0.1f, 100.0f);
-        glm::mat4 skyView = glm::mat4(glm::mat3(camera.getViewMatrix()));
-        glm::mat4 view = camera.getViewMatrix();
+        profiler.beginCpu("Render");
+        renderTargets.setBackbufferSize(WIDTH, HEIGHT);
+        renderTargets.beginFrame();
 
-        // glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        const RenderTarget *sceneTarget = renderTargets.acquire({1.0f, HDR_COLOUR_FORMAT, true});
+        sceneTarget->bind();
+        gpuProfiler.begin("Scene");
 
         glEnable(GL_DEPTH_TEST);
         glClearColor(0.0f, 0.11f, 0.21f, 1.0f);
@@ -282,204 +595,128 @@ int main()
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        glDepthMask(GL_FALSE);
-        skyboxShader.use();
-        skyboxShader.uploadUniformMatrix4f("projection", projection);
-        skyboxShader.uploadUniformMatrix4f("view", skyView);
-        glBindVertexArray(skyboxVAO);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glDepthMask(GL_TRUE);
-
-        shader_001.use();
-        shader_001.uploadUniformMatrix4f("projection", projection);
-        shader_001.uploadUniformMatrix4f("view", view);
-        shader_001.uploadUniformVector3f("viewPos", camera.cameraFront);
-
-        uploadLightUniforms(shader_001, 0, lightPos, glm::vec3(0.7f), 0.09f, 0.032f);
-        uploadLightUniforms(shader_001, 1, lightPos2, glm::vec3(0.7f), 0.09f, 0.032f);
-
-        if (in_hand && glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-            in_hand = false;
-            item = NONE;
-        }
-        if (glm::length(vecTransform.position - camera.cameraPosition) < 2
-            && glm::dot(camera.cameraFront, glm::normalize(vecTransform.position - camera.cameraPosition)) > 0.9f
-            && glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-            in_hand = true;
-            item = VECTOR;
-        }
-
-        if (glm::length(npcOrboTransform.position - camera.cameraPosition) < 2
-            && glm::dot(camera.cameraFront, glm::normalize(npcOrboTransform.position - camera.cameraPosition)) > 0.85f
-            && glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-            in_hand = true;
-            item = ORBO;
-        }
-
-        if (glm::length(ballTransform.position - camera.cameraPosition) < 2
-            && glm::dot(camera.cameraFront, glm::normalize(ballTransform.position - camera.cameraPosition)) > 0.85f
-            && glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-            in_hand = true;
-            item = BALL;
+        // write every uniform the scene needs up front, so the fallback path maps and unmaps the ring just once
+        uploadRing.beginFrame();
+        const GLintptr frameUniforms = uploadRing.push(FrameUniforms{packet.projection, packet.view, glm::vec4(packet.viewPos, 1.0f)});
+        // the indirect path keeps its per draw data in its own instance buffer, so only the fallback needs these.
+        // the fallback culls on the cpu here, with the same sphere test the gpu path's compute shader does
+        const Frustum viewFrustum = Frustum::fromMatrix(packet.projection * packet.view);
+        drawUniformOffsets.resize(indirect ? 0 : packet.draws.size());
+        for (size_t i = 0; i < drawUniformOffsets.size(); i++) {
+            const DrawItem &draw = packet.draws[i];
+            const glm::vec4 sphere = draw.model->worldSphere(draw.matrix);
+            if (!viewFrustum.intersectsSphere(glm::vec3(sphere), sphere.w)) {
+                drawUniformOffsets[i] = -1;
+                profiler.addCounter("Draws culled", 1.0);
+                continue;
+            }
+            drawUniformOffsets[i] = uploadRing.push(makeDrawUniforms(draw.matrix, draw.shininess));
         }
-
-        //hey orbo...
-        if (item == ORBO) {
-            npcOrboTransform.position = camera.cameraPosition + camera.cameraFront - glm::vec3(0.0f, 0.6f, 0.0f);
-        } else if (item == VECTOR) {
-            vecTransform.position = camera.cameraPosition + camera.cameraFront;
-
-        } else if (item == BALL) {
-            ballTransform.position = camera.cameraPosition + camera.cameraFront;
-        } else {
-            item = NONE;
+        const GLintptr terrainUniforms = uploadRing.push(makeDrawUniforms(terrainModelMat, scene.entity(terrainEntity).shininess));
+        uploadRing.flush();
+
+        uploadRing.bindUniform(UNIFORM_BLOCK_FRAME, frameUniforms, sizeof(FrameUniforms));
+        materials.beginPass();
+        const auto setupLighting = [&](const Shader &program) {
+            program.use();
+            ibl.bind(program);
+            for (size_t i = 0; i < packet.lights.size(); i++) {
+                uploadLightUniforms(program, static_cast<int>(i), packet.lights[i], glm::vec3(0.7f), 0.09f, 0.032f);
+            }
+        };
+        // the terrain first, so it's in the depth the indirect path's second culling phase tests against
+        setupLighting(shader_001);
+        if (terrainUniforms >= 0) {
+            uploadRing.bindUniform(UNIFORM_BLOCK_DRAW, terrainUniforms, sizeof(DrawUniforms));
+            terrain.draw(shader_001, terrainModelMat, packet.projection * packet.view, packet.camera, static_cast<float>(HEIGHT));
         }
-
-        if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-            in_hand = false;
-            item = NONE;
+        if (indirect) {
+            setupLighting(indirect->shader());
+            indirect->draw(packet.draws.data(), packet.draws.size(), packet.projection * packet.view, occlusionCulling ? &*hiz : nullptr, sceneTarget);
         }
 
-        if (item != ORBO) {
-            npcOrboTransform.rotation.y += static_cast<float>(deltaTime);
+        shader_001.use();
+        for (size_t i = 0; i < drawUniformOffsets.size(); i++) {
+            // -1 if it was culled, or if the ring ran out of room, which it reports itself
+            if (drawUniformOffsets[i] < 0) {
+                continue;
+            }
+            uploadRing.bindUniform(UNIFORM_BLOCK_DRAW, drawUniformOffsets[i], sizeof(DrawUniforms));
+            packet.draws[i].model->draw(shader_001, packet.draws[i].lod);
         }
-
-        if (glfwGetKey(window, GLFW_KEY_E) == GLFW_RELEASE) {
-            in_hand = false;
+        // last, so it's only shaded where the depth buffer was left at the far plane
+        skybox.draw(packet.projection, packet.view);
+        uploadRing.endFrame();
+        gpuProfiler.end();
+
+        // next frame's occluders, from everything that was drawn. built even with the culling off, so turning it back on
+        // never tests against an old frame
+        if (hiz) {
+            gpuProfiler.begin("Hi-Z build");
+            hiz->build(*sceneTarget, packet.projection * packet.view);
+            gpuProfiler.end();
         }
 
-        glm::mat4 orboModelMat = glm::mat4(1.0f);
-        orboModelMat = glm::translate(orboModelMat, orbotransform.position);
-        orboModelMat = glm::scale(orboModelMat, orbotransform.scale);
-        orboModelMat = glm::rotate(orboModelMat, 1.0f, orbotransform.rotation);
-        orboModelMat = glm::rotate(orboModelMat, orbotransform.rotation.x, orbotransform.rotation);
-        orboModelMat = glm::rotate(orboModelMat, orbotransform.rotation.y, orbotransform.rotation);
-        orboModelMat = glm::rotate(orboModelMat, orbotransform.rotation.z, orbotransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 16);
-        shader_001.uploadUniformMatrix4f("model", orboModelMat);
-        orboModel.draw(shader_001);
-
-        glm::mat4 ballModelMat = glm::mat4(1.0f);
-        ballModelMat = glm::translate(ballModelMat, ballTransform.position);
-        ballModelMat = glm::scale(ballModelMat, ballTransform.scale);
-        ballModelMat = glm::rotate(ballModelMat, 1.0f, ballTransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 16);
-        shader_001.uploadUniformMatrix4f("model", ballModelMat);
-        ballModel.draw(shader_001);
-
-        glm::mat4 vecModelMat = glm::mat4(1.0f);
-        vecModelMat = glm::translate(vecModelMat, vecTransform.position);
-        vecModelMat = glm::scale(vecModelMat, vecTransform.scale);
-        vecModelMat = glm::rotate(vecModelMat, 1.0f, vecTransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 4);
-        shader_001.uploadUniformMatrix4f("model", vecModelMat);
-        vecModel.draw(shader_001);
-
-        glm::mat4 floorModelMat = glm::mat4(1.0f);
-        floorModelMat = glm::translate(floorModelMat, floortransform.position);
-        floorModelMat = glm::scale(floorModelMat, floortransform.scale);
-        floorModelMat = glm::rotate(floorModelMat, 1.0f, floortransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 32);
-        shader_001.uploadUniformMatrix4f("model", floorModelMat);
-        floorTiles.draw(shader_001);
-
-        glm::mat4 trebModelMat = glm::mat4(1.0f);
-        trebModelMat = glm::translate(trebModelMat, trebTransform.position);
-        trebModelMat = glm::scale(trebModelMat, trebTransform.scale);
-        trebModelMat = glm::rotate(trebModelMat, 1.0f, trebTransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 4);
-        shader_001.uploadUniformMatrix4f("model", trebModelMat);
-        trebModel.draw(shader_001);
-
-        glm::mat4 pcModelMat = glm::mat4(1.0f);
-        pcModelMat = glm::translate(pcModelMat, pcTransform.position);
-        pcModelMat = glm::scale(pcModelMat, pcTransform.scale);
-        pcModelMat = glm::rotate(pcModelMat, 1.0f, pcTransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 32);
-        shader_001.uploadUniformMatrix4f("model", pcModelMat);
-        pcModel.draw(shader_001);
-
-        glm::mat4 npcOrboModelMat = glm::mat4(1.0f);
-        npcOrboModelMat = glm::translate(npcOrboModelMat, npcOrboTransform.position);
-        npcOrboModelMat = glm::scale(npcOrboModelMat, npcOrboTransform.scale);
-        npcOrboModelMat = glm::rotate(npcOrboModelMat, npcOrboTransform.rotation.x, npcOrboTransform.rotation);
-        npcOrboModelMat = glm::rotate(npcOrboModelMat, npcOrboTransform.rotation.y, npcOrboTransform.rotation);
-        npcOrboModelMat = glm::rotate(npcOrboModelMat, npcOrboTransform.rotation.z, npcOrboTransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 64);
-        shader_001.uploadUniformMatrix4f("model", npcOrboModelMat);
-        orboModel.draw(shader_001);
-
-        glm::mat4 terrainModelMat = glm::mat4(1.0f);
-        terrainModelMat = glm::translate(terrainModelMat, terrainTransform.position);
-        terrainModelMat = glm::scale(terrainModelMat, terrainTransform.scale);
-        terrainModelMat = glm::rotate(terrainModelMat, 1.0f, terrainTransform.rotation);
-        shader_001.uploadUniformFloat("shininess", 4);
-        shader_001.uploadUniformMatrix4f("model", terrainModelMat);
-        terrainModel.draw(shader_001);
-        //
-        // // now bind back to default framebuffer and draw a quad plane with the attached framebuffer colour texture
-        // glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
-        // // clear all relevant buffers
-        // glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // set clear colour to white (not really necessary actually, since we won't be able to see behind the quad anyways)
-        // glClear(GL_COLOR_BUFFER_BIT);
-        //
-        // screenShader.use();
-        // screenShader.uploadUniformFloat("time", (float)glfwGetTime());
-        // screenShader.uploadUniformFloat("distance", glm::distance(npcOrboTransform.position, camera.cameraPosition));
-        // glBindVertexArray(quadVAO);
-        // glBindTexture(GL_TEXTURE_2D, texture);	// use the colour attachment texture as the texture of the quad plane
-        // glDrawArrays(GL_TRIANGLES, 0, 6);
+        // tonemap, bloom, fxaa and so on, ending up in the default framebuffer
+        postProcess.execute(sceneTarget->colour);
+        renderTargets.release(sceneTarget);
 
         ImGui::Begin("Hello ImGui!");
         ImGui::Text("This is text!");
-        ImGui::SliderFloat("Trebushay scale X", &trebTransform.scale.x, 0.0f, 1.0f);
-        ImGui::SliderFloat("Trebushay scale Y", &trebTransform.scale.y, 0.0f, 1.0f);
-        ImGui::SliderFloat("Trebushay scale Z", &trebTransform.scale.z, 0.0f, 1.0f);
+        ImGui::SliderFloat("Trebushay scale X", &trebScale.x, 0.0f, 1.0f);
+        ImGui::SliderFloat("Trebushay scale Y", &trebScale.y, 0.0f, 1.0f);
+        ImGui::SliderFloat("Trebushay scale Z", &trebScale.z, 0.0f, 1.0f);
+        // flip it to see what it saves in the scene pass's gpu time
+        if (hiz) {
+            ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+        }
         ImGui::End();
 
+        drawProfilerWindow();
+        postProcess.drawWindow();
+
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        renderTargets.endFrame();
+        profiler.endCpu("Render");
 
-        lastFrame = glfwGetTime();
-        deltaTime = lastFrame - currentFrame;
+        glfwSwapBuffers(window);
+        profiler.endCpu("Frame");
     }
 
+    // let the simulation out of a push it might be waiting in, and wait for it to stop touching the scene
+    packets.close();
+    simulation.join();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    ofstream cachePosFile("orbo.txt");
-    cachePosFile << std::to_string(camera.cameraPosition.x) + " , " << std::to_string(camera.cameraPosition.y) + " , " << std::to_string(camera.cameraPosition.z);
+    Scene::saveCamera(SCENE_CAMERA_STATE, camera);
 
     glfwDestroyWindow(window);
     glfwTerminate();
-    glDeleteFramebuffers(1, &fbo);
     return 0;
 }
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void processInput(GLFWwindow *window)
+// process all input: react to the keys the gl thread saw pressed this frame
+// called once per simulation step, so held keys move the camera the same distance at any frame rate
+void processInput(const FrameInput &input, const float step)
 {
-    if (!ui_mode) {
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-            camera.processKeyboard(FORWARD, deltaTime);
-        }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-            camera.processKeyboard(BACKWARD, deltaTime);
-        }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            camera.processKeyboard(RIGHT, deltaTime);
-        }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            camera.processKeyboard(LEFT, deltaTime);
-        }
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-            camera.processKeyboard(JUMP, deltaTime);
-        }
+    if (input.forward) {
+        camera.processKeyboard(FORWARD, step);
+    }
+    if (input.backward) {
+        camera.processKeyboard(BACKWARD, step);
+    }
+    if (input.right) {
+        camera.processKeyboard(RIGHT, step);
+    }
+    if (input.left) {
+        camera.processKeyboard(LEFT, step);
+    }
+    if (input.jump) {
+        camera.processKeyboard(JUMP, step);
     }
 }
 
@@ -508,6 +745,13 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
     std::cout << "Frame buffer size: " << width << ", " << height << std::endl;
+
+    // minimising reports 0x0, keep the last real size so the aspect ratio doesn't blow up
+    if (width > 0 && height > 0) {
+        WIDTH = width;
+        HEIGHT = height;
+        ASPECT_RATIO = static_cast<float>(WIDTH) / static_cast<float>(HEIGHT);
+    }
 }
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 
@@ -521,13 +765,15 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     lastX = xpos;
     lastY = ypos;
 
+    // the camera belongs to the simulation thread, so the movement waits in polledInput until the next hand over
     if (!ui_mode) {
-        camera.processMouseMovement(mouseDx, mouseDy);
+        polledInput.mouseDx += mouseDx;
+        polledInput.mouseDy += mouseDy;
     }
 }
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    camera.processMouseScroll(yoffset);
+    polledInput.scroll += yoffset;
 }
 void OrbitLight(glm::mat4 &light, glm::vec3 &lightPos, const glm::vec3 &pivotPos, const float radius, const float offsetMultiplier) {
 
@@ -546,33 +792,58 @@ void createSpotLight(const Shader &shader, const int index, const glm::vec3 &lig
     const float ambientStrength, const glm::vec3 lightColour, const float cutOffAngle, const float outerCutOffAngle,
     const float linear, const float quadratic) {
 
-    shader.uploadUniformVector3f("spotlights[" + std::to_string(index) + "].parentLight.position", lightPos);
-    shader.uploadUniformVector3f("spotlights[" + std::to_string(index) + "].direction", lightDirection);
-    shader.uploadUniformFloat("spotlights[" + std::to_string(index) + "].parentLight.ambientStrength", ambientStrength);
-    shader.uploadUniformVector3f("spotlights[" + std::to_string(index) + "].parentLight.colour", lightColour);
-    shader.uploadUniformFloat("spotlights[" + std::to_string(index) + "].cutOffAngle", cutOffAngle);
-    shader.uploadUniformFloat("spotlights[" + std::to_string(index) + "].outerCutOffAngle", outerCutOffAngle);
-    shader.uploadUniformFloat("spotlights[" + std::to_string(index) + "].attenuation.linear", linear);
-    shader.uploadUniformFloat("spotlights[" + std::to_string(index) + "].attenuation.quadratic", quadratic);
+    // built in place on the stack, rather than a few std::strings per uniform
+    char name[64];
+    const auto member = [&](const char *field) {
+        std::snprintf(name, sizeof(name), "spotlights[%d].%s", index, field);
+        return name;
+    };
+    shader.uploadUniformVector3f(member("parentLight.position"), lightPos);
+    shader.uploadUniformVector3f(member("direction"), lightDirection);
+    shader.uploadUniformFloat(member("parentLight.ambientStrength"), ambientStrength);
+    shader.uploadUniformVector3f(member("parentLight.colour"), lightColour);
+    shader.uploadUniformFloat(member("cutOffAngle"), cutOffAngle);
+    shader.uploadUniformFloat(member("outerCutOffAngle"), outerCutOffAngle);
+    shader.uploadUniformFloat(member("attenuation.linear"), linear);
+    shader.uploadUniformFloat(member("attenuation.quadratic"), quadratic);
 }
 void uploadPointLightUniforms(const Shader &shader, const int index, const Vector3f &lightPos, const float ambientStrength,
     const Vector3f lightColour, const float linear, const float quadratic) {
 
-    shader.uploadUniformVector3f("pointLights[" + std::to_string(index) + "].parentLight.position", lightPos);
-    shader.uploadUniformVector3f("pointLights[" + std::to_string(index) + "].parentLight.colour", lightColour);
-    shader.uploadUniformFloat("pointLights[" + std::to_string(index) + "].parentLight.ambientStrength", ambientStrength);
-    shader.uploadUniformFloat("pointLights[" + std::to_string(index) + "].attenuation.linear", linear);
-    shader.uploadUniformFloat("pointLights[" + std::to_string(index) + "].attenuation.quadratic", quadratic);
+    char name[64];
+    const auto member = [&](const char *field) {
+        std::snprintf(name, sizeof(name), "pointLights[%d].%s", index, field);
+        return name;
+    };
+    shader.uploadUniformVector3f(member("parentLight.position"), lightPos);
+    shader.uploadUniformVector3f(member("parentLight.colour"), lightColour);
+    shader.uploadUniformFloat(member("parentLight.ambientStrength"), ambientStrength);
+    shader.uploadUniformFloat(member("attenuation.linear"), linear);
+    shader.uploadUniformFloat(member("attenuation.quadratic"), quadratic);
 }
 void uploadLightUniforms(const Shader &shader, const int index, const glm::vec3 &lightPos, const glm::vec3 lightColour,
     const float linear, const float quadratic) {
 
-    shader.uploadUniformVector3f("lights[" + std::to_string(index) + "].position", lightPos);
-    shader.uploadUniformVector3f("lights[" + std::to_string(index) + "].colour", lightColour);
-    shader.uploadUniformFloat("lights[" + std::to_string(index) + "].linear", linear);
-    shader.uploadUniformFloat("lights[" + std::to_string(index) + "].quadratic", quadratic);
+    char name[64];
+    const auto member = [&](const char *field) {
+        std::snprintf(name, sizeof(name), "lights[%d].%s", index, field);
+        return name;
+    };
+    shader.uploadUniformVector3f(member("position"), lightPos);
+    shader.uploadUniformVector3f(member("colour"), lightColour);
+    shader.uploadUniformFloat(member("linear"), linear);
+    shader.uploadUniformFloat(member("quadratic"), quadratic);
+}
+
+DrawUniforms makeDrawUniforms(const glm::mat4 &modelMatrix, const float shininess) {
+    DrawUniforms uniforms{};
+    uniforms.model = modelMatrix;
+    uniforms.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(modelMatrix))));
+    uniforms.shininess = shininess;
+    return uniforms;
 }
 
+
 void uploadDirectionLightUniforms(const Shader &shader, const glm::vec3 &direction, const float ambientStrength,
     const glm::vec3 lightColour) {
 
@@ -581,29 +852,26 @@ void uploadDirectionLightUniforms(const Shader &shader, const glm::vec3 &directi
     shader.uploadUniformFloat("directionLight.parentLight.ambientStrength", ambientStrength);
 
 }
-GLuint loadCubemapTextures(const std::vector<std::string> &faces) {
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrComponents;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        if (unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrComponents, 0)) {
+void updatePropBounds(SpatialHash &props, const int prop, const Model &model, const glm::mat4 &modelMatrix) {
+    glm::vec3 min, max;
+    model.worldBounds(modelMatrix, min, max);
+    props.update(prop, min, max);
+}
 
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
+#ifdef TRACK_HEAP_ALLOCATIONS
+// counts every global allocation for the "Heap allocations" counter. the rest of operator new's family (arrays,
+// nothrow) ends up here too, and the default operator delete frees what malloc gave back
+void *operator new(const std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
\ No newline at end of file
+    throw std::bad_alloc();
+}
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+#endif
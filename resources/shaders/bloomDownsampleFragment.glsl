@@ -0,0 +1,19 @@
+#version 330 core
+
+in vec2 TexCoords;
+out vec4 FragColour;
+
+uniform sampler2D source;
+uniform vec2 texelSize;
+
+// dual filter downsample: the centre plus the four diagonal corners, each corner tap is bilinear so it averages 4 texels
+void main()
+{
+    vec3 colour = texture(source, TexCoords).rgb * 4.0f;
+    colour += texture(source, TexCoords - texelSize).rgb;
+    colour += texture(source, TexCoords + texelSize).rgb;
+    colour += texture(source, TexCoords + vec2(texelSize.x, -texelSize.y)).rgb;
+    colour += texture(source, TexCoords - vec2(texelSize.x, -texelSize.y)).rgb;
+
+    FragColour = vec4(colour / 8.0f, 1.0f);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+in vec2 TexCoords;
+out vec4 FragColour;
+
+uniform sampler2D source;
+uniform vec2 texelSize;
+uniform float threshold;
+uniform float knee;
+
+// downsamples to half res and keeps only what is brighter than the threshold, with a soft knee so the cut off
+// doesn't show up as a hard edge
+void main()
+{
+    vec3 colour = texture(source, TexCoords).rgb * 4.0f;
+    colour += texture(source, TexCoords - texelSize).rgb;
+    colour += texture(source, TexCoords + texelSize).rgb;
+    colour += texture(source, TexCoords + vec2(texelSize.x, -texelSize.y)).rgb;
+    colour += texture(source, TexCoords - vec2(texelSize.x, -texelSize.y)).rgb;
+    colour /= 8.0f;
+
+    float brightness = max(colour.r, max(colour.g, colour.b));
+    float soft = clamp(brightness - threshold + knee, 0.0f, 2.0f * knee);
+    soft = soft * soft / (4.0f * knee + 0.0001f);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 0.0001f);
+
+    FragColour = vec4(colour * contribution, 1.0f);
+}
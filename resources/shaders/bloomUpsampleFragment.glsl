@@ -0,0 +1,26 @@
+#version 330 core
+
+in vec2 TexCoords;
+out vec4 FragColour;
+
+uniform sampler2D source;
+uniform vec2 texelSize;
+uniform float radius;
+
+// 3x3 tent filter, blended additively onto the next level up
+void main()
+{
+    vec2 offset = texelSize * radius;
+
+    vec3 colour = texture(source, TexCoords).rgb * 4.0f;
+    colour += texture(source, TexCoords + vec2(-offset.x, 0.0f)).rgb * 2.0f;
+    colour += texture(source, TexCoords + vec2( offset.x, 0.0f)).rgb * 2.0f;
+    colour += texture(source, TexCoords + vec2(0.0f, -offset.y)).rgb * 2.0f;
+    colour += texture(source, TexCoords + vec2(0.0f,  offset.y)).rgb * 2.0f;
+    colour += texture(source, TexCoords - offset).rgb;
+    colour += texture(source, TexCoords + offset).rgb;
+    colour += texture(source, TexCoords + vec2(offset.x, -offset.y)).rgb;
+    colour += texture(source, TexCoords + vec2(-offset.x, offset.y)).rgb;
+
+    FragColour = vec4(colour / 16.0f, 1.0f);
+}
@@ -189,7 +189,8 @@ vec3 calculateSpotLight(SpotLight spotlight, vec3 normal, vec3 viewDirection, ve
 void main()
 {
     vec3 unitNormal = normalize(Normal);
-    vec3 viewDirection = normalize(VertexPosWorld - viewPos);
+    // from the surface towards the camera, which is what the specular lobe is measured against
+    vec3 viewDirection = normalize(viewPos - VertexPosWorld);
 
     vec3 result = calculateDirectionalLight(directionLight, unitNormal, viewDirection);
 
@@ -207,7 +208,7 @@ void main()
     float normalizedDeviceCoords = gl_FragCoord.z * 2.0f -1;
     float linearDepth = ((2.0 * near * far) / (far + near - normalizedDeviceCoords * (far - near))) / far;
 
-    vec3 refraction = refract(viewDirection, unitNormal, 0.658);
+    vec3 refraction = refract(-viewDirection, unitNormal, 0.658);
     vec3 skyTex = vec3(texture(skybox, refraction).rgb);
     FragColour = vec4(result, 1.0);
 
@@ -3,24 +3,42 @@
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 VertexPosWorld;
+// which material, and the draw's shininess override (0 for none), from whichever vertex shader this is linked with
+flat in int MaterialIndex;
+flat in float Shininess;
 
 out vec4 FragColour;
 
-uniform sampler2D diffuseTex1;
-uniform sampler2D specularTex1;
-uniform sampler2D diffuseTex2;
-uniform sampler2D specularTex2;
-uniform sampler2D normalTex1;
-uniform sampler2D normalTex2;
-uniform sampler2D heightTex1;
-uniform sampler2D heightTex2;
+// every material, see material.h. MAX_MATERIALS has to match MATERIAL_TABLE_SIZE
+#define MAX_MATERIALS 256
+struct MaterialData {
+    // rgb used when there's no diffuse texture, a is the shininess
+    vec4 diffuse;
+    vec4 specular;
+    // x the diffuse layer, y the specular layer, -1 for none
+    ivec4 layers;
+};
+
+layout (std140) uniform Materials {
+    MaterialData materials[MAX_MATERIALS];
+};
+
+// the texture arrays the current material's textures are in
+uniform sampler2DArray diffuseMaps;
+uniform sampler2DArray specularMaps;
 
-uniform vec3 viewPos;
-uniform bool useTex;
+// filled from the upload ring, see uploadring.h. declared the same in vertex_001.glsl
+layout (std140) uniform PerFrame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
-uniform float shininess;
 
-uniform samplerCube skybox;
+// image based lighting, baked from the skybox by IBL
+uniform vec3 irradianceSH[9];
+uniform samplerCube prefilteredMap;
+uniform float prefilteredMaxLod;
 
 struct Light{
     vec3 colour;
@@ -34,17 +52,39 @@ uniform Light lights[NR_LIGHTS];
 
 vec3 calcBlinnPhong();
 
+// diffuse irradiance from the 3 band sh projection (the coefficients already have the cosine lobe and 1/pi folded in)
+vec3 irradiance(vec3 n){
+
+    return max(irradianceSH[0] * 0.282095f
+        + irradianceSH[1] * 0.488603f * n.y
+        + irradianceSH[2] * 0.488603f * n.z
+        + irradianceSH[3] * 0.488603f * n.x
+        + irradianceSH[4] * 1.092548f * n.x * n.y
+        + irradianceSH[5] * 1.092548f * n.y * n.z
+        + irradianceSH[6] * 0.315392f * (3.0f * n.z * n.z - 1.0f)
+        + irradianceSH[7] * 1.092548f * n.x * n.z
+        + irradianceSH[8] * 0.546274f * (n.x * n.x - n.y * n.y), vec3(0.0f));
+}
+
 void main()
 {
     vec3 unitNormal = normalize(Normal);
-    vec3 viewDirection = normalize(VertexPosWorld - viewPos);
+    // from the surface towards the camera, which is what the specular lobe is measured against
+    vec3 viewDirection = normalize(viewPos - VertexPosWorld);
 
     vec3 result = vec3(0.0f);
 
-    vec3 ambient = vec3(texture(diffuseTex1, TexCoords)) * 0.2f;
+    MaterialData material = materials[MaterialIndex];
+    vec3 albedo = material.layers.x >= 0 ? texture(diffuseMaps, vec3(TexCoords, material.layers.x)).rgb : material.diffuse.rgb;
+    vec3 specularColour = material.layers.y >= 0 ? texture(specularMaps, vec3(TexCoords, material.layers.y)).rgb : material.specular.rgb;
+    // a draw can override the material's shininess, e.g. the same model drawn twice looking different
+    float exponent = Shininess > 0.0f ? Shininess : material.diffuse.a;
 
-    vec3 refraction = reflect(viewDirection, unitNormal);
-    vec3 skyTex = vec3(texture(skybox, refraction).rgb);
+    // blinn-phong exponent to a rough equivalent ggx roughness, which is what the prefiltered mips are laid out by
+    float roughness = sqrt(2.0f / (exponent + 2.0f));
+    vec3 reflection = reflect(-viewDirection, unitNormal);
+    vec3 ambient = albedo * irradiance(unitNormal)
+        + textureLod(prefilteredMap, reflection, roughness * prefilteredMaxLod).rgb * specularColour * 0.3f;
 
     for(int i = 0; i < NR_LIGHTS; i++){
 
@@ -55,18 +95,18 @@ void main()
         float atten = 1.0f / (1 + (lights[i].linear * distance) + (lights[i].quadratic * pow(distance, 2)));
 
         float diff = max(dot(unitNormal, unitLightDirection), 0.0f);
-        float spec = pow(max(dot(viewDirection, specularReflectDirection), 0.0f), shininess);
+        float spec = pow(max(dot(viewDirection, specularReflectDirection), 0.0f), exponent);
 
-        vec3 diffuse  = lights[i].colour * diff * (vec3(texture(diffuseTex1, TexCoords)));
-        vec3 specular = spec * vec3(texture(specularTex1, TexCoords)) * 0.3f;
+        vec3 diffuse  = lights[i].colour * diff * albedo;
+        vec3 specular = spec * specularColour * 0.3f;
 
 
         diffuse *= atten;
         specular *= atten;
 
-        result += (diffuse + specular + ambient);
+        result += (diffuse + specular);
     }
-
+    result += ambient;
 
 
     FragColour = vec4(result, 1.0f);
@@ -0,0 +1,47 @@
+#version 330 core
+
+in vec2 TexCoords;
+out vec4 FragColour;
+
+uniform sampler2D source;
+uniform vec2 texelSize;
+
+#define FXAA_REDUCE_MIN (1.0f / 128.0f)
+#define FXAA_REDUCE_MUL (1.0f / 8.0f)
+#define FXAA_SPAN_MAX 8.0f
+
+float luma(vec3 colour)
+{
+    return dot(colour, vec3(0.299f, 0.587f, 0.114f));
+}
+
+// the low quality variant of fxaa: finds the local edge direction from the 4 diagonal neighbours, blurs along it and
+// throws the wider blur away if it picked up something from outside the local contrast range
+void main()
+{
+    vec3 colourM = texture(source, TexCoords).rgb;
+    float lumaNW = luma(textureOffset(source, TexCoords, ivec2(-1,  1)).rgb);
+    float lumaNE = luma(textureOffset(source, TexCoords, ivec2( 1,  1)).rgb);
+    float lumaSW = luma(textureOffset(source, TexCoords, ivec2(-1, -1)).rgb);
+    float lumaSE = luma(textureOffset(source, TexCoords, ivec2( 1, -1)).rgb);
+    float lumaM  = luma(colourM);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 direction;
+    direction.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    direction.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float directionReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25f * FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+    float inverseDirectionMin = 1.0f / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * inverseDirectionMin, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * texelSize;
+
+    vec3 colourA = 0.5f * (texture(source, TexCoords + direction * (1.0f / 3.0f - 0.5f)).rgb
+                         + texture(source, TexCoords + direction * (2.0f / 3.0f - 0.5f)).rgb);
+    vec3 colourB = colourA * 0.5f + 0.25f * (texture(source, TexCoords - direction * 0.5f).rgb
+                                           + texture(source, TexCoords + direction * 0.5f).rgb);
+
+    float lumaB = luma(colourB);
+    FragColour = vec4((lumaB < lumaMin || lumaB > lumaMax) ? colourA : colourB, 1.0f);
+}
@@ -1,11 +1,11 @@
 #version 330 core
-layout (location = 0) in vec2 aPos;
-layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+// one triangle that covers the whole screen, built from gl_VertexID so no vertex buffer is needed
 void main()
 {
-    TexCoords = aTexCoords;
-    gl_Position = vec4(aPos.x, aPos.y, 0.0f, 1.0f);
-}
\ No newline at end of file
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = position;
+    gl_Position = vec4(position * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -1,14 +1,15 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-
+// one triangle big enough to cover the screen, sat on the far plane so it only lands where nothing else was drawn.
+// the direction through each corner comes from the inverse view projection, with the camera's position left out
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+uniform mat4 inverseViewProjection;
 
 void main() {
 
-    TexCoords = aPos;
-    gl_Position = projection * view * vec4(aPos, 1.0f);
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0f - 1.0f;
+    // the far plane's xyz before the divide is still a direction, and stays linear across the screen to interpolate
+    TexCoords = (inverseViewProjection * vec4(position, 1.0f, 1.0f)).xyz;
+    gl_Position = vec4(position, 1.0f, 1.0f);
 }
@@ -0,0 +1,29 @@
+#version 330 core
+
+in vec2 TexCoords;
+out vec4 FragColour;
+
+uniform sampler2D source;
+uniform sampler2D bloomTexture;
+uniform bool useBloom;
+uniform float bloomIntensity;
+uniform float exposure;
+
+// narkowicz's fit of the aces filmic curve
+vec3 aces(vec3 x)
+{
+    return clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+void main()
+{
+    vec3 colour = texture(source, TexCoords).rgb;
+    if(useBloom){
+        colour += texture(bloomTexture, TexCoords).rgb * bloomIntensity;
+    }
+
+    colour = aces(colour * exposure);
+    colour = pow(colour, vec3(1.0f / 2.2f));
+
+    FragColour = vec4(colour, 1.0f);
+}
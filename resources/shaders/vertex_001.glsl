@@ -7,16 +7,32 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 VertexPosWorld;
+// the same for the whole draw. vertex_indirect.glsl fills these per instance instead
+flat out int MaterialIndex;
+flat out float Shininess;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// filled from the upload ring, see uploadring.h. declared the same in fragment_001.glsl
+layout (std140) uniform PerFrame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
+layout (std140) uniform PerDraw {
+    mat4 model;
+    mat4 normalMatrix;
+    float shininess;
+};
+
+// the material's slot in the table, see material.h
+uniform int materialIndex;
 
 void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     TexCoords = aTexCoords;
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = mat3(normalMatrix) * aNormal;
     VertexPosWorld = vec3(model * vec4(aPos, 1.0f));
+    MaterialIndex = materialIndex;
+    Shininess = shininess;
 }
\ No newline at end of file
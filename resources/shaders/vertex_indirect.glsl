@@ -0,0 +1,46 @@
+#version 430 core
+// vertex_001.glsl for the indirect path: everything per draw comes from the instance buffer instead, see indirect.h
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// which instance this is, from the culled list. it advances once per instance, from the command's baseInstance
+layout (location = 3) in uint aInstance;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 VertexPosWorld;
+flat out int MaterialIndex;
+flat out float Shininess;
+
+// filled from the upload ring, see uploadring.h. declared the same in fragment_001.glsl
+layout (std140) uniform PerFrame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// the std430 layout of IndirectInstance, declared the same in cull.comp
+struct Instance {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 sphere;
+    uint command;
+    int materialIndex;
+    float shininess;
+    float padding;
+};
+
+layout (std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+void main()
+{
+    mat4 model = instances[aInstance].model;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    TexCoords = aTexCoords;
+    Normal = mat3(instances[aInstance].normalMatrix) * aNormal;
+    VertexPosWorld = vec3(model * vec4(aPos, 1.0f));
+    MaterialIndex = instances[aInstance].materialIndex;
+    Shininess = instances[aInstance].shininess;
+}
@@ -0,0 +1,186 @@
+// runs the simulation side of a frame the way main.cpp's simulation thread does, over and over, counting global heap
+// allocations. once it has warmed up (arenas grown to fit, vectors at their high water mark) a frame that isn't doing
+// anything new shouldn't make any. the gl thread's half needs a window and the real assets, so that one is only
+// watched live in the game with TRACK_HEAP_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#include "arena.h"
+#include "bvh.h"
+#include "framepipeline.h"
+#include "jobs.h"
+#include "physics.h"
+#include "profiler.h"
+#include "scenegraph.h"
+#include "spatialhash.h"
+#include "testing.h"
+
+namespace {
+    std::atomic<unsigned long long> allocations{0};
+}
+
+// every global allocation, arrays and nothrow included, ends up here
+void *operator new(const std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// long enough for the resting props to fall asleep and the circling ones to have been round a few times
+constexpr int WARM_UP_FRAMES = 150;
+constexpr int MEASURED_FRAMES = 200;
+constexpr int PROPS = 64;
+// frames for a circling prop to go once round
+constexpr int LAP = 30;
+constexpr float STEP = 1.0f / 60.0f;
+
+namespace {
+
+    std::vector<glm::vec3> cubePositions() {
+        std::vector<glm::vec3> positions;
+        for (int corner = 0; corner < 8; corner++) {
+            positions.emplace_back((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f, (corner & 4) ? 0.5f : -0.5f);
+        }
+        return positions;
+    }
+
+    const std::vector<unsigned int> CUBE_INDICES = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                                    2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+}
+
+int main() {
+    // the world, built once like at load
+    std::vector<glm::vec3> groundPositions;
+    std::vector<unsigned int> groundIndices;
+    for (int z = 0; z <= 32; z++) {
+        for (int x = 0; x <= 32; x++) {
+            groundPositions.emplace_back(static_cast<float>(x) - 16.0f, 0.0f, static_cast<float>(z) - 16.0f);
+        }
+    }
+    for (unsigned int z = 0; z < 32; z++) {
+        for (unsigned int x = 0; x < 32; x++) {
+            const unsigned int a = z * 33 + x;
+            groundIndices.insert(groundIndices.end(), {a, a + 33, a + 1, a + 1, a + 33, a + 34});
+        }
+    }
+    const Heightfield ground(groundPositions, groundIndices);
+    const MeshBvh box(cubePositions(), CUBE_INDICES);
+
+    PhysicsWorld physics;
+    SceneGraph sceneGraph;
+    SpatialHash props;
+    SceneBvh pickScene;
+    std::vector<int> bodies, nodes, proxies, picks;
+    const int root = sceneGraph.addNode(glm::mat4(1.0f));
+    // half of them resting on the ground, the other half circling above it, going through the same cells each lap
+    std::vector<glm::vec3> centres;
+    for (int i = 0; i < PROPS; i++) {
+        BodyDesc desc;
+        desc.shape = static_cast<ShapeType>(i % 3);
+        desc.position = glm::vec3(static_cast<float>(i % 8) * 3.0f - 12.0f, i < PROPS / 2 ? 0.3f : 3.0f, static_cast<float>(i / 8) * 3.0f - 12.0f);
+        desc.radius = 0.3f;
+        desc.halfHeight = 0.3f;
+        desc.halfExtents = glm::vec3(0.3f);
+        centres.push_back(desc.position);
+        bodies.push_back(physics.addBody(desc));
+        physics.setKinematic(bodies.back(), i >= PROPS / 2);
+        nodes.push_back(sceneGraph.addNode(glm::translate(glm::mat4(1.0f), desc.position), root));
+        proxies.push_back(props.insert(desc.position - glm::vec3(0.5f), desc.position + glm::vec3(0.5f), i));
+        picks.push_back(pickScene.addInstance(box, glm::translate(glm::mat4(1.0f), desc.position), i));
+    }
+    BoundedQueue<RenderPacket> packets(FRAME_PIPELINE_DEPTH);
+    FrameArena packetArenas[FRAME_PACKETS_IN_FLIGHT];
+    std::vector<int> propsInReach;
+    std::atomic<unsigned long long> measuredStart{0};
+
+    std::thread simulation([&] {
+        ProfileCapture capture;
+        Profiler::captureInto(&capture);
+        for (int frame = 0; frame < WARM_UP_FRAMES + MEASURED_FRAMES; frame++) {
+            if (frame == WARM_UP_FRAMES) {
+                measuredStart = allocations.load();
+            }
+            capture.clear();
+            profiler.beginCpu("Sim frame");
+
+            const float angle = 6.28318531f * static_cast<float>(frame % LAP) / LAP;
+            for (int i = PROPS / 2; i < PROPS; i++) {
+                physics.moveKinematic(bodies[i], centres[i] + 2.5f * glm::vec3(std::cos(angle), 0.0f, std::sin(angle)),
+                                      glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+            }
+            physics.step(STEP, ground);
+
+            FrameArena &packetArena = packetArenas[frame % FRAME_PACKETS_IN_FLIGHT];
+            packetArena.reset();
+            RenderPacket packet(&packetArena);
+            packet.view = glm::lookAt(glm::vec3(0.0f, 5.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            packet.lights = {glm::vec3(1.0f), glm::vec3(2.0f)};
+
+            for (int i = 0; i < PROPS; i++) {
+                const glm::mat4 matrix = glm::translate(glm::mat4(1.0f), physics.renderPosition(bodies[i], 0.5f)) *
+                                         glm::mat4_cast(physics.renderOrientation(bodies[i], 0.5f));
+                sceneGraph.setLocal(nodes[i], matrix);
+            }
+            sceneGraph.update();
+            for (int i = 0; i < PROPS; i++) {
+                const glm::mat4 &world = sceneGraph.world(nodes[i]);
+                const glm::vec3 centre(world[3]);
+                props.update(proxies[i], centre - glm::vec3(0.5f), centre + glm::vec3(0.5f));
+                pickScene.setTransform(picks[i], world);
+                packet.draws.push_back({nullptr, world, 0.0f, 0});
+            }
+
+            propsInReach.clear();
+            props.queryRadius(glm::vec3(0.0f, 1.0f, 0.0f), 3.0f, propsInReach);
+            pickScene.raycast({glm::vec3(0.0f, 5.0f, 10.0f), glm::vec3(0.0f, -0.4f, -1.0f), 20.0f});
+
+            jobs.parallelFor(static_cast<int>(packet.draws.size()), [&](const int begin, const int end) {
+                for (int i = begin; i < end; i++) {
+                    packet.draws[i].shininess = packet.draws[i].matrix[3].y;
+                }
+            });
+
+            profiler.setCounter("Packet arena KB", static_cast<double>(packetArena.bytesReserved()) / 1024.0);
+            profiler.endCpu("Sim frame");
+            packet.profile = capture;
+            if (!packets.push(std::move(packet))) {
+                return;
+            }
+        }
+        packets.close();
+    });
+
+    // the gl thread's side of the hand over, without the gl
+    int drawn = 0;
+    std::optional<RenderPacket> queued;
+    while (true) {
+        profiler.beginFrame();
+        jobs.publishStats();
+        if (!packets.pop(queued)) {
+            break;
+        }
+        profiler.merge(queued->profile);
+        drawn += static_cast<int>(queued->draws.size());
+    }
+    simulation.join();
+
+    const unsigned long long steadyState = allocations.load() - measuredStart.load();
+    std::printf("%llu allocations over %d frames after warming up\n", steadyState, MEASURED_FRAMES);
+    CHECK(steadyState == 0);
+    CHECK(drawn == (WARM_UP_FRAMES + MEASURED_FRAMES) * PROPS);
+    return testResult("allocation_test");
+}
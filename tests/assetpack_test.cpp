@@ -0,0 +1,281 @@
+// the asset pack and the lz4 blocks inside it: lz4 compression round trips on data that doesn't compress, data
+// that does and the format's edge cases (tiny blocks, long runs, matches overlapping what they copy, repeats further
+// back than a match can reach), and damaged blocks are refused rather than read past. then a pack written the way the
+// baker writes one, read back blob for blob, and damaged packs that open() or read() have to turn away
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "assetpack.h"
+#include "testing.h"
+
+namespace {
+
+    std::vector<unsigned char> randomBytes(std::mt19937 &random, const size_t size, const int alphabet = 256) {
+        std::uniform_int_distribution<int> byte(0, alphabet - 1);
+        std::vector<unsigned char> bytes(size);
+        for (unsigned char &b : bytes) {
+            b = static_cast<unsigned char>(byte(random));
+        }
+        return bytes;
+    }
+
+    // compresses and decompresses, checking the block decodes to exactly the input and only at exactly its size.
+    // returns the compressed size
+    size_t roundTrip(const char *name, const std::vector<unsigned char> &input) {
+        std::vector<unsigned char> block;
+        lz4Compress(input.data(), input.size(), block);
+        CHECK(block.size() <= lz4Bound(input.size()));
+
+        std::vector<unsigned char> output(input.size() + 1, 0xCD);
+        const bool decoded = lz4Decompress(block.data(), block.size(), output.data(), input.size());
+        const bool same = decoded && std::equal(input.begin(), input.end(), output.begin());
+        if (!same) {
+            std::printf("%s: %zu bytes didn't come back from a %zu byte block\n", name, input.size(), block.size());
+        }
+        CHECK(same);
+        // nothing past the end is written, whatever the fast copies do inside it
+        CHECK(output[input.size()] == 0xCD);
+        CHECK(!lz4Decompress(block.data(), block.size(), output.data(), input.size() + 1));
+        if (!input.empty()) {
+            CHECK(!lz4Decompress(block.data(), block.size(), output.data(), input.size() - 1));
+            CHECK(!lz4Decompress(block.data(), block.size() - 1, output.data(), input.size()));
+        }
+        return block.size();
+    }
+
+    void lz4RoundTrips() {
+        std::mt19937 random(5);
+        roundTrip("empty", {});
+        roundTrip("one byte", {42});
+        roundTrip("twelve the same", std::vector<unsigned char>(12, 7));
+        roundTrip("thirteen the same", std::vector<unsigned char>(13, 7));
+
+        // random bytes don't compress, and shouldn't cost much more than themselves stored
+        const std::vector<unsigned char> noise = randomBytes(random, 300000);
+        CHECK(roundTrip("noise", noise) <= lz4Bound(noise.size()));
+
+        // a long run is all one match, its length spilling over many 255 bytes, at close to the format's best ratio
+        const size_t zeros = roundTrip("zeros", std::vector<unsigned char>(1 << 20, 0));
+        std::printf("1 MB of zeros in %zu bytes\n", zeros);
+        CHECK(zeros < (1 << 20) / 200);
+
+        // short periods make matches that overlap the bytes they're copying
+        for (int period = 1; period <= 9; period++) {
+            std::vector<unsigned char> pattern = randomBytes(random, period);
+            std::vector<unsigned char> repeated;
+            for (int i = 0; i < 5000; i++) {
+                repeated.push_back(pattern[i % period]);
+            }
+            CHECK(roundTrip("short period", repeated) < repeated.size() / 10);
+        }
+
+        // a few symbols, so short matches everywhere and literal runs of every length between them
+        roundTrip("small alphabet", randomBytes(random, 200000, 4));
+
+        // the same 40 KB twice either side of 80 KB of noise, so the repeat is too far back for any match to reach
+        const std::vector<unsigned char> chunk = randomBytes(random, 40000);
+        std::vector<unsigned char> far = chunk;
+        const std::vector<unsigned char> gap = randomBytes(random, 80000);
+        far.insert(far.end(), gap.begin(), gap.end());
+        far.insert(far.end(), chunk.begin(), chunk.end());
+        roundTrip("repeat out of reach", far);
+        // and within reach. after that much noise the search is skipping ahead, so it may or may not be found
+        std::vector<unsigned char> near = chunk;
+        near.insert(near.end(), chunk.begin(), chunk.end());
+        roundTrip("repeat in reach", near);
+    }
+
+    // damaged blocks must come back false or decode to something, never read or write outside the buffers. the
+    // output buffer is sized exactly, so an overrun shows as a crash or a checked guard byte
+    void lz4RefusesDamage() {
+        std::mt19937 random(6);
+        std::vector<unsigned char> input = randomBytes(random, 20000, 8);
+        std::vector<unsigned char> block;
+        lz4Compress(input.data(), input.size(), block);
+        std::vector<unsigned char> output(input.size() + 1);
+        std::uniform_int_distribution<size_t> at(0, block.size() - 1);
+        std::uniform_int_distribution<int> byte(0, 255);
+        int refused = 0;
+        for (int trial = 0; trial < 2000; trial++) {
+            std::vector<unsigned char> damaged = block;
+            for (int flips = 1 + trial % 4; flips > 0; flips--) {
+                damaged[at(random)] = static_cast<unsigned char>(byte(random));
+            }
+            output[input.size()] = 0xCD;
+            refused += lz4Decompress(damaged.data(), damaged.size(), output.data(), input.size()) ? 0 : 1;
+            CHECK(output[input.size()] == 0xCD);
+        }
+        std::printf("%d of 2000 damaged blocks refused\n", refused);
+        CHECK(refused > 0);
+
+        // an offset pointing back before the start of the output
+        const unsigned char before[] = {0x10, 'a', 0x05, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a'};
+        CHECK(!lz4Decompress(before, sizeof(before), output.data(), 10));
+        // a zero offset
+        const unsigned char zero[] = {0x10, 'a', 0x00, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a'};
+        CHECK(!lz4Decompress(zero, sizeof(zero), output.data(), 10));
+        // a literal length that runs off the end of the block
+        const unsigned char runs[] = {0xF0, 0xFF, 0xFF};
+        CHECK(!lz4Decompress(runs, sizeof(runs), output.data(), 1000));
+    }
+
+    std::string packPath(const char *name) {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    std::string readFile(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    void writeFile(const std::string &path, const std::string &bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    AssetPackBlob blob(const std::string &source, const uint16_t kind, const std::vector<unsigned char> &bytes) {
+        AssetPackBlob packed;
+        packed.source = source;
+        packed.kind = kind;
+        packed.bytes.assign(bytes.begin(), bytes.end());
+        compressAssetPackBlob(packed);
+        return packed;
+    }
+
+    // blobs as the baker would have them: compressible and not, one source as two kinds of texture, out of order
+    std::vector<AssetPackBlob> testBlobs() {
+        std::mt19937 random(7);
+        std::vector<unsigned char> flat(100000, 200);
+        std::vector<AssetPackBlob> blobs;
+        blobs.push_back(blob("resources/textures/wall.png", ASSET_PACK_SRGB_TEXTURE, flat));
+        blobs.push_back(blob("resources/models/crate.obj", ASSET_PACK_MODEL, randomBytes(random, 5000)));
+        blobs.push_back(blob("resources/textures/wall.png", ASSET_PACK_TEXTURE, randomBytes(random, 70000)));
+        blobs.push_back(blob("resources/textures/sky.jpg", ASSET_PACK_SRGB_TEXTURE, randomBytes(random, 33, 2)));
+        blobs.push_back(blob("resources/models/barrel.obj", ASSET_PACK_MODEL, std::vector<unsigned char>(3, 1)));
+        return blobs;
+    }
+
+    void packRoundTrips() {
+        const std::vector<AssetPackBlob> expected = testBlobs();
+        std::vector<AssetPackBlob> blobs = expected;
+        CHECK(!blobs[0].compressed.empty());
+        CHECK(blobs[2].compressed.empty());
+
+        const std::string path = packPath("assetpack_test.pack");
+        std::string status;
+        CHECK(writeAssetPack(path, blobs, 0x1234567890ABCDEFull, status));
+        std::printf("%s\n", status.c_str());
+
+        AssetPack pack;
+        if (!CHECK(pack.open(path))) {
+            return;
+        }
+        CHECK(pack.contentKey() == 0x1234567890ABCDEFull);
+        for (const AssetPackBlob &want : expected) {
+            const bool texture = want.kind != ASSET_PACK_MODEL;
+            const AssetPack::Blob got = pack.read(want.source, texture, want.kind == ASSET_PACK_SRGB_TEXTURE);
+            const bool same = got && got.size == want.bytes.size() && std::memcmp(got.data(), want.bytes.data(), got.size) == 0;
+            if (!same) {
+                std::printf("%s (kind %d) didn't come back out of the pack\n", want.source.c_str(), want.kind);
+            }
+            CHECK(same);
+            // compressed blobs are decoded into a copy, stored ones are read in place, on the pack's alignment
+            CHECK(got.decompressed.empty() == want.compressed.empty());
+            if (got && got.decompressed.empty()) {
+                CHECK(reinterpret_cast<uintptr_t>(got.mapped) % ASSET_PACK_ALIGNMENT == 0);
+            }
+        }
+        uint64_t decompressed = 0;
+        for (const AssetPackBlob &want : expected) {
+            decompressed += want.compressed.empty() ? 0 : want.bytes.size();
+        }
+        CHECK(pack.blobCount() == expected.size());
+        CHECK(pack.decompressedBytes() == decompressed);
+
+        // lookups are by normalised path and kind
+        CHECK(static_cast<bool>(pack.read("resources/./models/crate.obj")));
+        CHECK(!pack.read("resources/models/crate.obj", true, false));
+        CHECK(!pack.read("resources/models/missing.obj"));
+        CHECK(!pack.read("resources/textures/sky.jpg", true, false));
+        pack.close();
+        CHECK(!pack.loaded());
+        CHECK(!pack.read("resources/models/crate.obj"));
+        std::filesystem::remove(path);
+    }
+
+    // a pack that's been cut short, is from another version, or has a damaged header or block
+    void damagedPacks() {
+        std::vector<AssetPackBlob> blobs = testBlobs();
+        const std::string path = packPath("assetpack_test.pack");
+        std::string status;
+        CHECK(writeAssetPack(path, blobs, 1, status));
+        const std::string good = readFile(path);
+        const std::string damagedPath = packPath("assetpack_test_damaged.pack");
+        AssetPack pack;
+
+        AssetPackHeader header{};
+        std::memcpy(&header, good.data(), sizeof(header));
+        std::vector<AssetPackEntry> entries(header.entryCount);
+        std::memcpy(entries.data(), good.data() + sizeof(header), entries.size() * sizeof(AssetPackEntry));
+
+        writeFile(damagedPath, good.substr(0, good.size() - 1));
+        CHECK(!pack.open(damagedPath));
+        writeFile(damagedPath, good.substr(0, sizeof(AssetPackHeader) - 1));
+        CHECK(!pack.open(damagedPath));
+
+        std::string damaged = good;
+        damaged[offsetof(AssetPackHeader, version)] ^= 0x7F;
+        writeFile(damagedPath, damaged);
+        CHECK(!pack.open(damagedPath));
+
+        // an entry offset big enough to wrap round when its size is added
+        damaged = good;
+        AssetPackEntry wrapping = entries[0];
+        wrapping.offset = UINT64_MAX - 8;
+        std::memcpy(damaged.data() + sizeof(header), &wrapping, sizeof(wrapping));
+        writeFile(damagedPath, damaged);
+        CHECK(!pack.open(damagedPath));
+
+        // an lz4 entry claiming to decode to far more than any block its size could
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries[i].codec == ASSET_PACK_LZ4) {
+                damaged = good;
+                AssetPackEntry huge = entries[i];
+                huge.size = huge.storedSize * 1000;
+                std::memcpy(damaged.data() + sizeof(header) + i * sizeof(AssetPackEntry), &huge, sizeof(huge));
+                writeFile(damagedPath, damaged);
+                CHECK(!pack.open(damagedPath));
+            }
+        }
+
+        // a damaged block opens (only the table of contents is checked up front) but won't read
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries[i].codec == ASSET_PACK_LZ4) {
+                damaged = good;
+                std::fill(damaged.begin() + static_cast<std::ptrdiff_t>(entries[i].offset),
+                          damaged.begin() + static_cast<std::ptrdiff_t>(entries[i].offset + entries[i].storedSize), '\xFF');
+                writeFile(damagedPath, damaged);
+                CHECK(pack.open(damagedPath));
+                const std::string source = good.data() + header.stringOffset + entries[i].source;
+                CHECK(!pack.read(source, entries[i].kind != ASSET_PACK_MODEL, entries[i].kind == ASSET_PACK_SRGB_TEXTURE));
+            }
+        }
+        pack.close();
+        std::filesystem::remove(path);
+        std::filesystem::remove(damagedPath);
+    }
+}
+
+int main() {
+    lz4RoundTrips();
+    lz4RefusesDamage();
+    packRoundTrips();
+    damagedPacks();
+    return testResult("assetpack_test");
+}
@@ -0,0 +1,41 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// what every benchmark uses. each one times a piece of work a few times and prints the best run, which is the one
+// least disturbed by whatever else the machine was doing
+
+constexpr int BENCHMARK_REPEATS = 7;
+
+// best of BENCHMARK_REPEATS runs of work(), in milliseconds
+template<typename Work>
+double bestMilliseconds(Work &&work, const int repeats = BENCHMARK_REPEATS) {
+    double best = 1e300;
+    for (int i = 0; i < repeats; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        work();
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+// keeps a result alive so the compiler can't throw away the work that made it
+template<typename T>
+void keep(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char *>(&value);
+#endif
+}
+
+inline void report(const char *what, const double milliseconds, const double items, const char *unit) {
+    std::printf("%-44s %10.3f ms  %14.0f %s/ms\n", what, milliseconds, items / milliseconds, unit);
+}
+
+#endif //BENCHMARK_H
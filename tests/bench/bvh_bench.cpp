@@ -0,0 +1,88 @@
+// rays per millisecond through the bvh. a lumpy sphere about the size of pc.obj (35k triangles) on its own, hit by a
+// grid of rays like a camera would cast, then 64 moving copies of it in a scene hit by rays in random directions
+#include <cmath>
+#include <random>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#include "benchmark.h"
+#include "bvh.h"
+
+constexpr int RAYS = 1 << 18;
+
+int main() {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    constexpr int SLICES = 192, STACKS = 96;
+    for (int j = 0; j <= STACKS; j++) {
+        const float phi = 3.14159265f * static_cast<float>(j) / STACKS;
+        for (int i = 0; i <= SLICES; i++) {
+            const float theta = 6.28318531f * static_cast<float>(i) / SLICES;
+            const float radius = 1.0f + 0.05f * std::sin(theta * 9.0f) * std::sin(phi * 7.0f);
+            positions.emplace_back(radius * std::sin(phi) * std::cos(theta), radius * std::cos(phi), radius * std::sin(phi) * std::sin(theta));
+        }
+    }
+    for (int j = 0; j < STACKS; j++) {
+        for (int i = 0; i < SLICES; i++) {
+            const unsigned int a = j * (SLICES + 1) + i;
+            indices.insert(indices.end(), {a, a + 1, a + SLICES + 1, a + 1, a + SLICES + 2, a + SLICES + 1});
+        }
+    }
+    const double buildMs = bestMilliseconds([&] {
+        const MeshBvh bvh(positions, indices);
+        keep(bvh.nodes.size());
+    }, 3);
+    const MeshBvh mesh(positions, indices);
+    std::printf("built %zu triangles into %zu nodes in %.1f ms\n", mesh.triangleCount(), mesh.nodes.size(), buildMs);
+
+    // a 512 x 512 grid of parallel rays covering the sphere and a bit around it, so some miss
+    report("MeshBvh, camera grid", bestMilliseconds([&] {
+        int hits = 0;
+        for (int y = 0; y < 512; y++) {
+            for (int x = 0; x < 512; x++) {
+                const glm::vec3 origin(static_cast<float>(x) / 200.0f - 1.28f, static_cast<float>(y) / 200.0f - 1.28f, 5.0f);
+                float tMax = FLT_MAX;
+                glm::vec3 normal;
+                hits += mesh.intersect(BvhRay(origin, glm::vec3(0.0f, 0.0f, -1.0f)), tMax, normal);
+            }
+        }
+        keep(hits);
+    }), RAYS, "rays");
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> spread(-20.0f, 20.0f);
+    SceneBvh scene;
+    std::vector<glm::vec3> places;
+    for (int i = 0; i < 64; i++) {
+        places.emplace_back(spread(random), spread(random) * 0.25f, spread(random));
+        scene.addInstance(mesh, glm::translate(glm::mat4(1.0f), places.back()), i);
+    }
+    std::vector<Ray> rays(RAYS);
+    for (Ray &ray : rays) {
+        ray.origin = glm::vec3(spread(random), spread(random) * 0.25f, spread(random));
+        ray.direction = glm::normalize(glm::vec3(spread(random), spread(random) * 0.25f, spread(random)));
+        ray.maxDistance = 50.0f;
+    }
+    scene.update();
+
+    report("SceneBvh, 64 instances, random rays", bestMilliseconds([&] {
+        int hits = 0;
+        for (const Ray &ray : rays) {
+            hits += scene.raycast(ray).instance >= 0;
+        }
+        keep(hits);
+    }), RAYS, "rays");
+
+    // every instance moved a little each frame, as the physics props are, then the tree brought up to date
+    int frame = 0;
+    report("SceneBvh, move all 64 and refit", bestMilliseconds([&] {
+        for (int repeat = 0; repeat < 1000; repeat++) {
+            frame++;
+            for (int i = 0; i < 64; i++) {
+                const glm::vec3 wobble(std::sin(static_cast<float>(frame + i)) * 0.1f, 0.0f, 0.0f);
+                scene.setTransform(i, glm::translate(glm::mat4(1.0f), places[i] + wobble));
+            }
+            scene.update();
+        }
+    }), 1000, "refits");
+    return 0;
+}
@@ -0,0 +1,72 @@
+// ground queries per millisecond on a 256 x 256 unit terrain (about a million samples), one at a time and batched.
+// once at random points all over it, where most lookups miss the cache, and once at points within a few units of
+// each other, like the bodies around the player, where they don't
+#include <cmath>
+#include <random>
+#include <vector>
+#include "benchmark.h"
+#include "heightfield.h"
+
+constexpr int QUERIES = 1 << 20;
+
+int main() {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    constexpr int CELLS = 512;
+    constexpr float SIZE = 256.0f;
+    for (int z = 0; z <= CELLS; z++) {
+        for (int x = 0; x <= CELLS; x++) {
+            const float px = SIZE * static_cast<float>(x) / CELLS, pz = SIZE * static_cast<float>(z) / CELLS;
+            positions.emplace_back(px, 4.0f * std::sin(px * 0.1f) * std::cos(pz * 0.13f), pz);
+        }
+    }
+    for (int z = 0; z < CELLS; z++) {
+        for (int x = 0; x < CELLS; x++) {
+            const unsigned int a = z * (CELLS + 1) + x;
+            indices.insert(indices.end(), {a, a + CELLS + 1, a + 1, a + 1, a + CELLS + 1, a + CELLS + 2});
+        }
+    }
+    const double buildMs = bestMilliseconds([&] {
+        const Heightfield ground(positions, indices);
+        keep(ground);
+    }, 1);
+    std::printf("built from %zu triangles in %.1f ms\n", indices.size() / 3, buildMs);
+    const Heightfield ground(positions, indices);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> coordinate(0.0f, SIZE);
+    std::uniform_real_distribution<float> nearby(-4.0f, 4.0f);
+    std::vector<float> x(QUERIES), z(QUERIES), out(QUERIES);
+
+    for (const bool local : {false, true}) {
+        for (int i = 0; i < QUERIES; i++) {
+            x[i] = local ? 128.0f + nearby(random) : coordinate(random);
+            z[i] = local ? 128.0f + nearby(random) : coordinate(random);
+        }
+        std::printf("%s\n", local ? "within 4 units of one point:" : "all over the terrain:");
+
+        report("  height()", bestMilliseconds([&] {
+            for (int i = 0; i < QUERIES; i++) {
+                out[i] = ground.height(x[i], z[i]);
+            }
+            keep(out[QUERIES - 1]);
+        }), QUERIES, "queries");
+
+        report("  sample() (height and normal)", bestMilliseconds([&] {
+            glm::vec3 sum(0.0f);
+            for (int i = 0; i < QUERIES; i++) {
+                float h;
+                glm::vec3 n;
+                ground.sample(x[i], z[i], h, n);
+                sum += n * h;
+            }
+            keep(sum);
+        }), QUERIES, "queries");
+
+        report("  heightBatch()", bestMilliseconds([&] {
+            ground.heightBatch(x.data(), z.data(), out.data(), QUERIES);
+            keep(out[QUERIES - 1]);
+        }), QUERIES, "queries");
+    }
+    return 0;
+}
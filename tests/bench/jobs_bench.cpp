@@ -0,0 +1,100 @@
+// how the job system scales from one thread up to every core, and how much stealing it takes to get there.
+// each workload runs on job systems of 1, 2, 4 ... threads; efficiency is the one thread time over (threads x time),
+// 100% being perfect scaling. pass a thread count to go past the number of cores
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "benchmark.h"
+#include "jobs.h"
+
+namespace {
+
+    // about a microsecond of arithmetic, with nothing shared between items
+    float work(const int item, const int amount) {
+        float x = static_cast<float>(item);
+        for (int i = 0; i < amount; i++) {
+            x = std::sin(x) * 0.5f + 1.0f;
+        }
+        return x;
+    }
+
+    template<typename Workload>
+    void scaling(const char *name, const int maxThreads, Workload workload) {
+        std::printf("%s\n", name);
+        double single = 0.0;
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            JobSystem system(threads - 1);
+            const double ms = bestMilliseconds([&] { workload(system); }, 5);
+            system.takeStats();
+            workload(system);
+            const JobSystem::Stats stats = system.takeStats();
+            if (threads == 1) {
+                single = ms;
+            }
+            std::printf("  %2d threads %10.3f ms  efficiency %5.1f%%  %8llu jobs  %5.1f%% stolen  %5.1f%% of steal attempts found work\n",
+                        threads, ms, 100.0 * single / (threads * ms), static_cast<unsigned long long>(stats.jobsRun),
+                        stats.jobsRun ? 100.0 * static_cast<double>(stats.steals) / static_cast<double>(stats.jobsRun) : 0.0,
+                        stats.stealAttempts ? 100.0 * static_cast<double>(stats.steals) / static_cast<double>(stats.stealAttempts) : 0.0);
+            if (threads < maxThreads && threads * 2 > maxThreads) {
+                threads = maxThreads / 2;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    const int maxThreads = argc > 1 ? std::max(1, std::atoi(argv[1])) : cores;
+    std::printf("%d cores\n", cores);
+
+    constexpr int ITEMS = 1 << 16;
+    std::vector<float> out(ITEMS);
+
+    // the same cost everywhere, split up by parallelFor's automatic grain
+    scaling("parallelFor, even items", maxThreads, [&](JobSystem &system) {
+        system.parallelFor(ITEMS, [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                out[i] = work(i, 40);
+            }
+        });
+    });
+
+    // the later items cost up to 8 times the early ones, so threads given the cheap end run out and have to steal
+    scaling("parallelFor, uneven items", maxThreads, [&](JobSystem &system) {
+        system.parallelFor(ITEMS, [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                out[i] = work(i, 10 + 70 * i / ITEMS);
+            }
+        });
+    });
+
+    // jobs that queue more jobs from inside, like a scene graph walk, so the work starts on one thread and has to
+    // be stolen off it
+    scaling("nested jobs, 64 x 64", maxThreads, [&](JobSystem &system) {
+        JobCounter outer;
+        for (int i = 0; i < 64; i++) {
+            system.run([&system, &out, i] {
+                JobCounter inner;
+                for (int j = 0; j < 64; j++) {
+                    const int item = i * 64 + j;
+                    system.run([&out, item] { out[item] = work(item, 200); }, &inner);
+                }
+                system.wait(inner);
+            }, &outer);
+        }
+        system.wait(outer);
+    });
+
+    // nothing in the jobs at all, so this is just what a job costs to queue, run and count
+    constexpr int EMPTY_JOBS = 100000;
+    JobSystem system(maxThreads - 1);
+    report("empty jobs, run and waited on", bestMilliseconds([&] {
+        JobCounter counter;
+        for (int i = 0; i < EMPTY_JOBS; i++) {
+            system.run([] {}, &counter);
+        }
+        system.wait(counter);
+    }), EMPTY_JOBS, "jobs");
+    return 0;
+}
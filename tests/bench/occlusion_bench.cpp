@@ -0,0 +1,114 @@
+// occluder triangles per millisecond through the software occlusion buffer: setting up and binning them
+// (addOccluder), rasterising them with each kernel this cpu can run, and the whole frame as main.cpp does it. the
+// scene is a field of tori in perspective, whole and then simplified the way OccluderMesh::fromModel does it, so the
+// second half also shows what simplifying saves
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "benchmark.h"
+#include "occlusion.h"
+
+namespace {
+
+    struct BenchVertex {
+        glm::vec3 Position;
+    };
+    struct BenchMesh {
+        std::vector<BenchVertex> vertices;
+        std::vector<unsigned int> indices;
+    };
+    struct BenchModel {
+        std::vector<BenchMesh> meshes;
+        float boundsRadius = 1.35f;
+    };
+
+    BenchModel torus(const int around, const int tube) {
+        BenchModel model;
+        BenchMesh &mesh = model.meshes.emplace_back();
+        for (int i = 0; i < around; i++) {
+            const float theta = glm::two_pi<float>() * static_cast<float>(i) / around;
+            for (int j = 0; j < tube; j++) {
+                const float phi = glm::two_pi<float>() * static_cast<float>(j) / tube;
+                const float radius = 1.0f + 0.35f * std::cos(phi);
+                mesh.vertices.push_back({glm::vec3(radius * std::cos(theta), 0.35f * std::sin(phi), radius * std::sin(theta))});
+            }
+        }
+        for (int i = 0; i < around; i++) {
+            for (int j = 0; j < tube; j++) {
+                const auto at = [&](const int a, const int b) {
+                    return static_cast<unsigned int>((a % around) * tube + b % tube);
+                };
+                mesh.indices.insert(mesh.indices.end(), {at(i, j), at(i, j + 1), at(i + 1, j), at(i + 1, j), at(i, j + 1), at(i + 1, j + 1)});
+            }
+        }
+        return model;
+    }
+
+    void run(const char *label, const OccluderMesh &occluder, const std::vector<glm::mat4> &placements, const glm::mat4 &viewProjection) {
+        OcclusionBuffer buffer;
+        const auto addAll = [&] {
+            buffer.begin(viewProjection);
+            for (const glm::mat4 &model : placements) {
+                buffer.addOccluder(occluder, model);
+            }
+        };
+        addAll();
+        const auto triangles = static_cast<double>(buffer.triangleCount());
+        std::printf("%s: %zu triangles a torus, %zu set up after clipping and culling\n", label, occluder.triangleCount(), buffer.triangleCount());
+        char name[80];
+
+        std::snprintf(name, sizeof(name), "%s, set up and bin", label);
+        report(name, bestMilliseconds(addAll), triangles, "triangles");
+
+        std::vector<std::pair<const char *, OcclusionBuffer::TileKernel>> kernels = {{"scalar", OcclusionBuffer::rasterizeTileScalar}};
+#ifdef OCCLUSION_USE_SSE
+        kernels.emplace_back("sse", OcclusionBuffer::rasterizeTileSse);
+        if (std::string(OcclusionBuffer::path()) == "avx2") {
+            kernels.emplace_back("avx2", OcclusionBuffer::rasterizeTileAvx2);
+        }
+#endif
+        for (const auto &[kernelName, kernel] : kernels) {
+            std::snprintf(name, sizeof(name), "%s, rasterise %s", label, kernelName);
+            report(name, bestMilliseconds([&] {
+                buffer.rasterize(kernel);
+                keep(buffer.depthAt(OCCLUSION_WIDTH / 2, OCCLUSION_HEIGHT / 2));
+            }), triangles, "triangles");
+        }
+
+        std::snprintf(name, sizeof(name), "%s, whole frame", label);
+        report(name, bestMilliseconds([&] {
+            addAll();
+            buffer.rasterize();
+            keep(buffer.depthAt(OCCLUSION_WIDTH / 2, OCCLUSION_HEIGHT / 2));
+        }), triangles, "triangles");
+    }
+}
+
+int main() {
+    std::printf("%d job threads, rasterize() picks the %s kernel here\n", jobs.threadCount(), OcclusionBuffer::path());
+    // 64 tori spread over a field in front of the camera, some reaching off screen and behind it so clipping is in there
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> across(-12.0f, 12.0f);
+    std::uniform_real_distribution<float> depth(-30.0f, 2.0f);
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+    std::vector<glm::mat4> placements;
+    for (int i = 0; i < 64; i++) {
+        placements.push_back(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(across(random), across(random) * 0.3f, depth(random))),
+                                         angle(random), glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f))));
+    }
+    const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), static_cast<float>(OCCLUSION_WIDTH) / OCCLUSION_HEIGHT, 0.1f, 100.0f) *
+                                     glm::lookAt(glm::vec3(0.0f, 1.0f, 5.0f), glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    const BenchModel model = torus(96, 32);
+    OccluderMesh whole;
+    for (const BenchVertex &vertex : model.meshes[0].vertices) {
+        whole.positions.push_back(vertex.Position);
+    }
+    whole.indices = model.meshes[0].indices;
+    run("whole", whole, placements, viewProjection);
+    run("simplified", OccluderMesh::fromModel(model), placements, viewProjection);
+    return 0;
+}
@@ -0,0 +1,74 @@
+// time per physics step with 1k and 10k props (spheres, boxes and capsules mixed) dropped onto rolling ground, and
+// how many bodies that steps per millisecond. timed over the first three seconds one second at a time: falling,
+// landing on each other, then the pile settling with more and more of it asleep
+#include <cmath>
+#include <random>
+#include <vector>
+#include "benchmark.h"
+#include "physics.h"
+
+constexpr float STEP = 1.0f / 60.0f;
+constexpr int STEPS_PER_SECOND = 60;
+
+namespace {
+
+    Heightfield rollingGround(const float size) {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        constexpr int CELLS = 128;
+        for (int z = 0; z <= CELLS; z++) {
+            for (int x = 0; x <= CELLS; x++) {
+                const float px = size * (static_cast<float>(x) / CELLS - 0.5f), pz = size * (static_cast<float>(z) / CELLS - 0.5f);
+                positions.emplace_back(px, 1.5f * std::sin(px * 0.2f) * std::cos(pz * 0.17f), pz);
+            }
+        }
+        for (int z = 0; z < CELLS; z++) {
+            for (int x = 0; x < CELLS; x++) {
+                const unsigned int a = z * (CELLS + 1) + x;
+                indices.insert(indices.end(), {a, a + CELLS + 1, a + 1, a + 1, a + CELLS + 1, a + CELLS + 2});
+            }
+        }
+        return {positions, indices};
+    }
+
+    void run(const int bodies) {
+        // about one body per square metre, stacked a few high so they land on each other
+        const float size = std::sqrt(static_cast<float>(bodies)) * 1.2f;
+        const Heightfield ground = rollingGround(size + 4.0f);
+        PhysicsWorld world;
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> across(-size * 0.5f, size * 0.5f);
+        std::uniform_real_distribution<float> up(3.0f, 8.0f);
+        for (int i = 0; i < bodies; i++) {
+            BodyDesc desc;
+            desc.shape = static_cast<ShapeType>(i % 3);
+            desc.position = glm::vec3(across(random), up(random), across(random));
+            desc.radius = 0.2f;
+            desc.halfHeight = 0.2f;
+            desc.halfExtents = glm::vec3(0.3f, 0.15f, 0.2f);
+            world.addBody(desc);
+        }
+
+        char name[64];
+        for (int second = 0; second < 3; second++) {
+            int awake = 0;
+            const double ms = bestMilliseconds([&] {
+                for (int s = 0; s < STEPS_PER_SECOND; s++) {
+                    world.step(STEP, ground);
+                }
+            }, 1);
+            for (int i = 0; i < bodies; i++) {
+                awake += !world.sleeping(i);
+            }
+            std::snprintf(name, sizeof(name), "%dk bodies, second %d (%d awake after)", bodies / 1000, second + 1, awake);
+            report(name, ms / STEPS_PER_SECOND, bodies, "bodies");
+        }
+    }
+}
+
+int main() {
+    std::printf("%d job threads, times are per step\n", jobs.threadCount());
+    run(1000);
+    run(10000);
+    return 0;
+}
@@ -0,0 +1,69 @@
+// loading a 100k entity scene: compiling the json into a snapshot, then the load every later run does, mapping the
+// snapshot and checking it, and walking every entity's transform out of it the way main.cpp builds the scene graph
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "scene.h"
+
+constexpr int ENTITIES = 100000;
+constexpr int MODELS = 8;
+
+int main() {
+    // the same shape as default.json, just a lot longer. about a third of the entities hang under an earlier one
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> place(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    std::string json = "{\n\"camera\": {\"position\": [0.0, 1.0, 0.0], \"yaw\": 90.0},\n\"models\": {";
+    for (int m = 0; m < MODELS; m++) {
+        json += (m ? ", " : "") + std::string("\"model") + std::to_string(m) + "\": \"resources/models/model" + std::to_string(m) + ".obj\"";
+    }
+    json += "},\n\"entities\": [\n";
+    for (int i = 0; i < ENTITIES; i++) {
+        json += "{\"name\": \"entity" + std::to_string(i) + "\", \"model\": \"model" + std::to_string(i % MODELS) + "\"";
+        if (i > 0 && random() % 3 == 0) {
+            json += ", \"parent\": \"entity" + std::to_string(random() % i) + "\"";
+        }
+        json += ", \"position\": [" + std::to_string(place(random)) + ", " + std::to_string(place(random)) + ", " + std::to_string(place(random))
+              + "], \"rotation\": [0.0, " + std::to_string(angle(random)) + ", 0.0], \"scale\": 1.0, \"shininess\": 16.0}";
+        json += i + 1 < ENTITIES ? ",\n" : "\n";
+    }
+    json += "]\n}\n";
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "scene_bench";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::string path = (directory / "scene.json").string();
+    std::ofstream(path, std::ios::binary) << json;
+    std::printf("%d entities, %.1f MB of json\n", ENTITIES, static_cast<double>(json.size()) / (1 << 20));
+
+    std::vector<unsigned char> snapshot;
+    report("compile json to snapshot", bestMilliseconds([&] {
+        keep(Scene::compile(json, json.size(), 0, snapshot));
+    }, 3), ENTITIES, "entities");
+    std::printf("snapshot is %.1f MB\n", static_cast<double>(snapshot.size()) / (1 << 20));
+
+    // the first load writes the snapshot, every one after maps it
+    const Scene first(path, directory.string());
+    if (!first.loaded()) {
+        std::printf("scene didn't load\n");
+        return 1;
+    }
+    report("load from snapshot", bestMilliseconds([&] {
+        const Scene scene(path, directory.string());
+        keep(scene.entityCount());
+    }), ENTITIES, "entities");
+    report("load from snapshot and walk transforms", bestMilliseconds([&] {
+        const Scene scene(path, directory.string());
+        glm::vec3 sum(0.0f);
+        for (uint32_t i = 0; i < scene.entityCount(); i++) {
+            sum += glm::vec3(scene.transform(i).matrix()[3]);
+        }
+        keep(sum);
+    }), ENTITIES, "entities");
+
+    std::filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,91 @@
+// scene graph update() on a 100k node random tree: how long a frame's update takes when a few nodes have moved, a
+// lot have, a whole branch has, and everything has, against recomputing every world matrix from scratch each frame
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#include "benchmark.h"
+#include "scenegraph.h"
+
+constexpr int NODES = 100000;
+// roots of the tree, like the entities in a scene, everything else hangs under one of them
+constexpr int ROOTS = 64;
+
+int main() {
+    std::printf("%d job threads\n", jobs.threadCount());
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    SceneGraph graph;
+    std::vector<int> parents;
+    for (int i = 0; i < NODES; i++) {
+        // each node under a random earlier one, nearer the end more often than not, so the tree is bushy and a few
+        // dozen deep rather than a chain or a star
+        int parent = -1;
+        if (i >= ROOTS) {
+            std::uniform_int_distribution<int> earlier(i / 2, i - 1);
+            parent = earlier(random);
+        }
+        parents.push_back(parent);
+        graph.addNode(glm::translate(glm::mat4(1.0f), glm::vec3(offset(random), offset(random), offset(random))), parent);
+    }
+    graph.update();
+
+    std::vector<int> moved(NODES);
+    for (int i = 0; i < NODES; i++) {
+        moved[i] = i;
+    }
+    std::shuffle(moved.begin(), moved.end(), random);
+
+    char name[64];
+    for (const int count : {1, 100, 1000, 10000, NODES}) {
+        int updated = 0;
+        float angle = 0.0f;
+        const double ms = bestMilliseconds([&] {
+            angle += 0.01f;
+            for (int i = 0; i < count; i++) {
+                graph.setLocal(moved[i], glm::rotate(graph.local(moved[i]), angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+            }
+            updated = graph.update();
+        });
+        std::snprintf(name, sizeof(name), "%d moved (%d updated)", count, updated);
+        report(name, ms, updated, "nodes");
+    }
+
+    // the root with the most under it, so a whole branch comes along with it
+    std::vector<int> rootOf(NODES), branchSize(ROOTS, 0);
+    for (int i = 0; i < NODES; i++) {
+        rootOf[i] = parents[i] >= 0 ? rootOf[parents[i]] : i;
+        branchSize[rootOf[i]]++;
+    }
+    const int root = static_cast<int>(std::max_element(branchSize.begin(), branchSize.end()) - branchSize.begin());
+    int updated = 0;
+    const double rootMs = bestMilliseconds([&] {
+        graph.setLocal(root, glm::translate(graph.local(root), glm::vec3(0.01f, 0.0f, 0.0f)));
+        updated = graph.update();
+    });
+    std::snprintf(name, sizeof(name), "moving a root (%d updated)", updated);
+    report(name, rootMs, updated, "nodes");
+
+    // what update() saves: every node's world matrix recomputed with a walk up to its root, as a graph without
+    // dirty tracking or depth first order would
+    std::vector<glm::mat4> locals(NODES), worlds(NODES);
+    for (int i = 0; i < NODES; i++) {
+        locals[i] = graph.local(i);
+    }
+    report("brute force, every node walked to its root", bestMilliseconds([&] {
+        for (int i = 0; i < NODES; i++) {
+            glm::mat4 world = locals[i];
+            for (int p = parents[i]; p >= 0; p = parents[p]) {
+                world = locals[p] * world;
+            }
+            worlds[i] = world;
+        }
+        keep(worlds[NODES - 1][3].x);
+    }, 3), NODES, "nodes");
+    float largestError = 0.0f;
+    for (int i = 0; i < NODES; i++) {
+        largestError = std::max(largestError, glm::length(glm::vec3(worlds[i][3]) - glm::vec3(graph.world(i)[3])));
+    }
+    std::printf("update() and the brute force agree to %g\n", largestError);
+    return 0;
+}
@@ -0,0 +1,65 @@
+// spatial hash queries per millisecond with 10k props scattered over a 100 x 100 area (the size of the scene's
+// playable ground): k nearest (k = 4), pick radius and box queries from random points, and every prop moving a little
+#include <random>
+#include <vector>
+#include "benchmark.h"
+#include "spatialhash.h"
+
+constexpr int PROPS = 10000;
+constexpr int QUERIES = 20000;
+
+int main() {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> place(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.2f, 1.5f);
+    SpatialHash hash;
+    std::vector<glm::vec3> mins, sizes;
+    for (int i = 0; i < PROPS; i++) {
+        mins.emplace_back(place(random), place(random) * 0.02f, place(random));
+        sizes.emplace_back(size(random), size(random), size(random));
+        hash.insert(mins.back(), mins.back() + sizes.back(), i);
+    }
+    std::vector<glm::vec3> points(QUERIES);
+    for (glm::vec3 &point : points) {
+        point = glm::vec3(place(random), 1.0f, place(random));
+    }
+
+    std::vector<int> found;
+    report("10k props, nearest 4", bestMilliseconds([&] {
+        size_t total = 0;
+        for (const glm::vec3 &point : points) {
+            hash.queryNearest(point, 4, found);
+            total += found.size();
+        }
+        keep(total);
+    }), QUERIES, "queries");
+    report("10k props, radius 2.5", bestMilliseconds([&] {
+        size_t total = 0;
+        for (const glm::vec3 &point : points) {
+            found.clear();
+            hash.queryRadius(point, 2.5f, found);
+            total += found.size();
+        }
+        keep(total);
+    }), QUERIES, "queries");
+    report("10k props, 4 x 4 x 4 aabb", bestMilliseconds([&] {
+        size_t total = 0;
+        for (const glm::vec3 &point : points) {
+            found.clear();
+            hash.queryAabb(point - glm::vec3(2.0f), point + glm::vec3(2.0f), found);
+            total += found.size();
+        }
+        keep(total);
+    }), QUERIES, "queries");
+
+    // a physics step's worth of movement: most props stay in their cells, the rest cross into the next one
+    std::uniform_real_distribution<float> nudge(-0.1f, 0.1f);
+    report("10k props, update all", bestMilliseconds([&] {
+        for (int i = 0; i < PROPS; i++) {
+            mins[i] += glm::vec3(nudge(random), 0.0f, nudge(random));
+            hash.update(i, mins[i], mins[i] + sizes[i]);
+        }
+        keep(hash.size());
+    }), PROPS, "updates");
+    return 0;
+}
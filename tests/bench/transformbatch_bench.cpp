@@ -0,0 +1,86 @@
+// model (and normal) matrices per millisecond out of a TransformBatch with each kernel this cpu can run, against
+// Transform::matrix() and affine() one at a time and glm's translate * mat4_cast * scale, for 10k transforms (about a
+// scene's worth of props, in cache) and 1M (not)
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "benchmark.h"
+#include "transformbatch.h"
+
+namespace {
+
+    using Kernel = void (*)(const TransformBatch &, size_t, size_t, glm::mat4 *, glm::mat4 *);
+
+    void run(const size_t count) {
+        std::mt19937 random(9);
+        std::uniform_real_distribution<float> place(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> size(0.5f, 2.0f);
+        std::normal_distribution<float> normal;
+        TransformBatch batch;
+        batch.resize(count);
+        std::vector<Transform> transforms(count);
+        for (size_t i = 0; i < count; i++) {
+            transforms[i] = {glm::vec3(place(random), place(random), place(random)),
+                             glm::normalize(glm::quat(normal(random), normal(random), normal(random), normal(random))),
+                             glm::vec3(size(random), size(random), size(random))};
+            batch.set(i, transforms[i]);
+        }
+        std::vector<glm::mat4> models(count), normals(count);
+        std::vector<glm::mat3x4> affines(count);
+        const int repeats = count > 100000 ? 3 : 7;
+        char name[80];
+
+        std::snprintf(name, sizeof(name), "%zuk, glm translate * mat4_cast * scale", count / 1000);
+        report(name, bestMilliseconds([&] {
+            for (size_t i = 0; i < count; i++) {
+                models[i] = glm::scale(glm::translate(glm::mat4(1.0f), transforms[i].position) * glm::mat4_cast(transforms[i].rotation),
+                                       transforms[i].scale);
+            }
+            keep(models[count - 1][3].x);
+        }, repeats), count, "matrices");
+        std::snprintf(name, sizeof(name), "%zuk, Transform::matrix()", count / 1000);
+        report(name, bestMilliseconds([&] {
+            for (size_t i = 0; i < count; i++) {
+                models[i] = transforms[i].matrix();
+            }
+            keep(models[count - 1][3].x);
+        }, repeats), count, "matrices");
+        std::snprintf(name, sizeof(name), "%zuk, Transform::affine()", count / 1000);
+        report(name, bestMilliseconds([&] {
+            for (size_t i = 0; i < count; i++) {
+                affines[i] = transforms[i].affine();
+            }
+            keep(affines[count - 1][0].w);
+        }, repeats), count, "matrices");
+
+        std::vector<std::pair<const char *, Kernel>> kernels = {{"scalar", TransformBatch::buildScalar}};
+#ifdef TRANSFORM_BATCH_USE_SSE
+        kernels.emplace_back("sse", TransformBatch::buildSse);
+        if (std::string(TransformBatch::path()) == "avx2") {
+            kernels.emplace_back("avx2", TransformBatch::buildAvx2);
+        }
+#endif
+        for (const auto &[kernelName, kernel] : kernels) {
+            std::snprintf(name, sizeof(name), "%zuk, batch %s", count / 1000, kernelName);
+            report(name, bestMilliseconds([&] {
+                kernel(batch, 0, count, models.data(), nullptr);
+                keep(models[count - 1][3].x);
+            }, repeats), count, "matrices");
+            std::snprintf(name, sizeof(name), "%zuk, batch %s with normals", count / 1000, kernelName);
+            report(name, bestMilliseconds([&] {
+                kernel(batch, 0, count, models.data(), normals.data());
+                keep(normals[count - 1][0].x);
+            }, repeats), count, "matrices");
+        }
+    }
+}
+
+int main() {
+    std::printf("build() picks the %s kernel here\n", TransformBatch::path());
+    run(10000);
+    run(1000000);
+    return 0;
+}
@@ -0,0 +1,182 @@
+// ray casts through the bvh against a brute force loop over every triangle, on a random triangle soup and on a
+// scene of moving instances, plus a layout that would make the tree deeper than the traversal stacks hold without the cap
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#include "bvh.h"
+#include "testing.h"
+
+namespace {
+
+    // moller-trumbore again, kept apart from the one in bvh.h on purpose
+    float bruteForce(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices, const glm::vec3 &origin,
+                     const glm::vec3 &direction, const float maxDistance) {
+        float closest = maxDistance;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            const glm::vec3 a = positions[indices[t]], b = positions[indices[t + 1]], c = positions[indices[t + 2]];
+            const glm::vec3 e1 = b - a, e2 = c - a;
+            const glm::vec3 p = glm::cross(direction, e2);
+            const float det = glm::dot(e1, p);
+            if (std::abs(det) < 1e-12f) {
+                continue;
+            }
+            const glm::vec3 s = origin - a;
+            const float u = glm::dot(s, p) / det;
+            const glm::vec3 q = glm::cross(s, e1);
+            const float v = glm::dot(direction, q) / det;
+            const float distance = glm::dot(e2, q) / det;
+            if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance > 0.0f && distance < closest) {
+                closest = distance;
+            }
+        }
+        return closest;
+    }
+
+    int depth(const std::vector<BvhNode> &nodes, const uint32_t node = 0) {
+        if (nodes[node].count > 0) {
+            return 0;
+        }
+        return 1 + std::max(depth(nodes, nodes[node].first), depth(nodes, nodes[node].first + 1));
+    }
+
+    void soupMatchesBruteForce() {
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> inBox(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> small(-1.0f, 1.0f);
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        for (unsigned int t = 0; t < 2000; t++) {
+            const glm::vec3 centre(inBox(random), inBox(random), inBox(random));
+            for (int k = 0; k < 3; k++) {
+                positions.push_back(centre + glm::vec3(small(random), small(random), small(random)));
+                indices.push_back(t * 3 + k);
+            }
+        }
+        const MeshBvh bvh(positions, indices);
+        CHECK(bvh.triangleCount() == 2000);
+        CHECK(depth(bvh.nodes) <= static_cast<int>(BVH_MAX_DEPTH));
+
+        int mismatches = 0, hits = 0;
+        for (int r = 0; r < 2000; r++) {
+            const glm::vec3 origin(inBox(random) * 2.0f, inBox(random) * 2.0f, inBox(random) * 2.0f);
+            const glm::vec3 direction = glm::vec3(inBox(random), inBox(random), inBox(random)) - origin;
+            const float expected = bruteForce(positions, indices, origin, direction, FLT_MAX);
+            float tMax = FLT_MAX;
+            glm::vec3 normal;
+            const bool hit = bvh.intersect(BvhRay(origin, direction), tMax, normal);
+            hits += hit;
+            if (hit != (expected < FLT_MAX) || (hit && std::abs(tMax - expected) > 1e-5f * std::max(1.0f, expected))) {
+                mismatches++;
+            }
+        }
+        CHECK(mismatches == 0);
+        // enough of them hit something for the comparison to mean anything
+        CHECK(hits > 500);
+    }
+
+    void depthIsCapped() {
+        // small triangles each twice as far out as the last: every sah split can only peel the last few off, so an
+        // uncapped tree would be a quarter as deep as there are triangles, past what the traversal stacks hold
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        const float start = std::ldexp(1.0f, -120);
+        float x = start;
+        for (unsigned int t = 0; t < 240; t++) {
+            positions.insert(positions.end(), {glm::vec3(x, -0.1f, -0.1f), glm::vec3(x, 0.1f, -0.1f), glm::vec3(x, 0.0f, 0.1f)});
+            indices.insert(indices.end(), {t * 3, t * 3 + 1, t * 3 + 2});
+            x *= 2.0f;
+        }
+        const MeshBvh bvh(positions, indices);
+        CHECK(depth(bvh.nodes) == static_cast<int>(BVH_MAX_DEPTH));
+
+        // a ray down the line goes through every level, and finds the first triangle
+        float tMax = FLT_MAX;
+        glm::vec3 normal;
+        CHECK(bvh.intersect(BvhRay(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f)), tMax, normal));
+        CHECK(tMax == start);
+        // and one from the far end, the last
+        tMax = FLT_MAX;
+        CHECK(bvh.intersect(BvhRay(glm::vec3(x, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f)), tMax, normal));
+        CHECK(tMax == x / 2.0f);
+    }
+
+    // unit cube around the origin, 12 triangles
+    void cube(std::vector<glm::vec3> &positions, std::vector<unsigned int> &indices) {
+        for (int corner = 0; corner < 8; corner++) {
+            positions.emplace_back((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f, (corner & 4) ? 0.5f : -0.5f);
+        }
+        indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    }
+
+    void sceneFindsTheRightInstance() {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        cube(positions, indices);
+        const MeshBvh box(positions, indices);
+
+        SceneBvh scene;
+        const int plain = scene.addInstance(box, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f)), 10);
+        // stretched along x and turned a quarter about y, so the stretch ends up along z
+        const int stretched = scene.addInstance(box, glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, 0.0f, -5.0f)),
+                                                                            glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+                                                                glm::vec3(4.0f, 1.0f, 1.0f)), 20);
+        // behind the first one, so it's only ever hit when the first is missed
+        const int behind = scene.addInstance(box, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -9.0f)), 30);
+
+        RayHit hit = scene.raycast({glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f)});
+        CHECK(hit.instance == plain);
+        CHECK(scene.userId(hit.instance) == 10);
+        CHECK_NEAR(hit.distance, 4.5, 1e-5);
+        CHECK_NEAR(glm::length(hit.point - glm::vec3(0.0f, 0.0f, -4.5f)), 0.0, 1e-5);
+        CHECK_NEAR(glm::length(hit.normal - glm::vec3(0.0f, 0.0f, 1.0f)), 0.0, 1e-5);
+
+        // the stretched box is 4 long in z, so its near face is at -3
+        hit = scene.raycast({glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)});
+        CHECK(hit.instance == stretched);
+        CHECK_NEAR(hit.distance, 3.0, 1e-5);
+        // and its side faces are at x = 2.5 and 3.5, normals unskewed by the scale
+        hit = scene.raycast({glm::vec3(0.0f, 0.0f, -6.0f), glm::vec3(1.0f, 0.0f, 0.0f)});
+        CHECK(hit.instance == stretched);
+        CHECK_NEAR(hit.distance, 2.5, 1e-5);
+        CHECK_NEAR(glm::length(hit.normal - glm::vec3(-1.0f, 0.0f, 0.0f)), 0.0, 1e-5);
+
+        // out of reach
+        hit = scene.raycast({glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 4.0f});
+        CHECK(hit.instance == -1);
+
+        // moving the front box away uncovers the one behind it, and it's found where it was moved to
+        scene.setTransform(plain, glm::translate(glm::mat4(1.0f), glm::vec3(-3.0f, 0.0f, -5.0f)));
+        hit = scene.raycast({glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f)});
+        CHECK(hit.instance == behind);
+        CHECK_NEAR(hit.distance, 8.5, 1e-5);
+        hit = scene.raycast({glm::vec3(-3.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)});
+        CHECK(hit.instance == plain);
+
+        // far enough that the refitted tree is rebuilt
+        scene.setTransform(plain, glm::translate(glm::mat4(1.0f), glm::vec3(500.0f, 0.0f, 0.0f)));
+        hit = scene.raycast({glm::vec3(500.0f, 0.0f, 10.0f), glm::vec3(0.0f, 0.0f, -1.0f)});
+        CHECK(hit.instance == plain);
+        CHECK_NEAR(hit.distance, 9.5, 1e-4);
+        hit = scene.raycast({glm::vec3(3.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)});
+        CHECK(hit.instance == stretched);
+    }
+
+    void emptySceneMisses() {
+        SceneBvh scene;
+        CHECK(scene.raycast({glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f)}).instance == -1);
+        const MeshBvh nothing(std::vector<glm::vec3>{}, std::vector<unsigned int>{});
+        float tMax = FLT_MAX;
+        glm::vec3 normal;
+        CHECK(!nothing.intersect(BvhRay(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f)), tMax, normal));
+    }
+}
+
+int main() {
+    soupMatchesBruteForce();
+    depthIsCapped();
+    sceneFindsTheRightInstance();
+    emptySceneMisses();
+    return testResult("bvh_test");
+}
@@ -0,0 +1,352 @@
+// the gpu driven path's cull.comp against the cpu: thousands of random bounding spheres culled by the compute
+// shader come out with exactly the ones Frustum::intersectsSphere (what the 3.3 fallback in main.cpp uses) keeps,
+// each in its own command's range of the visible list. then with a hi-z pyramid built from a depth buffer holding
+// one wall, nothing that pokes out from behind the wall is dropped and everything well hidden behind it is. and when
+// the wall has gone by the next frame, the second phase gives back everything the first dropped because of it.
+// needs gl 4.3 for the compute shaders, which mesa's llvmpipe has, so it runs headless without a gpu
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+#include "headlessgl.h"
+#include "hiz.h"
+#include "indirect.h"
+#include "rendertarget.h"
+#include "testing.h"
+
+constexpr int TARGET_SIZE = 256;
+constexpr int INSTANCES = 5000;
+constexpr int COMMANDS = 7;
+// the wall covers this square of the depth buffer, in pixels
+constexpr int WALL_FIRST = 64;
+constexpr int WALL_LAST = 192;
+constexpr float WALL_DISTANCE = 10.0f;
+
+namespace {
+
+    struct CullResult {
+        // per instance, whether it ended up in the visible list
+        std::vector<char> visible;
+        GLuint frustumCulled = 0;
+        GLuint occlusionCulled = 0;
+        bool rangesOk = true;
+    };
+
+    // what IndirectRenderer::cull does, on instances made up here rather than from models. the first of two phases
+    // fills retest with what it occlusion culled, which the second then takes as its input
+    CullResult runCull(const Shader &cullShader, const std::vector<IndirectInstance> &instances, const Frustum &frustum,
+                       const HiZPyramid *occluders, const GLint phase = CULL_PHASE_ONLY, std::vector<GLuint> *retest = nullptr) {
+        std::vector<DrawElementsIndirectCommand> commands(COMMANDS, DrawElementsIndirectCommand{36, 0, 0, 0, 0});
+        std::vector<GLuint> perCommand(COMMANDS, 0);
+        for (const IndirectInstance &instance : instances) {
+            perCommand[instance.command]++;
+        }
+        for (int c = 1; c < COMMANDS; c++) {
+            commands[c].baseInstance = commands[c - 1].baseInstance + perCommand[c - 1];
+        }
+
+        GLuint buffers[5];
+        glGenBuffers(5, buffers);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(instances.size() * sizeof(IndirectInstance)), instances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(commands.size() * sizeof(DrawElementsIndirectCommand)), commands.data(), GL_STATIC_DRAW);
+        // filled with a value no instance has, to spot a slot that was counted but never written
+        const std::vector<GLuint> unwritten(instances.size(), 0xffffffffu);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[2]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(unwritten.size() * sizeof(GLuint)), unwritten.data(), GL_STATIC_DRAW);
+        const GLuint zero[3] = {0, 0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[3]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), zero, GL_STATIC_DRAW);
+        // the count, then the list
+        std::vector<GLuint> retestList(instances.size() + 1, 0);
+        if (phase == CULL_PHASE_SECOND) {
+            retestList[0] = static_cast<GLuint>(retest->size());
+            std::copy(retest->begin(), retest->end(), retestList.begin() + 1);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[4]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(retestList.size() * sizeof(GLuint)), retestList.data(), GL_STATIC_DRAW);
+
+        cullShader.use();
+        glUniform4fv(glGetUniformLocation(cullShader.ID, "frustumPlanes"), 6, &frustum.planes[0][0]);
+        glUniform1ui(glGetUniformLocation(cullShader.ID, "instanceCount"), static_cast<GLuint>(instances.size()));
+        glUniform1i(glGetUniformLocation(cullShader.ID, "cullPhase"), phase);
+        cullShader.uploadUniformBool("occlusionCulling", occluders != nullptr);
+        if (occluders) {
+            occluders->bind(cullShader);
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_INSTANCES, buffers[0]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_COMMANDS, buffers[1]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_VISIBLE, buffers[2]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_STATS, buffers[3]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BLOCK_RETEST, buffers[4]);
+        glDispatchCompute((static_cast<GLuint>(instances.size()) + INDIRECT_CULL_GROUP_SIZE - 1) / INDIRECT_CULL_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        std::vector<GLuint> visibleList(instances.size());
+        GLuint stats[3];
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(commands.size() * sizeof(DrawElementsIndirectCommand)), commands.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[2]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(visibleList.size() * sizeof(GLuint)), visibleList.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[3]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(stats), stats);
+        if (phase == CULL_PHASE_FIRST) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[4]);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(retestList.size() * sizeof(GLuint)), retestList.data());
+            retest->assign(retestList.begin() + 1, retestList.begin() + 1 + std::min<GLuint>(retestList[0], instances.size()));
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glDeleteBuffers(5, buffers);
+
+        // each command's instances have to be in its own range, once each, and belong to it
+        CullResult result;
+        result.visible.assign(instances.size(), 0);
+        result.frustumCulled = stats[0];
+        result.occlusionCulled = stats[1];
+        for (int c = 0; c < COMMANDS; c++) {
+            result.rangesOk = result.rangesOk && commands[c].instanceCount <= perCommand[c];
+            for (GLuint slot = 0; slot < std::min(commands[c].instanceCount, perCommand[c]); slot++) {
+                const GLuint index = visibleList[commands[c].baseInstance + slot];
+                if (index >= instances.size() || instances[index].command != static_cast<GLuint>(c) || result.visible[index]) {
+                    result.rangesOk = false;
+                    continue;
+                }
+                result.visible[index] = 1;
+            }
+        }
+        return result;
+    }
+
+    // how close the sphere's surface comes to crossing any of the planes. spheres a hair from one are left out, where
+    // the gpu's float maths can fairly land either side
+    float closestPlane(const Frustum &frustum, const glm::vec4 &sphere) {
+        float closest = FLT_MAX;
+        for (const glm::vec4 &plane : frustum.planes) {
+            closest = std::min(closest, std::abs(glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w + sphere.w));
+        }
+        return closest;
+    }
+
+    IndirectInstance instanceAt(const glm::vec4 &sphere, const int command) {
+        IndirectInstance instance{};
+        instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(sphere));
+        instance.normalMatrix = glm::mat4(1.0f);
+        instance.sphere = sphere;
+        instance.command = static_cast<GLuint>(command);
+        return instance;
+    }
+
+    void frustumCullingMatchesCpu(const Shader &cullShader, const glm::mat4 &viewProjection) {
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        std::mt19937 random(8);
+        std::uniform_real_distribution<float> around(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> size(0.1f, 4.0f);
+        std::vector<IndirectInstance> instances;
+        std::vector<char> expected;
+        while (instances.size() < INSTANCES) {
+            const glm::vec4 sphere(around(random), around(random) * 0.5f, around(random) - 40.0f, size(random));
+            if (closestPlane(frustum, sphere) < 1e-3f) {
+                continue;
+            }
+            instances.push_back(instanceAt(sphere, static_cast<int>(instances.size() % COMMANDS)));
+            expected.push_back(frustum.intersectsSphere(glm::vec3(sphere), sphere.w));
+        }
+
+        const CullResult result = runCull(cullShader, instances, frustum, nullptr);
+        CHECK(result.rangesOk);
+        int mismatches = 0, kept = 0;
+        for (size_t i = 0; i < instances.size(); i++) {
+            mismatches += result.visible[i] != expected[i];
+            kept += expected[i];
+        }
+        CHECK(mismatches == 0);
+        CHECK(result.frustumCulled == static_cast<GLuint>(INSTANCES - kept));
+        CHECK(result.occlusionCulled == 0);
+        // both outcomes common enough for the comparison to mean something
+        CHECK(kept > INSTANCES / 10 && kept < INSTANCES * 9 / 10);
+    }
+
+    // the pixel square a sphere's box covers and its nearest depth, worked out the way cull.comp does it. false when
+    // some of it is behind the camera or off screen, which the shader never calls hidden
+    bool project(const glm::mat4 &viewProjection, const glm::vec4 &sphere, glm::vec2 &first, glm::vec2 &last, float &nearest) {
+        glm::vec3 lowest(1.0f), highest(-1.0f);
+        for (int corner = 0; corner < 8; corner++) {
+            const glm::vec3 offset((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+            const glm::vec4 clip = viewProjection * glm::vec4(glm::vec3(sphere) + offset * sphere.w, 1.0f);
+            if (clip.w <= 0.0f) {
+                return false;
+            }
+            lowest = glm::min(lowest, glm::vec3(clip) / clip.w);
+            highest = glm::max(highest, glm::vec3(clip) / clip.w);
+        }
+        if (glm::any(glm::lessThan(lowest, glm::vec3(-1.0f))) || glm::any(glm::greaterThan(glm::vec2(highest), glm::vec2(1.0f)))) {
+            return false;
+        }
+        first = (glm::vec2(lowest) * 0.5f + 0.5f) * static_cast<float>(TARGET_SIZE);
+        last = (glm::vec2(highest) * 0.5f + 0.5f) * static_cast<float>(TARGET_SIZE);
+        nearest = lowest.z * 0.5f + 0.5f;
+        return true;
+    }
+
+    float wallDepth(const glm::mat4 &viewProjection) {
+        const glm::vec4 wallClip = viewProjection * glm::vec4(0.0f, 0.0f, -WALL_DISTANCE, 1.0f);
+        return wallClip.z / wallClip.w * 0.5f + 0.5f;
+    }
+
+    // the depth buffer cleared to the far plane, then with a wall square on to the camera to the wall's depth inside
+    // a scissor, which is all drawing the wall would do to it
+    void drawDepth(const RenderTarget *scene, const glm::mat4 &viewProjection, const bool wall) {
+        scene->bind();
+        glClearDepth(1.0);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        if (wall) {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(WALL_FIRST, WALL_FIRST, WALL_LAST - WALL_FIRST, WALL_LAST - WALL_FIRST);
+            glClearDepth(wallDepth(viewProjection));
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glDisable(GL_SCISSOR_TEST);
+            glClearDepth(1.0);
+        }
+    }
+
+    // spheres in front of, through and behind the wall, all inside the frustum so only occlusion decides
+    std::vector<IndirectInstance> aroundTheWall(const glm::mat4 &viewProjection, const unsigned seed,
+                                                const std::function<void(const glm::vec4 &)> &added = nullptr) {
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> across(-6.0f, 6.0f);
+        std::uniform_real_distribution<float> distance(2.0f, 40.0f);
+        std::uniform_real_distribution<float> size(0.05f, 1.5f);
+        std::vector<IndirectInstance> instances;
+        while (instances.size() < INSTANCES) {
+            const glm::vec4 sphere(across(random), across(random), -distance(random), size(random));
+            glm::vec2 first, last;
+            float nearest;
+            if (!frustum.intersectsSphere(glm::vec3(sphere), sphere.w) || !project(viewProjection, sphere, first, last, nearest)) {
+                continue;
+            }
+            if (added) {
+                added(sphere);
+            }
+            instances.push_back(instanceAt(sphere, static_cast<int>(instances.size() % COMMANDS)));
+        }
+        return instances;
+    }
+
+    void occlusionCullingIsConservative(const Shader &cullShader, const glm::mat4 &viewProjection) {
+        RenderTargetManager targets(TARGET_SIZE, TARGET_SIZE);
+        const RenderTarget *scene = targets.acquire({1.0f, GL_RGBA8, true});
+        drawDepth(scene, viewProjection, true);
+        HiZPyramid pyramid;
+        pyramid.build(*scene, viewProjection);
+        CHECK(pyramid.ready());
+
+        const float wall = wallDepth(viewProjection);
+        std::vector<int> verdict;
+        int mustGo = 0, mustStay = 0;
+        const std::vector<IndirectInstance> instances = aroundTheWall(viewProjection, 9, [&](const glm::vec4 &sphere) {
+            glm::vec2 first, last;
+            float nearest;
+            project(viewProjection, sphere, first, last, nearest);
+            // the shader looks at up to 2x2 texels of the level where the box spans at most two, and those can reach
+            // a texel past the box on each side. only boxes whose reach is inside the wall and clearly behind it
+            // have to go; anything that isn't entirely behind it has to stay; the rest may go either way
+            const float reach = 2.0f * std::max(std::max(last.x - first.x, last.y - first.y), 1.0f) + 1.0f;
+            const bool coveredByWall = first.x - reach >= WALL_FIRST && first.y - reach >= WALL_FIRST && last.x + reach <= WALL_LAST &&
+                                       last.y + reach <= WALL_LAST;
+            const bool insideWall = first.x >= WALL_FIRST && first.y >= WALL_FIRST && last.x <= WALL_LAST && last.y <= WALL_LAST;
+            int expected = 0;
+            if (coveredByWall && nearest > wall + 1e-4f) {
+                expected = 1;
+                mustGo++;
+            } else if (!insideWall || nearest < wall - 1e-4f) {
+                expected = -1;
+                mustStay++;
+            }
+            verdict.push_back(expected);
+        });
+
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        const CullResult result = runCull(cullShader, instances, frustum, &pyramid);
+        CHECK(result.rangesOk);
+        int wronglyCulled = 0, wronglyKept = 0;
+        for (size_t i = 0; i < instances.size(); i++) {
+            wronglyCulled += verdict[i] < 0 && !result.visible[i];
+            wronglyKept += verdict[i] > 0 && result.visible[i];
+        }
+        std::printf("%d hidden, %d in view, %d either way; gpu culled %u\n", mustGo, mustStay, INSTANCES - mustGo - mustStay,
+                    result.occlusionCulled);
+        CHECK(wronglyCulled == 0);
+        CHECK(wronglyKept == 0);
+        CHECK(result.frustumCulled == 0);
+        CHECK(mustGo > 100 && mustStay > 100);
+        targets.release(scene);
+    }
+
+    // last frame the wall was there, this frame it isn't. the first phase culls against last frame's pyramid and
+    // puts aside what it drops; the second, against a pyramid of this frame's depth, has to give all of it back,
+    // each into the second half of the visible list. with the wall still there it drops the same ones again
+    void secondPhaseGivesBackWhatMoved(const Shader &cullShader, const glm::mat4 &viewProjection) {
+        RenderTargetManager targets(TARGET_SIZE, TARGET_SIZE);
+        const RenderTarget *scene = targets.acquire({1.0f, GL_RGBA8, true});
+        drawDepth(scene, viewProjection, true);
+        HiZPyramid pyramid;
+        pyramid.build(*scene, viewProjection);
+
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        const std::vector<IndirectInstance> instances = aroundTheWall(viewProjection, 10);
+        std::vector<GLuint> retest;
+        const CullResult first = runCull(cullShader, instances, frustum, &pyramid, CULL_PHASE_FIRST, &retest);
+        CHECK(first.rangesOk);
+        // what's put aside isn't counted as culled yet
+        CHECK(first.occlusionCulled == 0);
+        CHECK(retest.size() > 100);
+        std::vector<char> putAside(instances.size(), 0);
+        for (const GLuint index : retest) {
+            CHECK(index < instances.size() && !putAside[index] && !first.visible[index]);
+            putAside[index] = 1;
+        }
+        int firstVisible = 0;
+        for (const char visible : first.visible) {
+            firstVisible += visible;
+        }
+        CHECK(firstVisible + retest.size() == instances.size());
+
+        drawDepth(scene, viewProjection, false);
+        pyramid.build(*scene, viewProjection);
+        const CullResult second = runCull(cullShader, instances, frustum, &pyramid, CULL_PHASE_SECOND, &retest);
+        CHECK(second.rangesOk);
+        CHECK(second.occlusionCulled == 0 && second.frustumCulled == 0);
+        for (size_t i = 0; i < instances.size(); i++) {
+            CHECK(second.visible[i] == putAside[i]);
+        }
+
+        drawDepth(scene, viewProjection, true);
+        pyramid.build(*scene, viewProjection);
+        const CullResult still = runCull(cullShader, instances, frustum, &pyramid, CULL_PHASE_SECOND, &retest);
+        CHECK(still.occlusionCulled == retest.size());
+        for (const char visible : still.visible) {
+            CHECK(!visible);
+        }
+        targets.release(scene);
+    }
+}
+
+int main() {
+    HeadlessGl gl;
+    if (!gl.create(4, 3, TARGET_SIZE, TARGET_SIZE)) {
+        return TEST_SKIPPED;
+    }
+    std::printf("%s\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    const Shader cullShader("resources/shaders/cull.comp");
+    const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f) *
+                                     glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    frustumCullingMatchesCpu(cullShader, viewProjection);
+    occlusionCullingIsConservative(cullShader, viewProjection);
+    secondPhaseGivesBackWhatMoved(cullShader, viewProjection);
+    CHECK(glGetError() == GL_NO_ERROR);
+    return testResult("cull_test");
+}
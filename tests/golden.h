@@ -0,0 +1,85 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "testing.h"
+
+// golden image checks. images are 8 bit grey or rgb, kept as binary pgm/ppm under tests/golden so a diff tool or any
+// image viewer can open them. run a test with UPDATE_GOLDEN=1 to write what it renders as the new goldens, then look
+// at them before committing
+
+struct GoldenImage {
+    int width = 0;
+    int height = 0;
+    int channels = 1;
+    std::vector<unsigned char> pixels;
+};
+
+inline std::string goldenPath(const std::string &name, const int channels) {
+    return "tests/golden/" + name + (channels == 1 ? ".pgm" : ".ppm");
+}
+
+inline bool writeGolden(const std::string &path, const GoldenImage &image) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << (image.channels == 1 ? "P5" : "P6") << "\n" << image.width << " " << image.height << "\n255\n";
+    file.write(reinterpret_cast<const char *>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+    return static_cast<bool>(file);
+}
+
+inline bool readGolden(const std::string &path, GoldenImage &image) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int maximum = 0;
+    if (!(file >> magic >> image.width >> image.height >> maximum) || (magic != "P5" && magic != "P6") || maximum != 255) {
+        return false;
+    }
+    file.get();
+    image.channels = magic == "P5" ? 1 : 3;
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * image.channels);
+    file.read(reinterpret_cast<char *>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+    return static_cast<bool>(file);
+}
+
+// compares against tests/golden/<name>. every channel may be off by maxDifference, which covers rounding differences
+// between drivers, and the mean difference has to stay under meanDifference, which catches a shifted or blurred image
+inline bool checkGolden(const std::string &name, const GoldenImage &image, const int maxDifference = 4, const double meanDifference = 0.5) {
+    const std::string path = goldenPath(name, image.channels);
+    if (std::getenv("UPDATE_GOLDEN")) {
+        std::printf("wrote %s\n", path.c_str());
+        return writeGolden(path, image);
+    }
+    GoldenImage golden;
+    if (!readGolden(path, golden)) {
+        std::printf("no golden image %s, run with UPDATE_GOLDEN=1 to make it\n", path.c_str());
+        testFailures++;
+        return false;
+    }
+    if (golden.width != image.width || golden.height != image.height || golden.channels != image.channels) {
+        std::printf("%s is %dx%dx%d, rendered %dx%dx%d\n", path.c_str(), golden.width, golden.height, golden.channels, image.width, image.height, image.channels);
+        testFailures++;
+        return false;
+    }
+    int worst = 0;
+    double total = 0.0;
+    for (size_t i = 0; i < image.pixels.size(); i++) {
+        const int difference = std::abs(static_cast<int>(image.pixels[i]) - static_cast<int>(golden.pixels[i]));
+        worst = std::max(worst, difference);
+        total += difference;
+    }
+    const double mean = image.pixels.empty() ? 0.0 : total / static_cast<double>(image.pixels.size());
+    if (worst > maxDifference || mean > meanDifference) {
+        const std::string actual = "tests/golden/" + name + ".actual" + (image.channels == 1 ? ".pgm" : ".ppm");
+        writeGolden(actual, image);
+        std::printf("%s differs: worst channel %d, mean %.3f. rendered image written to %s\n", path.c_str(), worst, mean, actual.c_str());
+        testFailures++;
+        return false;
+    }
+    return true;
+}
+
+#endif //GOLDEN_H
@@ -0,0 +1,77 @@
+#ifndef HEADLESSGL_H
+#define HEADLESSGL_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include <cstdio>
+
+// a gl context with no window, on mesa's surfaceless platform, so the gl tests run on a build machine with no
+// display (llvmpipe when there's no gpu either). the default framebuffer is a width x height rgba8 pbuffer
+class HeadlessGl {
+    public:
+
+        HeadlessGl() = default;
+        HeadlessGl(const HeadlessGl &) = delete;
+        HeadlessGl &operator=(const HeadlessGl &) = delete;
+
+        ~HeadlessGl() {
+            if (display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (context != EGL_NO_CONTEXT) {
+                    eglDestroyContext(display, context);
+                }
+                if (surface != EGL_NO_SURFACE) {
+                    eglDestroySurface(display, surface);
+                }
+                eglTerminate(display);
+            }
+        }
+
+        // false (and says why) if there's no egl or the driver can't do a core context of that version
+        bool create(const int major, const int minor, const int width = 64, const int height = 64) {
+            const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (!getPlatformDisplay) {
+                std::printf("no eglGetPlatformDisplayEXT\n");
+                return false;
+            }
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            EGLint eglMajor = 0, eglMinor = 0;
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor) || !eglBindAPI(EGL_OPENGL_API)) {
+                std::printf("no surfaceless egl display\n");
+                return false;
+            }
+
+            const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+                                               EGL_ALPHA_SIZE, 8, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+            EGLConfig config = nullptr;
+            EGLint configs = 0;
+            if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0) {
+                std::printf("no pbuffer config\n");
+                return false;
+            }
+            const EGLint surfaceAttributes[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+
+            const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, major, EGL_CONTEXT_MINOR_VERSION, minor,
+                                                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+            if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+                std::printf("no gl %d.%d core context\n", major, minor);
+                return false;
+            }
+            if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+                std::printf("glad couldn't load gl\n");
+                return false;
+            }
+            return true;
+        }
+
+    private:
+
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+        EGLSurface surface = EGL_NO_SURFACE;
+};
+
+#endif //HEADLESSGL_H
@@ -0,0 +1,174 @@
+// ground queries against terrains whose height is known everywhere: a tilted plane, which bilinear sampling has to
+// reproduce exactly, and a smooth hill, plus what happens off the edge, under overhangs and over holes
+#include <cmath>
+#include <random>
+#include <vector>
+#include "heightfield.h"
+#include "testing.h"
+
+namespace {
+
+    struct Triangles {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+    };
+
+    // cells x cells quads from (x0, z0) to (x0 + size, z0 + size), with heights from surface(x, z). skip(cellX, cellZ)
+    // leaves a cell out
+    template<typename Surface, typename Skip>
+    void addSheet(Triangles &triangles, const float x0, const float z0, const float size, const int cells, Surface surface, Skip skip) {
+        const auto base = static_cast<unsigned int>(triangles.positions.size());
+        for (int z = 0; z <= cells; z++) {
+            for (int x = 0; x <= cells; x++) {
+                const float px = x0 + size * static_cast<float>(x) / cells;
+                const float pz = z0 + size * static_cast<float>(z) / cells;
+                triangles.positions.emplace_back(px, surface(px, pz), pz);
+            }
+        }
+        for (int z = 0; z < cells; z++) {
+            for (int x = 0; x < cells; x++) {
+                if (skip(x, z)) {
+                    continue;
+                }
+                const unsigned int a = base + z * (cells + 1) + x;
+                const unsigned int b = a + 1;
+                const unsigned int c = a + cells + 1;
+                const unsigned int d = c + 1;
+                triangles.indices.insert(triangles.indices.end(), {a, c, b, b, c, d});
+            }
+        }
+    }
+
+    float plane(const float x, const float z) {
+        return 0.5f * x - 0.25f * z + 1.0f;
+    }
+
+    float hill(const float x, const float z) {
+        return 3.0f * std::exp(-(x * x + z * z) / 20.0f);
+    }
+
+    void planeIsExact() {
+        Triangles triangles;
+        addSheet(triangles, -8.0f, -8.0f, 16.0f, 7, plane, [](int, int) { return false; });
+        const Heightfield ground(triangles.positions, triangles.indices);
+
+        CHECK(!ground.empty());
+        CHECK_NEAR(ground.minCorner().x, -8.0, 1e-5);
+        CHECK_NEAR(ground.maxCorner().y, 8.0, 0.25);
+
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> coordinate(-7.9f, 7.9f);
+        double worstHeight = 0.0, worstNormal = 0.0;
+        const glm::vec3 expectedNormal = glm::normalize(glm::vec3(-0.5f, 1.0f, 0.25f));
+        for (int i = 0; i < 1000; i++) {
+            const float x = coordinate(random), z = coordinate(random);
+            float h;
+            glm::vec3 n;
+            ground.sample(x, z, h, n);
+            worstHeight = std::max(worstHeight, static_cast<double>(std::abs(h - plane(x, z))));
+            worstNormal = std::max(worstNormal, static_cast<double>(glm::length(n - expectedNormal)));
+            CHECK(h == ground.height(x, z));
+        }
+        CHECK_NEAR(worstHeight, 0.0, 1e-4);
+        CHECK_NEAR(worstNormal, 0.0, 1e-4);
+    }
+
+    void hillIsClose() {
+        Triangles triangles;
+        addSheet(triangles, -10.0f, -10.0f, 20.0f, 80, hill, [](int, int) { return false; });
+        const Heightfield ground(triangles.positions, triangles.indices);
+
+        CHECK_NEAR(ground.height(0.0f, 0.0f), 3.0, 0.01);
+        double worst = 0.0;
+        for (float z = -9.0f; z <= 9.0f; z += 0.37f) {
+            for (float x = -9.0f; x <= 9.0f; x += 0.41f) {
+                worst = std::max(worst, static_cast<double>(std::abs(ground.height(x, z) - hill(x, z))));
+            }
+        }
+        CHECK(worst < 0.02);
+        // slopes face away from the top
+        CHECK(ground.normal(3.0f, 0.0f).x > 0.1f);
+        CHECK(ground.normal(0.0f, -3.0f).z < -0.1f);
+        // and the top is level, give or take the one cell slope the normal comes from
+        CHECK_NEAR(ground.normal(0.0f, 0.0f).y, 1.0, 1e-2);
+    }
+
+    void offTheEdgeClamps() {
+        Triangles triangles;
+        addSheet(triangles, 0.0f, 0.0f, 4.0f, 4, plane, [](int, int) { return false; });
+        const Heightfield ground(triangles.positions, triangles.indices);
+
+        CHECK_NEAR(ground.height(-100.0f, 2.0f), plane(0.0f, 2.0f), 1e-4);
+        CHECK_NEAR(ground.height(2.0f, 100.0f), plane(2.0f, 4.0f), 1e-4);
+        CHECK_NEAR(ground.height(1e30f, -1e30f), plane(4.0f, 0.0f), 1e-4);
+    }
+
+    void overhangKeepsTheTop() {
+        Triangles triangles;
+        addSheet(triangles, 0.0f, 0.0f, 4.0f, 4, [](float, float) { return 0.0f; }, [](int, int) { return false; });
+        // a ledge over part of it
+        addSheet(triangles, 1.0f, 1.0f, 2.0f, 2, [](float, float) { return 2.0f; }, [](int, int) { return false; });
+        const Heightfield ground(triangles.positions, triangles.indices);
+
+        CHECK_NEAR(ground.height(2.0f, 2.0f), 2.0, 1e-4);
+        CHECK_NEAR(ground.height(0.25f, 0.25f), 0.0, 1e-4);
+    }
+
+    void holesAreFilled() {
+        Triangles triangles;
+        // the middle 4 cells missing
+        addSheet(triangles, 0.0f, 0.0f, 8.0f, 8, [](float, float) { return 1.5f; }, [](const int x, const int z) {
+            return x >= 3 && x <= 4 && z >= 3 && z <= 4;
+        });
+        const Heightfield ground(triangles.positions, triangles.indices);
+
+        CHECK_NEAR(ground.height(4.0f, 4.0f), 1.5, 1e-4);
+        float h;
+        glm::vec3 n;
+        ground.sample(4.0f, 4.0f, h, n);
+        CHECK_NEAR(n.y, 1.0, 1e-4);
+    }
+
+    void batchMatchesSingle() {
+        Triangles triangles;
+        addSheet(triangles, -10.0f, -10.0f, 20.0f, 40, hill, [](int, int) { return false; });
+        const Heightfield ground(triangles.positions, triangles.indices);
+
+        // not a multiple of 4, and partly off the grid, so the tail loop and the clamping in the sse path both run
+        std::mt19937 random(2);
+        std::uniform_real_distribution<float> coordinate(-14.0f, 14.0f);
+        std::vector<float> x(1027), z(1027), batch(1027);
+        for (size_t i = 0; i < x.size(); i++) {
+            x[i] = coordinate(random);
+            z[i] = coordinate(random);
+        }
+        ground.heightBatch(x.data(), z.data(), batch.data(), x.size());
+        double worst = 0.0;
+        for (size_t i = 0; i < x.size(); i++) {
+            worst = std::max(worst, static_cast<double>(std::abs(batch[i] - ground.height(x[i], z[i]))));
+        }
+        CHECK_NEAR(worst, 0.0, 1e-5);
+    }
+
+    void emptyIsFlat() {
+        const Heightfield ground;
+        CHECK(ground.empty());
+        CHECK(ground.height(3.0f, 4.0f) == 0.0f);
+        CHECK(ground.normal(3.0f, 4.0f) == glm::vec3(0.0f, 1.0f, 0.0f));
+        const float x[5] = {0, 1, 2, 3, 4};
+        float out[5] = {9, 9, 9, 9, 9};
+        ground.heightBatch(x, x, out, 5);
+        CHECK(out[0] == 0.0f && out[4] == 0.0f);
+    }
+}
+
+int main() {
+    planeIsExact();
+    hillIsClose();
+    offTheEdgeClamps();
+    overhangKeepsTheTop();
+    holesAreFilled();
+    batchMatchesSingle();
+    emptyIsFlat();
+    return testResult("heightfield_test");
+}
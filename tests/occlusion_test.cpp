@@ -0,0 +1,171 @@
+// the software occlusion buffer: a fixed scene of occluders rasterised and compared with a golden depth image, every
+// simd kernel against the scalar one pixel for pixel, and OccluderMesh::fromModel's simplified occluders never in
+// front of (or wider than) the model they were made from, which would hide things that should be drawn
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "golden.h"
+#include "occlusion.h"
+#include "testing.h"
+
+namespace {
+
+    // just what OccluderMesh::fromModel reads from a Model
+    struct TestVertex {
+        glm::vec3 Position;
+    };
+    struct TestMesh {
+        std::vector<TestVertex> vertices;
+        std::vector<unsigned int> indices;
+    };
+    struct TestModel {
+        std::vector<TestMesh> meshes;
+        float boundsRadius = 0.0f;
+    };
+
+    // a ring of radius 1 round the y axis with a tube of radius 0.35, wound anticlockwise from outside. it's concave
+    // round the inside of the ring, where simplifying without care bulges the surface out
+    TestModel torus(const int around, const int tube) {
+        TestModel model;
+        TestMesh &mesh = model.meshes.emplace_back();
+        for (int i = 0; i < around; i++) {
+            const float theta = glm::two_pi<float>() * static_cast<float>(i) / around;
+            for (int j = 0; j < tube; j++) {
+                const float phi = glm::two_pi<float>() * static_cast<float>(j) / tube;
+                const float radius = 1.0f + 0.35f * std::cos(phi);
+                mesh.vertices.push_back({glm::vec3(radius * std::cos(theta), 0.35f * std::sin(phi), radius * std::sin(theta))});
+            }
+        }
+        for (int i = 0; i < around; i++) {
+            for (int j = 0; j < tube; j++) {
+                const auto at = [&](const int a, const int b) {
+                    return static_cast<unsigned int>((a % around) * tube + b % tube);
+                };
+                mesh.indices.insert(mesh.indices.end(), {at(i, j), at(i, j + 1), at(i + 1, j), at(i + 1, j), at(i, j + 1), at(i + 1, j + 1)});
+            }
+        }
+        model.boundsRadius = 1.35f;
+        return model;
+    }
+
+    // the model as it is, nothing simplified
+    OccluderMesh unsimplified(const TestModel &model) {
+        OccluderMesh occluder;
+        for (const TestVertex &vertex : model.meshes[0].vertices) {
+            occluder.positions.push_back(vertex.Position);
+        }
+        occluder.indices = model.meshes[0].indices;
+        return occluder;
+    }
+
+    // a square wall facing +z, two units across
+    OccluderMesh wall() {
+        OccluderMesh occluder;
+        occluder.positions = {{-1.0f, -1.0f, 0.0f}, {1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {-1.0f, 1.0f, 0.0f}};
+        occluder.indices = {0, 1, 2, 0, 2, 3};
+        return occluder;
+    }
+
+    // a tilted torus in front of a wall, the wall reaching past the left of the screen so it's clipped, seen down
+    // -z through an orthographic projection so the depth is linear and an 8 bit image shows it
+    void drawScene(OcclusionBuffer &buffer, const OccluderMesh &ring, const OcclusionBuffer::TileKernel kernel) {
+        const float aspect = static_cast<float>(OCCLUSION_WIDTH) / OCCLUSION_HEIGHT;
+        buffer.begin(glm::ortho(-2.0f * aspect, 2.0f * aspect, -2.0f, 2.0f, 0.0f, 10.0f) *
+                     glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+        buffer.addOccluder(ring, glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.8f, 0.0f, 1.0f)), 1.0f, glm::vec3(1.0f, 0.2f, 0.0f)));
+        buffer.addOccluder(wall(), glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-2.5f, -0.3f, -1.0f)), glm::vec3(2.5f, 1.2f, 1.0f)));
+        buffer.rasterize(kernel);
+    }
+
+    GoldenImage depthImage(const OcclusionBuffer &buffer) {
+        GoldenImage image;
+        image.width = OCCLUSION_WIDTH;
+        image.height = OCCLUSION_HEIGHT;
+        for (int y = OCCLUSION_HEIGHT - 1; y >= 0; y--) {
+            for (int x = 0; x < OCCLUSION_WIDTH; x++) {
+                image.pixels.push_back(static_cast<unsigned char>(std::clamp(buffer.depthAt(x, y), 0.0f, 1.0f) * 255.0f + 0.5f));
+            }
+        }
+        return image;
+    }
+
+    void depthMatchesGolden() {
+        OcclusionBuffer buffer;
+        drawScene(buffer, unsimplified(torus(48, 16)), OcclusionBuffer::rasterizeTileScalar);
+        checkGolden("occlusion_depth", depthImage(buffer), 1, 0.05);
+    }
+
+    void kernelsMatchScalar() {
+        const OccluderMesh ring = unsimplified(torus(48, 16));
+        OcclusionBuffer scalar;
+        drawScene(scalar, ring, OcclusionBuffer::rasterizeTileScalar);
+        std::vector<std::pair<const char *, OcclusionBuffer::TileKernel>> kernels;
+#ifdef OCCLUSION_USE_SSE
+        kernels.emplace_back("sse", OcclusionBuffer::rasterizeTileSse);
+        if (std::string(OcclusionBuffer::path()) == "avx2") {
+            kernels.emplace_back("avx2", OcclusionBuffer::rasterizeTileAvx2);
+        }
+#endif
+        for (const auto &[name, kernel] : kernels) {
+            OcclusionBuffer buffer;
+            drawScene(buffer, ring, kernel);
+            int different = 0;
+            for (int y = 0; y < OCCLUSION_HEIGHT; y++) {
+                for (int x = 0; x < OCCLUSION_WIDTH; x++) {
+                    different += buffer.depthAt(x, y) != scalar.depthAt(x, y);
+                }
+            }
+            if (different > 0) {
+                std::printf("%s kernel: %d pixels differ from scalar\n", name, different);
+            }
+            CHECK(different == 0);
+        }
+    }
+
+    // the torus from a few angles close up in perspective, whole and simplified. wherever the simplified one covers
+    // a pixel the whole one has to as well, and be at least as near
+    void simplifiedOccludersAreConservative() {
+        const TestModel model = torus(192, 64);
+        const OccluderMesh whole = unsimplified(model);
+        const OccluderMesh simplified = OccluderMesh::fromModel(model, 0.25f);
+        std::printf("torus occluder: %zu triangles simplified to %zu\n", whole.triangleCount(), simplified.triangleCount());
+        CHECK(simplified.triangleCount() < whole.triangleCount() / 2);
+
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), static_cast<float>(OCCLUSION_WIDTH) / OCCLUSION_HEIGHT, 0.1f, 20.0f);
+        for (const glm::vec3 &eye : {glm::vec3(0.0f, 3.0f, 0.5f), glm::vec3(0.0f, 0.6f, 2.5f), glm::vec3(2.0f, 1.5f, -1.0f)}) {
+            const glm::mat4 viewProjection = projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            OcclusionBuffer wholeBuffer, simplifiedBuffer;
+            wholeBuffer.begin(viewProjection);
+            wholeBuffer.addOccluder(whole, glm::mat4(1.0f));
+            wholeBuffer.rasterize(OcclusionBuffer::rasterizeTileScalar);
+            simplifiedBuffer.begin(viewProjection);
+            simplifiedBuffer.addOccluder(simplified, glm::mat4(1.0f));
+            simplifiedBuffer.rasterize(OcclusionBuffer::rasterizeTileScalar);
+
+            int inFront = 0, covered = 0;
+            for (int y = 0; y < OCCLUSION_HEIGHT; y++) {
+                for (int x = 0; x < OCCLUSION_WIDTH; x++) {
+                    const float simplifiedDepth = simplifiedBuffer.depthAt(x, y);
+                    covered += simplifiedDepth < 1.0f;
+                    // pixels on the torus's own edge can go either way by rounding, hence the tiny slack
+                    inFront += simplifiedDepth < wholeBuffer.depthAt(x, y) - 1e-6f;
+                }
+            }
+            if (inFront > 0) {
+                std::printf("from (%g, %g, %g): %d of %d covered pixels in front of the model\n", eye.x, eye.y, eye.z, inFront, covered);
+            }
+            CHECK(inFront == 0);
+            CHECK(covered > 1000);
+        }
+    }
+}
+
+int main() {
+    depthMatchesGolden();
+    kernelsMatchScalar();
+    simplifiedOccludersAreConservative();
+    return testResult("occlusion_test");
+}
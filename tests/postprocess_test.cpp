@@ -0,0 +1,103 @@
+// runs the post processing chain over a synthetic hdr frame (a gradient, a hard edge and a few very bright spots)
+// with different passes switched on, and compares what lands in the backbuffer with golden images
+#include <vector>
+#include "golden.h"
+#include "headlessgl.h"
+#include "postprocess.h"
+#include "testing.h"
+
+constexpr int FRAME_WIDTH = 160;
+constexpr int FRAME_HEIGHT = 120;
+
+namespace {
+
+    std::vector<float> syntheticFrame() {
+        std::vector<float> pixels(static_cast<size_t>(FRAME_WIDTH) * FRAME_HEIGHT * 4);
+        for (int y = 0; y < FRAME_HEIGHT; y++) {
+            for (int x = 0; x < FRAME_WIDTH; x++) {
+                float *p = &pixels[(static_cast<size_t>(y) * FRAME_WIDTH + x) * 4];
+                const float t = static_cast<float>(x) / FRAME_WIDTH * 1.5f;
+                p[0] = t;
+                p[1] = t * 0.5f;
+                p[2] = 0.25f;
+                // an aliased diagonal for fxaa to find
+                if (static_cast<float>(y) > static_cast<float>(x) * 0.6f + 10.0f) {
+                    p[0] = 0.2f;
+                    p[1] = 0.4f;
+                    p[2] = 0.8f;
+                }
+                p[3] = 1.0f;
+            }
+        }
+        // bright spots for bloom, far above the threshold
+        const int spots[][2] = {{40, 30}, {120, 90}, {100, 20}};
+        for (const auto &spot : spots) {
+            for (int y = spot[1] - 1; y <= spot[1] + 1; y++) {
+                for (int x = spot[0] - 1; x <= spot[0] + 1; x++) {
+                    float *p = &pixels[(static_cast<size_t>(y) * FRAME_WIDTH + x) * 4];
+                    p[0] = p[1] = p[2] = 20.0f;
+                }
+            }
+        }
+        return pixels;
+    }
+
+    GoldenImage runChain(PostProcessChain &chain, const GLuint scene, const bool bloom, const bool tonemap, const bool fxaa) {
+        chain.passes[0]->enabled = bloom;
+        chain.passes[1]->enabled = tonemap;
+        chain.passes[2]->enabled = fxaa;
+        chain.execute(scene);
+
+        GoldenImage image;
+        image.width = FRAME_WIDTH;
+        image.height = FRAME_HEIGHT;
+        image.channels = 3;
+        image.pixels.resize(static_cast<size_t>(FRAME_WIDTH) * FRAME_HEIGHT * 3);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, FRAME_WIDTH, FRAME_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.data());
+        return image;
+    }
+
+    int luminance(const GoldenImage &image, const int x, const int y) {
+        const unsigned char *p = &image.pixels[(static_cast<size_t>(y) * image.width + x) * 3];
+        return p[0] + p[1] + p[2];
+    }
+}
+
+int main() {
+    HeadlessGl gl;
+    if (!gl.create(3, 3, FRAME_WIDTH, FRAME_HEIGHT)) {
+        return TEST_SKIPPED;
+    }
+
+    RenderTargetManager targets(FRAME_WIDTH, FRAME_HEIGHT);
+    PostProcessChain chain(targets);
+    CHECK(chain.passes.size() == 3);
+
+    const RenderTarget *scene = targets.acquire({1.0f, HDR_COLOUR_FORMAT, true});
+    const std::vector<float> frame = syntheticFrame();
+    glBindTexture(GL_TEXTURE_2D, scene->colour);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, FRAME_WIDTH, FRAME_HEIGHT, GL_RGBA, GL_FLOAT, frame.data());
+
+    const GoldenImage full = runChain(chain, scene->colour, true, true, true);
+    const GoldenImage tonemapOnly = runChain(chain, scene->colour, false, true, false);
+    const GoldenImage passthrough = runChain(chain, scene->colour, false, false, false);
+    CHECK(glGetError() == GL_NO_ERROR);
+
+    checkGolden("postprocess_full", full);
+    checkGolden("postprocess_tonemap", tonemapOnly);
+    checkGolden("postprocess_passthrough", passthrough);
+
+    // bloom spreads the spots onto their neighbourhood, which tonemapping alone doesn't
+    CHECK(luminance(full, 40, 36) > luminance(tonemapOnly, 40, 36));
+    // with nothing on, the frame is presented as it is: the gradient's bright end clips, its dark end doesn't
+    CHECK(luminance(passthrough, 150, 5) > luminance(passthrough, 5, 5));
+
+    // the chain's intermediate targets go back in the pool, so running it again doesn't make any more
+    const size_t bytes = targets.totalBytes();
+    runChain(chain, scene->colour, true, true, true);
+    CHECK(targets.totalBytes() == bytes);
+
+    return testResult("postprocess_test");
+}
@@ -0,0 +1,190 @@
+// scenes from json through the binary snapshot and back: what's compiled comes out of the accessors the same whether
+// it was just compiled or mapped from the cache, a current snapshot is mapped rather than rebuilt, a stale or damaged
+// one is rebuilt, malformed json is refused, and the camera state saves and loads
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "glm/gtc/quaternion.hpp"
+#include "scene.h"
+#include "testing.h"
+
+namespace {
+
+    const std::filesystem::path DIRECTORY = std::filesystem::temp_directory_path() / "scene_test";
+
+    constexpr char SCENE_JSON[] = R"({
+        "camera": {"position": [1.0, 2.0, 3.0], "yaw": 45.0, "pitch": -10.0, "zoom": 60.0},
+        "models": {"ball": "resources/models/ball/bally.obj", "pc": "resources/models/pc/pc.obj"},
+        "entities": [
+            {"name": "table", "model": "pc", "position": [1.0, 0.0, -2.0], "rotation": [0.0, 90.0, 0.0], "scale": 0.5},
+            {"name": "ball", "model": "ball", "parent": "table", "position": [0.0, 1.0, 0.0], "scale": [1.0, 2.0, 3.0], "shininess": 16.0},
+            {"name": "marker", "rotation": [30.0, 0.0, 0.0]},
+            {"name": "lost", "model": "nothing"}
+        ]
+    })";
+
+    void writeFile(const std::filesystem::path &path, const std::string &text) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+
+    // the one snapshot in the cache directory
+    std::filesystem::path snapshotPath(const std::filesystem::path &cache) {
+        for (const auto &entry : std::filesystem::directory_iterator(cache)) {
+            if (entry.path().extension() == ".bin") {
+                return entry.path();
+            }
+        }
+        return {};
+    }
+
+    // changes bytes of a snapshot in place, keeping its size
+    void patchSnapshot(const std::filesystem::path &path, const size_t offset, const void *bytes, const size_t size) {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(static_cast<const char *>(bytes), static_cast<std::streamsize>(size));
+    }
+
+    size_t entityOffset(const Scene &scene, const uint32_t index) {
+        return sizeof(SceneHeader) + scene.modelCount() * sizeof(SceneModelRecord) + index * sizeof(SceneEntityRecord);
+    }
+
+    void checkContents(const Scene &scene) {
+        if (!CHECK(scene.loaded()) || !CHECK(scene.modelCount() == 2) || !CHECK(scene.entityCount() == 4)) {
+            return;
+        }
+        CHECK(std::string(scene.modelName(0)) == "ball");
+        CHECK(std::string(scene.modelPath(1)) == "resources/models/pc/pc.obj");
+
+        CHECK(scene.findEntity("ball") == 1);
+        CHECK(scene.findEntity("nobody") == -1);
+        CHECK(std::string(scene.entityName(2)) == "marker");
+        CHECK(scene.entity(0).model == 1 && scene.entity(0).parent == -1);
+        CHECK(scene.entity(1).model == 0 && scene.entity(1).parent == 0);
+        // no model, and a model that isn't listed, both load as none
+        CHECK(scene.entity(2).model == -1 && scene.entity(3).model == -1);
+        CHECK(scene.entity(1).shininess == 16.0f && scene.entity(0).shininess == 0.0f);
+
+        // euler degrees in the json, a quaternion once compiled, a single number for a uniform scale
+        const Transform table = scene.transform(0);
+        CHECK(table.position == glm::vec3(1.0f, 0.0f, -2.0f));
+        CHECK(table.scale == glm::vec3(0.5f));
+        CHECK_NEAR(glm::length(glm::vec3(table.matrix() * glm::vec4(1.0f, 0.0f, 0.0f, 0.0f)) - glm::vec3(0.0f, 0.0f, -0.5f)), 0.0, 1e-5);
+        CHECK(scene.transform(1).scale == glm::vec3(1.0f, 2.0f, 3.0f));
+        CHECK_NEAR(glm::angle(scene.transform(2).rotation), glm::radians(30.0f), 1e-5);
+        // missing fields take their defaults
+        CHECK(scene.transform(3).position == glm::vec3(0.0f) && scene.transform(3).scale == glm::vec3(1.0f));
+        CHECK_NEAR(glm::length(scene.transform(3).rotation), 1.0, 1e-6);
+
+        Camera camera;
+        scene.placeCamera(camera);
+        CHECK(camera.cameraPosition == glm::vec3(1.0f, 2.0f, 3.0f));
+        CHECK(camera.yaw == 45.0f && camera.pitch == -10.0f && camera.zoom == 60.0f);
+    }
+
+    void snapshotRoundTrips() {
+        const std::filesystem::path json = DIRECTORY / "round.json";
+        const std::filesystem::path cache = DIRECTORY / "round_cache";
+        writeFile(json, SCENE_JSON);
+
+        const Scene compiled(json.string(), cache.string());
+        checkContents(compiled);
+        const std::filesystem::path snapshot = snapshotPath(cache);
+        CHECK(!snapshot.empty());
+
+        // mapped from the cache the second time. a position changed in the snapshot shows up, which it wouldn't if
+        // the json had been compiled again
+        const Scene mapped(json.string(), cache.string());
+        checkContents(mapped);
+        const float moved[3] = {7.0f, 8.0f, 9.0f};
+        patchSnapshot(snapshot, entityOffset(mapped, 2) + offsetof(SceneEntityRecord, position), moved, sizeof(moved));
+        const Scene patched(json.string(), cache.string());
+        CHECK(patched.transform(2).position == glm::vec3(7.0f, 8.0f, 9.0f));
+
+        // the json changing size makes the snapshot stale, so it's compiled again
+        writeFile(json, std::string(SCENE_JSON) + "\n");
+        const Scene recompiled(json.string(), cache.string());
+        checkContents(recompiled);
+        CHECK(recompiled.transform(2).position == glm::vec3(0.0f));
+    }
+
+    void damagedSnapshotsAreRebuilt() {
+        const std::filesystem::path json = DIRECTORY / "damaged.json";
+        const std::filesystem::path cache = DIRECTORY / "damaged_cache";
+        writeFile(json, SCENE_JSON);
+        const Scene first(json.string(), cache.string());
+        const std::filesystem::path snapshot = snapshotPath(cache);
+        const size_t parentOffset = entityOffset(first, 1) + offsetof(SceneEntityRecord, parent);
+
+        // a parent that isn't an earlier entity, one below -1, a model past the end, a name past the strings, and a
+        // snapshot cut short. each is rebuilt from the json rather than used
+        for (const int32_t parent : {1, 3, -2}) {
+            patchSnapshot(snapshot, parentOffset, &parent, sizeof(parent));
+            checkContents(Scene(json.string(), cache.string()));
+        }
+        const int32_t model = 2;
+        patchSnapshot(snapshot, entityOffset(first, 0) + offsetof(SceneEntityRecord, model), &model, sizeof(model));
+        checkContents(Scene(json.string(), cache.string()));
+        const uint32_t name = 1u << 30;
+        patchSnapshot(snapshot, entityOffset(first, 3) + offsetof(SceneEntityRecord, name), &name, sizeof(name));
+        checkContents(Scene(json.string(), cache.string()));
+        std::filesystem::resize_file(snapshot, std::filesystem::file_size(snapshot) - 1);
+        checkContents(Scene(json.string(), cache.string()));
+        const uint32_t version = SCENE_SNAPSHOT_VERSION + 1;
+        patchSnapshot(snapshot, offsetof(SceneHeader, version), &version, sizeof(version));
+        checkContents(Scene(json.string(), cache.string()));
+    }
+
+    void badJsonIsRefused() {
+        const std::filesystem::path json = DIRECTORY / "bad.json";
+        const std::filesystem::path cache = DIRECTORY / "bad_cache";
+        for (const char *text : {
+                 R"({"entities": [)",
+                 R"([1, 2, 3])",
+                 R"({"entities": [{"model": "ball"}]})",
+                 R"({"models": {"ball": 3}})",
+                 R"({"entities": [{"name": "a", "parent": "b"}, {"name": "b"}]})",
+                 R"({"entities": [{"name": "a", "model": 0}]})",
+                 R"({"entities": [{"name": "a"}, {"name": "b", "parent": 0}]})"}) {
+            writeFile(json, text);
+            CHECK(!Scene(json.string(), cache.string()).loaded());
+        }
+        CHECK(!Scene((DIRECTORY / "missing.json").string(), cache.string()).loaded());
+
+        // an empty scene is fine, it just has nothing in it
+        writeFile(json, "{}");
+        const Scene empty(json.string(), cache.string());
+        CHECK(empty.loaded() && empty.modelCount() == 0 && empty.entityCount() == 0);
+    }
+
+    void cameraStateRoundTrips() {
+        const std::string path = (DIRECTORY / "state" / "camera.json").string();
+        Camera camera;
+        CHECK(!Scene::loadCamera(path, camera));
+        camera.teleport(glm::vec3(4.0f, 5.0f, -6.0f));
+        camera.yaw = 120.0f;
+        camera.pitch = 12.5f;
+        camera.zoom = 55.0f;
+        Scene::saveCamera(path, camera);
+
+        Camera restored;
+        CHECK(Scene::loadCamera(path, restored));
+        CHECK(restored.cameraPosition == camera.cameraPosition);
+        CHECK(restored.yaw == camera.yaw && restored.pitch == camera.pitch && restored.zoom == camera.zoom);
+
+        writeFile(path, "not json");
+        CHECK(!Scene::loadCamera(path, restored));
+    }
+}
+
+int main() {
+    std::filesystem::remove_all(DIRECTORY);
+    std::filesystem::create_directories(DIRECTORY);
+    snapshotRoundTrips();
+    damagedSnapshotsAreRebuilt();
+    badJsonIsRefused();
+    cameraStateRoundTrips();
+    std::filesystem::remove_all(DIRECTORY);
+    return testResult("scene_test");
+}
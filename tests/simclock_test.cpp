@@ -0,0 +1,128 @@
+// the fixed timestep clock: real time turned into whole steps with nothing lost or made up over thousands of jittery
+// frames at several frame rates, alpha always in [0, 1) and carrying the leftover so interpolated motion is smooth,
+// long stalls capped with the fraction kept, and time going backwards or standing still
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "simclock.h"
+#include "testing.h"
+
+namespace {
+
+    double counter(const char *name) {
+        double value = 0.0;
+        profiler.inspect([&](unsigned long long, const auto &, const auto &counters) {
+            for (const auto &entry : counters) {
+                if (entry.name == name) {
+                    value = entry.value;
+                }
+            }
+        });
+        return value;
+    }
+
+    // at any frame rate, jittered or not, every step's worth of real time becomes exactly one step: what's been
+    // simulated plus what's waiting in alpha is always the real time that's passed
+    void stepsAddUpToRealTime() {
+        std::mt19937 random(1);
+        for (const double fps : {30.0, 60.0, 144.0, 240.0, 59.94}) {
+            std::uniform_real_distribution<double> jitter(0.5, 1.5);
+            SimClock clock;
+            double now = 100.0;
+            CHECK(clock.advance(now) == 0);
+            CHECK(clock.alpha() == 0.0f);
+            const double start = now;
+            long long steps = 0;
+            bool alphaInRange = true;
+            for (int frame = 0; frame < 5000; frame++) {
+                now += jitter(random) / fps;
+                const int stepped = clock.advance(now);
+                steps += stepped;
+                alphaInRange = alphaInRange && stepped >= 0 && stepped <= SIM_MAX_STEPS_PER_FRAME && clock.alpha() >= 0.0f && clock.alpha() < 1.0f;
+                CHECK_NEAR(clock.time() + clock.alpha() * SIM_TIMESTEP, now - start, 1e-6);
+            }
+            CHECK(alphaInRange);
+            CHECK_NEAR(clock.time(), static_cast<double>(steps) * SIM_TIMESTEP, 1e-9);
+            CHECK(clock.step() == static_cast<float>(SIM_TIMESTEP));
+        }
+    }
+
+    // a frame exactly one step long runs one step every time, not none then two when the sums round the wrong way
+    void exactFramesRunOneStepEach() {
+        SimClock clock(0.01);
+        clock.advance(0.0);
+        int wrong = 0;
+        for (int frame = 1; frame <= 1000; frame++) {
+            wrong += clock.advance(frame * 0.01) != 1;
+        }
+        CHECK(wrong == 0);
+    }
+
+    // interpolating between the last two states with alpha puts a steadily moving thing exactly one step behind
+    // where it really is, every frame, however the frames and steps line up
+    void interpolationIsSmooth() {
+        std::mt19937 random(2);
+        std::uniform_real_distribution<double> frameTime(0.002, 0.03);
+        constexpr double SPEED = 3.0;
+        SimClock clock;
+        double now = 0.0;
+        clock.advance(now);
+        double previous = 0.0, current = 0.0;
+        double largestError = 0.0;
+        for (int frame = 0; frame < 5000; frame++) {
+            now += frameTime(random);
+            const int steps = clock.advance(now);
+            for (int i = 0; i < steps; i++) {
+                previous = current;
+                current += SPEED * clock.step();
+            }
+            const double rendered = previous + (current - previous) * clock.alpha();
+            const double expected = SPEED * (now - SIM_TIMESTEP);
+            if (now > SIM_TIMESTEP) {
+                largestError = std::max(largestError, std::abs(rendered - expected));
+            }
+        }
+        CHECK_NEAR(largestError, 0.0, 1e-3);
+    }
+
+    void stallsAreCapped() {
+        SimClock clock;
+        clock.advance(0.0);
+        clock.advance(0.5 * SIM_TIMESTEP);
+        const double dropped = counter("Sim steps dropped");
+        // two seconds stuck is 120 steps, only the cap's worth of which are run
+        const double stalled = 0.5 * SIM_TIMESTEP + 2.0 + 0.25 * SIM_TIMESTEP;
+        CHECK(clock.advance(stalled) == SIM_MAX_STEPS_PER_FRAME);
+        CHECK_NEAR(counter("Sim steps dropped") - dropped, 120 - SIM_MAX_STEPS_PER_FRAME, 0.0);
+        CHECK_NEAR(clock.time(), SIM_MAX_STEPS_PER_FRAME * SIM_TIMESTEP, 1e-9);
+        // the fraction of a step left over is kept, so alpha carries on from 0.5 + 0.25
+        CHECK_NEAR(clock.alpha(), 0.75, 1e-4);
+        CHECK_NEAR(clock.realDelta(), 2.0 + 0.25 * SIM_TIMESTEP, 1e-9);
+        // and the frame after runs normally
+        CHECK(clock.advance(stalled + 0.5 * SIM_TIMESTEP) == 1);
+        CHECK_NEAR(clock.alpha(), 0.25, 1e-4);
+    }
+
+    void timeGoingBackwardsIsIgnored() {
+        SimClock clock;
+        clock.advance(10.0);
+        clock.advance(10.0 + 1.5 * SIM_TIMESTEP);
+        const float alpha = clock.alpha();
+        // a clock that jumps back (a changed system clock, a wrapped timer) or doesn't move runs nothing
+        CHECK(clock.advance(5.0) == 0);
+        CHECK(clock.realDelta() == 0.0);
+        CHECK(clock.alpha() == alpha);
+        CHECK(clock.advance(5.0) == 0);
+        // and carries on from the new time
+        CHECK(clock.advance(5.0 + 0.5 * SIM_TIMESTEP) == 1);
+    }
+}
+
+int main() {
+    stepsAddUpToRealTime();
+    exactFramesRunOneStepEach();
+    interpolationIsSmooth();
+    stallsAreCapped();
+    timeGoingBackwardsIsIgnored();
+    return testResult("simclock_test");
+}
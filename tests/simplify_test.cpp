@@ -0,0 +1,281 @@
+// the quadric edge collapse simplifier on meshes whose right answer is known: a flat grid, which should lose nearly
+// all its triangles for no error without shrinking, a sphere, which should stay closed and facing outwards, and a
+// torus simplified inward only, which mustn't reach outside the original anywhere
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "glm/gtc/constants.hpp"
+#include "simplify.h"
+#include "testing.h"
+
+namespace {
+
+    struct TestMesh {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        std::vector<unsigned int> indices;
+    };
+
+    // cells x cells quads over [0, 1] on the xz plane, facing +y
+    TestMesh grid(const int cells) {
+        TestMesh mesh;
+        for (int z = 0; z <= cells; z++) {
+            for (int x = 0; x <= cells; x++) {
+                mesh.positions.emplace_back(static_cast<float>(x) / cells, 0.0f, static_cast<float>(z) / cells);
+                mesh.texCoords.emplace_back(static_cast<float>(x) / cells, static_cast<float>(z) / cells);
+            }
+        }
+        for (int z = 0; z < cells; z++) {
+            for (int x = 0; x < cells; x++) {
+                const unsigned int a = z * (cells + 1) + x;
+                const unsigned int b = a + 1;
+                const unsigned int c = a + cells + 1;
+                const unsigned int d = c + 1;
+                mesh.indices.insert(mesh.indices.end(), {a, c, b, b, c, d});
+            }
+        }
+        return mesh;
+    }
+
+    // unit sphere with a uv seam down one side, where the first and last column are separate vertices in the same place
+    TestMesh sphere(const int slices, const int stacks) {
+        TestMesh mesh;
+        for (int j = 0; j <= stacks; j++) {
+            const float phi = glm::pi<float>() * static_cast<float>(j) / stacks;
+            for (int i = 0; i <= slices; i++) {
+                const float theta = 2.0f * glm::pi<float>() * static_cast<float>(i % slices) / slices;
+                mesh.positions.emplace_back(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+                mesh.texCoords.emplace_back(static_cast<float>(i) / slices, static_cast<float>(j) / stacks);
+            }
+        }
+        for (int j = 0; j < stacks; j++) {
+            for (int i = 0; i < slices; i++) {
+                const unsigned int a = j * (slices + 1) + i;
+                const unsigned int b = a + 1;
+                const unsigned int c = a + slices + 1;
+                const unsigned int d = c + 1;
+                if (j != 0) {
+                    mesh.indices.insert(mesh.indices.end(), {a, b, c});
+                }
+                if (j != stacks - 1) {
+                    mesh.indices.insert(mesh.indices.end(), {b, d, c});
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // a ring of radius 1 round the y axis, with a tube of radius 0.35, wound anticlockwise from outside. it curves
+    // both ways, so plain collapses on the inside of the ring push the surface outwards
+    TestMesh torus(const int around, const int tube) {
+        TestMesh mesh;
+        for (int i = 0; i < around; i++) {
+            const float theta = 2.0f * glm::pi<float>() * static_cast<float>(i) / around;
+            for (int j = 0; j < tube; j++) {
+                const float phi = 2.0f * glm::pi<float>() * static_cast<float>(j) / tube;
+                const float radius = 1.0f + 0.35f * std::cos(phi);
+                mesh.positions.emplace_back(radius * std::cos(theta), 0.35f * std::sin(phi), radius * std::sin(theta));
+            }
+        }
+        for (int i = 0; i < around; i++) {
+            for (int j = 0; j < tube; j++) {
+                const auto at = [&](const int a, const int b) {
+                    return static_cast<unsigned int>((a % around) * tube + b % tube);
+                };
+                mesh.indices.insert(mesh.indices.end(), {at(i, j), at(i, j + 1), at(i + 1, j), at(i + 1, j), at(i, j + 1), at(i + 1, j + 1)});
+            }
+        }
+        return mesh;
+    }
+
+    // how many times the closed mesh wraps round a point, from the solid angles its triangles cover seen from there:
+    // about 1 inside and 0 outside
+    double windingNumber(const TestMesh &mesh, const glm::dvec3 &point) {
+        double total = 0.0;
+        for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+            const glm::dvec3 a = glm::dvec3(mesh.positions[mesh.indices[t]]) - point;
+            const glm::dvec3 b = glm::dvec3(mesh.positions[mesh.indices[t + 1]]) - point;
+            const glm::dvec3 c = glm::dvec3(mesh.positions[mesh.indices[t + 2]]) - point;
+            const double la = glm::length(a), lb = glm::length(b), lc = glm::length(c);
+            total += 2.0 * std::atan2(glm::dot(a, glm::cross(b, c)), la * lb * lc + glm::dot(a, b) * lc + glm::dot(a, c) * lb + glm::dot(b, c) * la);
+        }
+        return total / (4.0 * glm::pi<double>());
+    }
+
+    glm::vec3 faceNormal(const TestMesh &mesh, const std::vector<unsigned int> &indices, const size_t triangle) {
+        const glm::vec3 &p0 = mesh.positions[indices[triangle * 3]];
+        const glm::vec3 &p1 = mesh.positions[indices[triangle * 3 + 1]];
+        const glm::vec3 &p2 = mesh.positions[indices[triangle * 3 + 2]];
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+
+    bool indicesValid(const TestMesh &mesh, const std::vector<unsigned int> &indices) {
+        if (indices.size() % 3 != 0) {
+            return false;
+        }
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                if (indices[t + k] >= mesh.positions.size()) {
+                    return false;
+                }
+            }
+            if (indices[t] == indices[t + 1] || indices[t + 1] == indices[t + 2] || indices[t] == indices[t + 2]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void flatGridCollapsesForFree() {
+        const TestMesh mesh = grid(16);
+        const SimplifyResult result = simplifyMesh(mesh.positions, mesh.texCoords, mesh.indices, mesh.indices.size() / 10, 0.01f);
+
+        CHECK(indicesValid(mesh, result.indices));
+        CHECK(result.indices.size() <= mesh.indices.size() / 10);
+        // every collapse on a plane costs nothing
+        CHECK_NEAR(result.error, 0.0, 1e-4);
+
+        // the border planes keep the outline where it was, so the area stays the same and nothing flips over
+        double area = 0.0;
+        bool allUp = true;
+        for (size_t t = 0; t < result.indices.size() / 3; t++) {
+            const glm::vec3 n = faceNormal(mesh, result.indices, t);
+            area += 0.5 * glm::length(n);
+            allUp = allUp && n.y > 0.0f;
+        }
+        CHECK_NEAR(area, 1.0, 1e-4);
+        CHECK(allUp);
+    }
+
+    void sphereStaysClosed() {
+        const TestMesh mesh = sphere(32, 16);
+        const SimplifyResult result = simplifyMesh(mesh.positions, mesh.texCoords, mesh.indices, mesh.indices.size() / 4, 1.0f);
+
+        CHECK(indicesValid(mesh, result.indices));
+        CHECK(result.indices.size() <= mesh.indices.size() / 4);
+        CHECK(result.error > 0.0f);
+        CHECK(result.error < 0.2f);
+
+        // no triangle turned inside out
+        bool allOutwards = true;
+        for (size_t t = 0; t < result.indices.size() / 3; t++) {
+            const glm::vec3 centre = (mesh.positions[result.indices[t * 3]] + mesh.positions[result.indices[t * 3 + 1]] +
+                                      mesh.positions[result.indices[t * 3 + 2]]) / 3.0f;
+            allOutwards = allOutwards && glm::dot(faceNormal(mesh, result.indices, t), centre) > 0.0f;
+        }
+        CHECK(allOutwards);
+
+        // still watertight once the seam copies are welded: every edge is shared by exactly two triangles, in opposite
+        // directions
+        auto weld = [&](const unsigned int v) {
+            for (unsigned int w = 0; w < v; w++) {
+                if (glm::length(mesh.positions[w] - mesh.positions[v]) < 1e-5f) {
+                    return w;
+                }
+            }
+            return v;
+        };
+        std::vector<unsigned int> welded(mesh.positions.size());
+        for (unsigned int v = 0; v < welded.size(); v++) {
+            welded[v] = weld(v);
+        }
+        int unmatched = 0;
+        for (size_t t = 0; t < result.indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                const unsigned int a = welded[result.indices[t + k]];
+                const unsigned int b = welded[result.indices[t + (k + 1) % 3]];
+                int reverse = 0;
+                for (size_t s = 0; s < result.indices.size(); s += 3) {
+                    for (int l = 0; l < 3; l++) {
+                        reverse += welded[result.indices[s + l]] == b && welded[result.indices[s + (l + 1) % 3]] == a;
+                    }
+                }
+                unmatched += reverse != 1;
+            }
+        }
+        CHECK(unmatched == 0);
+
+        // corners moved across the seam pick the copy with the nearest uv, so no triangle stretches across the texture
+        bool noWrap = true;
+        for (size_t t = 0; t < result.indices.size(); t += 3) {
+            float minU = 1.0f, maxU = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                minU = std::min(minU, mesh.texCoords[result.indices[t + k]].x);
+                maxU = std::max(maxU, mesh.texCoords[result.indices[t + k]].x);
+            }
+            noWrap = noWrap && maxU - minU < 0.5f;
+        }
+        CHECK(noWrap);
+    }
+
+    // the middle of every simplified triangle, nudged just behind it, has to be inside the original. without
+    // inwardOnly some of them aren't, or the test wouldn't show anything
+    int trianglesOutside(const TestMesh &mesh, const std::vector<unsigned int> &indices) {
+        int outside = 0;
+        for (size_t t = 0; t < indices.size() / 3; t++) {
+            const glm::dvec3 centre = glm::dvec3(mesh.positions[indices[t * 3]] + mesh.positions[indices[t * 3 + 1]] +
+                                                 mesh.positions[indices[t * 3 + 2]]) / 3.0;
+            const glm::dvec3 behind = centre - 1e-4 * glm::normalize(glm::dvec3(faceNormal(mesh, indices, t)));
+            outside += windingNumber(mesh, behind) < 0.5;
+        }
+        return outside;
+    }
+
+    void inwardOnlyStaysInside() {
+        const TestMesh mesh = torus(48, 16);
+        CHECK_NEAR(windingNumber(mesh, glm::dvec3(1.0, 0.0, 0.0)), 1.0, 1e-6);
+        CHECK_NEAR(windingNumber(mesh, glm::dvec3(0.0, 0.0, 0.0)), 0.0, 1e-6);
+
+        const SimplifyResult plain = simplifyMesh(mesh.positions, {}, mesh.indices, mesh.indices.size() / 4, 1.0f);
+        const SimplifyResult inward = simplifyMesh(mesh.positions, {}, mesh.indices, mesh.indices.size() / 4, 1.0f, true);
+        const int plainOutside = trianglesOutside(mesh, plain.indices);
+        const int inwardOutside = trianglesOutside(mesh, inward.indices);
+        std::printf("torus at a quarter: %d of %zu triangles outside, inward only %d of %zu\n", plainOutside,
+                    plain.indices.size() / 3, inwardOutside, inward.indices.size() / 3);
+        CHECK(plainOutside > 0);
+        CHECK(inwardOutside == 0);
+        CHECK(indicesValid(mesh, inward.indices));
+        // it still gets a long way, the outside of the ring is convex and collapses freely
+        CHECK(inward.indices.size() < mesh.indices.size() / 2);
+
+        // a flat grid is all on its border or plane, so inward only changes nothing there
+        const TestMesh flat = grid(16);
+        const SimplifyResult flatInward = simplifyMesh(flat.positions, flat.texCoords, flat.indices, flat.indices.size() / 10, 0.01f, true);
+        CHECK(flatInward.indices.size() <= flat.indices.size() / 10);
+    }
+
+    void errorCapStopsEarly() {
+        const TestMesh mesh = sphere(32, 16);
+        const SimplifyResult result = simplifyMesh(mesh.positions, mesh.texCoords, mesh.indices, 0, 0.01f);
+
+        CHECK(indicesValid(mesh, result.indices));
+        CHECK(result.error <= 0.01f);
+        // a sphere this coarse can't lose much without moving more than that
+        CHECK(result.indices.size() > mesh.indices.size() / 2);
+    }
+
+    void sameInputSameOutput() {
+        const TestMesh mesh = sphere(24, 12);
+        const SimplifyResult first = simplifyMesh(mesh.positions, mesh.texCoords, mesh.indices, mesh.indices.size() / 3, 1.0f);
+        const SimplifyResult second = simplifyMesh(mesh.positions, mesh.texCoords, mesh.indices, mesh.indices.size() / 3, 1.0f);
+        CHECK(first.indices == second.indices);
+        CHECK(first.error == second.error);
+    }
+
+    void nothingToDo() {
+        const TestMesh mesh = grid(2);
+        const SimplifyResult result = simplifyMesh(mesh.positions, mesh.texCoords, mesh.indices, mesh.indices.size(), 1.0f);
+        CHECK(result.indices == mesh.indices);
+        CHECK(result.error == 0.0f);
+    }
+}
+
+int main() {
+    flatGridCollapsesForFree();
+    sphereStaysClosed();
+    inwardOnlyStaysInside();
+    errorCapStopsEarly();
+    sameInputSameOutput();
+    nothingToDo();
+    return testResult("simplify_test");
+}
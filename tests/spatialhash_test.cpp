@@ -0,0 +1,228 @@
+// the spatial hash's queries against brute force over every box, through inserts, moves and removals: aabb and radius
+// queries, k nearest with the shell search's early stop, boxes too big for the grid, and empty cells being pruned
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "spatialhash.h"
+#include "testing.h"
+
+namespace {
+
+    struct Box {
+        glm::vec3 min;
+        glm::vec3 max;
+        bool alive = false;
+    };
+
+    float distanceSq(const Box &box, const glm::vec3 &p) {
+        const glm::vec3 d = glm::max(glm::max(box.min - p, p - box.max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+    bool overlaps(const Box &box, const glm::vec3 &min, const glm::vec3 &max) {
+        return glm::all(glm::lessThanEqual(box.min, max)) && glm::all(glm::greaterThanEqual(box.max, min));
+    }
+
+    // handles the hash gave back, sorted, with any reported twice left in so the comparison catches them
+    std::vector<int> sorted(std::vector<int> handles) {
+        std::sort(handles.begin(), handles.end());
+        return handles;
+    }
+
+    // a small prop most of the time, now and then one big enough to go in the large list
+    Box randomBox(std::mt19937 &random) {
+        std::uniform_real_distribution<float> place(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> size(0.1f, 3.0f);
+        const glm::vec3 min(place(random), place(random) * 0.1f, place(random));
+        const float stretch = random() % 50 == 0 ? 20.0f : 1.0f;
+        return {min, min + glm::vec3(size(random) * stretch, size(random), size(random) * stretch), true};
+    }
+
+    // every query, over every box still alive
+    void checkQueries(const SpatialHash &hash, const std::vector<Box> &boxes, std::mt19937 &random, const int queries) {
+        std::uniform_real_distribution<float> place(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> reach(0.0f, 8.0f);
+        std::vector<int> found, expected;
+        for (int q = 0; q < queries; q++) {
+            const glm::vec3 point(place(random), place(random) * 0.1f, place(random));
+            const glm::vec3 half(reach(random), reach(random), reach(random));
+
+            found.clear();
+            expected.clear();
+            hash.queryAabb(point - half, point + half, found);
+            for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+                if (boxes[i].alive && overlaps(boxes[i], point - half, point + half)) {
+                    expected.push_back(i);
+                }
+            }
+            CHECK(sorted(found) == expected);
+
+            const float radius = reach(random);
+            found.clear();
+            expected.clear();
+            hash.queryRadius(point, radius, found);
+            for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+                if (boxes[i].alive && distanceSq(boxes[i], point) <= radius * radius) {
+                    expected.push_back(i);
+                }
+            }
+            CHECK(sorted(found) == expected);
+
+            // ties can come back in either order, so the distances are compared rather than the handles
+            const size_t k = 1 + random() % 8;
+            hash.queryNearest(point, k, found);
+            std::vector<float> distances;
+            for (const Box &box : boxes) {
+                if (box.alive) {
+                    distances.push_back(distanceSq(box, point));
+                }
+            }
+            std::sort(distances.begin(), distances.end());
+            distances.resize(std::min(k, distances.size()));
+            if (CHECK(found.size() == distances.size())) {
+                for (size_t i = 0; i < found.size(); i++) {
+                    CHECK(distanceSq(boxes[found[i]], point) == distances[i]);
+                }
+            }
+        }
+    }
+
+    void queriesMatchBruteForce() {
+        std::mt19937 random(1);
+        SpatialHash hash;
+        std::vector<Box> boxes;
+        for (int i = 0; i < 3000; i++) {
+            boxes.push_back(randomBox(random));
+            CHECK(hash.insert(boxes.back().min, boxes.back().max, i * 10) == i);
+        }
+        CHECK(hash.userId(7) == 70);
+        checkQueries(hash, boxes, random, 200);
+
+        // moves of every size, some staying in their cells and some jumping across the world, and removals whose
+        // handles are then handed out again
+        std::uniform_real_distribution<float> nudge(-0.5f, 0.5f);
+        for (int round = 0; round < 5; round++) {
+            for (int i = 0; i < static_cast<int>(boxes.size()); i++) {
+                Box &box = boxes[i];
+                if (!box.alive) {
+                    continue;
+                }
+                if (random() % 10 == 0) {
+                    box = randomBox(random);
+                } else {
+                    const glm::vec3 move(nudge(random), nudge(random), nudge(random));
+                    box.min += move;
+                    box.max += move;
+                }
+                hash.update(i, box.min, box.max);
+            }
+            std::vector<int> removed;
+            for (int i = 0; i < 200; i++) {
+                const int handle = static_cast<int>(random() % boxes.size());
+                if (boxes[handle].alive) {
+                    hash.remove(handle);
+                    boxes[handle].alive = false;
+                    removed.push_back(handle);
+                }
+            }
+            for (size_t i = 0; i < removed.size() / 2; i++) {
+                const Box box = randomBox(random);
+                const int handle = hash.insert(box.min, box.max);
+                CHECK(!boxes[handle].alive);
+                boxes[handle] = box;
+            }
+            CHECK(hash.size() == static_cast<size_t>(std::count_if(boxes.begin(), boxes.end(), [](const Box &box) { return box.alive; })));
+            checkQueries(hash, boxes, random, 100);
+        }
+    }
+
+    void nearestDoesntStopTooSoon() {
+        // the point sits at the top of cell 0 in x. the only box in its own shell of cells is 2.09 away, behind it in
+        // cell -1, while one two cells ahead is 2.01 away. after shell 1 nothing unseen can be nearer than 2 units,
+        // which doesn't rule out the box ahead, so the search has to go on to shell 2 to find it
+        SpatialHash hash;
+        const int behind = hash.insert(glm::vec3(-0.2f, 0.5f, 0.5f), glm::vec3(-0.1f, 0.6f, 0.6f));
+        const int ahead = hash.insert(glm::vec3(4.0f, 0.5f, 0.5f), glm::vec3(4.1f, 0.6f, 0.6f));
+        std::vector<int> found;
+        hash.queryNearest(glm::vec3(1.99f, 0.5f, 0.5f), 1, found);
+        CHECK(found.size() == 1 && found[0] == ahead);
+        hash.queryNearest(glm::vec3(1.99f, 0.5f, 0.5f), 2, found);
+        CHECK(found.size() == 2 && found[0] == ahead && found[1] == behind);
+
+        // asking for more than there are gives all of them, and a point far outside everything still finds them
+        hash.queryNearest(glm::vec3(5000.0f, -300.0f, 20.0f), 10, found);
+        CHECK(found.size() == 2 && found[0] == ahead);
+        hash.queryNearest(glm::vec3(0.0f), 0, found);
+        CHECK(found.empty());
+        hash.remove(behind);
+        hash.remove(ahead);
+        hash.queryNearest(glm::vec3(0.0f), 3, found);
+        CHECK(found.empty());
+    }
+
+    void largeBoxesAreFound() {
+        // far too big for the grid, so it's on the large list that every query checks
+        SpatialHash hash;
+        const int ground = hash.insert(glm::vec3(-1000.0f, -1.0f, -1000.0f), glm::vec3(1000.0f, 0.0f, 1000.0f));
+        const int prop = hash.insert(glm::vec3(10.0f, 0.0f, 10.0f), glm::vec3(11.0f, 1.0f, 11.0f));
+        std::vector<int> found;
+        hash.queryAabb(glm::vec3(500.0f, -0.5f, 500.0f), glm::vec3(501.0f, 0.5f, 501.0f), found);
+        CHECK(found.size() == 1 && found[0] == ground);
+        found.clear();
+        hash.queryRadius(glm::vec3(10.5f, 3.0f, 10.5f), 3.0f, found);
+        CHECK(sorted(found) == std::vector<int>({ground, prop}));
+        hash.queryNearest(glm::vec3(10.5f, 5.0f, 10.5f), 1, found);
+        CHECK(found.size() == 1 && found[0] == prop);
+        // once it's shrunk it goes back in the grid
+        hash.update(ground, glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 0.0f, 1.0f));
+        found.clear();
+        hash.queryAabb(glm::vec3(500.0f, -0.5f, 500.0f), glm::vec3(501.0f, 0.5f, 501.0f), found);
+        CHECK(found.empty());
+        hash.queryAabb(glm::vec3(0.0f), glm::vec3(0.5f), found);
+        CHECK(found.size() == 1 && found[0] == ground);
+    }
+
+    void emptyCellsArePruned() {
+        SpatialHash hash;
+        std::vector<Box> boxes;
+        for (int i = 0; i < 100; i++) {
+            const glm::vec3 min(static_cast<float>(i % 10) * 3.0f, 0.0f, static_cast<float>(i / 10) * 3.0f);
+            boxes.push_back({min, min + glm::vec3(0.5f), true});
+            hash.insert(boxes.back().min, boxes.back().max);
+        }
+        const size_t settled = hash.cellCount();
+
+        // back and forth between two cells keeps both, rather than freeing and allocating one every move
+        const int mover = hash.insert(glm::vec3(-10.0f, 0.0f, 0.0f), glm::vec3(-9.5f, 0.5f, 0.5f));
+        boxes.push_back({glm::vec3(-10.0f, 0.0f, 0.0f), glm::vec3(-9.5f, 0.5f, 0.5f), true});
+        for (int i = 0; i < 50; i++) {
+            const float x = i % 2 ? -10.0f : -12.0f;
+            hash.update(mover, glm::vec3(x, 0.0f, 0.0f), glm::vec3(x + 0.5f, 0.5f, 0.5f));
+        }
+        CHECK(hash.cellCount() == settled + 2);
+
+        // wandering off across the world leaves a trail of empty cells, which is cut back every so often
+        size_t most = 0;
+        for (int i = 0; i < 5000; i++) {
+            const float x = -14.0f - static_cast<float>(i) * SPATIAL_HASH_CELL_SIZE;
+            boxes.back().min = glm::vec3(x, 0.0f, 0.0f);
+            boxes.back().max = glm::vec3(x + 0.5f, 0.5f, 0.5f);
+            hash.update(mover, boxes.back().min, boxes.back().max);
+            most = std::max(most, hash.cellCount());
+        }
+        CHECK(most <= settled + SPATIAL_HASH_KEEP_EMPTY_CELLS + 2);
+        CHECK(hash.cellCount() < most);
+
+        // and nothing that was still in use went with them
+        std::mt19937 random(2);
+        checkQueries(hash, boxes, random, 100);
+    }
+}
+
+int main() {
+    queriesMatchBruteForce();
+    nearestDoesntStopTooSoon();
+    largeBoxesAreFound();
+    emptyCellsArePruned();
+    return testResult("spatialhash_test");
+}
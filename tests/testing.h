@@ -0,0 +1,44 @@
+#ifndef TESTING_H
+#define TESTING_H
+
+#include <cmath>
+#include <cstdio>
+
+// what every test uses. a failed check is printed with where it was and counted, and the test carries on so one run
+// shows everything that's wrong. main returns testResult
+
+// returned by a test that can't run on this machine (no gl, nothing baked), which ctest reports as skipped
+constexpr int TEST_SKIPPED = 77;
+
+inline int testFailures = 0;
+
+inline bool checkThat(const bool ok, const char *text, const char *file, const int line) {
+    if (!ok) {
+        std::printf("%s:%d: check failed: %s\n", file, line, text);
+        testFailures++;
+    }
+    return ok;
+}
+
+inline bool checkNear(const double a, const double b, const double tolerance, const char *textA, const char *textB, const char *file, const int line) {
+    const bool ok = std::abs(a - b) <= tolerance;
+    if (!ok) {
+        std::printf("%s:%d: check failed: %s (%g) != %s (%g) within %g\n", file, line, textA, a, textB, b, tolerance);
+        testFailures++;
+    }
+    return ok;
+}
+
+#define CHECK(condition) checkThat((condition), #condition, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) checkNear((a), (b), (tolerance), #a, #b, __FILE__, __LINE__)
+
+inline int testResult(const char *name) {
+    if (testFailures) {
+        std::printf("%s: %d checks failed\n", name, testFailures);
+        return 1;
+    }
+    std::printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif //TESTING_H
@@ -0,0 +1,141 @@
+// Transform's quaternion maths against glm doing the same thing the long way: matrix() against translate * rotate *
+// scale, affine()'s rows moving points the same as the full matrix, euler angles there and back, rotate() turning
+// about the object's own axes, and no drift over many small turns
+#include <cmath>
+#include <random>
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "transform.h"
+#include "testing.h"
+
+namespace {
+
+    float largestDifference(const glm::mat4 &a, const glm::mat4 &b) {
+        float largest = 0.0f;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                largest = std::max(largest, std::abs(a[column][row] - b[column][row]));
+            }
+        }
+        return largest;
+    }
+
+    glm::quat randomRotation(std::mt19937 &random) {
+        std::normal_distribution<float> normal;
+        return glm::normalize(glm::quat(normal(random), normal(random), normal(random), normal(random)));
+    }
+
+    void matrixMatchesGlm() {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> place(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.1f, 10.0f);
+        float largest = 0.0f;
+        for (int i = 0; i < 10000; i++) {
+            const Transform transform(glm::vec3(place(random), place(random), place(random)), randomRotation(random),
+                                      glm::vec3(size(random), size(random), size(random)));
+            const glm::mat4 expected = glm::scale(glm::translate(glm::mat4(1.0f), transform.position) * glm::mat4_cast(transform.rotation),
+                                                  transform.scale);
+            largest = std::max(largest, largestDifference(transform.matrix(), expected));
+            CHECK(transform.matrix()[0][3] == 0.0f && transform.matrix()[1][3] == 0.0f && transform.matrix()[2][3] == 0.0f);
+            CHECK(transform.matrix()[3][3] == 1.0f);
+        }
+        CHECK_NEAR(largest, 0.0, 1e-4);
+    }
+
+    void affineRowsMovePoints() {
+        std::mt19937 random(4);
+        std::uniform_real_distribution<float> place(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.1f, 10.0f);
+        for (int i = 0; i < 1000; i++) {
+            const Transform transform(glm::vec3(place(random), place(random), place(random)), randomRotation(random),
+                                      glm::vec3(size(random), size(random), size(random)));
+            const glm::mat3x4 rows = transform.affine();
+            const glm::vec4 point(place(random), place(random), place(random), 1.0f);
+            const glm::vec3 moved(glm::dot(rows[0], point), glm::dot(rows[1], point), glm::dot(rows[2], point));
+            CHECK_NEAR(glm::length(moved - glm::vec3(transform.matrix() * point)), 0.0, 1e-3);
+            const glm::mat4 widened = Transform::widen(rows);
+            for (int row = 0; row < 3; row++) {
+                CHECK(widened[3][row] == rows[row][3]);
+            }
+            CHECK(widened[0][3] == 0.0f && widened[1][3] == 0.0f && widened[2][3] == 0.0f && widened[3][3] == 1.0f);
+        }
+    }
+
+    void scaleIsInTheObjectsAxes() {
+        // stretched along its own x then turned a quarter about y, so the stretch ends up along world -z
+        const Transform transform(glm::vec3(1.0f, 2.0f, 3.0f), glm::angleAxis(glm::half_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f)),
+                                  glm::vec3(2.0f, 1.0f, 1.0f));
+        const glm::vec3 tip(transform.matrix() * glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+        CHECK_NEAR(glm::length(tip - glm::vec3(1.0f, 2.0f, 1.0f)), 0.0, 1e-5);
+        const glm::vec3 side(transform.matrix() * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+        CHECK_NEAR(glm::length(side - glm::vec3(2.0f, 2.0f, 3.0f)), 0.0, 1e-5);
+    }
+
+    void eulerRoundTrips() {
+        std::mt19937 random(2);
+        // pitch kept off straight up and down, where yaw and roll stop being separate angles
+        std::uniform_real_distribution<float> pitch(-1.5f, 1.5f);
+        std::uniform_real_distribution<float> angle(-3.1f, 3.1f);
+        for (int i = 0; i < 1000; i++) {
+            const glm::vec3 euler(pitch(random), angle(random), angle(random));
+            const Transform transform = Transform::fromEuler(glm::vec3(0.0f), euler, glm::vec3(1.0f));
+            CHECK_NEAR(glm::length(transform.rotation), 1.0, 1e-5);
+            // the angles that come back can differ, but they have to describe the same rotation. close to straight up
+            // or down the conversion loses a few bits, hence the looser tolerance
+            Transform again;
+            again.setEuler(transform.euler());
+            CHECK_NEAR(largestDifference(again.matrix(), transform.matrix()), 0.0, 5e-4);
+        }
+
+        // one angle at a time comes back as itself
+        const Transform yawed = Transform::fromEuler(glm::vec3(0.0f), glm::vec3(0.0f, 0.7f, 0.0f), glm::vec3(1.0f));
+        CHECK_NEAR(glm::length(yawed.euler() - glm::vec3(0.0f, 0.7f, 0.0f)), 0.0, 1e-5);
+        const Transform pitched = Transform::fromEuler(glm::vec3(0.0f), glm::vec3(-0.4f, 0.0f, 0.0f), glm::vec3(1.0f));
+        CHECK_NEAR(glm::length(pitched.euler() - glm::vec3(-0.4f, 0.0f, 0.0f)), 0.0, 1e-5);
+    }
+
+    void rotateTurnsAboutItsOwnAxes() {
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+        for (int i = 0; i < 1000; i++) {
+            Transform transform(glm::vec3(angle(random)), randomRotation(random), glm::vec3(1.0f, 2.0f, 3.0f));
+            const glm::mat4 before = transform.matrix();
+            const glm::vec3 axis = glm::normalize(glm::vec3(angle(random), angle(random), angle(random)));
+            const float turn = angle(random);
+            transform.rotate(turn, axis);
+            // a local turn goes between the scale and the existing rotation, not in front of the translation
+            const glm::mat4 expected = glm::scale(glm::rotate(glm::scale(before, 1.0f / glm::vec3(1.0f, 2.0f, 3.0f)), turn, axis),
+                                                  glm::vec3(1.0f, 2.0f, 3.0f));
+            CHECK_NEAR(largestDifference(transform.matrix(), expected), 0.0, 1e-4);
+        }
+
+        // facing down -z, a quarter turn about its own x tips it up to face +y whichever way it started
+        Transform facing;
+        facing.rotate(glm::half_pi<float>(), glm::vec3(1.0f, 0.0f, 0.0f));
+        CHECK_NEAR(glm::length(glm::vec3(facing.matrix() * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f)) - glm::vec3(0.0f, 1.0f, 0.0f)), 0.0, 1e-5);
+        Transform yawed = Transform::fromEuler(glm::vec3(0.0f), glm::vec3(0.0f, glm::half_pi<float>(), 0.0f), glm::vec3(1.0f));
+        yawed.rotate(glm::half_pi<float>(), glm::vec3(1.0f, 0.0f, 0.0f));
+        CHECK_NEAR(glm::length(glm::vec3(yawed.matrix() * glm::vec4(0.0f, 0.0f, -1.0f, 0.0f)) - glm::vec3(0.0f, 1.0f, 0.0f)), 0.0, 1e-5);
+    }
+
+    void smallTurnsDontDrift() {
+        // a frame's worth of spin at a time for ten minutes at 60fps, ending a whole number of turns round
+        Transform transform;
+        constexpr int STEPS = 36000;
+        for (int i = 0; i < STEPS; i++) {
+            transform.rotate(glm::two_pi<float>() * 10.0f / STEPS, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+        }
+        CHECK_NEAR(glm::length(transform.rotation), 1.0, 1e-6);
+        CHECK_NEAR(largestDifference(transform.matrix(), glm::mat4(1.0f)), 0.0, 1e-2);
+    }
+}
+
+int main() {
+    matrixMatchesGlm();
+    affineRowsMovePoints();
+    scaleIsInTheObjectsAxes();
+    eulerRoundTrips();
+    rotateTurnsAboutItsOwnAxes();
+    smallTurnsDontDrift();
+    return testResult("transform_test");
+}
@@ -0,0 +1,113 @@
+// every TransformBatch kernel this cpu can run against glm building the same matrices the long way, on counts that
+// do and don't fill the last group of 4 or 8 and on ranges that start part way in, plus what resize() fills in
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "transformbatch.h"
+#include "testing.h"
+
+namespace {
+
+    using Kernel = void (*)(const TransformBatch &, size_t, size_t, glm::mat4 *, glm::mat4 *);
+
+    // relative to the size of the matrix's entries, since the normal matrices of tiny scales have big ones
+    float largestDifference(const glm::mat4 &a, const glm::mat4 &b) {
+        float largest = 0.0f;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                largest = std::max(largest, std::abs(a[column][row] - b[column][row]) / std::max(1.0f, std::abs(b[column][row])));
+            }
+        }
+        return largest;
+    }
+
+    TransformBatch randomBatch(const size_t count, std::mt19937 &random) {
+        std::uniform_real_distribution<float> place(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> size(0.05f, 20.0f);
+        std::normal_distribution<float> normal;
+        TransformBatch batch;
+        batch.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            batch.set(i, {glm::vec3(place(random), place(random), place(random)),
+                          glm::normalize(glm::quat(normal(random), normal(random), normal(random), normal(random))),
+                          glm::vec3(size(random), size(random), size(random))});
+        }
+        return batch;
+    }
+
+    void matchesGlm(const char *name, const Kernel kernel) {
+        std::mt19937 random(4);
+        for (const size_t count : {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 1000, 1003}) {
+            const TransformBatch batch = randomBatch(count, random);
+            for (const size_t begin : {size_t(0), std::min(count, size_t(3))}) {
+                // anything the kernel shouldn't touch is left as a marker to check it wasn't written to
+                std::vector<glm::mat4> models(count, glm::mat4(7.0f)), normals(count, glm::mat4(7.0f));
+                kernel(batch, begin, count, models.data(), normals.data());
+                float largestModel = 0.0f, largestNormal = 0.0f;
+                for (size_t i = 0; i < count; i++) {
+                    if (i < begin) {
+                        CHECK(models[i] == glm::mat4(7.0f) && normals[i] == glm::mat4(7.0f));
+                        continue;
+                    }
+                    const Transform transform = batch.get(i);
+                    const glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), transform.position) * glm::mat4_cast(transform.rotation),
+                                                       transform.scale);
+                    largestModel = std::max(largestModel, largestDifference(models[i], model));
+                    largestNormal = std::max(largestNormal, largestDifference(normals[i], glm::mat4(glm::inverseTranspose(glm::mat3(model)))));
+                }
+                if (largestModel > 1e-5f || largestNormal > 1e-4f) {
+                    std::printf("%s: %zu transforms from %zu, off by %g (models) %g (normals)\n", name, count, begin, largestModel, largestNormal);
+                }
+                CHECK(largestModel <= 1e-5f);
+                CHECK(largestNormal <= 1e-4f);
+            }
+
+            // and without normals, which mustn't be written through
+            std::vector<glm::mat4> models(count);
+            kernel(batch, 0, count, models.data(), nullptr);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(largestDifference(models[i], batch.get(i).matrix()) <= 1e-5f);
+            }
+        }
+    }
+
+    void resizeFillsIdentities() {
+        TransformBatch batch;
+        batch.resize(5);
+        batch.set(2, {glm::vec3(1.0f), glm::quat(0.0f, 1.0f, 0.0f, 0.0f), glm::vec3(3.0f)});
+        batch.resize(20);
+        CHECK(batch.size() == 20);
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (i == 2) {
+                continue;
+            }
+            const Transform transform = batch.get(i);
+            CHECK(transform.position == glm::vec3(0.0f));
+            CHECK(transform.rotation == glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+            CHECK(transform.scale == glm::vec3(1.0f));
+        }
+        // what was set before is kept
+        CHECK(batch.get(2).scale == glm::vec3(3.0f));
+        std::vector<glm::mat4> models(batch.size());
+        batch.build(models.data());
+        CHECK(models[19] == glm::mat4(1.0f));
+    }
+}
+
+int main() {
+    std::printf("build() runs the %s kernel here\n", TransformBatch::path());
+    matchesGlm("scalar", TransformBatch::buildScalar);
+#ifdef TRANSFORM_BATCH_USE_SSE
+    matchesGlm("sse", TransformBatch::buildSse);
+    if (std::string(TransformBatch::path()) == "avx2") {
+        matchesGlm("avx2", TransformBatch::buildAvx2);
+    } else {
+        std::printf("no avx2 on this cpu, that kernel isn't tested\n");
+    }
+#endif
+    resizeFillsIdentities();
+    return testResult("transformbatch_test");
+}
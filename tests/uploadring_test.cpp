@@ -0,0 +1,222 @@
+// the upload ring on a real (headless) gl context, persistently mapped and then through the unsynchronized map
+// fallback: each frame's allocations land aligned inside its own region, regions are reused in turn as the fences
+// come round, what the gpu reads is what was written that frame even with later frames reusing the memory, and a
+// full region refuses allocations without writing anything or upsetting the frames after it
+#include <cstring>
+#include <vector>
+#include "headlessgl.h"
+#include "uploadring.h"
+#include "testing.h"
+
+namespace {
+
+    constexpr int FRAMES = 4 * UPLOAD_RING_FRAMES + 1;
+    constexpr int DRAWS_PER_FRAME = 50;
+
+    // copies the draw block it's given into its frame's slot of an ssbo, so what the gpu saw can be read back later
+    constexpr char COPY_SHADER[] = R"(#version 430
+        layout(local_size_x = 1) in;
+        layout(std140, binding = 1) uniform PerDraw {
+            mat4 model;
+            mat4 normalMatrix;
+            float shininess;
+        };
+        layout(std430, binding = 0) buffer Seen {
+            float seen[];
+        };
+        uniform int slot;
+        void main() {
+            seen[slot] = model[3][0] + shininess;
+        }
+    )";
+
+    double counter(const char *name) {
+        double value = 0.0;
+        profiler.inspect([&](unsigned long long, const auto &, const auto &counters) {
+            for (const auto &entry : counters) {
+                if (entry.name == name) {
+                    value = entry.value;
+                }
+            }
+        });
+        return value;
+    }
+
+    GLuint compileCopyShader() {
+        const GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+        const char *source = COPY_SHADER;
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        const GLuint program = glCreateProgram();
+        glAttachShader(program, shader);
+        glLinkProgram(program);
+        glDeleteShader(shader);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        CHECK(linked == GL_TRUE);
+        return program;
+    }
+
+    // the ring's buffer, found through a binding point since it's private
+    GLuint ringBuffer(const UploadRing &ring, const GLintptr offset) {
+        ring.bindUniform(UNIFORM_BLOCK_DRAW, offset, sizeof(DrawUniforms));
+        GLint buffer = 0;
+        glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, UNIFORM_BLOCK_DRAW, &buffer);
+        return static_cast<GLuint>(buffer);
+    }
+
+    DrawUniforms stamped(const float value) {
+        DrawUniforms draw{};
+        draw.model = glm::mat4(1.0f);
+        draw.model[3][0] = value;
+        draw.normalMatrix = glm::mat4(1.0f);
+        draw.shininess = 0.5f;
+        return draw;
+    }
+
+    float readBack(const GLuint buffer, const GLintptr offset) {
+        DrawUniforms draw{};
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, offset, sizeof(draw), &draw);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return draw.model[3][0];
+    }
+
+    // many frames round the ring, each with its own values, every draw's block read by the gpu as it goes
+    void framesGoRoundTheRing(UploadRing &ring, const GLuint copyProgram) {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+        GLuint seen = 0;
+        glGenBuffers(1, &seen);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, seen);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, FRAMES * DRAWS_PER_FRAME * sizeof(float), nullptr, GL_STATIC_READ);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, seen);
+        glUseProgram(copyProgram);
+        const GLint slotLocation = glGetUniformLocation(copyProgram, "slot");
+
+        std::vector<GLintptr> offsets[FRAMES];
+        bool aligned = true, inRegion = true, ordered = true;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            ring.beginFrame();
+            const GLintptr regionStart = static_cast<GLintptr>(frame % UPLOAD_RING_FRAMES) * UPLOAD_RING_FRAME_SIZE;
+            for (int draw = 0; draw < DRAWS_PER_FRAME; draw++) {
+                const GLintptr offset = ring.push(stamped(static_cast<float>(frame * 1000 + draw)));
+                aligned = aligned && offset % alignment == 0;
+                inRegion = inRegion && offset >= regionStart && offset + static_cast<GLintptr>(sizeof(DrawUniforms)) <= regionStart + UPLOAD_RING_FRAME_SIZE;
+                ordered = ordered && (offsets[frame].empty() || offset >= offsets[frame].back() + static_cast<GLintptr>(sizeof(DrawUniforms)));
+                offsets[frame].push_back(offset);
+            }
+            // the first draw of each frame starts its region
+            CHECK(offsets[frame][0] == regionStart);
+            ring.flush();
+            for (int draw = 0; draw < DRAWS_PER_FRAME; draw++) {
+                ring.bindUniform(UNIFORM_BLOCK_DRAW, offsets[frame][draw], sizeof(DrawUniforms));
+                glUniform1i(slotLocation, frame * DRAWS_PER_FRAME + draw);
+                glDispatchCompute(1, 1, 1);
+            }
+            ring.endFrame();
+
+            // the regions of the frames the gpu may still be reading haven't been touched
+            const GLuint buffer = ringBuffer(ring, offsets[frame][0]);
+            for (int back = 0; back < UPLOAD_RING_FRAMES && back <= frame; back++) {
+                const int earlier = frame - back;
+                CHECK(readBack(buffer, offsets[earlier][DRAWS_PER_FRAME - 1]) == static_cast<float>(earlier * 1000 + DRAWS_PER_FRAME - 1));
+            }
+        }
+        CHECK(aligned);
+        CHECK(inRegion);
+        CHECK(ordered);
+
+        // and each dispatch saw its own frame's values, not a later frame's written over them
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        std::vector<float> values(FRAMES * DRAWS_PER_FRAME);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, seen);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(values.size() * sizeof(float)), values.data());
+        int wrong = 0;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            for (int draw = 0; draw < DRAWS_PER_FRAME; draw++) {
+                wrong += values[frame * DRAWS_PER_FRAME + draw] != static_cast<float>(frame * 1000 + draw) + 0.5f;
+            }
+        }
+        CHECK(wrong == 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glDeleteBuffers(1, &seen);
+        glUseProgram(0);
+    }
+
+    // filling a region: every aligned slot that fits is handed out, then nothing, and nothing past the region is
+    // written
+    void fullRegionRefusesMore(UploadRing &ring) {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        const double overflows = counter("Upload ring overflows");
+
+        ring.beginFrame();
+        // too big for any region, and refused without taking anything from this one
+        std::vector<char> huge(UPLOAD_RING_FRAME_SIZE + 1, 1);
+        CHECK(ring.allocate(huge.data(), static_cast<GLsizeiptr>(huge.size())) == -1);
+        const GLintptr first = ring.push(stamped(1.0f));
+        CHECK(first % UPLOAD_RING_FRAME_SIZE == 0);
+        GLintptr last = first;
+        int handedOut = 1;
+        for (;;) {
+            const GLintptr offset = ring.push(stamped(static_cast<float>(handedOut + 1)));
+            if (offset < 0) {
+                break;
+            }
+            last = offset;
+            handedOut++;
+        }
+        // each block starts on the alignment, and the last one only has to fit, not fill a whole stride
+        const GLintptr size = sizeof(DrawUniforms);
+        const GLintptr stride = (size + alignment - 1) / alignment * alignment;
+        CHECK(handedOut == (UPLOAD_RING_FRAME_SIZE - size) / stride + 1);
+        CHECK(last + static_cast<GLintptr>(sizeof(DrawUniforms)) <= first + UPLOAD_RING_FRAME_SIZE);
+        CHECK(ring.push(stamped(-1.0f)) == -1);
+        CHECK(counter("Upload ring overflows") - overflows == 3.0);
+        ring.endFrame();
+        glFinish();
+        const GLuint buffer = ringBuffer(ring, first);
+        CHECK(readBack(buffer, first) == 1.0f);
+        CHECK(readBack(buffer, last) == static_cast<float>(handedOut));
+
+        // the next region along wasn't written by the refused pushes, and the frame after is back to normal
+        ring.beginFrame();
+        const GLintptr next = ring.push(stamped(42.0f));
+        CHECK(next == (first + UPLOAD_RING_FRAME_SIZE) % (UPLOAD_RING_FRAME_SIZE * UPLOAD_RING_FRAMES));
+        ring.endFrame();
+        glFinish();
+        CHECK(readBack(buffer, next) == 42.0f);
+    }
+}
+
+int main() {
+    HeadlessGl gl;
+    if (!gl.create(4, 4)) {
+        return TEST_SKIPPED;
+    }
+    std::printf("%s\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    const GLuint copyProgram = compileCopyShader();
+
+    {
+        UploadRing ring;
+        CHECK(ring.isPersistent());
+        framesGoRoundTheRing(ring, copyProgram);
+        fullRegionRefusesMore(ring);
+    }
+
+    // the path drivers without gl 4.4 take, mapping each frame's region unsynchronized and unmapping it in flush()
+    GLAD_GL_VERSION_4_4 = 0;
+    {
+        UploadRing ring;
+        CHECK(!ring.isPersistent());
+        framesGoRoundTheRing(ring, copyProgram);
+        fullRegionRefusesMore(ring);
+    }
+    GLAD_GL_VERSION_4_4 = 1;
+
+    glDeleteProgram(copyProgram);
+    CHECK(glGetError() == GL_NO_ERROR);
+    return testResult("uploadring_test");
+}
@@ -0,0 +1,682 @@
+// the asset baker: scans resources/ for models, follows each obj to the mtls it pulls in and those to the images they
+// name, picks up the skybox's faces, and bakes whatever changed since the last run into BAKED_ASSET_DIRECTORY (see
+// bakedasset.h). models are imported, welded, cache ordered and simplified into their levels of detail here rather
+// than at startup, and images are decoded and mipped. every output is named after the hash of what went into it, so
+// an asset changed back to how it was finds its old output still there. the outputs are then packed into the one
+// file the game loads (see assetpack.h). run from the project directory:
+//     AssetBaker [directory to scan, resources by default]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "assimp/Importer.hpp"
+#include "assimp/postprocess.h"
+#include "assimp/scene.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "assetpack.h"
+#include "bakedasset.h"
+#include "hash.h"
+#include "jobs.h"
+#include "scenegraph.h"
+#include "simplify.h"
+#include "stb_image.h"
+
+// simplified levels generated per mesh, as a fraction of the full triangle count
+constexpr float MODEL_LOD_RATIOS[] = {0.5f, 0.25f, 0.125f};
+// no collapse is allowed to move the surface by more than this fraction of the mesh's size
+constexpr float MODEL_LOD_MAX_ERROR = 0.05f;
+// a level is only kept if it drops at least this fraction of the previous level's triangles
+constexpr float MODEL_LOD_MIN_REDUCTION = 0.15f;
+
+namespace {
+
+    // one node of the graph as it's being baked
+    struct BakeItem {
+        AssetRecord record;
+        std::string status;
+        double milliseconds = 0.0;
+        bool bake = false;
+        bool failed = false;
+    };
+
+    std::string readFile(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    AssetDependency describe(const std::string &path) {
+        AssetDependency dependency{path, -1, 0};
+        std::error_code error;
+        const auto size = std::filesystem::file_size(path, error);
+        if (!error) {
+            dependency.size = static_cast<int64_t>(size);
+            dependency.time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        }
+        return dependency;
+    }
+
+    // every word after keyword on the lines starting with it, or only the last word of each (the file name, after
+    // any options) if lastOnly is set
+    std::vector<std::string> keywordArguments(const std::string &path, const std::string &keyword, const bool lastOnly) {
+        std::vector<std::string> found;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream words(line);
+            std::string word;
+            if (!(words >> word) || word != keyword) {
+                continue;
+            }
+            std::vector<std::string> arguments;
+            while (words >> word) {
+                arguments.push_back(word);
+            }
+            if (lastOnly && !arguments.empty()) {
+                found.push_back(arguments.back());
+            } else if (!lastOnly) {
+                found.insert(found.end(), arguments.begin(), arguments.end());
+            }
+        }
+        return found;
+    }
+
+    // the hash every output is named after: the baker's version, what kind of output it is and the contents of every
+    // file it depends on. only worked out for nodes whose files look changed, since it means reading them all
+    std::string contentKey(const AssetRecord &record) {
+        uint64_t key = fnv1a(&BAKED_ASSET_VERSION, sizeof(BAKED_ASSET_VERSION));
+        const char kind = record.texture ? (record.srgb ? 's' : 't') : 'm';
+        key = fnv1a(&kind, 1, key);
+        for (const AssetDependency &dependency : record.dependencies) {
+            const std::string bytes = readFile(dependency.path);
+            key = fnv1a(dependency.path.data(), dependency.path.size() + 1, key);
+            key = fnv1a(bytes.data(), bytes.size(), key);
+        }
+        std::stringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << key;
+        return name.str();
+    }
+
+    // written next to where it's going and renamed over it, so a bake that's interrupted never leaves half a file
+    bool writeOutput(const std::string &output, const std::vector<char> &bytes) {
+        const std::string path = AssetManifest::outputPath(output);
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            if (!file) {
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+
+    template<typename T>
+    void append(std::vector<char> &out, const T *data, const size_t count) {
+        const auto *bytes = reinterpret_cast<const char *>(data);
+        out.insert(out.end(), bytes, bytes + count * sizeof(T));
+    }
+
+    // ---- models ----
+
+    struct BakedMesh {
+        std::vector<BakedVertex> vertices;
+        std::vector<uint32_t> elements;
+        std::vector<BakedLodRecord> lods;
+        BakedMeshRecord record{};
+        std::string diffuseTexture;
+        std::string specularTexture;
+    };
+
+    // assimp's matrices are row major, glm's column major
+    glm::mat4 toGlm(const aiMatrix4x4 &m) {
+        return glm::transpose(glm::make_mat4(&m.a1));
+    }
+
+    // walks the node tree into a scene graph of the model's nodes, collecting the meshes in draw order. each node's
+    // transform is relative to its parent, as in the source file
+    void processNode(const aiNode *node, const aiScene *scene, SceneGraph &nodes, const int parent, std::vector<std::pair<const aiMesh *, int>> &found) {
+        const int handle = nodes.addNode(toGlm(node->mTransformation), parent);
+        for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+            found.emplace_back(scene->mMeshes[node->mMeshes[i]], handle);
+        }
+        for (unsigned int i = 0; i < node->mNumChildren; i++) {
+            processNode(node->mChildren[i], scene, nodes, handle, found);
+        }
+    }
+
+    // copies the vertices and indices out of an imported mesh, placed by the transform of the node it hangs off.
+    // normals go through the inverse transpose so they stay perpendicular under non uniform scales. the shader
+    // normalises them, so any scale left in them does no harm
+    void readGeometry(const aiMesh *mesh, const glm::mat4 &transform, BakedMesh &out) {
+        const glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+        out.vertices.resize(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+            const glm::vec3 position = glm::vec3(transform * glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f));
+            const glm::vec3 normal = normalTransform * glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            const glm::vec2 texCoords = mesh->mTextureCoords[0] ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+            BakedVertex &vertex = out.vertices[i];
+            std::memcpy(vertex.position, &position, sizeof(vertex.position));
+            std::memcpy(vertex.normal, &normal, sizeof(vertex.normal));
+            std::memcpy(vertex.texCoords, &texCoords, sizeof(vertex.texCoords));
+        }
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+            const aiFace &face = mesh->mFaces[i];
+            out.elements.insert(out.elements.end(), face.mIndices, face.mIndices + face.mNumIndices);
+        }
+    }
+
+    // simplifies the mesh to each of MODEL_LOD_RATIOS, always from the full mesh so each level's error is measured
+    // against the original surface, and appends the levels after level 0. stops once the simplifier can't get
+    // meaningfully further
+    void buildLods(BakedMesh &mesh) {
+        std::vector<glm::vec3> positions(mesh.vertices.size());
+        std::vector<glm::vec2> texCoords(mesh.vertices.size());
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            positions[i] = glm::make_vec3(mesh.vertices[i].position);
+            texCoords[i] = glm::make_vec2(mesh.vertices[i].texCoords);
+            min = glm::min(min, positions[i]);
+            max = glm::max(max, positions[i]);
+        }
+        const float maxError = glm::length(max - min) * MODEL_LOD_MAX_ERROR;
+
+        const std::vector<unsigned int> full(mesh.elements.begin(), mesh.elements.end());
+        mesh.lods.push_back({0, static_cast<uint32_t>(full.size()), 0.0f});
+        size_t previous = full.size();
+        for (const float ratio : MODEL_LOD_RATIOS) {
+            const auto target = static_cast<size_t>(static_cast<float>(full.size()) * ratio) / 3 * 3;
+            const SimplifyResult level = simplifyMesh(positions, texCoords, full, target, maxError);
+            if (static_cast<float>(level.indices.size()) > static_cast<float>(previous) * (1.0f - MODEL_LOD_MIN_REDUCTION)) {
+                break;
+            }
+            previous = level.indices.size();
+            mesh.lods.push_back({static_cast<uint32_t>(mesh.elements.size()), static_cast<uint32_t>(level.indices.size()), level.error});
+            mesh.elements.insert(mesh.elements.end(), level.indices.begin(), level.indices.end());
+        }
+    }
+
+    // renumbers the vertices in the order level 0 first uses them, which assimp has already ordered for the post
+    // transform cache, so the vertex fetches walk through memory too. vertices nothing uses are dropped
+    void orderVertices(BakedMesh &mesh) {
+        std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+        std::vector<BakedVertex> ordered;
+        ordered.reserve(mesh.vertices.size());
+        for (uint32_t &index : mesh.elements) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = static_cast<uint32_t>(ordered.size());
+                ordered.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices = std::move(ordered);
+    }
+
+    // the material's colours and the source paths of its textures, the same way the game read them from assimp
+    void readMaterial(const aiMaterial *material, const std::filesystem::path &directory, BakedMesh &mesh) {
+        BakedMeshRecord &record = mesh.record;
+        const glm::vec3 white(1.0f), black(0.0f);
+        std::memcpy(record.diffuse, &white, sizeof(record.diffuse));
+        std::memcpy(record.specular, &black, sizeof(record.specular));
+        std::memcpy(record.ambient, &black, sizeof(record.ambient));
+        record.shininess = 32.0f;
+
+        aiColor3D colour(0.0f, 0.0f, 0.0f);
+        float shininess = 0.0f;
+        if (material->Get(AI_MATKEY_COLOR_DIFFUSE, colour) == AI_SUCCESS) {
+            record.diffuse[0] = colour.r; record.diffuse[1] = colour.g; record.diffuse[2] = colour.b;
+        }
+        if (material->Get(AI_MATKEY_COLOR_AMBIENT, colour) == AI_SUCCESS) {
+            record.ambient[0] = colour.r; record.ambient[1] = colour.g; record.ambient[2] = colour.b;
+        }
+        if (material->Get(AI_MATKEY_COLOR_SPECULAR, colour) == AI_SUCCESS) {
+            record.specular[0] = colour.r; record.specular[1] = colour.g; record.specular[2] = colour.b;
+        }
+        // most of the exporters this has seen write Ns as 0-1 rather than a phong exponent, those keep the default
+        if (material->Get(AI_MATKEY_SHININESS, shininess) == AI_SUCCESS && shininess >= 1.0f) {
+            record.shininess = shininess;
+        }
+
+        aiString path;
+        if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0 && material->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS) {
+            mesh.diffuseTexture = AssetManifest::normalise((directory / path.C_Str()).string());
+        }
+        if (material->GetTextureCount(aiTextureType_SPECULAR) > 0 && material->GetTexture(aiTextureType_SPECULAR, 0, &path) == AI_SUCCESS) {
+            mesh.specularTexture = AssetManifest::normalise((directory / path.C_Str()).string());
+        }
+    }
+
+    bool bakeModel(BakeItem &item) {
+        const std::string &source = item.record.source;
+        Assimp::Importer importer;
+        const aiScene *scene = importer.ReadFile(source, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals |
+                                                         aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            item.status = std::string("import failed: ") + importer.GetErrorString();
+            return false;
+        }
+
+        // the node hierarchy places sub meshes relative to each other. it's static, so the placement is baked into
+        // the vertices and everything reading model space (bounds, bvhs, heightfields) sees it
+        SceneGraph nodes;
+        std::vector<std::pair<const aiMesh *, int>> found;
+        processNode(scene->mRootNode, scene, nodes, -1, found);
+        nodes.update();
+
+        // simplifying is most of the work and every mesh's is independent
+        std::vector<BakedMesh> meshes(found.size());
+        jobs.parallelFor(static_cast<int>(found.size()), [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                readGeometry(found[i].first, nodes.world(found[i].second), meshes[i]);
+                buildLods(meshes[i]);
+                orderVertices(meshes[i]);
+            }
+        }, 1);
+        const std::filesystem::path directory = std::filesystem::path(source).parent_path();
+        for (size_t i = 0; i < found.size(); i++) {
+            readMaterial(scene->mMaterials[found[i].first->mMaterialIndex], directory, meshes[i]);
+        }
+
+        BakedModelHeader header{};
+        std::memcpy(header.magic, BAKED_MODEL_MAGIC, sizeof(header.magic));
+        header.version = BAKED_ASSET_VERSION;
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        for (const BakedMesh &mesh : meshes) {
+            for (const BakedVertex &vertex : mesh.vertices) {
+                min = glm::min(min, glm::make_vec3(vertex.position));
+                max = glm::max(max, glm::make_vec3(vertex.position));
+            }
+        }
+        if (!meshes.empty()) {
+            const glm::vec3 centre = (min + max) * 0.5f;
+            std::memcpy(header.boundsCentre, &centre, sizeof(header.boundsCentre));
+            header.boundsRadius = glm::length(max - min) * 0.5f;
+        }
+
+        std::vector<char> strings;
+        std::set<std::string> textures;
+        const auto addString = [&strings, &textures](const std::string &text) {
+            if (text.empty()) {
+                return BAKED_NO_TEXTURE;
+            }
+            textures.insert(text);
+            const auto offset = static_cast<uint32_t>(strings.size());
+            strings.insert(strings.end(), text.c_str(), text.c_str() + text.size() + 1);
+            return offset;
+        };
+
+        // everything in the data section is 4 byte values, so laying it out in order keeps it aligned
+        uint64_t offset = sizeof(BakedModelHeader) + meshes.size() * sizeof(BakedMeshRecord);
+        for (BakedMesh &mesh : meshes) {
+            BakedMeshRecord &record = mesh.record;
+            record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+            record.indexCount = static_cast<uint32_t>(mesh.elements.size());
+            record.lodCount = static_cast<uint32_t>(mesh.lods.size());
+            record.vertexOffset = offset;
+            offset += mesh.vertices.size() * sizeof(BakedVertex);
+            record.indexOffset = offset;
+            offset += mesh.elements.size() * sizeof(uint32_t);
+            record.lodOffset = offset;
+            offset += mesh.lods.size() * sizeof(BakedLodRecord);
+            record.diffuseTexture = addString(mesh.diffuseTexture);
+            record.specularTexture = addString(mesh.specularTexture);
+        }
+        header.stringOffset = offset;
+        header.stringBytes = static_cast<uint32_t>(strings.size());
+
+        std::vector<char> out;
+        out.reserve(offset + strings.size());
+        append(out, &header, 1);
+        for (const BakedMesh &mesh : meshes) {
+            append(out, &mesh.record, 1);
+        }
+        for (const BakedMesh &mesh : meshes) {
+            append(out, mesh.vertices.data(), mesh.vertices.size());
+            append(out, mesh.elements.data(), mesh.elements.size());
+            append(out, mesh.lods.data(), mesh.lods.size());
+        }
+        append(out, strings.data(), strings.size());
+
+        item.record.textures.assign(textures.begin(), textures.end());
+        if (!writeOutput(item.record.output, out)) {
+            item.status = "couldn't write " + AssetManifest::outputPath(item.record.output);
+            return false;
+        }
+        return true;
+    }
+
+    // ---- textures ----
+
+    // halves an rgba8 image, averaging each 2x2 block. colour textures are averaged in linear space, or the mips
+    // come out darker than the texture they're of; alpha always is linear. the last row and column of an odd sized
+    // level fold into their neighbours, the same as the level sizes gl expects
+    std::vector<unsigned char> downsample(const std::vector<unsigned char> &source, const uint32_t width, const uint32_t height, const bool srgb,
+                                          const float *toLinear) {
+        const uint32_t outWidth = std::max(width >> 1, 1u);
+        const uint32_t outHeight = std::max(height >> 1, 1u);
+        std::vector<unsigned char> out(static_cast<size_t>(outWidth) * outHeight * 4);
+        for (uint32_t y = 0; y < outHeight; y++) {
+            const uint32_t y0 = std::min(y * 2, height - 1);
+            const uint32_t y1 = y == outHeight - 1 ? height - 1 : std::min(y * 2 + 1, height - 1);
+            for (uint32_t x = 0; x < outWidth; x++) {
+                const uint32_t x0 = std::min(x * 2, width - 1);
+                const uint32_t x1 = x == outWidth - 1 ? width - 1 : std::min(x * 2 + 1, width - 1);
+                float sums[4] = {};
+                int count = 0;
+                for (uint32_t sy = y0; sy <= y1; sy++) {
+                    for (uint32_t sx = x0; sx <= x1; sx++) {
+                        const unsigned char *texel = &source[(static_cast<size_t>(sy) * width + sx) * 4];
+                        for (int c = 0; c < 4; c++) {
+                            sums[c] += srgb && c < 3 ? toLinear[texel[c]] : static_cast<float>(texel[c]) / 255.0f;
+                        }
+                        count++;
+                    }
+                }
+                unsigned char *texel = &out[(static_cast<size_t>(y) * outWidth + x) * 4];
+                for (int c = 0; c < 4; c++) {
+                    float value = sums[c] / static_cast<float>(count);
+                    if (srgb && c < 3) {
+                        value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                    }
+                    texel[c] = static_cast<unsigned char>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+                }
+            }
+        }
+        return out;
+    }
+
+    bool bakeTexture(BakeItem &item) {
+        int width = 0, height = 0, channels = 0;
+        unsigned char *data = stbi_load(item.record.source.c_str(), &width, &height, &channels, 4);
+        if (!data) {
+            item.status = std::string("decode failed: ") + stbi_failure_reason();
+            return false;
+        }
+
+        float toLinear[256];
+        for (int i = 0; i < 256; i++) {
+            const float c = static_cast<float>(i) / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        BakedTextureHeader header{};
+        std::memcpy(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic));
+        header.version = BAKED_ASSET_VERSION;
+        header.width = static_cast<uint32_t>(width);
+        header.height = static_cast<uint32_t>(height);
+        header.srgb = item.record.srgb ? 1 : 0;
+        header.levels = 1;
+        while ((std::max(header.width, header.height) >> header.levels) > 0) {
+            header.levels++;
+        }
+
+        std::vector<char> out;
+        append(out, &header, 1);
+        std::vector<unsigned char> level(data, data + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(data);
+        for (uint32_t mip = 0; mip < header.levels; mip++) {
+            append(out, level.data(), level.size());
+            if (mip + 1 < header.levels) {
+                level = downsample(level, bakedMipSize(header.width, mip), bakedMipSize(header.height, mip), item.record.srgb, toLinear);
+            }
+        }
+
+        if (!writeOutput(item.record.output, out)) {
+            item.status = "couldn't write " + AssetManifest::outputPath(item.record.output);
+            return false;
+        }
+        return true;
+    }
+
+    // ---- the graph ----
+
+    // every obj under root, and through their mtls every image they use, plus the sky's faces: any image in a
+    // directory called skybox. an image used as a colour map and as a data map is two nodes, since it's baked
+    // differently for each
+    std::vector<BakeItem> scan(const std::string &root) {
+        std::vector<std::string> objs;
+        std::set<std::pair<std::string, bool>> textures;
+        std::error_code error;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            if (!it->is_regular_file()) {
+                continue;
+            }
+            std::string extension = it->path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (extension == ".obj") {
+                objs.push_back(AssetManifest::normalise(it->path().string()));
+            } else if ((extension == ".jpg" || extension == ".jpeg" || extension == ".png") && it->path().parent_path().filename() == "skybox") {
+                textures.emplace(AssetManifest::normalise(it->path().string()), true);
+            }
+        }
+        std::sort(objs.begin(), objs.end());
+
+        std::vector<BakeItem> items;
+        for (const std::string &obj : objs) {
+            BakeItem model;
+            model.record.source = obj;
+            model.record.dependencies.push_back(describe(obj));
+            const std::filesystem::path directory = std::filesystem::path(obj).parent_path();
+            for (const std::string &library : keywordArguments(obj, "mtllib", false)) {
+                const std::string mtl = AssetManifest::normalise((directory / library).string());
+                model.record.dependencies.push_back(describe(mtl));
+                // assimp looks textures up next to the obj, whatever directory the mtl is in
+                for (const std::string &map : keywordArguments(mtl, "map_Kd", true)) {
+                    textures.emplace(AssetManifest::normalise((directory / map).string()), true);
+                }
+                for (const std::string &map : keywordArguments(mtl, "map_Ks", true)) {
+                    textures.emplace(AssetManifest::normalise((directory / map).string()), false);
+                }
+            }
+            items.push_back(std::move(model));
+        }
+        for (const auto &[path, srgb] : textures) {
+            BakeItem texture;
+            texture.record.source = path;
+            texture.record.texture = true;
+            texture.record.srgb = srgb;
+            texture.record.dependencies.push_back(describe(path));
+            items.push_back(std::move(texture));
+        }
+        return items;
+    }
+
+    bool sameFiles(const AssetRecord &a, const AssetRecord &b) {
+        if (a.dependencies.size() != b.dependencies.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.dependencies.size(); i++) {
+            const AssetDependency &x = a.dependencies[i], &y = b.dependencies[i];
+            if (x.path != y.path || x.size != y.size || x.time != y.time) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool exists(const std::string &path) {
+        std::error_code error;
+        return std::filesystem::exists(path, error);
+    }
+
+    // ---- the pack ----
+
+    // hash of every output that goes in the pack and what it's packed as. the outputs are named after their content,
+    // so if this matches the pack that's there, nothing in it would change
+    uint64_t packKey(const std::vector<const AssetRecord *> &records) {
+        uint64_t key = fnv1a(&ASSET_PACK_VERSION, sizeof(ASSET_PACK_VERSION));
+        key = fnv1a(&ASSET_PACK_MAX_COMPRESSED_RATIO, sizeof(ASSET_PACK_MAX_COMPRESSED_RATIO), key);
+        for (const AssetRecord *record : records) {
+            const uint16_t kind = assetPackKind(record->texture, record->srgb);
+            key = fnv1a(record->source.c_str(), record->source.size() + 1, key);
+            key = fnv1a(&kind, sizeof(kind), key);
+            key = fnv1a(record->output.c_str(), record->output.size() + 1, key);
+        }
+        return key;
+    }
+
+    // packs every output in the manifest into ASSET_PACK_PATH, lz4 compressing the blobs that are worth it. returns
+    // false if it couldn't be written; status says what happened either way
+    bool writePack(const AssetManifest &manifest, std::string &status) {
+        std::vector<const AssetRecord *> records;
+        for (const AssetRecord &record : manifest.records) {
+            records.push_back(&record);
+        }
+        std::sort(records.begin(), records.end(), [](const AssetRecord *a, const AssetRecord *b) {
+            const uint16_t kindA = assetPackKind(a->texture, a->srgb), kindB = assetPackKind(b->texture, b->srgb);
+            return a->source != b->source ? a->source < b->source : kindA < kindB;
+        });
+        const uint64_t key = packKey(records);
+        {
+            AssetPack existing;
+            if (existing.open(ASSET_PACK_PATH) && existing.contentKey() == key) {
+                status = "up to date";
+                return true;
+            }
+        }
+
+        // reading and compressing is the slow part, and each blob's is independent
+        std::vector<AssetPackBlob> blobs(records.size());
+        std::atomic<bool> missing = false;
+        jobs.parallelFor(static_cast<int>(records.size()), [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++) {
+                AssetPackBlob &blob = blobs[i];
+                blob.source = records[i]->source;
+                blob.kind = assetPackKind(records[i]->texture, records[i]->srgb);
+                blob.bytes = readFile(AssetManifest::outputPath(records[i]->output));
+                if (blob.bytes.empty()) {
+                    missing = true;
+                    continue;
+                }
+                compressAssetPackBlob(blob);
+            }
+        }, 1);
+        if (missing) {
+            status = "an output went missing while packing";
+            return false;
+        }
+        return writeAssetPack(ASSET_PACK_PATH, blobs, key, status);
+    }
+}
+
+int main(const int argc, char **argv) {
+    const auto start = std::chrono::steady_clock::now();
+    const std::string root = argc > 1 ? argv[1] : "resources";
+
+    std::error_code error;
+    std::filesystem::create_directories(BAKED_ASSET_DIRECTORY, error);
+    AssetManifest previous;
+    previous.load(BAKED_ASSET_MANIFEST);
+
+    std::vector<BakeItem> items = scan(root);
+
+    // a node whose files all have the size and time they had last run, and whose output is still there, is done
+    // without reading anything. otherwise its content decides: an output by that hash may already exist (a file that
+    // was only touched, or changed back), and if not it's baked
+    std::vector<int> toBake;
+    for (int i = 0; i < static_cast<int>(items.size()); i++) {
+        BakeItem &item = items[i];
+        if (item.record.dependencies.front().size < 0) {
+            item.status = "missing";
+            item.failed = true;
+            continue;
+        }
+        const AssetRecord *last = previous.find(item.record.source, item.record.texture, item.record.srgb);
+        if (last && sameFiles(*last, item.record) && exists(AssetManifest::outputPath(last->output))) {
+            item.record.output = last->output;
+            item.record.textures = last->textures;
+            item.status = "up to date";
+            continue;
+        }
+        item.bake = true;
+        toBake.push_back(i);
+    }
+
+    jobs.parallelFor(static_cast<int>(toBake.size()), [&](const int begin, const int end) {
+        for (int i = begin; i < end; i++) {
+            BakeItem &item = items[toBake[i]];
+            const auto itemStart = std::chrono::steady_clock::now();
+            item.record.output = contentKey(item.record);
+            const AssetRecord *last = previous.find(item.record.source, item.record.texture, item.record.srgb);
+            if (exists(AssetManifest::outputPath(item.record.output)) && (item.record.texture || (last && last->output == item.record.output))) {
+                if (last) {
+                    item.record.textures = last->textures;
+                }
+                item.status = "unchanged";
+            } else if (item.record.texture ? bakeTexture(item) : bakeModel(item)) {
+                item.status = "baked";
+            } else {
+                item.failed = true;
+            }
+            item.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - itemStart).count();
+        }
+    }, 1);
+
+    AssetManifest manifest;
+    std::unordered_set<std::string> outputs;
+    int baked = 0, reused = 0, missing = 0, failed = 0, models = 0;
+    for (BakeItem &item : items) {
+        models += item.record.texture ? 0 : 1;
+        std::cout << "  " << std::left << std::setw(11) << item.status.substr(0, item.status.find(':')) << std::right << std::setw(9)
+                  << std::fixed << std::setprecision(1) << item.milliseconds << " ms  " << (item.record.texture ? "texture " : "model   ")
+                  << item.record.source << (item.record.texture && item.record.srgb ? " (srgb)" : "");
+        if (item.failed && item.status.find(':') != std::string::npos) {
+            std::cout << " - " << item.status.substr(item.status.find(':') + 2);
+        }
+        std::cout << std::endl;
+        if (item.failed) {
+            (item.status == "missing" ? missing : failed)++;
+            continue;
+        }
+        (item.status == "baked" ? baked : reused)++;
+        outputs.insert(item.record.output);
+        manifest.records.push_back(std::move(item.record));
+    }
+    if (!manifest.save(BAKED_ASSET_MANIFEST)) {
+        std::cout << "ASSETS: couldn't write " << BAKED_ASSET_MANIFEST << std::endl;
+        return 1;
+    }
+
+    // outputs nothing refers to any more are from assets that changed or went away
+    int pruned = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(BAKED_ASSET_DIRECTORY, error)) {
+        if (entry.path().extension() == ".bin" && !outputs.count(entry.path().stem().string())) {
+            std::filesystem::remove(entry.path(), error);
+            pruned++;
+        }
+    }
+
+    const auto packStart = std::chrono::steady_clock::now();
+    std::string packStatus;
+    const bool packed = writePack(manifest, packStatus);
+    std::cout << "  " << std::left << std::setw(11) << (packed ? "pack" : "pack failed") << std::right << std::setw(9) << std::fixed
+              << std::setprecision(1) << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - packStart).count() << " ms  "
+              << ASSET_PACK_PATH << " - " << packStatus << std::endl;
+
+    const double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "AssetBaker: " << models << " models, " << items.size() - models << " textures. baked " << baked << ", reused "
+              << reused << ", missing " << missing << ", failed " << failed << ", pruned " << pruned << " stale outputs in " << total << " ms" << std::endl;
+    if (!packed) {
+        return 1;
+    }
+    // an image an mtl names that isn't there is the model's problem at runtime, not a reason to stop the build
+    for (const BakeItem &item : items) {
+        if (item.failed && !item.record.texture) {
+            return 1;
+        }
+    }
+    return 0;
+}